@@ -10,6 +10,7 @@
 #include <osapi.h>
 #include "user_task.h"
 #include "user_flash.h"
+#include "user_kv.h"
 
 // Port Definitions
 #define CONFIG_PORT 4000
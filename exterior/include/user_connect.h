@@ -11,10 +11,16 @@
 #include "user_task.h"
 #include "user_network.h"
 #include "user_humidity.h"
+#include "user_link.h"
 
 // Port definitions
 #define ESPCONNECT_ACCEPT 6000
 
+// Readings sent to the interior per frame. Larger batches leave the radio idle
+// for longer; smaller ones reach the interior sooner. A failed reading is sent
+// at once, whatever the batch holds
+#define LINK_BATCH_N 4
+
 /* ------------------- */
 /* Function prototypes */
 /* ------------------- */
@@ -37,7 +43,8 @@ void ICACHE_FLASH_ATTR user_int_connect_init(os_event_t *e);
 void ICACHE_FLASH_ATTR user_int_connect_cb(void *arg);
 
 // Callback Function: user_tcp_accept_recv_cb(void *arg, char *pusrdata, unsigned short length);
-// Desc: Data receipt callback (accept version). Called when the client sends a packet to the server
+// Desc: Data receipt callback (accept version). Called when the client sends a packet to the server.
+//	Feeds the link decoder, which counts the interior's LINK_ACK frames
 // Args:
 // 	void *arg: pointer to the espconn which called this function
 // 	char *pusrdata: recieved client data
@@ -80,7 +87,10 @@ void ICACHE_FLASH_ATTR user_tcp_sent_cb(void *arg);
 void ICACHE_FLASH_ATTR user_int_connect_cleanup(os_event_t *e);
 
 // User Task: user_int_send_data(os_event_t *e)
-// Desc: Sends humidity data to the interior 
+// Desc: Adds the latest reading to the batch for the interior, and sends the
+//	batch as one LINK_SAMPLES frame once it holds LINK_BATCH_N readings or
+//	the sensor has failed. A batch which could not be sent is kept and sent
+//	with the next reading
 // Args:
 //	os_event_t *e: Point to OS event data
 // Return:
@@ -0,0 +1,69 @@
+// user_dispatch.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Table driven state machine used by the control task. Each
+//	firmware describes its control flow as a list of states and a transition
+//	table keyed on the combined sig | par of the posted event (see user_task.h),
+//	and user_control_task hands every event to user_dispatch.
+
+#ifndef _USER_DISPATCH_H
+#define _USER_DISPATCH_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_task.h"
+
+#define STATE_ANY	0xFF	// Transition applies in every state (from)
+#define STATE_SAME	0xFF	// Transition does not change state (to)
+
+// Handler called with the event that caused the transition
+typedef void (*user_dispatch_fn)(os_event_t *e);
+
+// State descriptor. entry/exit run only when a transition actually changes state.
+// A final state ignores every further event, so nothing is re-posted while the
+// system waits to be restarted
+struct user_state {
+	const char *name;		// Name for debug messages
+	user_dispatch_fn entry;		// Run on entering the state, or NULL
+	user_dispatch_fn exit;		// Run on leaving the state, or NULL
+	bool final;			// Drop all events while in this state
+};
+
+// Transition table entry. Tables must be sorted by event; entries for the same
+// event may be given once per from state, and a STATE_ANY entry is the fallback
+struct user_transition {
+	uint32 event;			// sig | par that triggers the transition
+	uint8 from;			// State the transition applies in, or STATE_ANY
+	uint8 to;			// State to enter, or STATE_SAME
+	user_dispatch_fn action;	// Run between the exit and entry hooks, or NULL
+};
+
+// State machine
+struct user_machine {
+	const struct user_state *states;	// State descriptors, indexed by state number
+	const struct user_transition *table;	// Transition table, sorted by event
+	uint16 table_n;				// Number of transitions
+	uint8 state;				// Current state
+};
+
+// Application Function: user_dispatch_init(struct user_machine *m, uint8 state)
+// Desc: Checks the transition table is sorted and sets the initial state.
+//	The initial state's entry hook is not run
+// Args:
+//	struct user_machine *m: State machine
+//	uint8 state: Initial state
+// Returns:
+//	false if the table is not sorted by event
+bool ICACHE_FLASH_ATTR user_dispatch_init(struct user_machine *m, uint8 state);
+
+// Application Function: user_dispatch(struct user_machine *m, os_event_t *e)
+// Desc: Looks up the transition for an event in the current state and runs
+//	it: the current state's exit hook, the transition action, then the new
+//	state's entry hook. Events without a transition are ignored
+// Args:
+//	struct user_machine *m: State machine
+//	os_event_t *e: Posted event
+// Returns:
+//	true if a transition was taken
+bool ICACHE_FLASH_ATTR user_dispatch(struct user_machine *m, os_event_t *e);
+
+#endif
@@ -0,0 +1,71 @@
+// user_dlog.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Deferred debug log behind PRINT_DEBUG. Rather than format and
+//	print a message while the caller waits on the UART, user_dlog packs the
+//	format string's address and the raw arguments into a binary record in a
+//	RAM ring, and a priority 0 task feeds whole records to the UART FIFO as
+//	it has room. host/dlog_decode.py turns the records back into text with
+//	the format strings from the firmware's ELF file.
+//
+//	Byte 0-1:  DLOG_SYNC_0, DLOG_SYNC_1
+//	Byte 2:    Length of the rest of the record
+//	Byte 3-6:  Format string address less that of user_dlog_base, signed
+//	Byte 7-:   One field per conversion in the format string: %s as a
+//	           length byte and up to DLOG_STR_MAX characters, the rest as
+//	           32 bit values. Multi-byte fields are little endian
+//
+//	Fields which do not fit in DLOG_RECORD_MAX are left off, and the decoder
+//	shows them as '?'. A record which does not fit in the ring is dropped and
+//	counted, and the count goes out in a record of its own once there is room.
+//	Output written straight to the UART, e.g. by os_printf, passes through the
+//	decoder unchanged. With DEBUG_LEVEL at DEBUG_NONE there is nothing to
+//	log, and only user_dlog_init (which does nothing) is built.
+//	This file is shared by the interior and exterior builds.
+
+#ifndef _USER_DLOG_H
+#define _USER_DLOG_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include <ets_sys.h>
+
+#define DLOG_SYNC_0		0xA5
+#define DLOG_SYNC_1		0x5A
+#define DLOG_HEADER		7		// Sync, length and format address
+#define DLOG_RECORD_MAX		120		// Largest record, fits the UART FIFO whole
+#define DLOG_STR_MAX		32		// Most characters kept of a %s argument
+#define DLOG_RING_SIZE		2048		// Ring bytes (power of 2)
+#define DLOG_WAIT_TIME		5		// Wait (ms) for the UART FIFO to drain when a record does not fit
+
+// UART0 transmit registers, as in the SDK's driver/uart_register.h
+#define DLOG_UART_FIFO		0x60000000
+#define DLOG_UART_STATUS	0x6000001C
+#define DLOG_UART_TX_COUNT(status)	(((status) >> 16) & 0xFF)	// Bytes waiting in the FIFO
+#define DLOG_UART_FIFO_SIZE	128
+
+// Format addresses are stored relative to this string, which is also the
+// format of the dropped records count
+extern const char user_dlog_base[];
+
+// Application Function: user_dlog(const char *fmt, ...)
+// Desc: Queues a debug message. Use PRINT_DEBUG rather than calling this.
+//	Understands the conversions os_printf does: %d, %u, %x, %c and %s, with
+//	flags and widths
+// Args:
+//	const char *fmt: Format string, which must be a literal so its address
+//		is in the ELF file
+//	...: Arguments
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_dlog(const char *fmt, ...);
+
+// Application Function: user_dlog_init(void)
+// Desc: Registers the drain task on priority 0 and starts sending whatever
+//	was logged before it. Call once user_msg_queue_0 is allocated
+// Args:
+//	None
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_dlog_init(void);
+
+#endif
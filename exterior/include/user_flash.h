@@ -15,9 +15,9 @@
 // starting from 0
 // ----------
 #define USER_DATA_START_ADDR            0x00070000
-#define USER_DATA_START_SECT            USER_DATA_START_ADDR / (4 * 1024)
+#define USER_DATA_START_SECT            (USER_DATA_START_ADDR / (4 * 1024))
 #define USER_DATA_END_ADDR              0x00080000
-#define USER_DATA_END_SECT              USER_DATA_END_SECT / (4 * 1024)        
+#define USER_DATA_END_SECT              (USER_DATA_END_ADDR / (4 * 1024))
 
 // Flash read/write macros
 // ----------
@@ -18,13 +18,52 @@
 // Humidity data read interval in ms
 #define HUMIDITY_READ_INTERVAL 3000
 
+// Measurement cycle timing in ms. The average HIH8121 measurement cycle takes 36.65ms,
+// so the data is first fetched after HUMIDITY_CONVERSION_TIME. If the sensor still
+// reports stale data, the fetch is retried every HUMIDITY_RETRY_TIME, up to HUMIDITY_RETRY_MAX times
+#define HUMIDITY_CONVERSION_TIME 40
+#define HUMIDITY_RETRY_TIME 10
+#define HUMIDITY_RETRY_MAX 6
+
+// HIH8121 status codes, reported in the upper two bits of the first data byte
+#define HUMIDITY_STATUS_VALID	0	// Valid data which has not yet been fetched
+#define HUMIDITY_STATUS_STALE	1	// Data has already been fetched/a measurement is in progress
+#define HUMIDITY_STATUS_CMD	2	// Sensor is in command mode
+#define HUMIDITY_STATUS_DIAG	3	// Sensor is in a diagnostic condition
+
+// Sensor status bits (sensor_status). These are the LINK_STATUS_* bits the
+// interior is sent, see user_link.h
+#define SENSOR_OK	0x01	// Last reading succeeded
+#define SENSOR_FAIL	0x02	// Sensor did not respond or never finished converting
+#define SENSOR_DIAG	0x04	// Sensor reported command or diagnostic mode
+
+// Humidity acquisition states. A reading is split into a measurement request
+// and a data fetch from a timer callback, so the CPU is never blocked while the
+// sensor converts
+typedef enum {
+	HUMIDITY_IDLE       = 0,	// No measurement in progress
+	HUMIDITY_CONVERTING = 1,	// Measurement requested, waiting to fetch the data
+} HUMIDITY_STATE;
+
 // Humidity data storage.
 extern float sensor_data_ext;	      // Exterior humidity
+extern uint8 sensor_status;	      // SENSOR_* bits
 
 // Function Prototypyes:
 
 // Callback Function: user_read_humidity()
-// Desc: Gets a single humidity reading from the humidity sensor via I2C.
+// Desc: Sends a measurement request to the humidity sensor via I2C, and
+//	schedules user_fetch_humidity() to retrieve the result.
 void ICACHE_FLASH_ATTR user_read_humidity(void);
 
+// Callback Function: user_fetch_humidity()
+// Desc: Retrieves the result of the measurement requested by user_read_humidity()
+//	and notifies the control task. Re-arms itself if the measurement is not done.
+//	A failed reading is reported too, so the interior hears about it
+void ICACHE_FLASH_ATTR user_fetch_humidity(void);
+
+// Application Function: user_humidity_convert(uint16 count)
+// Desc: Converts a 14-bit humidity count from the sensor into %RH
+float ICACHE_FLASH_ATTR user_humidity_convert(uint16 count);
+
 #endif
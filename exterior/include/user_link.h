@@ -0,0 +1,155 @@
+// user_link.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Framed link protocol between the exterior and interior systems.
+//	Every frame starts with a fixed header and carries a length, so a reader
+//	can put frames back together however TCP splits or joins them:
+//
+//	Byte 0-1:  LINK_MAGIC_0, LINK_MAGIC_1
+//	Byte 2:    LINK_VERSION
+//	Byte 3:    Frame type, LINK_SAMPLES or LINK_ACK
+//	Byte 4-5:  Sequence number, +1 per frame sent
+//	Byte 6-7:  Payload length
+//	Byte 8-:   Payload
+//
+//	LINK_SAMPLES (exterior to interior), a batch of humidity readings:
+//	Byte 0-3:  Time of the first sample, ms since the exterior booted
+//	Byte 4-5:  Time between samples, ms
+//	Byte 6:    Sensor status, LINK_STATUS_* bits
+//	Byte 7:    Number of samples, 0 to LINK_SAMPLES_MAX. A frame without
+//	           samples reports a sensor failure
+//	Byte 8-:   Samples, 0.01 %RH each, oldest first
+//
+//	LINK_ACK (interior to exterior), the sequence number of the last
+//	LINK_SAMPLES frame received:
+//	Byte 0-1:  Sequence number
+//
+//	Multi-byte fields are little endian. The decoder holds one frame in a
+//	fixed buffer; a header with the wrong magic, version or an oversized
+//	length is skipped a byte at a time until the stream lines up again.
+//	This file is shared by the interior and exterior builds.
+
+#ifndef _USER_LINK_H
+#define _USER_LINK_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_task.h"
+
+#define LINK_MAGIC_0		'H'
+#define LINK_MAGIC_1		'C'
+#define LINK_VERSION		1
+#define LINK_HEADER_SIZE	8
+#define LINK_SAMPLES_MAX	16		// Most samples in one frame
+#define LINK_SAMPLES_HEADER	8		// LINK_SAMPLES payload ahead of the samples
+#define LINK_PAYLOAD_MAX	(LINK_SAMPLES_HEADER + (2 * LINK_SAMPLES_MAX))
+#define LINK_FRAME_MAX		(LINK_HEADER_SIZE + LINK_PAYLOAD_MAX)
+
+// Frame types
+#define LINK_SAMPLES		1
+#define LINK_ACK		2
+
+// Sensor status bits
+#define LINK_STATUS_OK		0x01	// Last reading succeeded
+#define LINK_STATUS_FAIL	0x02	// Sensor did not respond or never finished converting
+#define LINK_STATUS_DIAG	0x04	// Sensor reported command or diagnostic mode
+
+// Decoded frame, payload pointing into the decoder's buffer
+struct user_link_frame {
+	uint8 type;		// LINK_SAMPLES, etc
+	uint16 seq;		// Sequence number
+	const uint8 *payload;
+	uint16 len;		// Payload length
+};
+
+// Decoded LINK_SAMPLES payload
+struct user_link_samples {
+	uint32 time;		// Time of the first sample, ms
+	uint16 period;		// Time between samples, ms
+	uint8 status;		// LINK_STATUS_* bits
+	uint8 n;		// Number of samples
+	uint16 sample[LINK_SAMPLES_MAX];	// 0.01 %RH
+};
+
+// Frame handler
+typedef void (*user_link_handler)(void *arg, const struct user_link_frame *frame);
+
+// Streaming decoder, one per connection
+struct user_link_decoder {
+	uint8 buf[LINK_FRAME_MAX];	// Frame being put together
+	uint16 len;			// Bytes in buf
+	uint32 frames;			// Frames decoded
+	uint32 skipped;			// Bytes skipped to find a frame start
+};
+
+// Application Function: user_link_encode(uint8 *buf, uint8 type, uint16 seq, uint16 len)
+// Desc: Writes a frame header. The payload follows at buf + LINK_HEADER_SIZE
+// Args:
+//	uint8 *buf: Frame, at least LINK_HEADER_SIZE + len bytes
+//	uint8 type: Frame type
+//	uint16 seq: Sequence number
+//	uint16 len: Payload length
+// Returns:
+//	The frame length
+uint16 ICACHE_FLASH_ATTR user_link_encode(uint8 *buf, uint8 type, uint16 seq, uint16 len);
+
+// Application Function: user_link_encode_samples(uint8 *buf, uint16 seq, const struct user_link_samples *s)
+// Desc: Writes a LINK_SAMPLES frame
+// Args:
+//	uint8 *buf: Frame, at least LINK_FRAME_MAX bytes
+//	uint16 seq: Sequence number
+//	const struct user_link_samples *s: Samples, n from 0 to LINK_SAMPLES_MAX
+// Returns:
+//	The frame length
+uint16 ICACHE_FLASH_ATTR user_link_encode_samples(uint8 *buf, uint16 seq, const struct user_link_samples *s);
+
+// Application Function: user_link_encode_ack(uint8 *buf, uint16 seq, uint16 acked)
+// Desc: Writes a LINK_ACK frame
+// Args:
+//	uint8 *buf: Frame, at least LINK_HEADER_SIZE + 2 bytes
+//	uint16 seq: Sequence number
+//	uint16 acked: Sequence number of the frame acknowledged
+// Returns:
+//	The frame length
+uint16 ICACHE_FLASH_ATTR user_link_encode_ack(uint8 *buf, uint16 seq, uint16 acked);
+
+// Application Function: user_link_decode_init(struct user_link_decoder *dec)
+// Desc: Readies a decoder for a new connection
+// Args:
+//	struct user_link_decoder *dec: Decoder
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_link_decode_init(struct user_link_decoder *dec);
+
+// Application Function: user_link_decode(struct user_link_decoder *dec, const uint8 *data, uint16 len, user_link_handler handler, void *arg)
+// Desc: Feeds received bytes to a decoder, calling the handler once per
+//	complete frame. A frame may be split over any number of calls, and one
+//	call may complete several frames
+// Args:
+//	struct user_link_decoder *dec: Decoder
+//	const uint8 *data: Received data
+//	uint16 len: Length of data
+//	user_link_handler handler: Called for each frame
+//	void *arg: Passed to the handler
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_link_decode(struct user_link_decoder *dec, const uint8 *data, uint16 len, user_link_handler handler, void *arg);
+
+// Application Function: user_link_samples(const struct user_link_frame *frame, struct user_link_samples *s)
+// Desc: Reads the payload of a LINK_SAMPLES frame
+// Args:
+//	const struct user_link_frame *frame: Frame
+//	struct user_link_samples *s: Filled with the samples
+// Returns:
+//	false if the frame is not a well formed LINK_SAMPLES frame
+bool ICACHE_FLASH_ATTR user_link_samples(const struct user_link_frame *frame, struct user_link_samples *s);
+
+// Application Function: user_link_ack(const struct user_link_frame *frame, uint16 *acked)
+// Desc: Reads the payload of a LINK_ACK frame
+// Args:
+//	const struct user_link_frame *frame: Frame
+//	uint16 *acked: Set to the sequence number acknowledged
+// Returns:
+//	false if the frame is not a well formed LINK_ACK frame
+bool ICACHE_FLASH_ATTR user_link_ack(const struct user_link_frame *frame, uint16 *acked);
+
+#endif
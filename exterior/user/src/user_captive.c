@@ -97,42 +97,46 @@ void ICACHE_FLASH_ATTR user_tcp_recv_cb(void *arg, char *pusrdata, unsigned shor
 	struct espconn *client_conn = arg;		// Pull client connection
 	struct user_data_station_config post_config;	// Flash storage structure
 	sint8 flash_result = 0;				// Result of flash operation
-	char *p1;					// Char pointer for string manipulation
-	char *p2;
-	char *ssid;				// User sent SSID
-	uint8 ssid_len;				// Length of the SSID
-	char *pass;				// User sent password
-	uint8 pass_len;				// Length of the password
+	struct user_kv_lexer lx;			// Packet tokenizer
+	struct user_kv kv;				// Current field
+	const char *ssid = NULL;			// User sent SSID
+	uint16 ssid_len = 0;				// Length of the SSID
+	const char *pass = NULL;			// User sent password
+	uint16 pass_len = 0;				// Length of the password
 
 	PRINT_DEBUG(DEBUG_LOW, "received data from interior\r\n");
 	PRINT_DEBUG(DEBUG_HIGH, "data=%s\r\n", pusrdata);
 
-	// Search for form data
-	p1 = (uint8 *)os_strstr(pusrdata, "ssid=");	//Locate SSID
-	if (p1 == NULL) {
+	// Pick the fields out of the packet in one pass
+	user_kv_init(&lx, pusrdata, length, '&');
+	while (user_kv_next(&lx, &kv)) {
+		if (user_kv_is(kv.key, kv.key_len, "ssid")) {
+			ssid = kv.val;
+			ssid_len = kv.val_len;
+		} else if (user_kv_is(kv.key, kv.key_len, "pass")) {
+			pass = kv.val;
+			pass_len = kv.val_len;
+		}
+	}
+	if ((ssid == NULL) || (pass == NULL) ||
+	    (ssid_len > sizeof(post_config.config.ssid)) || (pass_len > sizeof(post_config.config.password))) {
 		PRINT_DEBUG(DEBUG_ERR, "ERROR: received malformed config packet\r\n");
 		TASK_RETURN(SIG_CONFIG, PAR_CONFIG_MALFORMED);
 		return;
 	}
 
-	p1 = p1 + 5;					// Move past "ssid=" to the actual ssid
-	p2 = (uint8 *)os_strstr(p1, "&");		// Search for &, which separates values
-	ssid_len = (uint8)((uint32)p2 - (uint32)p1);	// Calculate SSID length
-	ssid = p1;					// Save location of SSID
-	
-	p1 = (char *)os_strstr(pusrdata, "pass=");	// Locate password
-	p1 = p1 + 5;					// Move past "pass=" to the actual pass
-	pass_len = os_strlen(p1);			// Calculate the password length
-	pass = p1;
-	
-	PRINT_DEBUG(DEBUG_HIGH, "ssid read: %s\r\n", ssid);
-	PRINT_DEBUG(DEBUG_HIGH, "pass read: %d\r\n", pass);
+	PRINT_DEBUG(DEBUG_HIGH, "ssid length: %d\r\n", ssid_len);
+	PRINT_DEBUG(DEBUG_HIGH, "pass length: %d\r\n", pass_len);
 
 	// Store retrieved data in flash data structure
 	os_memcpy(post_config.config.ssid, ssid, ssid_len);
 	os_memcpy(post_config.config.password, pass, pass_len);
-	post_config.config.ssid[ssid_len] = '\0';	// Add null terminators
-	post_config.config.password[pass_len] = '\0';
+	if (ssid_len < sizeof(post_config.config.ssid)) {	// Add null terminators, unless full length
+		post_config.config.ssid[ssid_len] = '\0';
+	}
+	if (pass_len < sizeof(post_config.config.password)) {
+		post_config.config.password[pass_len] = '\0';
+	}
 
 
 	PRINT_DEBUG(DEBUG_LOW, "Writing new data to flash\r\n");
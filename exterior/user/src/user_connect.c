@@ -9,6 +9,42 @@ struct _esp_tcp tcp_connect_proto;
 
 static struct espconn *int_con = NULL;		// Connection to interior system
 
+// Link protocol state for the interior connection
+static struct user_link_decoder int_decoder;	// Decodes the interior's ACKs
+static struct user_link_samples batch;		// Readings not yet sent
+static uint8 link_buf[LINK_FRAME_MAX];		// Frame being sent
+static uint16 link_seq = 0;			// Sequence number of the next frame
+static uint16 link_acked = 0;			// Last sequence number acknowledged
+static uint32 link_ms = 0;			// Uptime in ms, for frame timestamps
+static uint32 link_last_us = 0;			// system_get_time() when link_ms was last advanced
+
+// Callback Function: user_int_frame(void *arg, const struct user_link_frame *frame)
+// Desc: Called by the link decoder for each frame from the interior
+static void ICACHE_FLASH_ATTR user_int_frame(void *arg, const struct user_link_frame *frame)
+{
+	if (!user_link_ack(frame, &link_acked)) {
+		PRINT_DEBUG(DEBUG_ERR, "received malformed interior frame, type=%d length=%d\r\n", frame->type, frame->len);
+		return;
+	}
+	PRINT_DEBUG(DEBUG_HIGH, "interior acknowledged seq=%d, %d frames outstanding\r\n",
+		link_acked, (uint16)(link_seq - link_acked - 1));
+
+	return;
+}
+
+// Application Function: user_link_uptime(void)
+// Desc: Advances the ms uptime. system_get_time() wraps every 71 minutes, so
+//	this must run more often than that, which each reading does
+static uint32 ICACHE_FLASH_ATTR user_link_uptime(void)
+{
+	uint32 elapsed = (system_get_time() - link_last_us) / 1000;	// Whole ms since the last call
+
+	link_ms += elapsed;
+	link_last_us += elapsed * 1000;
+
+	return link_ms;
+}
+
 struct station_config station_conn;
 
 void ICACHE_FLASH_ATTR user_int_connect_init(os_event_t *e)
@@ -54,8 +90,10 @@ void ICACHE_FLASH_ATTR user_int_connect_cb(void *arg)
 	struct espconn *client_conn = arg;
 
 	int_con = arg;	// Save the connection
+	user_link_decode_init(&int_decoder);
 
 	// Register callbacks for the connected client
+	espconn_regist_recvcb(client_conn, user_tcp_accept_recv_cb);
 	espconn_regist_reconcb(client_conn, user_tcp_recon_cb);
 	espconn_regist_disconcb(client_conn, user_tcp_discon_cb);
 	espconn_regist_sentcb(client_conn, user_tcp_sent_cb);
@@ -64,6 +102,11 @@ void ICACHE_FLASH_ATTR user_int_connect_cb(void *arg)
 	return;
 }
 
+void ICACHE_FLASH_ATTR user_tcp_accept_recv_cb(void *arg, char *pusrdata, unsigned short length)
+{
+	user_link_decode(&int_decoder, (const uint8 *)pusrdata, length, user_int_frame, arg);
+}
+
 void ICACHE_FLASH_ATTR user_tcp_recon_cb(void *arg, sint8 err)
 {
 	PRINT_DEBUG(DEBUG_ERR, "tcp connection error occured\r\n");
@@ -91,16 +134,43 @@ void ICACHE_FLASH_ATTR user_int_connect_cleanup(os_event_t *e)
 
 void ICACHE_FLASH_ATTR user_int_send_data(os_event_t *e)
 {
-	uint8 send_buf[4];	// Buffer to send to interior
-	sint8 result = 0;	// Send operation result	
+	uint32 now = user_link_uptime();	// Time of this reading, ms
+	uint16 len = 0;				// Frame length
+	sint8 result = 0;			// Send operation result	
+
+	// Add the reading to the batch. If sends have been failing long enough to
+	// fill it, the oldest reading makes room
+	if (sensor_status & SENSOR_OK) {
+		if (batch.n == LINK_SAMPLES_MAX) {
+			os_memmove(&batch.sample[0], &batch.sample[1], sizeof(batch.sample[0]) * (LINK_SAMPLES_MAX - 1));
+			batch.time += batch.period;
+			batch.n--;
+		}
+		if (batch.n == 0) {
+			batch.time = now;
+		}
+		batch.sample[batch.n++] = (uint16)((sensor_data_ext * 100) + 0.5);
+	}
+	batch.period = HUMIDITY_READ_INTERVAL;
+	batch.status = sensor_status;
 
-	// Copy the exterior humidity into the buffer
-	os_memcpy(send_buf, (uint8 *)&sensor_data_ext, 4);
+	if ((batch.n < LINK_BATCH_N) && (sensor_status & SENSOR_OK)) {
+		return;
+	}
+	if (int_con == NULL) {
+		PRINT_DEBUG(DEBUG_ERR, "no interior connection, holding %d readings\r\n", batch.n);
+		return;
+	}
 
-	// Send the data
-	result = espconn_send(int_con, send_buf, 4);
+	// Send the batch
+	len = user_link_encode_samples(link_buf, link_seq, &batch);
+	result = espconn_send(int_con, link_buf, len);
 	if (result < 0) {
 		PRINT_DEBUG(DEBUG_ERR, "failed to send RH to interior, code=%d\r\n", result);
+		return;
 	}
+	link_seq++;
+	batch.n = 0;
+
 	return;
 };
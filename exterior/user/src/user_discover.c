@@ -9,7 +9,7 @@ static struct _esp_udp udp_broadcast_proto;
 
 char *discovery_key = "hbfcd_exterior_confirm";
 uint16 discovery_keylen = 22;
-char *discovery_packet = "key=%s&ip=%d.%d.%d.%d.";
+char *discovery_packet = "key=%s&ip=%d.%d.%d.%d";
 bool int_conn = false;
 
 void ICACHE_FLASH_ATTR user_broadcast_init(os_event_t *e)
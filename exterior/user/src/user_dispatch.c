@@ -0,0 +1,92 @@
+// user_dispatch.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_dispatch.h"
+
+bool ICACHE_FLASH_ATTR user_dispatch_init(struct user_machine *m, uint8 state)
+{
+	uint16 i = 0;
+
+	m->state = state;
+
+	for (i = 1; i < m->table_n; i++) {
+		if (m->table[i].event < m->table[i - 1].event) {
+			PRINT_DEBUG(DEBUG_ERR, "ERROR: transition table unsorted at sig=%04x par=%04x\r\n",
+				m->table[i].event >> 16, m->table[i].event & 0xFFFF);
+			return false;
+		};
+	};
+
+	return true;
+};
+
+// Application Function: user_dispatch_find(struct user_machine *m, uint32 event)
+// Desc: Binary search for the transition matching event in the current state
+// Returns:
+//	Matching transition, or NULL
+static const struct user_transition * ICACHE_FLASH_ATTR user_dispatch_find(struct user_machine *m, uint32 event)
+{
+	const struct user_transition *any = NULL;	// STATE_ANY fallback
+	uint16 lo = 0;					// Search bounds
+	uint16 hi = m->table_n;
+	uint16 mid = 0;
+
+	// Find the first entry for event
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (m->table[mid].event < event) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		};
+	};
+
+	// An entry for the current state beats a STATE_ANY entry
+	for (; (lo < m->table_n) && (m->table[lo].event == event); lo++) {
+		if (m->table[lo].from == m->state) {
+			return &m->table[lo];
+		};
+		if ((m->table[lo].from == STATE_ANY) && (any == NULL)) {
+			any = &m->table[lo];
+		};
+	};
+
+	return any;
+};
+
+bool ICACHE_FLASH_ATTR user_dispatch(struct user_machine *m, os_event_t *e)
+{
+	const struct user_transition *t = NULL;	// Transition taken
+	uint32 event = e->sig | e->par;		// Combined signal/parameter
+	bool change = false;			// True if the transition leaves the current state
+
+	if (m->states[m->state].final) {
+		PRINT_DEBUG(DEBUG_HIGH, "state %s: dropped sig=%04x par=%04x\r\n",
+			m->states[m->state].name, e->sig >> 16, e->par);
+		return false;
+	};
+
+	t = user_dispatch_find(m, event);
+	if (t == NULL) {
+		PRINT_DEBUG(DEBUG_ERR, "state %s: unhandled sig=%04x par=%04x\r\n",
+			m->states[m->state].name, e->sig >> 16, e->par);
+		return false;
+	};
+
+	change = (t->to != STATE_SAME) && (t->to != m->state);
+	if (change && (m->states[m->state].exit != NULL)) {
+		m->states[m->state].exit(e);
+	};
+	if (change) {
+		PRINT_DEBUG(DEBUG_LOW, "state %s -> %s\r\n", m->states[m->state].name, m->states[t->to].name);
+		m->state = t->to;
+	};
+	if (t->action != NULL) {
+		t->action(e);
+	};
+	if (change && (m->states[m->state].entry != NULL)) {
+		m->states[m->state].entry(e);
+	};
+
+	return true;
+};
@@ -7,15 +7,22 @@
 float sensor_data_int = 0;
 float sensor_data_ext = 0;
 float threshold_humidity = 40;
+uint8 sensor_status = 0;
+
+// Humidity acquisition state
+static uint8 humidity_state = HUMIDITY_IDLE;	// Current phase of the measurement cycle
+static uint8 humidity_retries = 0;		// Number of fetches which have returned stale data
+static os_timer_t timer_humidity_fetch;		// Timer for fetching measurement results
 
 void ICACHE_FLASH_ATTR user_read_humidity(void)
 {
-        uint8 status = 0;               // Status reported by humidity sensor
-        uint8 read_byte = 0;            // Byte read from the humidity sensor
-        uint16 humidity = 0;            // Humidity reading w/o calculations
-        float adj_humidity = 0;         // Humidity reading after calculations
+	// Don't start a new measurement while one is still being fetched
+	if (humidity_state != HUMIDITY_IDLE) {
+		PRINT_DEBUG(DEBUG_ERR, "humidity measurement still in progress, skipping\r\n");
+		return;
+	}
 
-	PRINT_DEBUG(DEBUG_LOW, "reading humidity\r\nn");
+	PRINT_DEBUG(DEBUG_LOW, "reading humidity\r\n");
 
         // Wake up the sensor by sending a measurement request. This consists of the slave's address
         // and a single 0 bit. 
@@ -23,22 +30,40 @@ void ICACHE_FLASH_ATTR user_read_humidity(void)
         if (user_i2c_write_byte((SENSOR_ADDR << 1) & 0xFE) == 1) {
                 PRINT_DEBUG(DEBUG_ERR, "slave failed to initiate measurement\r\n");
         	user_i2c_stop_bit();
+		sensor_status = (sensor_status & ~SENSOR_OK) | SENSOR_FAIL;
+		TASK_RETURN(SIG_HUMIDITY, PAR_HUMIDITY_READ_FAIL);
 		return;
         };
         user_i2c_stop_bit();
 
 	PRINT_DEBUG(DEBUG_LOW, "sent measure request\r\n");
 
-        // The average measurement cycle takes 36.65ms. 100ms leaves a good amount
-        // of leeway
-        os_delay_us(50000);
-        os_delay_us(50000);
+        // The average measurement cycle takes 36.65ms. Return to the SDK and fetch
+        // the data from a timer callback once it should have completed
+	humidity_state = HUMIDITY_CONVERTING;
+	humidity_retries = 0;
+	os_timer_disarm(&timer_humidity_fetch);
+	os_timer_setfn(&timer_humidity_fetch, user_fetch_humidity, NULL);
+	os_timer_arm(&timer_humidity_fetch, HUMIDITY_CONVERSION_TIME, false);
+
+        return;
+};
+
+void ICACHE_FLASH_ATTR user_fetch_humidity(void)
+{
+        uint8 status = 0;               // Status reported by humidity sensor
+        uint8 read_byte = 0;            // Byte read from the humidity sensor
+        uint16 humidity = 0;            // Humidity reading w/o calculations
+        float adj_humidity = 0;         // Humidity reading after calculations
         
         // Retrieve the data now that the measurement cycle has completed
         user_i2c_start_bit();
         if (user_i2c_write_byte((SENSOR_ADDR << 1) | 0x01) == 1) {
                 PRINT_DEBUG(DEBUG_ERR, "slave failed to receive address\r\n");
         	user_i2c_stop_bit();
+		sensor_status = (sensor_status & ~SENSOR_OK) | SENSOR_FAIL;
+		humidity_state = HUMIDITY_IDLE;
+		TASK_RETURN(SIG_HUMIDITY, PAR_HUMIDITY_READ_FAIL);
 		return;      
         };
 
@@ -51,7 +76,26 @@ void ICACHE_FLASH_ATTR user_read_humidity(void)
         user_i2c_stop_bit();
         humidity |= read_byte;                           // Lower byte is lower 8 bits of humidity
 
-        adj_humidity = ((float)humidity / (float)((1 << 14) - 2)) * 100;        // Calculate RH as defined by Honeywell
+	// Stale data means the measurement cycle hasn't finished yet. Check back shortly
+	if (status == HUMIDITY_STATUS_STALE) {
+		if (humidity_retries < HUMIDITY_RETRY_MAX) {
+			humidity_retries++;
+			os_timer_arm(&timer_humidity_fetch, HUMIDITY_RETRY_TIME, false);
+		} else {
+			PRINT_DEBUG(DEBUG_ERR, "humidity measurement timed out\r\n");
+			sensor_status = (sensor_status & ~SENSOR_OK) | SENSOR_FAIL;
+			humidity_state = HUMIDITY_IDLE;
+			TASK_RETURN(SIG_HUMIDITY, PAR_HUMIDITY_READ_FAIL);
+		}
+		return;
+	}
+	humidity_state = HUMIDITY_IDLE;
+	sensor_status = (sensor_status & ~(SENSOR_FAIL | SENSOR_DIAG)) | SENSOR_OK;
+	if (status >= HUMIDITY_STATUS_CMD) {
+		sensor_status |= SENSOR_DIAG;
+	}
+
+        adj_humidity = user_humidity_convert(humidity);
 
         PRINT_DEBUG(DEBUG_HIGH, "reading=%d, humidity=%d, status=%d\r\n", humidity, (uint32)adj_humidity, status);
 
@@ -62,3 +106,8 @@ void ICACHE_FLASH_ATTR user_read_humidity(void)
 
         return;
 };
+
+float ICACHE_FLASH_ATTR user_humidity_convert(uint16 count)
+{
+        return ((float)count / (float)((1 << 14) - 2)) * 100;        // Calculate RH as defined by Honeywell
+};
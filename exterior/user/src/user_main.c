@@ -12,12 +12,29 @@
 #include "user_captive.h"
 #include "user_discover.h"
 #include "user_connect.h"
+#include "user_dispatch.h"
+#include "user_job.h"
+#include "user_heap.h"
 
 // Function prototypes
 void ICACHE_FLASH_ATTR user_init(void);				// First step initialization function. Handoff from bootloader.
 void ICACHE_FLASH_ATTR user_task_init(void);			// Task initialization. Hands off to the control task.
 void ICACHE_FLASH_ATTR user_control_task(os_event_t *e);	// Main control task. Schedules all other user tasks.
 void ICACHE_FLASH_ATTR user_gpio_init(void);			// Performs GPIO initialization
+void ICACHE_FLASH_ATTR user_heap_report(void *parg);		// Prints the heap counters
+
+// Control states
+enum {
+	STATE_BOOT = 0,		// Waiting for the control task to start
+	STATE_SCAN,		// Scanning for/associating to the saved AP and waiting for an IP
+	STATE_LINK,		// Discovering and connecting to the interior
+	STATE_RUN,		// Connected to the interior, sending humidity readings
+	STATE_CONFIG,		// Receiving new WiFi credentials from the interior
+	STATE_FATAL,		// Waiting for the reboot timer after an unrecoverable error
+	STATE_N
+};
+
+static struct user_machine ctl_machine;		// Control state machine, defined with its transition table below
 
 // User Task: user_init()
 // Desc: Initialization. The ESP8266 hooks into this function after boot.
@@ -46,212 +63,282 @@ void ICACHE_FLASH_ATTR user_init(void)
 void ICACHE_FLASH_ATTR user_task_init(void)
 {
         // Allocate space for message queues
-        user_msg_queue_0 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
-        user_msg_queue_1 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
-        user_msg_queue_2 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
-
-        // Register control task and begin control
+        user_msg_queue_0 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+        user_msg_queue_1 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+        user_msg_queue_2 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+
+        // Start sending the debug log, including anything queued during start up
+        user_dlog_init();
+
+        // Print the heap counters now and then, so a leak or fragmentation shows
+        //      before the node runs out
+        os_timer_setfn(&timer_heap, user_heap_report, NULL);
+        os_timer_arm(&timer_heap, HEAP_REPORT_TIME, true);
+
+        // Register control task and begin control. Without the job task every
+        //	TASK_START job would sit in the queue, so don't start either
+        if (!user_job_init()) {
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: job task not registered, rebooting system in 5 seconds\r\n");
+                os_timer_setfn(&timer_reboot, system_restart, NULL);
+                os_timer_arm(&timer_reboot, 5000, false);
+                return;
+        };
+        if (!user_dispatch_init(&ctl_machine, STATE_BOOT)) {
+                // Lookups in an unsorted table would misroute events, so don't start. The
+                //	reboot is delayed so the debug log gets out first
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: control task not started, rebooting system in 5 seconds\r\n");
+                os_timer_setfn(&timer_reboot, system_restart, NULL);
+                os_timer_arm(&timer_reboot, 5000, false);
+                return;
+        };
         system_os_task(user_control_task, USER_TASK_PRIO_2, user_msg_queue_2, MSG_QUEUE_LENGTH);
 	TASK_RETURN(SIG_CONTROL, PAR_CONTROL_START);
 
 	return;
 };
 
+// Callback Function: user_heap_report(void *parg)
+// Desc: Prints the heap counters, see user_heap.h
+void ICACHE_FLASH_ATTR user_heap_report(void *parg)
+{
+	struct user_heap_stats s;	// Counters
+
+	user_heap_stats(&s);
+	PRINT_DEBUG(DEBUG_LOW, "heap live=%d peak=%d allocs=%d frees=%d failed=%d free=%d\r\n",
+		s.live, s.peak, s.allocs, s.frees, s.failed, s.free_heap);
+
+	return;
+};
+
+/* ==================== */
+/* Master Control Block */
+/* ==================== */
+
+// User Task: user_ctl_scan(os_event_t *e)
+// Desc: Scans for AP's using the SSID/password saved in memory
+static void ICACHE_FLASH_ATTR user_ctl_scan(os_event_t *e)
+{
+	TASK_START(user_scan, 0, 0);
+};
+
+// User Task: user_ctl_wait_ip(os_event_t *e)
+// Desc: Once the system has found and associated to an AP, it waits to receive an IP address
+static void ICACHE_FLASH_ATTR user_ctl_wait_ip(os_event_t *e)
+{
+	os_timer_setfn(&timer_ipcheck, user_check_ip, NULL); // Check for an IP every second
+	os_timer_arm(&timer_ipcheck, 1000, true);
+};
+
+// User Task: user_ctl_config(os_event_t *e)
+// Desc: If the system does not find an AP with it's saved SSID/pass, it will connect to the
+//	interior's configuration network to receive a new SSID/pass
+static void ICACHE_FLASH_ATTR user_ctl_config(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "switching to configuration mode\r\n");
+	TASK_START(user_config_assoc_init, 0, 0);
+};
+
+// User Task: user_ctl_int_connect(os_event_t *e)
+// Desc: Once the system has obtained an IP, disable the IP checking timer and initialize the
+//	interior connection
+static void ICACHE_FLASH_ATTR user_ctl_int_connect(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "gotip\r\n");
+	os_timer_disarm(&timer_ipcheck);
+	TASK_START(user_int_connect_init, 0, 0);
+};
+
+// User Task: user_ctl_config_connect(os_event_t *e)
+// Desc: Once the system has obtained an IP on the interior's configuration network, disable
+//	the IP checking timer and connect to the interior to receive credentials
+static void ICACHE_FLASH_ATTR user_ctl_config_connect(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "gotip\r\n");
+	os_timer_disarm(&timer_ipcheck);
+	TASK_START(user_config_connect_init, 0, 0);
+};
+
+// User Task: user_ctl_broadcast_init(os_event_t *e)
+// Desc: Once the system has started to listen for the interior, configure it to broadcast
+//	discovery packets
+static void ICACHE_FLASH_ATTR user_ctl_broadcast_init(os_event_t *e)
+{
+	TASK_START(user_broadcast_init, 0, 0);
+};
+
+// User Task: user_ctl_broadcast(os_event_t *e)
+// Desc: Once discovery via udp broadcast is configured, begin broadcasting the discovery regularly
+static void ICACHE_FLASH_ATTR user_ctl_broadcast(os_event_t *e)
+{
+	os_timer_setfn(&timer_intcon, user_send_broadcast, NULL);
+	os_timer_arm(&timer_intcon, BROADCAST_PERIOD, true);
+};
+
+// User Task: user_ctl_discovery_timeout(os_event_t *e)
+// Desc: If the discovery times out, tear down the interior connection and go back to
+//	configuration mode
+static void ICACHE_FLASH_ATTR user_ctl_discovery_timeout(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "discovery timed out\r\n");
+	TASK_START(user_int_connect_cleanup, 0, 0);
+};
+
+// User Task: user_ctl_broadcast_stop(os_event_t *e)
+// Desc: Stops broadcasting discovery packets
+static void ICACHE_FLASH_ATTR user_ctl_broadcast_stop(os_event_t *e)
+{
+	os_timer_disarm(&timer_intcon);
+	TASK_START(user_broadcast_stop, 0, 0);
+};
+
+// User Task: user_ctl_config_assoc(os_event_t *e)
+// Desc: Once the discovery connections are torn down after a timeout, associate to the
+//	interior's configuration network
+static void ICACHE_FLASH_ATTR user_ctl_config_assoc(os_event_t *e)
+{
+	TASK_START(user_config_assoc_init, 0, 0);
+};
+
+// User Task: user_ctl_run(os_event_t *e)
+// Desc: Entry to STATE_RUN. Once the interior is connected to the exterior, initialize the
+//	humidity readings and stop broadcasting
+static void ICACHE_FLASH_ATTR user_ctl_run(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "interior connected\r\n");
+	PRINT_DEBUG(DEBUG_LOW, "starting humidity readings\r\n");
+	os_timer_setfn(&timer_humidity, user_read_humidity, NULL);
+	os_timer_arm(&timer_humidity, HUMIDITY_READ_INTERVAL, true);
+
+	user_ctl_broadcast_stop(e);
+};
+
+// User Task: user_ctl_send_data(os_event_t *e)
+// Desc: After each humidity reading, queue the data for the interior
+static void ICACHE_FLASH_ATTR user_ctl_send_data(os_event_t *e)
+{
+	TASK_START(user_int_send_data, 0, 0);
+};
+
+// User Task: user_ctl_assoc_retry(os_event_t *e)
+// Desc: Once associate mode is initiated, attempt to connect to the interior every second until sucessful
+static void ICACHE_FLASH_ATTR user_ctl_assoc_retry(os_event_t *e)
+{
+	os_timer_setfn(&timer_assoc, user_config_assoc, NULL);
+	os_timer_arm(&timer_assoc, 1000, true);
+};
+
+// User Task: user_ctl_assoc_done(os_event_t *e)
+// Desc: Once the system has sucessfully associated, wait until an IP has been received
+static void ICACHE_FLASH_ATTR user_ctl_assoc_done(os_event_t *e)
+{
+	os_timer_disarm(&timer_assoc);
+	user_ctl_wait_ip(e);
+};
+
+// User Task: user_ctl_config_cleanup(os_event_t *e)
+// Desc: Once the system has received WiFi creds, cleanup config mode connections
+static void ICACHE_FLASH_ATTR user_ctl_config_cleanup(os_event_t *e)
+{
+	TASK_START(user_config_cleanup, 0, 0);
+};
+
+// User Task: user_ctl_rescan(os_event_t *e)
+// Desc: Once cleanup is complete, relaunch the AP scan
+static void ICACHE_FLASH_ATTR user_ctl_rescan(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "re-entering AP scan\r\n");
+	TASK_START(user_scan, 0, 0);
+};
+
+// User Task: user_ctl_ignore(os_event_t *e)
+// Desc: Recoverable error which needs no response
+static void ICACHE_FLASH_ATTR user_ctl_ignore(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_ERR, "RESPONSE: ignoring\r\n");
+};
+
+// User Task: user_ctl_fatal(os_event_t *e)
+// Desc: Entry to STATE_FATAL. The system is restarted after a 5 second delay.
+//	STATE_FATAL is final, so the control task then sleeps until the reboot
+static void ICACHE_FLASH_ATTR user_ctl_fatal(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL! rebooting system in 5 seconds\r\n");
+	os_timer_setfn(&timer_reboot, system_restart, NULL);
+	os_timer_arm(&timer_reboot, 5000, false);
+};
+
+static const struct user_state ctl_states[STATE_N] = {
+	[STATE_BOOT]		= { "boot",	NULL,		NULL,	false },
+	[STATE_SCAN]		= { "scan",	NULL,		NULL,	false },
+	[STATE_LINK]		= { "link",	NULL,		NULL,	false },
+	[STATE_RUN]		= { "run",	user_ctl_run,	NULL,	false },
+	[STATE_CONFIG]		= { "config",	NULL,		NULL,	false },
+	[STATE_FATAL]		= { "fatal",	user_ctl_fatal,	NULL,	true },
+};
+
+// Transition table, sorted by sig | par
+static const struct user_transition ctl_table[] = {
+	// General control signals
+	{ SIG_CONTROL | PAR_CONTROL_START,			STATE_BOOT,	STATE_SCAN,	user_ctl_scan },
+	{ SIG_CONTROL | PAR_CONTROL_ERR_FATAL,			STATE_ANY,	STATE_FATAL,	NULL },
+
+	// AP scanning signals
+	{ SIG_AP_SCAN | PAR_AP_SCAN_CONNECTED,			STATE_ANY,	STATE_SAME,	user_ctl_wait_ip },
+	{ SIG_AP_SCAN | PAR_AP_SCAN_NOAP,			STATE_ANY,	STATE_CONFIG,	user_ctl_config },
+	{ SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONNECT,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to attempt to connect to an SSID
+	{ SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONFIG,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to configure station mode
+	{ SIG_AP_SCAN | PAR_AP_SCAN_FAILED_SCAN,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to begin AP scanning task
+	{ SIG_AP_SCAN | PAR_AP_SCAN_FLASH_FAILURE,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to read data from flash memory
+	{ SIG_AP_SCAN | PAR_AP_SCAN_STATION_MODE_FAILURE,	STATE_ANY,	STATE_FATAL,	NULL },	// Failed to change the wifi mode to station
+
+	// IP waiting signals
+	{ SIG_IP_WAIT | PAR_IP_WAIT_GOTIP,			STATE_CONFIG,	STATE_SAME,	user_ctl_config_connect },
+	{ SIG_IP_WAIT | PAR_IP_WAIT_GOTIP,			STATE_ANY,	STATE_LINK,	user_ctl_int_connect },
+	{ SIG_IP_WAIT | PAR_IP_WAIT_CHECK_FAILURE,		STATE_ANY,	STATE_SAME,	user_ctl_ignore },	// In theory the IP is still there
+
+	// Discovery signals
+	{ SIG_DISCOVERY | PAR_DISCOVERY_LISTEN_INIT,		STATE_ANY,	STATE_SAME,	user_ctl_broadcast_init },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_CONFIG_COMPLETE,	STATE_ANY,	STATE_SAME,	user_ctl_broadcast },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_TIMEOUT,		STATE_ANY,	STATE_CONFIG,	user_ctl_discovery_timeout },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_INT_CLEANUP,		STATE_ANY,	STATE_SAME,	user_ctl_broadcast_stop },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_BROADCAST_CLEANUP,	STATE_CONFIG,	STATE_SAME,	user_ctl_config_assoc },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_BROADCAST_CLEANUP,	STATE_ANY,	STATE_SAME,	NULL },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_CONNECTED,		STATE_ANY,	STATE_RUN,	NULL },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_BROADCAST_FAILURE,	STATE_ANY,	STATE_SAME,	user_ctl_ignore },	// Broadcast failed to send this time. Continue
+	{ SIG_DISCOVERY | PAR_DISCOVERY_LISTEN_FAILURE,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to start listening for the interior with TCP
+	{ SIG_DISCOVERY | PAR_DISCOVERY_OPEN_FAILURE,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to start listening for discovery packets
+
+	// Humidity signals
+	{ SIG_HUMIDITY | PAR_HUMIDITY_READ_DONE,		STATE_ANY,	STATE_SAME,	user_ctl_send_data },
+	{ SIG_HUMIDITY | PAR_HUMIDITY_READ_FAIL,		STATE_ANY,	STATE_SAME,	user_ctl_send_data },	// Sensor failed; the interior is told
+
+	// Config mode signals
+	{ SIG_CONFIG | PAR_CONFIG_ASSOC_INIT,			STATE_ANY,	STATE_SAME,	user_ctl_assoc_retry },
+	{ SIG_CONFIG | PAR_CONFIG_ASSOC,			STATE_ANY,	STATE_SAME,	user_ctl_assoc_done },
+	{ SIG_CONFIG | PAR_CONFIG_RECV,				STATE_ANY,	STATE_SCAN,	user_ctl_config_cleanup },
+	{ SIG_CONFIG | PAR_CONFIG_CLEANUP_COMPLETE,		STATE_ANY,	STATE_SAME,	user_ctl_rescan },
+	{ SIG_CONFIG | PAR_CONFIG_MALFORMED,			STATE_ANY,	STATE_SAME,	user_ctl_ignore },	// Received a malformed config packet
+	{ SIG_CONFIG | PAR_CONFIG_STATION_MODE_FAILURE,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to set system to station mode
+	{ SIG_CONFIG | PAR_CONFIG_CONFIG_FAILURE,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to configure system to connect to interior SSID
+	{ SIG_CONFIG | PAR_CONFIG_FLASH_FAILURE,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to save config to flash
+	{ SIG_CONFIG | PAR_CONFIG_CONNECT_FAILED,		STATE_ANY,	STATE_FATAL,	NULL },	// Failed to connect to interior via TCP
+	{ SIG_CONFIG | PAR_CONFIG_SETUP_FAILED,			STATE_ANY,	STATE_FATAL,	NULL },	// Failed to setup TCP connection to interior
+};
+
+static struct user_machine ctl_machine = {
+	ctl_states,
+	ctl_table,
+	sizeof(ctl_table) / sizeof(ctl_table[0]),
+	STATE_BOOT
+};
+
 // User Task: user_control_task(os_event_t *e)
 // Desc: Maximum priority control task which calls other tasks
-//	based on the results of previous tasks
+//	based on the results of previous tasks. The control flow itself
+//	lives in ctl_table
 void ICACHE_FLASH_ATTR user_control_task(os_event_t *e)
 {
-	// Control flags
-	static bool config_mode = false;
-
-	/* ==================== */
-	/* Master Control Block */
-	/* ==================== */
-	switch(e->sig | e->par) {
-
-		/* ----------------------- */
-		/* General Control Signals */
-		/* ----------------------- */
-
-		// Control entry point. The exterior begins by scanning for AP's using the
-		// SSID/password it has saved in memory.
-		case SIG_CONTROL | PAR_CONTROL_START:
-			TASK_START(user_scan, 0, 0);
-			break;
-
-		// Deadloop of task calls while waiting for the system to restart
-		case SIG_CONTROL | PAR_CONTROL_ERR_DEADLOOP:
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_DEADLOOP);
-			break;
-
-		// Fatal error case. The control function calls itself with this sig/par
-		// if it is passed an error it cannot recover from. The system is restarted
-		// after a 5 second delay
-		case SIG_CONTROL | PAR_CONTROL_ERR_FATAL:
-			PRINT_DEBUG(DEBUG_ERR, "rebooting system in 5 seconds\r\n");
-			os_timer_setfn(&timer_reboot, system_restart, NULL);
-			os_timer_arm(&timer_reboot, 5000, false);
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_DEADLOOP);
-			break;
-
-		/* ------------------- */
-		/* AP Scanning Signals */
-		/* ------------------- */
-
-		// Once the system has found and associated to an AP, it waits to receive an IP
-		// address
-		case SIG_AP_SCAN | PAR_AP_SCAN_CONNECTED:
-			os_timer_setfn(&timer_ipcheck, user_check_ip, NULL); // Check for an IP every second			
-			os_timer_arm(&timer_ipcheck, 1000, true);
-			break;    
-
-		// If the system does not find an AP with it's saved SSID/pass, it will enter
-		// AP mode and serve a configuration webpage, where a user can enter a new SSID/pass
-		case SIG_AP_SCAN | PAR_AP_SCAN_NOAP:
-			config_mode = true;
-			PRINT_DEBUG(DEBUG_LOW, "switching to configuration mode\r\n");
-			TASK_START(user_config_assoc_init, 0, 0);
-			break;
- 
-		// Error cases:
-		case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONNECT:       // Failed to attempt to connect to an SSID   
-		case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONFIG:        // Failed to configure station mode  
-		case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_SCAN:          // Failed to begin AP scanning task 
-		case SIG_AP_SCAN | PAR_AP_SCAN_FLASH_FAILURE:        // Failed to read data from flash memory   
-		case SIG_AP_SCAN | PAR_AP_SCAN_STATION_MODE_FAILURE: // Failed to change the wifi mode to station
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL!\r\n");
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
-			break;
-			
-		/* ------------------ */
-		/* IP Waiting Signals */
-		/* ------------------ */
-		
-		// Once the system has obtained an IP, disable the IP checking timer and initialize the
-		// exterior connection configuration
-		case SIG_IP_WAIT | PAR_IP_WAIT_GOTIP:
-			PRINT_DEBUG(DEBUG_LOW, "gotip\r\n");
-			os_timer_disarm(&timer_ipcheck);
-			if (config_mode) {
-				TASK_START(user_config_connect_init, 0, 0);
-			} else {
-				TASK_START(user_int_connect_init, 0, 0);
-			}
-			break;
-
-		// Error case. Failed to check IP info. In theory it's still there, so ignore this
-		case SIG_IP_WAIT | PAR_IP_WAIT_CHECK_FAILURE:
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: ignoring\r\n");
-			break; 
-
-		/* ----------------- */
-		/* Discovery Signals */
-		/* ----------------- */
-		
-		// Once the system has started to listen for the interior, configure it to broadcast
-		// discovery packets
-		case SIG_DISCOVERY | PAR_DISCOVERY_LISTEN_INIT:
-			TASK_START(user_broadcast_init, 0, 0);
-			break;	
-
-		// Once discovery via udp broadcast is configured, begin broadcasting the discovery
-		// regularly
-		case SIG_DISCOVERY | PAR_DISCOVERY_CONFIG_COMPLETE:
-			os_timer_setfn(&timer_intcon, user_send_broadcast, NULL);	
-			os_timer_arm(&timer_intcon, BROADCAST_PERIOD, true);
-			break;    
-		
-		// If the discovery times out, go back to configuration mode
-		case SIG_DISCOVERY | PAR_DISCOVERY_TIMEOUT:
-			PRINT_DEBUG(DEBUG_LOW, "discovery timed out\r\n");
-			config_mode = true;
-			TASK_START(user_int_connect_cleanup, 0, 0);
-			break;
-		case SIG_DISCOVERY | PAR_DISCOVERY_INT_CLEANUP:
-			os_timer_disarm(&timer_intcon);
-			TASK_START(user_broadcast_stop, 0, 0);
-			break;
-		case SIG_DISCOVERY | PAR_DISCOVERY_BROADCAST_CLEANUP:
-			if (config_mode == true) {
-				TASK_START(user_config_assoc_init, 0, 0);
-			}
-			break;
-					
-		// Once the interior is connected to the exterior, initialize the humidity readings
-		case SIG_DISCOVERY | PAR_DISCOVERY_CONNECTED:
-			PRINT_DEBUG(DEBUG_LOW, "interior connected\r\n");
-			PRINT_DEBUG(DEBUG_LOW, "starting humidity readings\r\n");
-			os_timer_setfn(&timer_humidity, user_read_humidity, NULL);
-			os_timer_arm(&timer_humidity, HUMIDITY_READ_INTERVAL, true);
-
-			os_timer_disarm(&timer_intcon);
-			TASK_START(user_broadcast_stop, 0, 0);
-			break;
-
-		// Error cases:
-		case SIG_DISCOVERY | PAR_DISCOVERY_BROADCAST_FAILURE:	// Broadcast failed to send this time. Continue
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: ignoring\r\n");
-			break;
-		case SIG_DISCOVERY | PAR_DISCOVERY_LISTEN_FAILURE:	// Failed to start listening for the interior with TCP
-		case SIG_DISCOVERY | PAR_DISCOVERY_OPEN_FAILURE:	// Failed to start listening for discovery packets
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL!\r\n");
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
-			break; 
-		
-		/* ---------------- */
-		/* Humidity Signals */
-		/* ---------------- */
-		
-		// After each humidity reading, send the data on to the interior
-		case SIG_HUMIDITY | PAR_HUMIDITY_READ_DONE:
-			TASK_START(user_int_send_data, 0, 0);
-			break;
-
-		/* ------------------- */
-		/* Config Mode Signals */
-		/* ------------------- */
-
-		// Once associate mode is initiated, attempt to connect to the interior every second until sucessful
-		case SIG_CONFIG | PAR_CONFIG_ASSOC_INIT:
-			os_timer_setfn(&timer_assoc, user_config_assoc, NULL);	
-			os_timer_arm(&timer_assoc, 1000, true);
-			break;
-
-		// Once the system has sucessfully associated, wait until an IP has been received
-		case SIG_CONFIG | PAR_CONFIG_ASSOC:
-			os_timer_disarm(&timer_assoc);
-			os_timer_setfn(&timer_ipcheck, user_check_ip, NULL); // Check for an IP every second			
-			os_timer_arm(&timer_ipcheck, 1000, true);
-			break;    
-	
-		// Once the system has received WiFi creds, cleanup config mode connections
-		case SIG_CONFIG | PAR_CONFIG_RECV:
-			config_mode = false;
-			TASK_START(user_config_cleanup, 0, 0);
-			break;
-		
-		// Once cleanup is complete, relaunch the AP scan
-		case SIG_CONFIG | PAR_CONFIG_CLEANUP_COMPLETE:
-			PRINT_DEBUG(DEBUG_LOW, "re-entering AP scan\r\n");
-			TASK_START(user_scan, 0, 0);	
-			break;
-
-		// Error cases:
-		case SIG_CONFIG | PAR_CONFIG_MALFORMED:		// Received a malformed config packet
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: ignoring\r\n");
-			break;
-		case SIG_CONFIG | PAR_CONFIG_STATION_MODE_FAILURE:	// Failed to set system to station mode
-		case SIG_CONFIG | PAR_CONFIG_CONFIG_FAILURE:	// Failed to configure system to connect to interior SSID
-		case SIG_CONFIG | PAR_CONFIG_FLASH_FAILURE:	// Failed to save config to flash
-		case SIG_CONFIG | PAR_CONFIG_CONNECT_FAILED:	// Failed to connect to interior via TCP 
-		case SIG_CONFIG | PAR_CONFIG_SETUP_FAILED:	// Failed to setup TCP connection to interior
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL!\r\n");
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
-			break; 
-			
-
-		};	
+	user_dispatch(&ctl_machine, e);
 
 	return;
 };
@@ -0,0 +1,139 @@
+// dispatch.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Cost of handing an event to the control task. Builds a transition
+//	table the size and shape of the interior's, and an equivalent switch over
+//	sig | par like the one it replaced, then times a long pseudo-random event
+//	sequence through each. Results are host ns per event, so only the ratio
+//	between the two carries over to the ESP8266.
+//
+//	make host-bench && ../host/build/interior/dispatch
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "user_dispatch.h"
+#include "host.h"
+
+#define EVENT_N		(1 << 12)	// Length of the event sequence
+#define ROUNDS		2000		// Times the sequence is replayed
+
+static volatile uint32 sink = 0;	// Keeps the no-op actions from being optimised away
+
+static void bench_action(os_event_t *e)
+{
+	sink += e->par;
+}
+
+static const struct user_state bench_states[] = {
+	{ "a", NULL, NULL, false },
+};
+
+// Same events as the interior's table, all leading back to state 0
+#define T(sig, par)	{ (sig) | (par), STATE_ANY, STATE_SAME, bench_action }
+static const struct user_transition bench_table[] = {
+	T(SIG_CONTROL, PAR_CONTROL_START), T(SIG_CONTROL, PAR_CONTROL_ERR_FATAL),
+	T(SIG_AP_SCAN, PAR_AP_SCAN_CONNECTED), T(SIG_AP_SCAN, PAR_AP_SCAN_NOAP),
+	T(SIG_AP_SCAN, PAR_AP_SCAN_FAILED_CONNECT), T(SIG_AP_SCAN, PAR_AP_SCAN_FAILED_CONFIG),
+	T(SIG_AP_SCAN, PAR_AP_SCAN_FAILED_SCAN), T(SIG_AP_SCAN, PAR_AP_SCAN_FLASH_FAILURE),
+	T(SIG_AP_SCAN, PAR_AP_SCAN_STATION_MODE_FAILURE),
+	T(SIG_IP_WAIT, PAR_IP_WAIT_GOTIP), T(SIG_IP_WAIT, PAR_IP_WAIT_CHECK_FAILURE),
+	T(SIG_DISCOVERY, PAR_DISCOVERY_CONFIG_COMPLETE), T(SIG_DISCOVERY, PAR_DISCOVERY_TIMEOUT),
+	T(SIG_DISCOVERY, PAR_DISCOVERY_FOUND), T(SIG_DISCOVERY, PAR_DISCOVERY_CONNECTED),
+	T(SIG_DISCOVERY, PAR_DISCOVERY_CONN_FAILED), T(SIG_DISCOVERY, PAR_DISCOVERY_MALFORMED),
+	T(SIG_DISCOVERY, PAR_DISCOVERY_LISTEN_FAILURE),
+	T(SIG_WEB, PAR_WEB_INIT_FAILURE),
+	T(SIG_APMODE, PAR_APMODE_SETUP_COMPLETE), T(SIG_APMODE, PAR_APMODE_CONFIG_RECV),
+	T(SIG_APMODE, PAR_APMODE_EXT_ACCEPT), T(SIG_APMODE, PAR_APMODE_CLEANUP_COMPLETE),
+	T(SIG_APMODE, PAR_APMODE_SEND_FAILURE), T(SIG_APMODE, PAR_APMODE_FLASH_FAILURE),
+	T(SIG_APMODE, PAR_APMODE_EXT_INIT_FAILURE), T(SIG_APMODE, PAR_APMODE_WEB_INIT_FAILURE),
+	T(SIG_APMODE, PAR_APMODE_DHCP_CONFIG_FAILURE), T(SIG_APMODE, PAR_APMODE_MODE_CONFIG_FAILURE),
+	T(SIG_APMODE, PAR_APMODE_AP_MODE_FAILURE),
+};
+#define TABLE_N		(sizeof(bench_table) / sizeof(bench_table[0]))
+
+static struct user_machine bench_machine = { bench_states, bench_table, TABLE_N, 0 };
+
+// User Task: bench_switch(os_event_t *e)
+// Desc: The same dispatch written as the old switch statement
+static void __attribute__((noinline)) bench_switch(os_event_t *e)
+{
+	switch (e->sig | e->par) {
+	case SIG_CONTROL | PAR_CONTROL_START:
+	case SIG_CONTROL | PAR_CONTROL_ERR_FATAL:
+	case SIG_AP_SCAN | PAR_AP_SCAN_CONNECTED:
+	case SIG_AP_SCAN | PAR_AP_SCAN_NOAP:
+	case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONNECT:
+	case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONFIG:
+	case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_SCAN:
+	case SIG_AP_SCAN | PAR_AP_SCAN_FLASH_FAILURE:
+	case SIG_AP_SCAN | PAR_AP_SCAN_STATION_MODE_FAILURE:
+	case SIG_IP_WAIT | PAR_IP_WAIT_GOTIP:
+	case SIG_IP_WAIT | PAR_IP_WAIT_CHECK_FAILURE:
+	case SIG_DISCOVERY | PAR_DISCOVERY_CONFIG_COMPLETE:
+	case SIG_DISCOVERY | PAR_DISCOVERY_TIMEOUT:
+	case SIG_DISCOVERY | PAR_DISCOVERY_FOUND:
+	case SIG_DISCOVERY | PAR_DISCOVERY_CONNECTED:
+	case SIG_DISCOVERY | PAR_DISCOVERY_CONN_FAILED:
+	case SIG_DISCOVERY | PAR_DISCOVERY_MALFORMED:
+	case SIG_DISCOVERY | PAR_DISCOVERY_LISTEN_FAILURE:
+	case SIG_WEB | PAR_WEB_INIT_FAILURE:
+	case SIG_APMODE | PAR_APMODE_SETUP_COMPLETE:
+	case SIG_APMODE | PAR_APMODE_CONFIG_RECV:
+	case SIG_APMODE | PAR_APMODE_EXT_ACCEPT:
+	case SIG_APMODE | PAR_APMODE_CLEANUP_COMPLETE:
+	case SIG_APMODE | PAR_APMODE_SEND_FAILURE:
+	case SIG_APMODE | PAR_APMODE_FLASH_FAILURE:
+	case SIG_APMODE | PAR_APMODE_EXT_INIT_FAILURE:
+	case SIG_APMODE | PAR_APMODE_WEB_INIT_FAILURE:
+	case SIG_APMODE | PAR_APMODE_DHCP_CONFIG_FAILURE:
+	case SIG_APMODE | PAR_APMODE_MODE_CONFIG_FAILURE:
+	case SIG_APMODE | PAR_APMODE_AP_MODE_FAILURE:
+		bench_action(e);
+		break;
+	}
+}
+
+static double bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+void user_init(void)
+{
+	static os_event_t events[EVENT_N];
+	double t0, t_table, t_switch;
+	uint32 i, r, seed = 1;
+
+	if (!user_dispatch_init(&bench_machine, 0)) {
+		exit(1);
+	}
+
+	// Spread events uniformly over the table
+	for (i = 0; i < EVENT_N; i++) {
+		seed = seed * 1103515245 + 12345;
+		events[i].sig = bench_table[(seed >> 16) % TABLE_N].event & 0xFFFF0000;
+		events[i].par = bench_table[(seed >> 16) % TABLE_N].event & 0x0000FFFF;
+	}
+
+	t0 = bench_now_ns();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < EVENT_N; i++) {
+			user_dispatch(&bench_machine, &events[i]);
+		}
+	}
+	t_table = (bench_now_ns() - t0) / ((double)ROUNDS * EVENT_N);
+
+	t0 = bench_now_ns();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < EVENT_N; i++) {
+			bench_switch(&events[i]);
+		}
+	}
+	t_switch = (bench_now_ns() - t0) / ((double)ROUNDS * EVENT_N);
+
+	printf("%u transitions: table=%.1f ns/event  switch=%.1f ns/event\n", (unsigned)TABLE_N, t_table, t_switch);
+	exit(0);
+}
@@ -0,0 +1,125 @@
+// fan_step.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Step response benchmark of the fan speed controller. Runs the
+//	real ZCD/tach ISR, hw_timer triac pulse and user_tach_calc() against the
+//	simulated fan in host_fan.c, steps desired_rpm through a fixed sequence and
+//	reports rise time, overshoot, settling time and steady state error for
+//	each step. Always runs on the simulated clock, so results are repeatable.
+//
+//	make host-bench && ../host/build/interior/fan_step
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "user_fan.h"
+#include "host.h"
+
+#define STEP_TIME	60000	// Time each set point is held (ms)
+#define SAMPLE_PERIOD	100	// Plant speed sampling period (ms)
+#define STEADY_TIME	10000	// Window at the end of each step used for steady state (ms)
+#define SETTLE_BAND	0.02f	// Settling band, as a fraction of the set point
+#define SAMPLE_N	(STEP_TIME / SAMPLE_PERIOD)
+
+static const sint32 steps[] = {2500, 1800, 2800, 2200};	// Set point sequence (RPM)
+#define STEP_N		(sizeof(steps) / sizeof(steps[0]))
+
+static os_timer_t timer_sample;
+static float samples[SAMPLE_N];
+static uint32 sample_i = 0;
+static uint32 step_i = 0;
+static float step_start = 0;		// Plant speed when the step was applied
+static float sum_rise = 0, sum_over = 0, sum_settle = 0, sum_sse = 0;
+
+// Application Function: fan_step_report(void)
+// Desc: Works out the response metrics of the step that just finished
+static void fan_step_report(void)
+{
+	float target = (float)steps[step_i];
+	float span = target - step_start;
+	float dir = span < 0 ? -1.0f : 1.0f;
+	float t10 = -1, t90 = -1, settle = 0, peak = 0, over, mean = 0, lo = 1e9f, hi = -1e9f;
+	float e, t;
+	uint32 i, steady_n = STEADY_TIME / SAMPLE_PERIOD;
+
+	for (i = 0; i < SAMPLE_N; i++) {
+		t = (float)((i + 1) * SAMPLE_PERIOD) / 1000.0f;
+		e = (samples[i] - step_start) * dir;		// Progress towards the set point
+		if (t10 < 0 && e >= 0.1f * span * dir) {
+			t10 = t;
+		}
+		if (t90 < 0 && e >= 0.9f * span * dir) {
+			t90 = t;
+		}
+		if ((samples[i] - target) * dir > peak) {
+			peak = (samples[i] - target) * dir;
+		}
+		if (samples[i] > target * (1 + SETTLE_BAND) || samples[i] < target * (1 - SETTLE_BAND)) {
+			settle = t;
+		}
+		if (i >= SAMPLE_N - steady_n) {
+			mean += samples[i];
+			lo = samples[i] < lo ? samples[i] : lo;
+			hi = samples[i] > hi ? samples[i] : hi;
+		}
+	}
+	mean /= steady_n;
+	over = span != 0 ? 100.0f * peak / (span * dir) : 0;
+
+	printf("step %u: %5d -> %5d rpm  rise=%6.1fs  overshoot=%5.1f%%  settle=%6.1fs  sse=%+7.1f rpm  ripple=%6.1f rpm\n",
+		step_i + 1, (int)step_start, (int)target,
+		(t10 >= 0 && t90 >= 0) ? t90 - t10 : -1.0f, over,
+		settle >= STEP_TIME / 1000.0f ? -1.0f : settle, mean - target, hi - lo);
+
+	// Steps that never rise or settle count as the whole step time
+	sum_rise += (t10 >= 0 && t90 >= 0) ? t90 - t10 : STEP_TIME / 1000.0f;
+	sum_settle += settle;
+	sum_over += over;
+	sum_sse += mean > target ? mean - target : target - mean;
+}
+
+// Callback Function: fan_step_sample(void *arg)
+// Desc: Samples the plant and moves on to the next set point once a step is done
+static void fan_step_sample(void *arg)
+{
+	samples[sample_i++] = host_fan_rpm();
+	if (sample_i < SAMPLE_N) {
+		return;
+	}
+
+	fan_step_report();
+	sample_i = 0;
+	if (++step_i == STEP_N) {
+		printf("mean: rise=%6.1fs  overshoot=%5.1f%%  settle=%6.1fs  |sse|=%6.1f rpm\n",
+			sum_rise / STEP_N, sum_over / STEP_N, sum_settle / STEP_N, sum_sse / STEP_N);
+		exit(EXIT_SUCCESS);
+	}
+	step_start = host_fan_rpm();
+	desired_rpm = steps[step_i];
+}
+
+// User Task: user_init(void)
+// Desc: Brings up only the fan side of the interior firmware (see user_gpio_init)
+void user_init(void)
+{
+	host_opts.virtual_time = true;
+
+	ETS_GPIO_INTR_DISABLE();
+	GPIO_REG_WRITE(GPIO_ENABLE_ADDRESS, GPIO_REG_READ(GPIO_ENABLE_ADDRESS) | TRIAC_BIT);
+	hw_timer_init(FRC1_SOURCE, 0);
+	hw_timer_set_pulse_func(user_fire_triac, user_release_triac);
+	gpio_output_set(0, 0, 0, ZCD_BIT);
+	gpio_pin_intr_state_set(GPIO_ID_PIN(ZCD_PIN), GPIO_PIN_INTR_POSEDGE);
+	gpio_output_set(0, 0, 0, TACH_BIT);
+	gpio_pin_intr_state_set(GPIO_ID_PIN(TACH_PIN), GPIO_PIN_INTR_ANYEDGE);
+	gpio_intr_handler_register(user_gpio_isr, 0);
+	ETS_GPIO_INTR_ENABLE();
+
+	fan_mode = FAN_NORMAL;
+	control_mode = CONTROL_SPEED;
+	desired_rpm = steps[0];
+	drive_flag = true;
+
+	os_timer_setfn(&timer_tachometer, user_tach_calc, NULL);
+	os_timer_arm(&timer_tachometer, TACH_PERIOD, true);
+	os_timer_setfn(&timer_sample, fan_step_sample, NULL);
+	os_timer_arm(&timer_sample, SAMPLE_PERIOD, true);
+}
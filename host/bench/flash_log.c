@@ -0,0 +1,233 @@
+// flash_log.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Flash log benchmark, run against a scratch flash image. Appends
+//	records up to several fill levels (part of one sector, part of the area,
+//	wrapped several times), restarting the log at each one, and reports the
+//	cost of an append and of finding the head after a restart, next to a
+//	linear scan of every header and record slot. Flash operation counts are
+//	what carries over to the ESP8266; host times are mostly file I/O. Every
+//	restart is checked by reading the whole log back, and a cursor is run
+//	behind a writer that laps it to check it skips reused sectors cleanly.
+//
+//	make host-bench && ../host/build/interior/flash_log
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "user_log.h"
+#include "host.h"
+
+#define BENCH_FLASH	"../host/build/interior/flash_log.bin"
+
+static const uint32 levels[] = { 100, 3000, 20000 };	// Records appended before each restart
+#define LEVEL_N		(sizeof(levels) / sizeof(levels[0]))
+
+static uint32 appended = 0;		// Data records appended so far
+
+static double bench_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Application Function: bench_entry(uint32 i, struct user_log_entry *e)
+// Desc: The i-th record appended, with values the packing keeps exactly
+static void bench_entry(uint32 i, struct user_log_entry *e)
+{
+	e->type = LOG_REC_DATA;
+	e->time = 0;
+	e->hum_int = i % 1001;
+	e->hum_ext = (i * 7) % 1001;
+	e->rpm = ((i * 3) % 1024) * 4;
+	e->delay = ((i * 5) % 1024) * 16;
+}
+
+// Application Function: bench_linear(uint16 *head)
+// Desc: Finds the head the obvious way, reading every header and then every
+//	record slot of the newest sector until an erased one
+// Returns: Used slots in the newest sector, whose index goes to *head
+static uint16 bench_linear(uint16 *head)
+{
+	struct user_log_header h;
+	uint32 best = 0;
+	uint32 w0 = 0;
+	uint16 s, slot;
+
+	*head = 0;
+	for (s = 0; s < LOG_SECT_N; s++) {
+		spi_flash_read((LOG_START_SECT + s) * LOG_SECT_SIZE, (uint32 *)&h, sizeof(h));
+		if ((h.magic == LOG_MAGIC) && (h.seq > best)) {
+			best = h.seq;
+			*head = s;
+		}
+	}
+	for (slot = 0; slot < LOG_REC_N; slot++) {
+		spi_flash_read((LOG_START_SECT + *head) * LOG_SECT_SIZE + sizeof(h) + slot * sizeof(struct user_log_rec), &w0, 4);
+		if (w0 == 0xFFFFFFFF) {
+			break;
+		}
+	}
+	return slot;
+}
+
+// Application Function: bench_check(void)
+// Desc: Reads the log back with a cursor and checks the data records are the
+//	most recent ones appended, in order
+static bool bench_check(void)
+{
+	struct user_log_cursor c;
+	struct user_log_entry e, r;
+	uint32 total = 0;		// Data records in the log
+	uint32 expect = 0;		// Index of the next data record expected
+
+	user_log_cursor_init(&c);
+	while (user_log_next(&c, &r)) {
+		total += (r.type == LOG_REC_DATA);
+	}
+
+	expect = appended - total;
+	user_log_cursor_init(&c);
+	while (user_log_next(&c, &r)) {
+		if (r.type != LOG_REC_DATA) {
+			continue;
+		}
+		bench_entry(expect, &e);
+		if ((r.hum_int != e.hum_int) || (r.hum_ext != e.hum_ext) ||
+		    (r.rpm != e.rpm) || (r.delay != e.delay)) {
+			printf("FAIL: record %u read back wrong\n", (unsigned)expect);
+			return false;
+		}
+		expect++;
+	}
+	if ((total == 0) || (total > LOG_SECT_N * LOG_REC_N)) {
+		printf("FAIL: %u records in the log\n", (unsigned)total);
+		return false;
+	}
+	return true;
+}
+
+// Application Function: bench_follow(void)
+// Desc: Appends twice the log's capacity while a cursor reads at a third of
+//	the rate, so the sector under it is reused. Every data record read must
+//	be a later one than the last, and the cursor must end on the newest
+static bool bench_follow(void)
+{
+	struct user_log_cursor c;
+	struct user_log_entry e, r;
+	uint32 next = 0;		// Lowest index the next data record read may have
+	uint32 jumps = 0;		// Times records were skipped
+	uint32 i, k;
+
+	user_log_cursor_init(&c);
+	while (user_log_next(&c, &r));
+	next = appended;
+	for (i = 0; i < 2 * LOG_SECT_N * LOG_REC_N + 1; i++) {
+		bench_entry(appended, &e);
+		if (!user_log_append(&e)) {
+			printf("FAIL: append %u\n", (unsigned)appended);
+			return false;
+		}
+		appended++;
+		if (((i % 3) != 0) || !user_log_next(&c, &r) || (r.type != LOG_REC_DATA)) {
+			continue;
+		}
+		for (k = next; k < appended; k++) {
+			bench_entry(k, &e);
+			if ((r.hum_int == e.hum_int) && (r.hum_ext == e.hum_ext) && (r.rpm == e.rpm) && (r.delay == e.delay)) {
+				break;
+			}
+		}
+		if (k == appended) {
+			printf("FAIL: cursor read a record out of order\n");
+			return false;
+		}
+		jumps += (k != next);
+		next = k + 1;
+	}
+	while (user_log_next(&c, &r)) {
+		next++;
+	}
+	if ((next != appended) || (jumps == 0)) {
+		printf("FAIL: cursor ended at %u of %u, %u jumps\n", (unsigned)next, (unsigned)appended, (unsigned)jumps);
+		return false;
+	}
+	printf("cursor lapped by the writer: %u skips, caught up\n", (unsigned)jumps);
+	return true;
+}
+
+void user_init(void)
+{
+	struct user_log_entry e;
+	struct host_flash_stats before;
+	double t0, t_append, t_bin, t_lin;
+	uint32 l, target, n;
+	uint32 reads_bin, reads_lin;
+	uint16 head, target_head, used;
+
+	host_opts.flash_file = BENCH_FLASH;
+	remove(BENCH_FLASH);
+	if (!user_log_init()) {
+		printf("FAIL: log init\n");
+		exit(1);
+	}
+
+	printf("%u sectors of %u records\n", (unsigned)LOG_SECT_N, (unsigned)LOG_REC_N);
+	for (l = 0; l < LEVEL_N; l++) {
+		// Append up to the fill level
+		target = levels[l];
+		n = target - appended;
+		before = host_flash_stats;
+		t0 = bench_now_us();
+		for (; appended < target; appended++) {
+			bench_entry(appended, &e);
+			if (!user_log_append(&e)) {
+				printf("FAIL: append %u\n", (unsigned)appended);
+				exit(1);
+			}
+		}
+		t_append = (bench_now_us() - t0) / n;
+		printf("%6u records: append %.1f us, %.3f writes + %.4f erases per record\n", (unsigned)target, t_append,
+			(double)(host_flash_stats.writes - before.writes) / n, (double)(host_flash_stats.erases - before.erases) / n);
+
+		// Restart, timing the head search both ways
+		before = host_flash_stats;
+		t0 = bench_now_us();
+		bench_linear(&head);
+		t_lin = bench_now_us() - t0;
+		reads_lin = host_flash_stats.reads - before.reads;
+
+		before = host_flash_stats;
+		t0 = bench_now_us();
+		if (!user_log_init()) {
+			printf("FAIL: log recovery\n");
+			exit(1);
+		}
+		t_bin = bench_now_us() - t0;
+		reads_bin = host_flash_stats.reads - before.reads;
+		printf("        recovery: binary %u reads %.1f us, linear %u reads %.1f us\n",
+			(unsigned)reads_bin, t_bin, (unsigned)reads_lin, t_lin);
+
+		if (!bench_check()) {
+			exit(1);
+		}
+	}
+
+	// A restart between erasing the next sector and writing its header must
+	// not lose the head
+	used = bench_linear(&head);
+	spi_flash_erase_sector(LOG_START_SECT + ((head + 1) % LOG_SECT_N));
+	if (!user_log_init() || (bench_linear(&target_head) != used + 1) || (target_head != head) || !bench_check()) {
+		printf("FAIL: recovery after a torn sector\n");
+		exit(1);
+	}
+	printf("torn sector: recovered\n");
+
+	if (!bench_follow() || !bench_check()) {
+		exit(1);
+	}
+
+	remove(BENCH_FLASH);
+	exit(0);
+}
@@ -0,0 +1,391 @@
+// http_req.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: HTTP server benchmark. First feeds typical requests (a browser
+//	page load, a form POST, a WebSocket upgrade) to user_http_parse whole, in
+//	small pieces and a byte at a time, checking what is parsed out each time,
+//	and reports parse cost per request. Then serves a small route over
+//	loopback through the espconn shim and reports requests per second from a
+//	client thread, on one kept alive connection and with a new connection
+//	per request, after checking which responses close the connection.
+//
+//	make host-bench && ../host/build/interior/http_req
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "user_http.h"
+#include "host.h"
+
+#define PARSE_ROUNDS	100000		// Parses of each request per split
+#define KEEP_N		20000		// Requests over one connection
+#define CONNECT_N	2000		// Requests with a connection each
+#define BENCH_PORT	80
+#define BENCH_OFFSET	21000		// Keeps the server clear of a running interior
+
+static const char *req_page = {
+	"GET /?x=1 HTTP/1.1\r\n"
+	"Host: 192.168.1.20\r\n"
+	"Connection: keep-alive\r\n"
+	"Cache-Control: max-age=0\r\n"
+	"Upgrade-Insecure-Requests: 1\r\n"
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+	"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+	"Accept-Encoding: gzip, deflate\r\n"
+	"Accept-Language: en-US,en;q=0.9\r\n"
+	"If-None-Match: \"2a2332f7\"\r\n\r\n"
+};
+static const char *req_post = {
+	"POST /submit HTTP/1.1\r\n"
+	"Host: 192.168.0.1\r\n"
+	"Content-Type: application/x-www-form-urlencoded\r\n"
+	"Content-Length: 32\r\n\r\n"
+	"ssid=Home+Network&pass=p%21ssw0d"
+};
+static const char *req_ws = {
+	"GET / HTTP/1.1\r\n"
+	"Host: 192.168.1.20\r\n"
+	"Connection: Upgrade\r\n"
+	"Upgrade: websocket\r\n"
+	"Sec-WebSocket-Version: 13\r\n"
+	"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n"
+};
+static const uint16 splits[] = { 0, 16, 1 };	// Piece sizes, 0 for whole
+#define SPLIT_N		(sizeof(splits) / sizeof(splits[0]))
+
+static struct user_http_req req;
+static struct espconn server_conn;
+static struct _esp_tcp server_proto;
+static int stdout_fd = -1;		// Real stdout, while the server's debug output is discarded
+
+static double bench_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Application Function: bench_parse(const char *text, uint16 piece)
+// Desc: Parses a request fed in pieces of the given size
+// Returns: The parse result
+static uint16 bench_parse(const char *text, uint16 piece)
+{
+	uint16 len = strlen(text);
+	uint16 pos = 0;
+	uint16 n, used;
+	uint16 status = HTTP_MORE;
+
+	user_http_parse_init(&req);
+	while ((pos < len) && (status == HTTP_MORE)) {
+		n = ((piece == 0) || (len - pos < piece)) ? (len - pos) : piece;
+		status = user_http_parse(&req, (const uint8 *)&text[pos], n, &used);
+		pos += used;
+	}
+	return status;
+}
+
+// Application Function: bench_check(void)
+// Desc: Checks every request parses out right at every split
+static bool bench_check(void)
+{
+	uint8 s;
+
+	for (s = 0; s < SPLIT_N; s++) {
+		if ((bench_parse(req_page, splits[s]) != HTTP_DONE) || (req.method != HTTP_GET) ||
+		    (strcmp(req.path, "/") != 0) || (strcmp(req.query, "x=1") != 0) ||
+		    (strcmp(req.etag, "\"2a2332f7\"") != 0) || !req.keep_alive || req.upgrade) {
+			printf("FAIL: page request, split %u\n", splits[s]);
+			return false;
+		}
+		if ((bench_parse(req_post, splits[s]) != HTTP_DONE) || (req.method != HTTP_POST) ||
+		    (strcmp(req.path, "/submit") != 0) || (req.body_len != 32) ||
+		    (strcmp((char *)req.body, "ssid=Home+Network&pass=p%21ssw0d") != 0)) {
+			printf("FAIL: post request, split %u\n", splits[s]);
+			return false;
+		}
+		if ((bench_parse(req_ws, splits[s]) != HTTP_DONE) || !req.upgrade ||
+		    (strcmp(req.ws_key, "dGhlIHNhbXBsZSBub25jZQ==") != 0)) {
+			printf("FAIL: upgrade request, split %u\n", splits[s]);
+			return false;
+		}
+	}
+	if ((bench_parse("GET / HTTP/1.1\r\nContent-Length: 9999\r\n\r\n", 0) != 413) ||
+	    (bench_parse("GET / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", 0) != 400) ||
+	    (bench_parse("GET / FTP/1.1\r\n\r\n", 0) != 400)) {
+		printf("FAIL: bad requests accepted\n");
+		return false;
+	}
+	return true;
+}
+
+// Application Function: bench_ping(struct espconn *conn, struct user_http_req *r)
+// Desc: Route handler served over loopback
+static void bench_ping(struct espconn *conn, struct user_http_req *r)
+{
+	user_http_respond(conn, 200, "text/plain", "pong", 4);
+}
+
+static const struct user_http_route bench_routes[] = {
+	{ HTTP_GET, "/ping", bench_ping },
+};
+static const struct user_http_server bench_server = { "bench", bench_routes, 1 };
+
+static void bench_recv_cb(void *arg, char *data, unsigned short len)
+{
+	user_http_recv(&bench_server, arg, data, len);
+}
+
+static void bench_sent_cb(void *arg)
+{
+	user_http_sent(arg);
+}
+
+static void bench_discon_cb(void *arg)
+{
+	user_http_close(arg);
+}
+
+static void bench_recon_cb(void *arg, sint8 err)
+{
+	user_http_close(arg);
+}
+
+static void bench_connect_cb(void *arg)
+{
+	espconn_regist_recvcb(arg, bench_recv_cb);
+	espconn_regist_sentcb(arg, bench_sent_cb);
+	espconn_regist_disconcb(arg, bench_discon_cb);
+	espconn_regist_reconcb(arg, bench_recon_cb);
+	user_http_accept(arg);
+}
+
+// Application Function: bench_connect(void)
+// Desc: Opens a client connection to the server
+static int bench_connect(void)
+{
+	struct sockaddr_in sa;
+	int fd, one = 1;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(BENCH_PORT + BENCH_OFFSET);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if ((fd < 0) || (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0)) {
+		printf("FAIL: connect\n");
+		exit(1);
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+// Application Function: bench_request(int fd)
+// Desc: Sends one request and reads the whole response
+static void bench_request(int fd)
+{
+	static const char *ping = "GET /ping HTTP/1.1\r\nHost: bench\r\n\r\n";
+	static const char *pong = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 4\r\n\r\npong";
+	char buf[256];
+	size_t want = strlen(pong);
+	size_t got = 0;
+	ssize_t n;
+
+	if (send(fd, ping, strlen(ping), 0) != (ssize_t)strlen(ping)) {
+		printf("FAIL: send\n");
+		exit(1);
+	}
+	while (got < want) {
+		n = recv(fd, &buf[got], sizeof(buf) - got, 0);
+		if (n <= 0) {
+			printf("FAIL: response cut short\n");
+			exit(1);
+		}
+		got += n;
+	}
+	if ((got != want) || (memcmp(buf, pong, want) != 0)) {
+		printf("FAIL: bad response\n");
+		exit(1);
+	}
+}
+
+// Application Function: bench_drain(int fd, char *buf, size_t size)
+// Desc: Reads until the server closes the connection
+// Returns:
+//	Bytes read, NUL terminated, or -1 if the connection was left open
+static ssize_t bench_drain(int fd, char *buf, size_t size)
+{
+	struct timeval tv = { 1, 0 };
+	size_t got = 0;
+	ssize_t n;
+
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	while ((n = recv(fd, &buf[got], size - 1 - got, 0)) > 0) {
+		got += n;
+	}
+	buf[got] = '\0';
+	return (n == 0) ? (ssize_t)got : -1;
+}
+
+// Application Function: bench_close_check(void)
+// Desc: Checks the server closes a connection after Connection: close, a
+//	bad request and a 503, and refuses a client with no slot only once
+// Returns:
+//	NULL if all is well, otherwise what failed
+static const char *bench_close_check(void)
+{
+	static const char *part = "GET /ping HTTP/1.1\r\n";
+	char buf[1024];
+	int held[HTTP_CONN_N];
+	int fd, i;
+	char *p;
+
+	fd = bench_connect();
+	send(fd, "GET /ping HTTP/1.1\r\nConnection: close\r\n\r\n", 44, 0);
+	if ((bench_drain(fd, buf, sizeof(buf)) < 0) || (strstr(buf, "Connection: close\r\n") == NULL) ||
+	    (strstr(buf, "\r\n\r\npong") == NULL)) {
+		return "Connection: close not honoured";
+	}
+	close(fd);
+
+	fd = bench_connect();
+	send(fd, "GET /ping HTTP/1.0\r\n\r\n", 24, 0);
+	if ((bench_drain(fd, buf, sizeof(buf)) < 0) || (strstr(buf, "pong") == NULL)) {
+		return "HTTP/1.0 connection left open";
+	}
+	close(fd);
+
+	fd = bench_connect();
+	send(fd, "GET / FTP/1.1\r\n\r\n", 19, 0);
+	if ((bench_drain(fd, buf, sizeof(buf)) < 0) || (strncmp(buf, "HTTP/1.1 400 ", 13) != 0) ||
+	    (strstr(buf, "Connection: close\r\n") == NULL)) {
+		return "bad request connection left open";
+	}
+	close(fd);
+
+	// Fill the pool with half sent requests, then send a client with no slot
+	//	several segments; it must get one 503
+	for (i = 0; i < HTTP_CONN_N; i++) {
+		held[i] = bench_connect();
+		send(held[i], part, strlen(part), 0);
+	}
+	usleep(50000);
+	fd = bench_connect();
+	for (i = 0; i < 4; i++) {
+		send(fd, part, strlen(part), MSG_NOSIGNAL);
+		usleep(10000);
+	}
+	if (bench_drain(fd, buf, sizeof(buf)) < 0) {
+		return "refused connection left open";
+	}
+	for (i = 0, p = buf; (p = strstr(p, "HTTP/1.1 503 ")) != NULL; p++, i++);
+	if (i != 1) {
+		return "refused client not answered 503 exactly once";
+	}
+	close(fd);
+	for (i = 0; i < HTTP_CONN_N; i++) {
+		close(held[i]);
+	}
+	usleep(50000);
+
+	return NULL;
+}
+
+// Callback Function: bench_client(void *arg)
+// Desc: Client thread, timed against the server running in the event loop
+static void *bench_client(void *arg)
+{
+	const char *fail;
+	double t0, t_keep, t_conn;
+	uint32 i;
+	int fd;
+
+	fail = bench_close_check();
+	if (fail != NULL) {
+		fflush(stdout);
+		dup2(stdout_fd, STDOUT_FILENO);
+		printf("FAIL: %s\n", fail);
+		exit(1);
+	}
+
+	fd = bench_connect();
+	t0 = bench_now_us();
+	for (i = 0; i < KEEP_N; i++) {
+		bench_request(fd);
+	}
+	t_keep = bench_now_us() - t0;
+	close(fd);
+
+	t0 = bench_now_us();
+	for (i = 0; i < CONNECT_N; i++) {
+		fd = bench_connect();
+		bench_request(fd);
+		close(fd);
+	}
+	t_conn = bench_now_us() - t0;
+
+	fflush(stdout);
+	dup2(stdout_fd, STDOUT_FILENO);
+	printf("loopback: keep-alive %.0f req/s, connection per request %.0f req/s\n",
+		KEEP_N / (t_keep / 1e6), CONNECT_N / (t_conn / 1e6));
+	exit(0);
+	return NULL;
+}
+
+void user_init(void)
+{
+	const char *names[] = { "page", "post", "upgrade" };
+	const char *texts[] = { req_page, req_post, req_ws };
+	pthread_t client;
+	double t0, t;
+	uint32 i;
+	uint8 r, s;
+
+	if (!bench_check()) {
+		exit(1);
+	}
+	for (r = 0; r < 3; r++) {
+		printf("%-8s %4u bytes:", names[r], (unsigned)strlen(texts[r]));
+		for (s = 0; s < SPLIT_N; s++) {
+			t0 = bench_now_us();
+			for (i = 0; i < PARSE_ROUNDS; i++) {
+				bench_parse(texts[r], splits[s]);
+			}
+			t = (bench_now_us() - t0) * 1e3 / PARSE_ROUNDS;
+			if (splits[s] == 0) {
+				printf("  whole %6.0f ns", t);
+			} else {
+				printf("  %2u byte pieces %6.0f ns", splits[s], t);
+			}
+		}
+		printf("\n");
+	}
+
+	// Serve over loopback; the client runs in its own thread while the
+	// server runs from the shim's event loop, as it would on the chip. The
+	// server logs every request at DEBUG_LEVEL, which would swamp the results
+	fflush(stdout);
+	stdout_fd = dup(STDOUT_FILENO);
+	freopen("/dev/null", "w", stdout);
+	host_opts.port_offset = BENCH_OFFSET;
+	server_proto.local_port = BENCH_PORT;
+	server_conn.type = ESPCONN_TCP;
+	server_conn.state = ESPCONN_NONE;
+	server_conn.proto.tcp = &server_proto;
+	espconn_regist_connectcb(&server_conn, bench_connect_cb);
+	if (espconn_accept(&server_conn) != 0) {
+		printf("FAIL: listen\n");
+		exit(1);
+	}
+	if (pthread_create(&client, NULL, bench_client, NULL) != 0) {
+		printf("FAIL: client thread\n");
+		exit(1);
+	}
+}
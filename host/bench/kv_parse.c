@@ -0,0 +1,208 @@
+// kv_parse.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Fan command parser benchmark. Checks user_fan_command against
+//	the commands the front page sends and against bad ones, which must change
+//	nothing, then times it against the os_strstr scans it replaced (kept
+//	below as bench_strstr) on the same commands. Also checks the discovery
+//	address and form field helpers it is built on.
+//
+//	make host-bench && ../host/build/interior/kv_parse
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "user_fan.h"
+#include "user_kv.h"
+#include "host.h"
+
+#define ROUNDS		1000000		// Parses of each command
+
+static const char *cmds[] = {
+	"speed=2000,mode=normal",
+	"delay=3000,mode=lock_on",
+	"speed=1500,mode=lock_off",
+	"mode=normal",
+};
+#define CMD_N		(sizeof(cmds) / sizeof(cmds[0]))
+
+static double bench_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Application Function: bench_atoi(const char *str, uint16 len)
+// Desc: The user_atoi the old parser used, least significant digit first
+static uint32 bench_atoi(const char *str, uint16 len)
+{
+	uint32 val = 0;
+	uint32 mult = 1;
+	sint16 i, digit;
+
+	if (len > 10) {
+		return 0;
+	}
+	for (i = len - 1; i >= 0; i--) {
+		digit = str[i] - '0';
+		if ((digit < 0) || (digit > 9)) {
+			return val;
+		}
+		val += digit * mult;
+		mult *= 10;
+	}
+	return val;
+}
+
+// Application Function: bench_rom_strstr(const char *s, const char *find)
+// Desc: Byte at a time search, as os_strstr is in the chip's ROM. glibc's
+//	vectorised strstr would flatter the old parser on the host
+static const char *bench_rom_strstr(const char *s, const char *find)
+{
+	size_t i;
+
+	for (; *s != '\0'; s++) {
+		for (i = 0; (find[i] != '\0') && (s[i] == find[i]); i++);
+		if (find[i] == '\0') {
+			return s;
+		}
+	}
+	return NULL;
+}
+
+// Application Function: bench_strstr(const char *data)
+// Desc: The old user_ws_parse_data, for comparison. A missing trailing comma
+//	is taken as the end of the string here, where the old code read on
+//	from a NULL pointer
+static void bench_strstr(const char *data)
+{
+	const char *p1, *p2;
+	uint32 speed, delay;
+
+	p1 = bench_rom_strstr(data, "speed=");
+	if (p1 != NULL) {
+		p1 += 6;
+		p2 = bench_rom_strstr(p1, ",");
+		speed = bench_atoi(p1, (p2 != NULL) ? (uint16)(p2 - p1) : (uint16)strlen(p1));
+		speed > FAN_RPM_MAX ? (speed = FAN_RPM_MAX) : 0;
+		speed < FAN_RPM_MIN ? (speed = FAN_RPM_MIN) : 0;
+		desired_rpm = speed;
+		control_mode = CONTROL_SPEED;
+	}
+	p1 = bench_rom_strstr(data, "delay=");
+	if (p1 != NULL) {
+		p1 += 6;
+		p2 = bench_rom_strstr(p1, ",");
+		delay = bench_atoi(p1, (p2 != NULL) ? (uint16)(p2 - p1) : (uint16)strlen(p1));
+		delay > SUPPLY_HALF_CYCLE ? (delay = SUPPLY_HALF_CYCLE) : 0;
+		desired_delay = delay;
+		control_mode = CONTROL_DELAY;
+	}
+	p1 = bench_rom_strstr(data, "mode=");
+	if (p1 != NULL) {
+		p1 += 4;
+		if (bench_rom_strstr(p1, "lock_on") != NULL) {
+			fan_mode = FAN_LOCK_ON;
+		}
+		if (bench_rom_strstr(p1, "lock_off") != NULL) {
+			fan_mode = FAN_LOCK_OFF;
+		}
+		if (bench_rom_strstr(p1, "normal") != NULL) {
+			fan_mode = FAN_NORMAL;
+		}
+	}
+}
+
+// Application Function: bench_expect(const char *cmd, bool ok, sint32 rpm, sint32 delay, uint8 control, uint8 mode)
+// Desc: Runs a command from a known state and checks the settings it leaves
+static bool bench_expect(const char *cmd, bool ok, sint32 rpm, sint32 delay, uint8 control, uint8 mode)
+{
+	desired_rpm = 2500;
+	desired_delay = 4000;
+	control_mode = CONTROL_SPEED;
+	fan_mode = FAN_NORMAL;
+
+	if ((user_fan_command(cmd, strlen(cmd)) != ok) || (desired_rpm != rpm) || (desired_delay != delay) ||
+	    (control_mode != control) || (fan_mode != mode)) {
+		printf("FAIL: \"%s\" left rpm=%d delay=%d control=%u mode=%u\n",
+			cmd, desired_rpm, desired_delay, control_mode, fan_mode);
+		return false;
+	}
+	return true;
+}
+
+// Application Function: bench_check(void)
+// Desc: Checks commands, bad commands and the helpers
+static bool bench_check(void)
+{
+	struct user_kv_lexer lx;
+	struct user_kv kv;
+	uint8 ip[4];
+	const char *form = "ssid=Home+Network&&pass=&x";
+	bool ok = true;
+
+	ok &= bench_expect("speed=2000,mode=normal", true, 2000, 4000, CONTROL_SPEED, FAN_NORMAL);
+	ok &= bench_expect("delay=3000,mode=lock_on", true, 2500, 3000, CONTROL_DELAY, FAN_LOCK_ON);
+	ok &= bench_expect("mode=override,", true, 2500, 4000, CONTROL_SPEED, FAN_OVERRIDE);
+	ok &= bench_expect("speed=9000", true, FAN_RPM_MAX, 4000, CONTROL_SPEED, FAN_NORMAL);
+	ok &= bench_expect("speed=10", true, FAN_RPM_MIN, 4000, CONTROL_SPEED, FAN_NORMAL);
+	ok &= bench_expect("delay=99999", true, 2500, SUPPLY_HALF_CYCLE, CONTROL_DELAY, FAN_NORMAL);
+
+	// Refused whole, even after a good pair
+	ok &= bench_expect("Hello HBFC/D", false, 2500, 4000, CONTROL_SPEED, FAN_NORMAL);
+	ok &= bench_expect("mode=lock_off,speed=2x00", false, 2500, 4000, CONTROL_SPEED, FAN_NORMAL);
+	ok &= bench_expect("delay=3000,mode=sideways", false, 2500, 4000, CONTROL_SPEED, FAN_NORMAL);
+	ok &= bench_expect("speed=", false, 2500, 4000, CONTROL_SPEED, FAN_NORMAL);
+	ok &= bench_expect("speed=99999999999", false, 2500, 4000, CONTROL_SPEED, FAN_NORMAL);
+	ok &= bench_expect("spee=2000", false, 2500, 4000, CONTROL_SPEED, FAN_NORMAL);
+
+	// Discovery address
+	ok &= user_kv_ip("192.168.1.20", 12, ip) && (ip[0] == 192) && (ip[3] == 20);
+	ok &= user_kv_ip("10.0.0.1", 8, ip) && (ip[0] == 10) && (ip[3] == 1);
+	ok &= !user_kv_ip("10.0.0", 6, ip) && !user_kv_ip("10.0.0.256", 10, ip) &&
+		!user_kv_ip("10.0..1", 7, ip) && !user_kv_ip("10.0.0.1.2", 10, ip) &&
+		!user_kv_ip("1.2.3.4.", 8, ip) && !user_kv_ip("10.0.0.", 7, ip);
+
+	// Form fields, empty pairs skipped
+	user_kv_init(&lx, form, strlen(form), '&');
+	ok &= user_kv_next(&lx, &kv) && user_kv_is(kv.key, kv.key_len, "ssid") &&
+		user_kv_is(kv.val, kv.val_len, "Home+Network");
+	ok &= user_kv_next(&lx, &kv) && user_kv_is(kv.key, kv.key_len, "pass") && (kv.val_len == 0);
+	ok &= user_kv_next(&lx, &kv) && user_kv_is(kv.key, kv.key_len, "x") && (kv.val_len == 0);
+	ok &= !user_kv_next(&lx, &kv);
+
+	if (!ok) {
+		printf("FAIL: helpers\n");
+	}
+	return ok;
+}
+
+void user_init(void)
+{
+	double t0, t_new, t_old;
+	uint32 i;
+	uint8 c;
+
+	if (!bench_check()) {
+		exit(1);
+	}
+
+	for (c = 0; c < CMD_N; c++) {
+		t0 = bench_now_us();
+		for (i = 0; i < ROUNDS; i++) {
+			user_fan_command(cmds[c], strlen(cmds[c]));
+		}
+		t_new = (bench_now_us() - t0) * 1e3 / ROUNDS;
+
+		t0 = bench_now_us();
+		for (i = 0; i < ROUNDS; i++) {
+			bench_strstr(cmds[c]);
+		}
+		t_old = (bench_now_us() - t0) * 1e3 / ROUNDS;
+
+		printf("%-26s one pass %5.1f ns   os_strstr scans %5.1f ns\n", cmds[c], t_new, t_old);
+	}
+	exit(0);
+}
@@ -0,0 +1,171 @@
+// link_decode.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Link frame decoder check and throughput. Encodes a stream of
+//	sample and ACK frames with garbage between some of them, feeds it to
+//	user_link_decode cut into random pieces from one byte up to several
+//	frames, and checks every frame comes out whole, in order and with the
+//	garbage skipped. Then times decoding the clean stream in TCP segment
+//	sized pieces. Results are host MB/s; the check is what carries over.
+//
+//	make host-bench && ../host/build/interior/link_decode
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "user_link.h"
+#include "host.h"
+
+#define FRAME_N		20000		// Frames in the stream
+#define STREAM_MAX	(FRAME_N * (LINK_FRAME_MAX + 8))
+#define SEGMENT		1460		// Piece size for the timed run
+#define ROUNDS		50		// Timed passes over the stream
+
+static uint8 stream[STREAM_MAX];
+static uint32 stream_len = 0;
+static uint32 garbage = 0;		// Garbage bytes put in the stream
+
+static uint32 next_seq = 0;		// Sequence number expected next
+static uint32 bad = 0;			// Frames which did not match
+
+static double bench_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Application Function: bench_fill(uint16 seq, struct user_link_samples *s)
+// Desc: The samples frame seq carries, so the handler can check it
+static void bench_fill(uint16 seq, struct user_link_samples *s)
+{
+	uint8 i;
+
+	s->time = seq * 3000u;
+	s->period = 3000;
+	s->status = (seq % 7) ? LINK_STATUS_OK : LINK_STATUS_FAIL;
+	s->n = (seq % 7) ? (seq % LINK_SAMPLES_MAX) + 1 : 0;
+	for (i = 0; i < s->n; i++) {
+		s->sample[i] = (seq * 31 + i) % 10000;
+	}
+}
+
+// Application Function: bench_build(void)
+// Desc: Encodes the stream. Every fifth frame is an ACK, and some frames are
+//	preceded by bytes a decoder could mistake for the start of a header
+static void bench_build(void)
+{
+	static const uint8 junk[][4] = {
+		{ 0x00, 0xFF, 0x13, 0x37 },
+		{ 'H', 'H', 'C', 0x09 },	// Wrong version
+		{ 'H', 'x', 'H', 'y' },
+	};
+	struct user_link_samples s;
+	uint32 seq;
+	uint8 j;
+
+	srand(1);
+	for (seq = 0; seq < FRAME_N; seq++) {
+		if (seq % 11 == 3) {
+			j = rand() % 3;
+			memcpy(&stream[stream_len], junk[j], 4);
+			stream_len += 4;
+			garbage += 4;
+		}
+		if (seq % 5 == 4) {
+			stream_len += user_link_encode_ack(&stream[stream_len], seq, seq - 1);
+		} else {
+			bench_fill(seq, &s);
+			stream_len += user_link_encode_samples(&stream[stream_len], seq, &s);
+		}
+	}
+}
+
+// Callback Function: bench_frame(void *arg, const struct user_link_frame *frame)
+// Desc: Checks a decoded frame against what bench_build put in the stream
+static void bench_frame(void *arg, const struct user_link_frame *frame)
+{
+	struct user_link_samples want, got;
+	uint16 acked;
+
+	if (frame->seq != (uint16)next_seq) {
+		bad++;
+	} else if (next_seq % 5 == 4) {
+		if (!user_link_ack(frame, &acked) || (acked != (uint16)(next_seq - 1))) {
+			bad++;
+		}
+	} else {
+		bench_fill(next_seq, &want);
+		if (!user_link_samples(frame, &got) || (got.n != want.n) || (got.time != want.time) ||
+		    (got.status != want.status) || memcmp(got.sample, want.sample, 2 * want.n)) {
+			bad++;
+		}
+	}
+	next_seq++;
+}
+
+// Callback Function: bench_frame_count(void *arg, const struct user_link_frame *frame)
+// Desc: Handler for the timed run, counts frames only
+static void bench_frame_count(void *arg, const struct user_link_frame *frame)
+{
+	(*(uint32 *)arg)++;
+}
+
+// Application Function: bench_check(uint16 max)
+// Desc: Decodes the stream in random pieces of 1 to max bytes
+static bool bench_check(uint16 max)
+{
+	struct user_link_decoder dec;
+	uint32 off = 0;
+	uint16 n;
+
+	memset(&dec, 0, sizeof(dec));
+	user_link_decode_init(&dec);
+	next_seq = 0;
+	bad = 0;
+	while (off < stream_len) {
+		n = (rand() % max) + 1;
+		if (n > stream_len - off) {
+			n = stream_len - off;
+		}
+		user_link_decode(&dec, &stream[off], n, bench_frame, NULL);
+		off += n;
+	}
+	if ((next_seq != FRAME_N) || (bad != 0) || (dec.skipped != garbage) || (dec.len != 0)) {
+		printf("FAIL: pieces up to %u: frames=%u bad=%u skipped=%u of %u\n",
+			max, next_seq, bad, dec.skipped, garbage);
+		return false;
+	}
+	return true;
+}
+
+void user_init(void)
+{
+	struct user_link_decoder dec;
+	double t0, t;
+	uint32 frames = 0;
+	uint32 off, r;
+	uint16 n;
+
+	bench_build();
+	if (!bench_check(1) || !bench_check(7) || !bench_check(LINK_FRAME_MAX) || !bench_check(SEGMENT)) {
+		exit(1);
+	}
+	printf("%u frames, %u bytes, %u garbage bytes skipped, decoded whole in pieces of 1-%u bytes\n",
+		FRAME_N, stream_len, garbage, SEGMENT);
+
+	memset(&dec, 0, sizeof(dec));
+	t0 = bench_now_us();
+	for (r = 0; r < ROUNDS; r++) {
+		user_link_decode_init(&dec);
+		for (off = 0; off < stream_len; off += n) {
+			n = (stream_len - off < SEGMENT) ? stream_len - off : SEGMENT;
+			user_link_decode(&dec, &stream[off], n, bench_frame_count, &frames);
+		}
+	}
+	t = bench_now_us() - t0;
+	printf("decode %6.1f MB/s   %5.1f ns/frame\n",
+		(double)stream_len * ROUNDS / t, t * 1e3 / frames);
+	exit(0);
+}
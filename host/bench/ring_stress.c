@@ -0,0 +1,142 @@
+// ring_stress.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Stress check for user_ring.h. A signal handler stands in for
+//	the ISR: a POSIX interval timer raises SIGALRM every few microseconds,
+//	and each delivery pre-empts the task loop wherever it happens to be, as
+//	an interrupt does on the single core ESP8266. The handler pushes a
+//	burst of sequence numbers, counting one past the last accepted push, so
+//	the task loop, which pops with the odd stall to let the ring fill, must
+//	see 0, 1, 2, ... with no gaps, and every push attempt must show up as
+//	either popped or dropped.
+//
+//	The same handler bumps two counters the task also touches: one the task
+//	snapshots and resets with user_atomic_swap, one it adds to with
+//	user_atomic_add. While the task holds ets_intr_lock a delivery is
+//	latched and replayed on the next one, as the chip holds a masked
+//	interrupt pending, so no increment may be lost on either counter.
+//
+//	make host-bench && ../host/build/interior/ring_stress
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <time.h>
+#include "user_ring.h"
+#include "host.h"
+
+#define PUSH_N		2000000		// Push attempts, across all bursts
+#define BURST_MAX	16		// Pushes per delivery, 1 to BURST_MAX
+#define STALL_EVERY	4096		// Pops between consumer stalls
+#define STALL_US	200		// Length of a stall, enough for the ring to fill
+#define TICK_NS		20000		// Interrupt period asked of the timer
+
+static volatile uint32 ring_buf[64];
+static struct user_ring ring = USER_RING_INIT(ring_buf);
+
+static volatile uint32 isr_seq = 0;		// Next value the ISR pushes
+static volatile uint32 isr_attempts = 0;	// Pushes tried, accepted or not
+static volatile uint32 isr_pending = 0;		// Deliveries latched while interrupts were locked
+static volatile uint32 isr_latched = 0;		// Total deliveries latched
+static volatile uint32 isr_rand = 1;		// Burst length generator
+
+static volatile uint32 swap_cnt = 0;		// ISR increments, task snapshots and resets
+static volatile uint32 add_cnt = 0;		// Both sides increment
+static volatile uint32 isr_adds = 0;		// ISR increments of add_cnt
+
+static double bench_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Interrupt Service Routine: bench_isr(int sig)
+// Desc: One interrupt, plus any latched while interrupts were locked
+static void bench_isr(int sig)
+{
+	uint32 n = 0;
+	uint32 i = 0;
+
+	if (!host_irq_allowed()) {
+		isr_pending++;
+		isr_latched++;
+		return;
+	}
+	host_irq_enter();
+	for (n = isr_pending + 1, isr_pending = 0; n > 0; n--) {
+		isr_rand = isr_rand * 1103515245 + 12345;
+		for (i = ((isr_rand >> 16) % BURST_MAX) + 1; (i > 0) && (isr_attempts < PUSH_N); i--) {
+			isr_attempts++;
+			if (user_ring_push(&ring, isr_seq)) {
+				isr_seq++;
+			}
+			swap_cnt++;
+			add_cnt++;
+			isr_adds++;
+		}
+	}
+	host_irq_exit();
+}
+
+void user_init(void)
+{
+	struct sigaction sa = { 0 };
+	struct sigevent sev = { 0 };
+	struct itimerspec its = { { 0, TICK_NS }, { 0, TICK_NS } };
+	timer_t timer;
+	uint32 expect = 0;		// Next value the task should pop
+	uint32 val = 0;
+	uint32 popped = 0;
+	uint32 gaps = 0;		// Popped values out of sequence
+	uint32 swapped = 0;		// Sum of user_atomic_swap snapshots
+	uint32 task_adds = 0;		// Task increments of add_cnt
+	double stall_end = 0;
+	double t0, t;
+
+	sa.sa_handler = bench_isr;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGALRM, &sa, NULL);
+	sev.sigev_notify = SIGEV_SIGNAL;
+	sev.sigev_signo = SIGALRM;
+	timer_create(CLOCK_MONOTONIC, &sev, &timer);
+
+	t0 = bench_now_us();
+	timer_settime(timer, 0, &its, NULL);
+	while ((isr_attempts < PUSH_N) || (user_ring_count(&ring) != 0)) {
+		if (user_ring_pop(&ring, &val)) {
+			if (val != expect) {
+				gaps++;
+			}
+			expect = val + 1;
+			popped++;
+			if ((popped % STALL_EVERY) == 0) {
+				for (stall_end = bench_now_us() + STALL_US; bench_now_us() < stall_end;);
+			}
+		}
+		// Every pass, so interrupts often land inside the locked sections
+		swapped += user_atomic_swap(&swap_cnt, 0);
+		user_atomic_add(&add_cnt, 1);
+		task_adds++;
+	}
+	timer_delete(timer);
+	t = bench_now_us() - t0;
+
+	// Deliveries latched after the last push have nothing left to push
+	isr_pending = 0;
+	swapped += user_atomic_swap(&swap_cnt, 0);
+
+	if ((gaps != 0) || (popped != isr_seq) || (isr_attempts != popped + ring.dropped) ||
+			(swapped != isr_attempts) || (add_cnt != isr_adds + task_adds) || (isr_latched == 0)) {
+		printf("FAIL: attempts=%u popped=%u dropped=%u gaps=%u swapped=%u add=%u of %u latched=%u\n",
+			isr_attempts, popped, ring.dropped, gaps, swapped, add_cnt,
+			isr_adds + task_adds, isr_latched);
+		exit(1);
+	}
+	printf("%u pushes from a signal handler ISR: %u popped in order, %u dropped on a full ring\n",
+		isr_attempts, popped, ring.dropped);
+	printf("atomic swap/add: no increments lost, %u interrupts latched while locked, %.1f s\n",
+		isr_latched, t / 1e6);
+	exit(0);
+}
@@ -0,0 +1,146 @@
+// ws_parse.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: WebSocket parser benchmark. Builds a client byte stream of masked
+//	frames - short and 16 bit length messages, messages fragmented over several
+//	frames and pings interleaved between fragments - then feeds it to
+//	user_ws_parse in randomly sized chunks, checking every delivered message
+//	against what was sent. Reports host MB/s of stream parsed.
+//
+//	make host-bench && ../host/build/interior/ws_parse
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "user_ws.h"
+#include "host.h"
+
+#define MSG_N		512		// Messages in the stream
+#define STREAM_MAX	(MSG_N * (WS_MSG_MAX + 64) * 2)
+#define CHUNK_MAX	1460		// Largest chunk handed to the parser (one TCP segment)
+#define ROUNDS		200		// Times the stream is replayed
+
+static uint8 stream[STREAM_MAX];	// Encoded client stream
+static uint8 work[STREAM_MAX];		// Copy parsed in place each round
+static uint32 stream_len = 0;
+static uint8 msgs[MSG_N][WS_MSG_MAX];	// Sent message payloads
+static uint16 msg_lens[MSG_N];
+static uint32 seed = 1;
+
+static uint32 got_msg = 0;		// Messages delivered this round
+static uint32 got_ping = 0;		// Pings delivered this round
+static bool bad = false;		// Set on any mismatch
+
+static uint32 bench_rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 16;
+}
+
+// Application Function: bench_frame(uint8 opcode, bool fin, const uint8 *data, uint16 len)
+// Desc: Appends one masked client frame to the stream
+static void bench_frame(uint8 opcode, bool fin, const uint8 *data, uint16 len)
+{
+	uint8 *f = &stream[stream_len];
+	uint8 mask[4];
+	uint16 i;
+	uint8 h = 0;
+
+	f[h++] = (fin ? 0x80 : 0x00) | opcode;
+	if (len < 126) {
+		f[h++] = 0x80 | len;
+	} else {
+		f[h++] = 0x80 | 126;
+		f[h++] = len >> 8;
+		f[h++] = len & 0xFF;
+	}
+	for (i = 0; i < 4; i++) {
+		mask[i] = bench_rand();
+		f[h++] = mask[i];
+	}
+	for (i = 0; i < len; i++) {
+		f[h + i] = data[i] ^ mask[i & 3];
+	}
+	stream_len += h + len;
+}
+
+static void bench_cb(void *arg, uint8 opcode, uint8 *data, uint16 len)
+{
+	(void)arg;
+
+	if (opcode == WS_OP_PING) {
+		if ((len != 4) || (memcmp(data, "ping", 4) != 0)) {
+			bad = true;
+		}
+		got_ping++;
+		return;
+	}
+	if ((got_msg >= MSG_N) || (len != msg_lens[got_msg]) || (data[len] != '\0') ||
+	    (memcmp(data, msgs[got_msg], len) != 0)) {
+		bad = true;
+	}
+	got_msg++;
+}
+
+static double bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+void user_init(void)
+{
+	static struct user_ws_parser parser;
+	uint32 pings = 0;
+	uint32 i, j, r, pos, n, off, frag;
+	uint16 code = 0;
+	double t0, t;
+
+	// Messages of random length, some sent whole and some in fragments
+	for (i = 0; i < MSG_N; i++) {
+		msg_lens[i] = 1 + bench_rand() % WS_MSG_MAX;
+		for (j = 0; j < msg_lens[i]; j++) {
+			msgs[i][j] = 'a' + bench_rand() % 26;
+		}
+		frag = 1 + bench_rand() % 4;
+		for (off = 0, j = 0; j < frag; j++) {
+			n = (j == frag - 1) ? (msg_lens[i] - off) : (msg_lens[i] - off) / 2;
+			bench_frame((j == 0) ? WS_OP_TEXT : WS_OP_CONT, j == frag - 1, &msgs[i][off], n);
+			off += n;
+			if ((j < frag - 1) && (bench_rand() & 1)) {
+				bench_frame(WS_OP_PING, true, (const uint8 *)"ping", 4);
+				pings++;
+			}
+		}
+	}
+
+	t0 = bench_now_ns();
+	for (r = 0; r < ROUNDS; r++) {
+		memcpy(work, stream, stream_len);
+		user_ws_parser_init(&parser);
+		got_msg = 0;
+		got_ping = 0;
+		for (pos = 0; pos < stream_len; pos += n) {
+			n = 1 + bench_rand() % CHUNK_MAX;
+			if (n > stream_len - pos) {
+				n = stream_len - pos;
+			}
+			code = user_ws_parse(&parser, &work[pos], n, bench_cb, NULL);
+			if (code != 0) {
+				break;
+			}
+		}
+		if ((code != 0) || bad || (got_msg != MSG_N) || (got_ping != pings)) {
+			printf("FAIL round %u: close=%u msgs=%u/%u pings=%u/%u\n", (unsigned)r, code,
+				(unsigned)got_msg, MSG_N, (unsigned)got_ping, (unsigned)pings);
+			exit(1);
+		}
+	}
+	t = bench_now_ns() - t0;
+
+	printf("%u bytes, %u messages, %u pings: %.1f MB/s\n", (unsigned)stream_len, MSG_N,
+		(unsigned)pings, (double)stream_len * ROUNDS / t * 1e3);
+	exit(0);
+}
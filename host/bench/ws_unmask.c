@@ -0,0 +1,91 @@
+// ws_unmask.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: WebSocket unmask throughput. Times user_ws_unmask against the
+//	byte loop it replaced (uint64 index, mask[i % 4]) over payload sizes from a
+//	short command up to a full TCP segment, starting at every alignment and
+//	mask offset, and checks both give the same bytes. Results are host MB/s,
+//	so only the ratio carries over to the ESP8266, where the uint64 index of
+//	the old loop costs more again.
+//
+//	make host-bench && ../host/build/interior/ws_unmask
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "user_ws.h"
+#include "host.h"
+
+#define BUF_MAX		1460		// Largest payload (one TCP segment)
+#define BYTES_PER_SIZE	(64 << 20)	// Bytes unmasked per size and routine
+
+static const uint32 sizes[] = { 14, 64, 256, 1460 };
+#define SIZE_N		(sizeof(sizes) / sizeof(sizes[0]))
+
+static uint8 buf[BUF_MAX + 8];
+static uint8 ref[BUF_MAX + 8];
+static const uint8 mask[4] = { 0x37, 0xFA, 0x21, 0x3D };
+
+// Application Function: bench_unmask_byte(uint8 *data, uint32 len, const uint8 *mask, uint32 offset)
+// Desc: The unmask loop as it was in user_ws_recv_cb
+static void __attribute__((noinline)) bench_unmask_byte(uint8 *data, uint32 len, const uint8 *mask, uint32 offset)
+{
+	uint64 i;
+
+	for (i = 0; i < len; i++) {
+		data[i] ^= mask[(i + offset) % 4];
+	}
+}
+
+static double bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+void user_init(void)
+{
+	uint32 s, a, o, i, n, reps;
+	double t0, t_word, t_byte;
+
+	// Both routines must agree at every alignment and offset
+	for (s = 0; s < SIZE_N; s++) {
+		for (a = 0; a < 4; a++) {
+			for (o = 0; o < 4; o++) {
+				for (i = 0; i < sizes[s]; i++) {
+					buf[a + i] = ref[a + i] = i * 7;
+				}
+				user_ws_unmask(&buf[a], sizes[s], mask, o);
+				bench_unmask_byte(&ref[a], sizes[s], mask, o);
+				if (memcmp(&buf[a], &ref[a], sizes[s]) != 0) {
+					printf("FAIL size=%u align=%u offset=%u\n", (unsigned)sizes[s], (unsigned)a, (unsigned)o);
+					exit(1);
+				}
+			}
+		}
+	}
+
+	for (s = 0; s < SIZE_N; s++) {
+		n = sizes[s];
+		reps = BYTES_PER_SIZE / n;
+
+		// Payloads follow a 2 to 14 byte header, so start off the word boundary
+		t0 = bench_now_ns();
+		for (i = 0; i < reps; i++) {
+			user_ws_unmask(&buf[2], n, mask, i);
+		}
+		t_word = bench_now_ns() - t0;
+
+		t0 = bench_now_ns();
+		for (i = 0; i < reps; i++) {
+			bench_unmask_byte(&buf[2], n, mask, i);
+		}
+		t_byte = bench_now_ns() - t0;
+
+		printf("%4u bytes: word=%7.1f MB/s  byte=%7.1f MB/s  (x%.1f)\n", (unsigned)n,
+			(double)n * reps / t_word * 1e3, (double)n * reps / t_byte * 1e3, t_byte / t_word);
+	}
+	exit(0);
+}
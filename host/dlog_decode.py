@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+# dlog_decode.py
+# Authors: Christian Auspland & Matthew Blanchard
+# Description: Turns the binary debug log records written by user_dlog.c back
+#	into text. Each record holds a format string's address relative to
+#	user_dlog_base and the raw arguments, so the format strings are read
+#	from the ELF file the capture came from: the firmware's .out for a
+#	serial capture, or host/build/<node>/user_main for the host build.
+#	Anything between records (os_printf output, SDK messages) is copied
+#	through unchanged.
+#
+#	dlog_decode.py <elf> [<capture>]	(reads stdin with no capture)
+
+import re
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+BASE_SYMBOL = "user_dlog_base"
+CONVERSION = re.compile(rb"%([-+ 0#]*)(\d*)(?:\.(\d+))?(l*)([diuxXcsp%])")
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+
+class Elf:
+	def __init__(self, path):
+		with open(path, "rb") as f:
+			self.data = f.read()
+		if self.data[:4] != b"\x7fELF" or self.data[5] != 1:
+			raise ValueError("%s is not a little endian ELF file" % path)
+		self.is64 = (self.data[4] == 2)
+		if self.is64:
+			shoff, = struct.unpack_from("<Q", self.data, 0x28)
+			shentsize, shnum = struct.unpack_from("<HH", self.data, 0x3a)
+		else:
+			shoff, = struct.unpack_from("<I", self.data, 0x20)
+			shentsize, shnum = struct.unpack_from("<HH", self.data, 0x2e)
+
+		# (type, flags, addr, offset, size, link) of each section
+		self.sections = []
+		for i in range(shnum):
+			at = shoff + i * shentsize
+			if self.is64:
+				_, type, flags, addr, offset, size, link = struct.unpack_from("<IIQQQQI", self.data, at)
+			else:
+				_, type, flags, addr, offset, size, link = struct.unpack_from("<IIIIIII", self.data, at)
+			self.sections.append((type, flags, addr, offset, size, link))
+
+	def symbol(self, name):
+		for type, _, _, offset, size, link in self.sections:
+			if type != SHT_SYMTAB:
+				continue
+			strtab = self.sections[link][3]
+			entsize = 24 if self.is64 else 16
+			for at in range(offset, offset + size, entsize):
+				if self.is64:
+					name_off, _, _, _, value, _ = struct.unpack_from("<IBBHQQ", self.data, at)
+				else:
+					name_off, value, _, _, _, _ = struct.unpack_from("<IIIBBH", self.data, at)
+				end = self.data.index(b"\0", strtab + name_off)
+				if self.data[strtab + name_off:end] == name.encode():
+					return value
+		raise KeyError("%s not found, is the ELF file stripped?" % name)
+
+	def string(self, addr):
+		for type, flags, start, offset, size, _ in self.sections:
+			if (flags & SHF_ALLOC) and type != SHT_NOBITS and start <= addr < start + size:
+				at = offset + addr - start
+				return self.data[at:self.data.index(b"\0", at)]
+		return None
+
+def format_record(fmt, fields):
+	out = b""
+	pos = 0
+	at = 0
+	for m in CONVERSION.finditer(fmt):
+		out += fmt[pos:m.start()]
+		pos = m.end()
+		flags, width, precision, _, conv = m.groups()
+		if conv == b"%":
+			out += b"%"
+			continue
+		spec = b"%" + flags + width + (b"." + precision if precision is not None else b"")
+		if conv == b"s":
+			if at >= len(fields):
+				out += b"?"
+				continue
+			n = fields[at]
+			text = fields[at + 1:at + 1 + n]
+			at += 1 + n
+			out += (spec + b"s") % text
+			continue
+		if at + 4 > len(fields):
+			out += b"?"
+			at = len(fields)
+			continue
+		val, = struct.unpack_from("<I", fields, at)
+		at += 4
+		if conv in (b"d", b"i"):
+			out += (spec + b"d") % struct.unpack("<i", struct.pack("<I", val))
+		elif conv == b"u":
+			out += (spec + b"d") % val
+		elif conv == b"c":
+			out += (spec + b"c") % (val & 0xFF)
+		elif conv == b"p":
+			out += b"0x%x" % val
+		else:
+			out += (spec + conv) % val
+	return out + fmt[pos:]
+
+def decode(elf, base, stream, out):
+	pos = 0
+	while True:
+		start = stream.find(SYNC, pos)
+		if start < 0:
+			out.write(stream[pos:])
+			return
+		out.write(stream[pos:start])
+		length = stream[start + 2] if start + 2 < len(stream) else 0
+		end = start + 3 + length
+		if length < 4 or end > len(stream):
+			out.write(b"[dlog: truncated record]\n")
+			pos = start + 2
+			continue
+		offset, = struct.unpack_from("<i", stream, start + 3)
+		fmt = elf.string(base + offset)
+		if fmt is None:
+			out.write(b"[dlog: no format string at offset %d]\n" % offset)
+			pos = start + 2
+			continue
+		out.write(format_record(fmt, stream[start + 7:end]))
+		pos = end
+
+def main(argv):
+	if len(argv) not in (2, 3):
+		sys.stderr.write("usage: dlog_decode.py <elf> [<capture>]\n")
+		return 1
+
+	try:
+		elf = Elf(argv[1])
+		base = elf.symbol(BASE_SYMBOL)
+	except (OSError, ValueError, KeyError) as e:
+		sys.stderr.write("dlog_decode.py: %s\n" % e)
+		return 1
+
+	if len(argv) == 3:
+		with open(argv[2], "rb") as f:
+			stream = f.read()
+	else:
+		stream = sys.stdin.buffer.read()
+
+	decode(elf, base, stream, sys.stdout.buffer)
+	return 0
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
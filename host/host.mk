@@ -0,0 +1,69 @@
+# === Host Build === #
+# Builds the firmware as a native Linux executable against the SDK shim in
+# ../host, so control paths can be run and measured without a board.
+# Included from a firmware Makefile after SRC is defined. The including
+# Makefile lists the firmware sources to build in HOST_APP and the shim
+# modules it needs in HOST_SHIM.
+#
+# Benchmarks: every name in HOST_BENCH is a ../host/bench/<name>.c that
+# supplies its own user_init(), linked against the firmware sources in
+# HOST_BENCH_APP and the shim. make host-bench builds and runs them all.
+
+HOST_CC = gcc
+HOST_DIR = ../host
+
+# -fcommon : user_task.h defines the task queues and timers in the header, which
+#       the xtensa toolchain merges as common symbols
+# -Wno-implicit-int : the exterior's user_discover.c declares a static without a type
+HOST_CFLAGS = -I./include -I$(HOST_DIR)/include -DICACHE_FLASH -DHOST_BUILD \
+	-fcommon -g -O1 -Wno-implicit-int -MMD
+# The shim is held to -Wall; the firmware sources are built as the xtensa build has them
+HOST_SHIM_CFLAGS = $(HOST_CFLAGS) -Wall
+HOST_LDLIBS = -lm
+
+ifdef DEBUG_LEVEL
+HOST_CFLAGS += -DDEBUG_LEVEL=$(DEBUG_LEVEL)
+endif
+
+HOST_OBJDIR = $(HOST_DIR)/build/$(notdir $(CURDIR))
+HOST_TARGET = $(HOST_OBJDIR)/user_main
+
+HOST_APP ?= $(SRC)
+HOST_SHIM ?= host_main.c host_mem.c host_gpio.c host_espconn.c host_wifi.c host_flash.c
+
+HOST_OBJ = $(addprefix $(HOST_OBJDIR)/app/, $(notdir $(HOST_APP:.c=.o))) \
+	$(addprefix $(HOST_OBJDIR)/shim/, $(HOST_SHIM:.c=.o))
+
+HOST_BENCH_TARGET = $(addprefix $(HOST_OBJDIR)/, $(HOST_BENCH))
+HOST_BENCH_OBJ = $(addprefix $(HOST_OBJDIR)/app/, $(notdir $(HOST_BENCH_APP:.c=.o))) \
+	$(addprefix $(HOST_OBJDIR)/shim/, $(HOST_SHIM:.c=.o))
+
+host: $(HOST_TARGET)
+
+$(HOST_TARGET): $(HOST_OBJ)
+	$(HOST_CC) $(HOST_CFLAGS) $^ $(HOST_LDLIBS) -o $@
+
+host-bench: $(HOST_BENCH_TARGET)
+	@for b in $(HOST_BENCH_TARGET); do echo "=== $$b"; $$b || exit 1; done
+
+$(HOST_BENCH_TARGET): $(HOST_OBJDIR)/%: $(HOST_OBJDIR)/bench/%.o $(HOST_BENCH_OBJ)
+	$(HOST_CC) $(HOST_CFLAGS) $^ $(HOST_LDLIBS) -o $@
+
+$(HOST_OBJDIR)/bench/%.o: $(HOST_DIR)/bench/%.c | $(HOST_OBJDIR)/bench
+	$(HOST_CC) -c $(HOST_CFLAGS) $< -o $@
+
+$(HOST_OBJDIR)/app/%.o: $(SRCDIR)/%.c | $(HOST_OBJDIR)/app
+	$(HOST_CC) -c $(HOST_CFLAGS) $< -o $@
+
+$(HOST_OBJDIR)/shim/%.o: $(HOST_DIR)/src/%.c | $(HOST_OBJDIR)/shim
+	$(HOST_CC) -c $(HOST_SHIM_CFLAGS) $< -o $@
+
+$(HOST_OBJDIR)/app $(HOST_OBJDIR)/shim $(HOST_OBJDIR)/bench:
+	mkdir -p $@
+
+-include $(HOST_OBJ:.o=.d) $(HOST_BENCH_OBJ:.o=.d) $(addprefix $(HOST_OBJDIR)/bench/, $(HOST_BENCH:=.d))
+
+host-clean:
+	rm -rf $(HOST_OBJDIR)
+
+.PHONY: host host-bench host-clean
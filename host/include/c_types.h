@@ -0,0 +1,72 @@
+// c_types.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK c_types.h. Provides
+//	the SDK integer types and attributes so firmware sources compile natively.
+
+#ifndef _C_TYPES_H_
+#define _C_TYPES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned char		uint8;
+typedef unsigned char		u8;
+typedef signed char		sint8;
+typedef signed char		int8;
+typedef signed char		s8;
+typedef unsigned short		uint16;
+typedef unsigned short		u16;
+typedef signed short		sint16;
+typedef signed short		s16;
+typedef unsigned int		uint32;
+typedef unsigned int		u_int;
+typedef unsigned int		u32;
+typedef signed int		sint32;
+typedef signed int		s32;
+typedef int			int32;
+typedef signed long long	sint64;
+typedef unsigned long long	uint64;
+typedef unsigned long long	u64;
+typedef float			real32;
+typedef double			real64;
+
+#define __le16	u16
+
+#define LOCAL		static
+
+#ifndef NULL
+#define NULL (void *)0
+#endif
+
+// Status returned by several SDK calls/callbacks
+typedef enum {
+	OK = 0,
+	FAIL,
+	PENDING,
+	BUSY,
+	CANCEL,
+} STATUS;
+
+#define BIT(nr)		(1UL << (nr))
+
+#define REG_SET_BIT(_r, _b)	(*(volatile uint32_t *)(_r) |= (_b))
+#define REG_CLR_BIT(_r, _b)	(*(volatile uint32_t *)(_r) &= ~(_b))
+
+#define DMEM_ATTR		__attribute__((section(".bss")))
+#define SHMEM_ATTR
+
+// Code/data placement attributes have no meaning off-target
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define STORE_ATTR		__attribute__((aligned(4)))
+
+#ifndef __cplusplus
+typedef unsigned char	bool;
+#define BOOL		bool
+#define true		(1)
+#define false		(0)
+#define TRUE		true
+#define FALSE		false
+#endif
+
+#endif /* _C_TYPES_H_ */
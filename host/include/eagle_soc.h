@@ -0,0 +1,122 @@
+// eagle_soc.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK eagle_soc.h. Register
+//	accesses are routed to the simulated GPIO/FRC1 model in host_gpio.c, and
+//	the UART0 transmitter in host_main.c
+
+#ifndef _EAGLE_SOC_H_
+#define _EAGLE_SOC_H_
+
+#include "c_types.h"
+
+// Bit masks
+#define BIT31	0x80000000
+#define BIT30	0x40000000
+#define BIT29	0x20000000
+#define BIT28	0x10000000
+#define BIT27	0x08000000
+#define BIT26	0x04000000
+#define BIT25	0x02000000
+#define BIT24	0x01000000
+#define BIT23	0x00800000
+#define BIT22	0x00400000
+#define BIT21	0x00200000
+#define BIT20	0x00100000
+#define BIT19	0x00080000
+#define BIT18	0x00040000
+#define BIT17	0x00020000
+#define BIT16	0x00010000
+#define BIT15	0x00008000
+#define BIT14	0x00004000
+#define BIT13	0x00002000
+#define BIT12	0x00001000
+#define BIT11	0x00000800
+#define BIT10	0x00000400
+#define BIT9	0x00000200
+#define BIT8	0x00000100
+#define BIT7	0x00000080
+#define BIT6	0x00000040
+#define BIT5	0x00000020
+#define BIT4	0x00000010
+#define BIT3	0x00000008
+#define BIT2	0x00000004
+#define BIT1	0x00000002
+#define BIT0	0x00000001
+
+// Clocks
+#define APB_CLK_FREQ	80 * 1000000
+#define UART_CLK_FREQ	APB_CLK_FREQ
+#define TIMER_CLK_FREQ	(APB_CLK_FREQ >> 8)
+
+// Simulated register file accessors (host_gpio.c)
+uint32 host_gpio_reg_read(uint32 reg);
+void host_gpio_reg_write(uint32 reg, uint32 val);
+uint32 host_rtc_reg_read(uint32 reg);
+void host_rtc_reg_write(uint32 reg, uint32 val);
+
+// GPIO registers, as offsets from the GPIO peripheral base
+#define GPIO_OUT_ADDRESS		0x00
+#define GPIO_OUT_W1TS_ADDRESS		0x04
+#define GPIO_OUT_W1TC_ADDRESS		0x08
+#define GPIO_ENABLE_ADDRESS		0x0c
+#define GPIO_ENABLE_W1TS_ADDRESS	0x10
+#define GPIO_ENABLE_W1TC_ADDRESS	0x14
+#define GPIO_IN_ADDRESS			0x18
+#define GPIO_STATUS_ADDRESS		0x1c
+#define GPIO_STATUS_W1TS_ADDRESS	0x20
+#define GPIO_STATUS_W1TC_ADDRESS	0x24
+#define GPIO_PIN0_ADDRESS		0x28
+#define GPIO_PIN_COUNT			16
+
+#define GPIO_REG_READ(reg)		host_gpio_reg_read(reg)
+#define GPIO_REG_WRITE(reg, val)	host_gpio_reg_write((reg), (val))
+
+#define GPIO_PIN_PAD_DRIVER_LSB		2
+#define GPIO_PIN_PAD_DRIVER_MASK	(0x00000001 << GPIO_PIN_PAD_DRIVER_LSB)
+#define GPIO_PIN_PAD_DRIVER_SET(x)	(((x) << GPIO_PIN_PAD_DRIVER_LSB) & GPIO_PIN_PAD_DRIVER_MASK)
+#define GPIO_PAD_DRIVER_ENABLE		1
+#define GPIO_PAD_DRIVER_DISABLE		(~GPIO_PAD_DRIVER_ENABLE)
+
+// FRC1 timer registers, as offsets from the RTC peripheral base
+#define FRC1_LOAD_ADDRESS		0x00
+#define FRC1_COUNT_ADDRESS		0x04
+#define FRC1_CTRL_ADDRESS		0x08
+#define FRC1_INT_ADDRESS		0x0c
+
+#define RTC_REG_READ(addr)		host_rtc_reg_read(addr)
+#define RTC_REG_WRITE(addr, val)	host_rtc_reg_write((addr), (val))
+
+// Registers by absolute address. Only the UART0 transmit FIFO and status
+// register are modelled, the FIFO writing to stdout (host_main.c)
+uint32 host_peri_reg_read(uint32 addr);
+void host_peri_reg_write(uint32 addr, uint32 val);
+
+#define READ_PERI_REG(addr)		host_peri_reg_read(addr)
+#define WRITE_PERI_REG(addr, val)	host_peri_reg_write((addr), (val))
+
+// Pin multiplexing. Every pin is treated as a GPIO off-target
+#define PERIPHS_IO_MUX_MTDI_U		0x04
+#define PERIPHS_IO_MUX_MTCK_U		0x08
+#define PERIPHS_IO_MUX_MTMS_U		0x0C
+#define PERIPHS_IO_MUX_MTDO_U		0x10
+#define PERIPHS_IO_MUX_U0RXD_U		0x14
+#define PERIPHS_IO_MUX_U0TXD_U		0x18
+#define PERIPHS_IO_MUX_GPIO0_U		0x34
+#define PERIPHS_IO_MUX_GPIO2_U		0x38
+#define PERIPHS_IO_MUX_GPIO4_U		0x3C
+#define PERIPHS_IO_MUX_GPIO5_U		0x40
+
+#define FUNC_GPIO0			0
+#define FUNC_GPIO2			0
+#define FUNC_GPIO4			0
+#define FUNC_GPIO5			0
+#define FUNC_GPIO12			3
+#define FUNC_GPIO13			3
+#define FUNC_GPIO14			3
+#define FUNC_GPIO15			3
+
+#define PIN_FUNC_SELECT(PIN_NAME, FUNC)	((void)(PIN_NAME), (void)(FUNC))
+#define PIN_PULLUP_DIS(PIN_NAME)	((void)(PIN_NAME))
+#define PIN_PULLUP_EN(PIN_NAME)		((void)(PIN_NAME))
+
+#endif /* _EAGLE_SOC_H_ */
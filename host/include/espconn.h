@@ -0,0 +1,98 @@
+// espconn.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK espconn.h. Connections
+//	are carried over BSD sockets on the loopback interface (see host_espconn.c)
+
+#ifndef __ESPCONN_H__
+#define __ESPCONN_H__
+
+#include "c_types.h"
+
+typedef sint8 err_t;
+
+typedef void *espconn_handle;
+typedef void (* espconn_connect_callback)(void *arg);
+typedef void (* espconn_reconnect_callback)(void *arg, sint8 err);
+
+// Definitions for error constants
+#define ESPCONN_OK		0	// No error, everything OK
+#define ESPCONN_MEM		-1	// Out of memory error
+#define ESPCONN_TIMEOUT		-3	// Timeout
+#define ESPCONN_RTE		-4	// Routing problem
+#define ESPCONN_INPROGRESS	-5	// Operation in progress
+#define ESPCONN_MAXNUM		-7	// Total number exceeds the set maximum
+#define ESPCONN_ABRT		-8	// Connection aborted
+#define ESPCONN_RST		-9	// Connection reset
+#define ESPCONN_CLSD		-10	// Connection closed
+#define ESPCONN_CONN		-11	// Not connected
+#define ESPCONN_ARG		-12	// Illegal argument
+#define ESPCONN_IF		-14	// Low_level error
+#define ESPCONN_ISCONN		-15	// Already connected
+
+// Protocol family and type of the espconn
+enum espconn_type {
+	ESPCONN_INVALID	= 0,
+	ESPCONN_TCP	= 0x10,
+	ESPCONN_UDP	= 0x20,
+};
+
+// Current state of the espconn
+enum espconn_state {
+	ESPCONN_NONE,
+	ESPCONN_WAIT,
+	ESPCONN_LISTEN,
+	ESPCONN_CONNECT,
+	ESPCONN_WRITE,
+	ESPCONN_READ,
+	ESPCONN_CLOSE
+};
+
+typedef struct _esp_tcp {
+	int remote_port;
+	int local_port;
+	uint8 local_ip[4];
+	uint8 remote_ip[4];
+	espconn_connect_callback connect_callback;
+	espconn_reconnect_callback reconnect_callback;
+	espconn_connect_callback disconnect_callback;
+	espconn_connect_callback write_finish_fn;
+} esp_tcp;
+
+typedef struct _esp_udp {
+	int remote_port;
+	int local_port;
+	uint8 local_ip[4];
+	uint8 remote_ip[4];
+} esp_udp;
+
+typedef void (* espconn_recv_callback)(void *arg, char *pdata, unsigned short len);
+typedef void (* espconn_sent_callback)(void *arg);
+
+struct espconn {
+	enum espconn_type type;
+	enum espconn_state state;
+	union {
+		esp_tcp *tcp;
+		esp_udp *udp;
+	} proto;
+	espconn_recv_callback recv_callback;
+	espconn_sent_callback sent_callback;
+	uint8 link_cnt;
+	void *reverse;
+};
+
+sint8 espconn_accept(struct espconn *espconn);
+sint8 espconn_create(struct espconn *espconn);
+sint8 espconn_connect(struct espconn *espconn);
+sint8 espconn_disconnect(struct espconn *espconn);
+sint8 espconn_delete(struct espconn *espconn);
+sint8 espconn_send(struct espconn *espconn, uint8 *psent, uint16 length);
+sint8 espconn_sent(struct espconn *espconn, uint8 *psent, uint16 length);
+sint8 espconn_regist_time(struct espconn *espconn, uint32 interval, uint8 type_flag);
+sint8 espconn_regist_sentcb(struct espconn *espconn, espconn_sent_callback sent_cb);
+sint8 espconn_regist_recvcb(struct espconn *espconn, espconn_recv_callback recv_cb);
+sint8 espconn_regist_connectcb(struct espconn *espconn, espconn_connect_callback connect_cb);
+sint8 espconn_regist_reconcb(struct espconn *espconn, espconn_reconnect_callback recon_cb);
+sint8 espconn_regist_disconcb(struct espconn *espconn, espconn_connect_callback discon_cb);
+
+#endif /* __ESPCONN_H__ */
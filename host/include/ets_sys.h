@@ -0,0 +1,65 @@
+// ets_sys.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK ets_sys.h. Interrupt
+//	control is routed to the simulated interrupt model in host_gpio.c
+
+#ifndef _ETS_SYS_H
+#define _ETS_SYS_H
+
+#include "c_types.h"
+#include "eagle_soc.h"
+
+typedef uint32 ETSSignal;
+typedef uint32 ETSParam;
+
+typedef struct ETSEventTag ETSEvent;
+
+struct ETSEventTag {
+	ETSSignal sig;
+	ETSParam  par;
+};
+
+typedef void (*ETSTask)(ETSEvent *e);
+
+typedef void ETSTimerFunc(void *timer_arg);
+
+typedef struct _ETSTIMER_ {
+	struct _ETSTIMER_	*timer_next;
+	uint32			timer_expire;
+	uint32			timer_period;
+	ETSTimerFunc		*timer_func;
+	void			*timer_arg;
+} ETSTimer;
+
+// Interrupt sources
+#define ETS_GPIO_INUM		4
+#define ETS_FRC_TIMER1_INUM	9
+
+typedef void (* ets_isr_t)(void *);
+
+void ets_isr_attach(int i, ets_isr_t func, void *arg);
+void ets_isr_mask(unsigned intr);
+void ets_isr_unmask(unsigned intr);
+void ets_intr_lock(void);
+void ets_intr_unlock(void);
+void host_frc1_nmi_attach(void (*func)(void));
+
+#define ETS_INTR_LOCK()			ets_intr_lock()
+#define ETS_INTR_UNLOCK()		ets_intr_unlock()
+
+#define ETS_GPIO_INTR_ATTACH(func, arg)	ets_isr_attach(ETS_GPIO_INUM, (ets_isr_t)(func), (void *)(arg))
+#define ETS_GPIO_INTR_DISABLE()		ets_isr_mask(1 << ETS_GPIO_INUM)
+#define ETS_GPIO_INTR_ENABLE()		ets_isr_unmask(1 << ETS_GPIO_INUM)
+
+#define ETS_FRC_TIMER1_INTR_ATTACH(func, arg)	ets_isr_attach(ETS_FRC_TIMER1_INUM, (ets_isr_t)(func), (void *)(arg))
+#define ETS_FRC_TIMER1_NMI_INTR_ATTACH(func)	host_frc1_nmi_attach(func)
+#define ETS_FRC1_INTR_ENABLE()		ets_isr_unmask(1 << ETS_FRC_TIMER1_INUM)
+#define ETS_FRC1_INTR_DISABLE()		ets_isr_mask(1 << ETS_FRC_TIMER1_INUM)
+#define TM1_EDGE_INT_ENABLE()		((void)0)
+#define TM1_EDGE_INT_DISABLE()		((void)0)
+
+// ROM functions
+void ets_delay_us(uint32 us);
+void uart_div_modify(uint8 uart_no, uint32 divlatch);
+
+#endif /* _ETS_SYS_H */
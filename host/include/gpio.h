@@ -0,0 +1,45 @@
+// gpio.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK gpio.h
+
+#ifndef _GPIO_H_
+#define _GPIO_H_
+
+#include "c_types.h"
+#include "eagle_soc.h"
+
+#define GPIO_PIN_ADDR(i)	(GPIO_PIN0_ADDRESS + (i) * 4)
+
+#define GPIO_ID_IS_PIN_REGISTER(reg_id)	((reg_id >= GPIO_ID_PIN0) && (reg_id <= GPIO_ID_PIN(GPIO_PIN_COUNT - 1)))
+#define GPIO_REGID_TO_PINIDX(reg_id)	((reg_id) - GPIO_ID_PIN0)
+
+typedef enum {
+	GPIO_PIN_INTR_DISABLE = 0,
+	GPIO_PIN_INTR_POSEDGE = 1,
+	GPIO_PIN_INTR_NEGEDGE = 2,
+	GPIO_PIN_INTR_ANYEDGE = 3,
+	GPIO_PIN_INTR_LOLEVEL = 4,
+	GPIO_PIN_INTR_HILEVEL = 5
+} GPIO_INT_TYPE;
+
+#define GPIO_OUTPUT_SET(gpio_no, bit_value) \
+	gpio_output_set((bit_value) << (gpio_no), ((~(bit_value)) & 0x01) << (gpio_no), 1 << (gpio_no), 0)
+#define GPIO_DIS_OUTPUT(gpio_no)	gpio_output_set(0, 0, 0, 1 << (gpio_no))
+#define GPIO_INPUT_GET(gpio_no)		((gpio_input_get() >> (gpio_no)) & BIT0)
+
+#define GPIO_ID_PIN0			0
+#define GPIO_ID_PIN(n)			(GPIO_ID_PIN0 + (n))
+#define GPIO_LAST_REGISTER_ID		GPIO_ID_PIN(15)
+#define GPIO_ID_NONE			0xffffffff
+
+typedef void (* gpio_intr_handler_fn_t)(uint32 intr_mask, void *arg);
+
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask);
+uint32 gpio_input_get(void);
+void gpio_intr_handler_register(void *fn, void *arg);
+void gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state);
+uint32 gpio_intr_pending(void);
+void gpio_intr_ack(uint32 ack_mask);
+void gpio_init(void);
+
+#endif /* _GPIO_H_ */
@@ -0,0 +1,83 @@
+// host.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Internal interface of the host SDK shim. Not included by firmware
+//	sources; used by the shim itself and by simulated devices attached to the
+//	GPIO model (sensors, fan plant, etc.)
+
+#ifndef HOST_H
+#define HOST_H
+
+#include "c_types.h"
+
+#define HOST_NEVER	((uint64)-1)	// Deadline meaning "no event pending"
+
+// Simulated peripheral attached to the GPIO model. Devices are serviced by the
+// host event loop whenever their deadline passes, and are notified whenever the
+// firmware changes the level it drives onto the pins.
+struct host_device {
+	const char *name;
+	uint64 (*next_event)(void);		// Absolute time (us) of next event, or HOST_NEVER
+	void (*run)(uint64 now);		// Service all events due at or before now
+	void (*pins_changed)(uint32 levels);	// Firmware changed the pin levels
+	struct host_device *next;
+};
+
+// Options shared between the shim modules (host_main.c)
+struct host_options {
+	const char *flash_file;		// Backing file for spi_flash_*
+	int port_offset;		// Added to every local port (lets several nodes share loopback)
+	int remote_offset;		// Added to every remote port
+	float humidity;			// Simulated relative humidity (%RH) seen by the HIH8121
+	float mains_hz;			// Simulated mains frequency seen by the ZCD
+	bool no_ap;			// WiFi scans find no access point
+	bool virtual_time;		// Run on a simulated clock instead of the wall clock
+	uint64 run_time;		// Exit after this many us of (simulated) time, 0 = forever
+	bool no_alloc;			// Abort on heap allocation once start up is over
+};
+
+extern struct host_options host_opts;
+
+// Time keeping (host_main.c)
+uint64 host_time_us(void);
+void host_advance_us(uint64 us);
+
+// Interrupt context (host_gpio.c)
+bool host_irq_allowed(void);
+void host_irq_enter(void);
+void host_irq_exit(void);
+void host_service_irqs(void);
+uint64 host_frc1_next_event(void);
+
+// Device registry and pin model (host_gpio.c)
+void host_device_register(struct host_device *dev);
+uint64 host_device_next_event(void);
+void host_device_run(uint64 now);
+void host_gpio_set_input(uint8 pin, uint8 level);
+void host_gpio_pull_low(uint32 mask, bool low);
+uint32 host_gpio_levels(void);
+
+// Fan plant (host_fan.c)
+float host_fan_rpm(void);
+
+// Flash operation counts, so benchmarks can report work independent of host speed (host_flash.c)
+struct host_flash_stats {
+	uint32 reads;
+	uint32 writes;
+	uint32 erases;
+};
+extern struct host_flash_stats host_flash_stats;
+
+// Firmware heap calls (host_mem.c)
+struct host_heap_stats {
+	uint32 allocs;			// os_malloc, os_zalloc, etc
+	uint32 frees;			// os_free of non-NULL pointers
+	bool frozen;			// Allocation aborts
+};
+extern struct host_heap_stats host_heap_stats;
+
+// Network (host_espconn.c)
+void host_net_poll(sint64 timeout_us);
+void host_net_run_deferred(void);
+
+
+#endif /* HOST_H */
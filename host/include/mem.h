@@ -0,0 +1,22 @@
+// mem.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK mem.h
+
+#ifndef __MEM_H__
+#define __MEM_H__
+
+#include <stdlib.h>
+
+// Counted, see host_mem.c
+void *host_malloc(size_t size);
+void *host_calloc(size_t n, size_t size);
+void *host_realloc(void *p, size_t size);
+void host_free(void *p);
+
+#define os_free(s)		host_free(s)
+#define os_malloc(s)		host_malloc(s)
+#define os_calloc(l, s)		host_calloc((l), (s))
+#define os_realloc(p, s)	host_realloc((p), (s))
+#define os_zalloc(s)		host_calloc(1, (s))
+
+#endif /* __MEM_H__ */
@@ -0,0 +1,44 @@
+// osapi.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK osapi.h. String/memory
+//	helpers map onto libc; timers are serviced by the host event loop.
+
+#ifndef _OSAPI_H_
+#define _OSAPI_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "os_type.h"
+#include "user_config.h"
+
+#define os_bzero		bzero
+#define os_delay_us		ets_delay_us
+#define os_install_putc1	(void)
+#define os_memcmp		memcmp
+#define os_memcpy		memcpy
+#define os_memmove		memmove
+#define os_memset		memset
+#define os_strcat		strcat
+#define os_strchr		strchr
+#define os_strcmp		strcmp
+#define os_strcpy		strcpy
+#define os_strlen		strlen
+#define os_strncmp		strncmp
+#define os_strncpy		strncpy
+#define os_strstr		strstr
+
+void ets_timer_arm_new(ETSTimer *ptimer, uint32 time, bool repeat_flag, bool ms_flag);
+void ets_timer_disarm(ETSTimer *ptimer);
+void ets_timer_setfn(ETSTimer *ptimer, ETSTimerFunc *pfunction, void *parg);
+
+#define os_timer_arm_us(a, b, c)	ets_timer_arm_new((a), (b), (c), 0)
+#define os_timer_arm(a, b, c)		ets_timer_arm_new((a), (b), (c), 1)
+#define os_timer_disarm			ets_timer_disarm
+#define os_timer_setfn(ptimer, pfunction, parg) \
+	ets_timer_setfn((ptimer), (ETSTimerFunc *)(pfunction), (parg))
+
+#define os_sprintf	sprintf
+#define os_snprintf	snprintf
+#define os_printf	printf
+
+#endif /* _OSAPI_H_ */
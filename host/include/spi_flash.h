@@ -0,0 +1,24 @@
+// spi_flash.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK spi_flash.h. Flash is
+//	backed by an image file (see host_flash.c)
+
+#ifndef SPI_FLASH_H
+#define SPI_FLASH_H
+
+#include "c_types.h"
+
+typedef enum {
+	SPI_FLASH_RESULT_OK,
+	SPI_FLASH_RESULT_ERR,
+	SPI_FLASH_RESULT_TIMEOUT
+} SpiFlashOpResult;
+
+#define SPI_FLASH_SEC_SIZE	4096
+
+uint32 spi_flash_get_id(void);
+SpiFlashOpResult spi_flash_erase_sector(uint16 sec);
+SpiFlashOpResult spi_flash_write(uint32 des_addr, uint32 *src_addr, uint32 size);
+SpiFlashOpResult spi_flash_read(uint32 src_addr, uint32 *des_addr, uint32 size);
+
+#endif /* SPI_FLASH_H */
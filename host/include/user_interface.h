@@ -0,0 +1,139 @@
+// user_interface.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host build stand-in for the ESP8266 NONOS SDK user_interface.h. Only
+//	the system and WiFi calls used by the firmware are declared; the WiFi calls are
+//	satisfied by a simulated station/SoftAP in host_wifi.c
+
+#ifndef __USER_INTERFACE_H__
+#define __USER_INTERFACE_H__
+
+#include "os_type.h"
+#include "ip_addr.h"
+#include "queue.h"
+#include "user_config.h"
+#include "spi_flash.h"
+#include "gpio.h"
+
+enum {
+	USER_TASK_PRIO_0 = 0,
+	USER_TASK_PRIO_1,
+	USER_TASK_PRIO_2,
+	USER_TASK_PRIO_MAX
+};
+
+typedef void (* init_done_cb_t)(void);
+
+bool system_os_task(os_task_t task, uint8 prio, os_event_t *queue, uint8 qlen);
+bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par);
+void system_restart(void);
+uint32 system_get_time(void);
+uint32 system_get_free_heap_size(void);
+void system_init_done_cb(init_done_cb_t cb);
+
+#define MAC2STR(a)	(a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
+#define MACSTR		"%02x:%02x:%02x:%02x:%02x:%02x"
+
+#define NULL_MODE	0x00
+#define STATION_MODE	0x01
+#define SOFTAP_MODE	0x02
+#define STATIONAP_MODE	0x03
+
+#define STATION_IF	0x00
+#define SOFTAP_IF	0x01
+
+typedef enum _auth_mode {
+	AUTH_OPEN = 0,
+	AUTH_WEP,
+	AUTH_WPA_PSK,
+	AUTH_WPA2_PSK,
+	AUTH_WPA_WPA2_PSK,
+	AUTH_MAX
+} AUTH_MODE;
+
+struct bss_info {
+	STAILQ_ENTRY(bss_info)	next;
+
+	uint8 bssid[6];
+	uint8 ssid[32];
+	uint8 ssid_len;
+	uint8 channel;
+	sint8 rssi;
+	AUTH_MODE authmode;
+	uint8 is_hidden;
+	sint16 freq_offset;
+	sint16 freqcal_val;
+	uint8 *esp_mesh_ie;
+};
+
+typedef enum {
+	OK_STATUS = 0,
+	FAIL_STATUS,
+	PENDING_STATUS,
+	BUSY_STATUS,
+	CANCEL_STATUS
+} SCAN_STATUS;
+
+typedef void (* scan_done_cb_t)(void *arg, STATUS status);
+
+struct station_config {
+	uint8 ssid[32];
+	uint8 password[64];
+	uint8 bssid_set;	// Only check the AP's MAC if bssid_set is 1
+	uint8 bssid[6];
+};
+
+struct scan_config {
+	uint8 *ssid;
+	uint8 *bssid;
+	uint8 channel;
+	uint8 show_hidden;
+};
+
+struct softap_config {
+	uint8 ssid[32];
+	uint8 password[64];
+	uint8 ssid_len;
+	uint8 channel;
+	AUTH_MODE authmode;
+	uint8 ssid_hidden;
+	uint8 max_connection;
+	uint16 beacon_interval;
+};
+
+struct dhcps_lease {
+	bool enable;
+	struct ip_addr start_ip;
+	struct ip_addr end_ip;
+};
+
+enum {
+	STATION_IDLE = 0,
+	STATION_CONNECTING,
+	STATION_WRONG_PASSWORD,
+	STATION_NO_AP_FOUND,
+	STATION_CONNECT_FAIL,
+	STATION_GOT_IP
+};
+
+uint8 wifi_get_opmode(void);
+bool wifi_set_opmode(uint8 opmode);
+bool wifi_set_opmode_current(uint8 opmode);
+bool wifi_get_ip_info(uint8 if_index, struct ip_info *info);
+bool wifi_set_ip_info(uint8 if_index, struct ip_info *info);
+
+bool wifi_station_get_config(struct station_config *config);
+bool wifi_station_set_config(struct station_config *config);
+bool wifi_station_set_config_current(struct station_config *config);
+bool wifi_station_connect(void);
+bool wifi_station_disconnect(void);
+bool wifi_station_scan(struct scan_config *config, scan_done_cb_t cb);
+uint8 wifi_station_get_connect_status(void);
+
+bool wifi_softap_get_config(struct softap_config *config);
+bool wifi_softap_set_config(struct softap_config *config);
+bool wifi_softap_set_config_current(struct softap_config *config);
+bool wifi_softap_dhcps_start(void);
+bool wifi_softap_dhcps_stop(void);
+bool wifi_softap_set_dhcps_lease(struct dhcps_lease *please);
+
+#endif /* __USER_INTERFACE_H__ */
@@ -0,0 +1,529 @@
+// host_espconn.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: espconn over BSD sockets for the host SDK shim. Every node lives on
+//	the loopback interface: remote addresses (including broadcasts) map to
+//	127.0.0.1, and the -o/-r port offsets let an interior and an exterior
+//	process talk to each other on one machine. Callbacks are delivered from the
+//	host event loop, never from inside the espconn call that caused them.
+
+#define _GNU_SOURCE		// accept4, ppoll
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "osapi.h"
+#include "espconn.h"
+#include "host.h"
+
+#define HOST_CONN_MAX	32		// Maximum number of open sockets
+#define HOST_RECV_LEN	1460		// Largest segment handed to a receive callback
+
+typedef enum {
+	HOST_CONN_FREE = 0,
+	HOST_CONN_LISTEN,		// TCP server socket
+	HOST_CONN_CONNECTING,		// Outgoing TCP connection in progress
+	HOST_CONN_TCP,			// Established TCP connection
+	HOST_CONN_UDP			// UDP socket
+} HOST_CONN_TYPE;
+
+// Socket bound to an espconn
+struct host_conn {
+	HOST_CONN_TYPE type;
+	int fd;
+	struct espconn *conn;		// User control structure
+	bool owned;			// conn/proto were allocated here (accepted clients)
+	bool sent_pending;		// A sent callback is owed
+	bool discon_pending;		// A disconnect callback is owed
+};
+
+static struct host_conn conns[HOST_CONN_MAX];
+static char recv_buf[HOST_RECV_LEN + 1];
+
+// Application Function: host_conn_find(struct espconn *conn, HOST_CONN_TYPE type)
+// Desc: Finds the socket of a control structure
+// Args:
+//	HOST_CONN_TYPE type: Socket type to match, or HOST_CONN_FREE for any
+// Returns: The socket, or NULL
+static struct host_conn *host_conn_find(struct espconn *conn, HOST_CONN_TYPE type)
+{
+	int i;
+	for (i = 0; i < HOST_CONN_MAX; i++) {
+		if (conns[i].type != HOST_CONN_FREE && conns[i].conn == conn &&
+		    (type == HOST_CONN_FREE || conns[i].type == type)) {
+			return &conns[i];
+		}
+	}
+	return NULL;
+}
+
+// Application Function: host_conn_alloc(int fd, struct espconn *conn, HOST_CONN_TYPE type)
+// Desc: Binds a socket to a control structure
+// Returns: The new entry, or NULL if the table is full
+static struct host_conn *host_conn_alloc(int fd, struct espconn *conn, HOST_CONN_TYPE type)
+{
+	int i;
+	for (i = 0; i < HOST_CONN_MAX; i++) {
+		if (conns[i].type == HOST_CONN_FREE) {
+			os_memset(&conns[i], 0, sizeof(conns[i]));
+			conns[i].type = type;
+			conns[i].fd = fd;
+			conns[i].conn = conn;
+			return &conns[i];
+		}
+	}
+	return NULL;
+}
+
+// Application Function: host_conn_free(struct host_conn *hc)
+// Desc: Closes a socket and releases anything allocated for it
+static void host_conn_free(struct host_conn *hc)
+{
+	close(hc->fd);
+	if (hc->owned) {
+		free(hc->conn->proto.tcp);
+		free(hc->conn);
+	}
+	hc->type = HOST_CONN_FREE;
+}
+
+// Application Function: host_sockaddr(struct sockaddr_in *sa, int port, int offset)
+// Desc: Builds a loopback address
+static void host_sockaddr(struct sockaddr_in *sa, int port, int offset)
+{
+	os_memset(sa, 0, sizeof(*sa));
+	sa->sin_family = AF_INET;
+	sa->sin_port = htons(port == 0 ? 0 : port + offset);
+	sa->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+// Application Function: host_socket(int type, int local_port)
+// Desc: Opens a non-blocking socket, bound to local_port (plus offset) if set
+// Returns: File descriptor, or -1 on failure
+static int host_socket(int type, int local_port)
+{
+	struct sockaddr_in sa;
+	int fd, one = 1;
+
+	fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (type == SOCK_DGRAM) {
+		setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+	} else {
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+	if (local_port != 0) {
+		host_sockaddr(&sa, local_port, host_opts.port_offset);
+		if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+			fprintf(stderr, "host: bind to port %d failed: %s\n",
+				local_port + host_opts.port_offset, strerror(errno));
+			close(fd);
+			return -1;
+		}
+	}
+	return fd;
+}
+
+sint8 espconn_accept(struct espconn *espconn)
+{
+	int fd;
+
+	if (espconn == NULL || espconn->type != ESPCONN_TCP || espconn->proto.tcp == NULL) {
+		return ESPCONN_ARG;
+	}
+	if (host_conn_find(espconn, HOST_CONN_LISTEN) != NULL) {
+		return ESPCONN_ISCONN;
+	}
+	fd = host_socket(SOCK_STREAM, espconn->proto.tcp->local_port);
+	if (fd < 0) {
+		return ESPCONN_IF;
+	}
+	if (listen(fd, 4) < 0 || host_conn_alloc(fd, espconn, HOST_CONN_LISTEN) == NULL) {
+		close(fd);
+		return ESPCONN_MEM;
+	}
+	espconn->state = ESPCONN_LISTEN;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_create(struct espconn *espconn)
+{
+	int fd;
+
+	if (espconn == NULL || espconn->type != ESPCONN_UDP || espconn->proto.udp == NULL) {
+		return ESPCONN_ARG;
+	}
+	if (host_conn_find(espconn, HOST_CONN_UDP) != NULL) {
+		return ESPCONN_ISCONN;
+	}
+	fd = host_socket(SOCK_DGRAM, espconn->proto.udp->local_port);
+	if (fd < 0) {
+		return ESPCONN_IF;
+	}
+	if (host_conn_alloc(fd, espconn, HOST_CONN_UDP) == NULL) {
+		close(fd);
+		return ESPCONN_MEM;
+	}
+	return ESPCONN_OK;
+}
+
+sint8 espconn_connect(struct espconn *espconn)
+{
+	struct sockaddr_in sa;
+	int fd;
+
+	if (espconn == NULL || espconn->type != ESPCONN_TCP || espconn->proto.tcp == NULL) {
+		return ESPCONN_ARG;
+	}
+	if (host_conn_find(espconn, HOST_CONN_FREE) != NULL) {
+		return ESPCONN_ISCONN;
+	}
+
+	// Outgoing connections use an ephemeral local port, so a node can connect
+	// to a peer listening on the same port number
+	fd = host_socket(SOCK_STREAM, 0);
+	if (fd < 0) {
+		return ESPCONN_IF;
+	}
+	host_sockaddr(&sa, espconn->proto.tcp->remote_port, host_opts.remote_offset);
+	if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 && errno != EINPROGRESS) {
+		close(fd);
+		return ESPCONN_RTE;
+	}
+	if (host_conn_alloc(fd, espconn, HOST_CONN_CONNECTING) == NULL) {
+		close(fd);
+		return ESPCONN_MEM;
+	}
+	espconn->state = ESPCONN_WAIT;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_disconnect(struct espconn *espconn)
+{
+	struct host_conn *hc = host_conn_find(espconn, HOST_CONN_TCP);
+
+	if (hc == NULL) {
+		return ESPCONN_ARG;
+	}
+	shutdown(hc->fd, SHUT_RDWR);
+	espconn->state = ESPCONN_CLOSE;
+	hc->discon_pending = true;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_delete(struct espconn *espconn)
+{
+	struct host_conn *hc;
+	bool found = false;
+
+	while ((hc = host_conn_find(espconn, HOST_CONN_FREE)) != NULL) {
+		host_conn_free(hc);
+		found = true;
+	}
+	if (!found) {
+		return ESPCONN_ARG;
+	}
+	espconn->state = ESPCONN_CLOSE;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_send(struct espconn *espconn, uint8 *psent, uint16 length)
+{
+	struct host_conn *hc = host_conn_find(espconn, HOST_CONN_FREE);
+	struct sockaddr_in sa;
+	ssize_t n;
+
+	if (hc == NULL || (hc->type != HOST_CONN_TCP && hc->type != HOST_CONN_UDP)) {
+		return ESPCONN_CONN;
+	}
+	if (hc->sent_pending) {
+		return ESPCONN_INPROGRESS;	// The SDK allows one write in flight
+	}
+
+	if (hc->type == HOST_CONN_UDP) {
+		host_sockaddr(&sa, espconn->proto.udp->remote_port, host_opts.remote_offset);
+		n = sendto(hc->fd, psent, length, 0, (struct sockaddr *)&sa, sizeof(sa));
+	} else {
+		n = send(hc->fd, psent, length, MSG_NOSIGNAL);
+	}
+	if (n < 0) {
+		return ESPCONN_IF;
+	}
+	hc->sent_pending = true;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_sent(struct espconn *espconn, uint8 *psent, uint16 length)
+{
+	return espconn_send(espconn, psent, length);
+}
+
+sint8 espconn_regist_time(struct espconn *espconn, uint32 interval, uint8 type_flag)
+{
+	return ESPCONN_OK;
+}
+
+sint8 espconn_regist_sentcb(struct espconn *espconn, espconn_sent_callback sent_cb)
+{
+	if (espconn == NULL) {
+		return ESPCONN_ARG;
+	}
+	espconn->sent_callback = sent_cb;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_regist_recvcb(struct espconn *espconn, espconn_recv_callback recv_cb)
+{
+	if (espconn == NULL) {
+		return ESPCONN_ARG;
+	}
+	espconn->recv_callback = recv_cb;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_regist_connectcb(struct espconn *espconn, espconn_connect_callback connect_cb)
+{
+	if (espconn == NULL || espconn->proto.tcp == NULL) {
+		return ESPCONN_ARG;
+	}
+	espconn->proto.tcp->connect_callback = connect_cb;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_regist_reconcb(struct espconn *espconn, espconn_reconnect_callback recon_cb)
+{
+	if (espconn == NULL || espconn->proto.tcp == NULL) {
+		return ESPCONN_ARG;
+	}
+	espconn->proto.tcp->reconnect_callback = recon_cb;
+	return ESPCONN_OK;
+}
+
+sint8 espconn_regist_disconcb(struct espconn *espconn, espconn_connect_callback discon_cb)
+{
+	if (espconn == NULL || espconn->proto.tcp == NULL) {
+		return ESPCONN_ARG;
+	}
+	espconn->proto.tcp->disconnect_callback = discon_cb;
+	return ESPCONN_OK;
+}
+
+// Application Function: host_fill_ip(uint8 *ip, int *port, struct sockaddr_in *sa)
+// Desc: Copies a peer address into an esp_tcp/esp_udp structure
+static void host_fill_ip(uint8 *ip, int *port, struct sockaddr_in *sa)
+{
+	os_memcpy(ip, &sa->sin_addr.s_addr, 4);
+	*port = ntohs(sa->sin_port);
+}
+
+// Application Function: host_conn_accept(struct host_conn *server)
+// Desc: Accepts a client on a listening socket. As with the SDK, the client gets
+//	its own control structure that starts out with the server's callbacks.
+static void host_conn_accept(struct host_conn *server)
+{
+	struct sockaddr_in sa;
+	socklen_t len = sizeof(sa);
+	struct host_conn *hc;
+	struct espconn *client;
+	esp_tcp *tcp;
+	int fd, one = 1;
+
+	fd = accept4(server->fd, (struct sockaddr *)&sa, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	client = calloc(1, sizeof(*client));
+	tcp = calloc(1, sizeof(*tcp));
+	hc = host_conn_alloc(fd, client, HOST_CONN_TCP);
+	if (client == NULL || tcp == NULL || hc == NULL) {
+		free(client);
+		free(tcp);
+		close(fd);
+		return;
+	}
+	hc->owned = true;
+
+	*client = *server->conn;
+	*tcp = *server->conn->proto.tcp;
+	client->proto.tcp = tcp;
+	client->state = ESPCONN_CONNECT;
+	host_fill_ip(tcp->remote_ip, &tcp->remote_port, &sa);
+	tcp->local_ip[0] = 127;
+	tcp->local_ip[3] = 1;
+
+	server->conn->link_cnt++;
+	if (tcp->connect_callback != NULL) {
+		tcp->connect_callback(client);
+	}
+}
+
+// Application Function: host_conn_readable(struct host_conn *hc)
+// Desc: Receives data waiting on a socket and passes it up. A closed or failed
+//	TCP connection is torn down and reported through the disconnect or
+//	reconnect (error) callback.
+static void host_conn_readable(struct host_conn *hc)
+{
+	struct espconn *conn = hc->conn;
+	struct sockaddr_in sa;
+	socklen_t len = sizeof(sa);
+	espconn_connect_callback discon;
+	espconn_reconnect_callback recon;
+	ssize_t n;
+
+	if (hc->type == HOST_CONN_UDP) {
+		n = recvfrom(hc->fd, recv_buf, HOST_RECV_LEN, 0, (struct sockaddr *)&sa, &len);
+		if (n > 0) {
+			host_fill_ip(conn->proto.udp->remote_ip, &conn->proto.udp->remote_port, &sa);
+			recv_buf[n] = '\0';
+			if (conn->recv_callback != NULL) {
+				conn->recv_callback(conn, recv_buf, (unsigned short)n);
+			}
+		}
+		return;
+	}
+
+	n = recv(hc->fd, recv_buf, HOST_RECV_LEN, 0);
+	if (n > 0) {
+		recv_buf[n] = '\0';
+		if (conn->recv_callback != NULL) {
+			conn->recv_callback(conn, recv_buf, (unsigned short)n);
+		}
+		return;
+	}
+	if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return;
+	}
+
+	// Peer closed (n == 0) or the connection failed
+	discon = conn->proto.tcp->disconnect_callback;
+	recon = conn->proto.tcp->reconnect_callback;
+	conn->state = ESPCONN_CLOSE;
+	hc->sent_pending = false;
+	hc->discon_pending = false;
+	if (n == 0 && discon != NULL) {
+		discon(conn);
+	} else if (n < 0 && recon != NULL) {
+		recon(conn, ESPCONN_RST);
+	}
+	host_conn_free(hc);
+}
+
+// Application Function: host_conn_connected(struct host_conn *hc)
+// Desc: Completes an outgoing TCP connection
+static void host_conn_connected(struct host_conn *hc)
+{
+	struct espconn *conn = hc->conn;
+	int err = 0;
+	socklen_t len = sizeof(err);
+
+	getsockopt(hc->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+	if (err != 0) {
+		conn->state = ESPCONN_CLOSE;
+		host_conn_free(hc);
+		if (conn->proto.tcp->reconnect_callback != NULL) {
+			conn->proto.tcp->reconnect_callback(conn, ESPCONN_RTE);
+		}
+		return;
+	}
+
+	hc->type = HOST_CONN_TCP;
+	conn->state = ESPCONN_CONNECT;
+	conn->proto.tcp->local_ip[0] = 127;
+	conn->proto.tcp->local_ip[3] = 1;
+	if (conn->proto.tcp->connect_callback != NULL) {
+		conn->proto.tcp->connect_callback(conn);
+	}
+}
+
+// Application Function: host_net_run_deferred(void)
+// Desc: Delivers owed sent and disconnect callbacks
+void host_net_run_deferred(void)
+{
+	struct host_conn *hc;
+	struct espconn *conn;
+	int i;
+
+	for (i = 0; i < HOST_CONN_MAX; i++) {
+		hc = &conns[i];
+		if (hc->type == HOST_CONN_FREE) {
+			continue;
+		}
+		conn = hc->conn;
+		if (hc->sent_pending) {
+			hc->sent_pending = false;
+			if (conn->sent_callback != NULL) {
+				conn->sent_callback(conn);
+			}
+		}
+		if (hc->type != HOST_CONN_FREE && hc->conn == conn && hc->discon_pending) {
+			hc->discon_pending = false;
+			if (conn->proto.tcp->disconnect_callback != NULL) {
+				conn->proto.tcp->disconnect_callback(conn);
+			}
+			// The callback may already have deleted the connection
+			if (hc->type != HOST_CONN_FREE && hc->conn == conn) {
+				host_conn_free(hc);
+			}
+		}
+	}
+}
+
+// Application Function: host_net_poll(sint64 timeout_us)
+// Desc: Waits for socket activity and dispatches it
+// Args:
+//	sint64 timeout_us: Longest time to wait, 0 to only check, -1 to wait forever
+void host_net_poll(sint64 timeout_us)
+{
+	struct pollfd pfd[HOST_CONN_MAX];
+	int map[HOST_CONN_MAX];
+	struct timespec ts;
+	struct host_conn *hc;
+	int i, n = 0;
+
+	for (i = 0; i < HOST_CONN_MAX; i++) {
+		if (conns[i].type == HOST_CONN_FREE) {
+			continue;
+		}
+		pfd[n].fd = conns[i].fd;
+		pfd[n].events = conns[i].type == HOST_CONN_CONNECTING ? POLLOUT : POLLIN;
+		pfd[n].revents = 0;
+		map[n++] = i;
+	}
+
+	ts.tv_sec = timeout_us / 1000000;
+	ts.tv_nsec = (timeout_us % 1000000) * 1000;
+	if (ppoll(pfd, n, timeout_us < 0 ? NULL : &ts, NULL) <= 0) {
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		hc = &conns[map[i]];
+		if (pfd[i].revents == 0 || hc->type == HOST_CONN_FREE || hc->fd != pfd[i].fd) {
+			continue;
+		}
+		switch (hc->type) {
+		case HOST_CONN_LISTEN:
+			host_conn_accept(hc);
+			break;
+		case HOST_CONN_CONNECTING:
+			host_conn_connected(hc);
+			break;
+		default:
+			host_conn_readable(hc);
+			break;
+		}
+	}
+}
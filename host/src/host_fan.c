@@ -0,0 +1,180 @@
+// host_fan.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Simulated exhaust fan plant for the host SDK shim. Generates the
+//	zero crossing detector pulses, watches the triac gate, turns the firing
+//	angle into a motor speed through a first order lag, and drives the
+//	reflective tachometer at the resulting speed. The firmware's own ZCD/tach
+//	ISR, hw_timer pulse sequence and speed controller run against it unchanged.
+
+#include <math.h>
+#include "user_fan.h"
+#include "host.h"
+
+#define FAN_TAU_US		2500000.0	// Mechanical time constant of fan + load
+#define FAN_STALL_V		0.35		// RMS voltage fraction below which the fan stalls
+#define ZCD_PULSE_US		300		// Width of the ZCD output pulse
+
+static uint64 zcd_next = 0;			// Time of the next zero crossing
+static uint64 zcd_fall = HOST_NEVER;		// Time the current ZCD pulse ends
+static uint64 zcd_last = 0;			// Time of the last zero crossing
+static sint64 fire_offset = -1;			// Gate time after zcd_last, -1 if not fired
+static bool gate = false;			// Last seen triac gate level
+
+static double fan_rpm = 0.0;			// True shaft speed
+static double tach_phase = 0.0;			// Position within the current blade period (0-1)
+static double tach_rate = 0.0;			// Blade pulses per us
+static uint64 tach_time = 0;			// Time tach_phase was last brought up to date
+static uint64 tach_next = HOST_NEVER;		// Time of the next tachometer edge
+static bool tach_level = false;			// Current tachometer output level
+
+// Application Function: fan_half_cycle(void)
+// Desc: Length of a mains half cycle, the ZCD pulse period
+// Returns: Half cycle in us
+static uint64 fan_half_cycle(void)
+{
+	return (uint64)(500000.0 / host_opts.mains_hz + 0.5);
+}
+
+// Application Function: fan_speed_target(sint64 offset, uint64 half)
+// Desc: Speed the fan settles at when the triac fires offset us into every half
+//	cycle. The RMS voltage of a phase cut sine at firing angle a is
+//	sqrt(1 - a/pi + sin(2a)/(2pi)) of full, and the fan speed is taken as
+//	proportional to it above the stall voltage.
+// Returns: Steady state RPM
+static double fan_speed_target(sint64 offset, uint64 half)
+{
+	double a, v;
+
+	if (offset < 0 || (uint64)offset >= half) {
+		return 0.0;
+	}
+	a = M_PI * (double)offset / (double)half;
+	v = sqrt(1.0 - a / M_PI + sin(2.0 * a) / (2.0 * M_PI));
+	return v < FAN_STALL_V ? 0.0 : FAN_RPM_MAX * v;
+}
+
+// Application Function: fan_tach_advance(uint64 now)
+// Desc: Moves the blade position forward to now at the current speed
+static void fan_tach_advance(uint64 now)
+{
+	tach_phase += (double)(now - tach_time) * tach_rate;
+	tach_time = now;
+}
+
+// Application Function: fan_tach_schedule(void)
+// Desc: Works out when the next tachometer edge is due. The output is high for
+//	the first half of every blade period.
+static void fan_tach_schedule(void)
+{
+	double remain;
+
+	if (tach_rate <= 0.0) {
+		tach_next = HOST_NEVER;
+		return;
+	}
+	remain = (tach_level ? 0.5 : 1.0) - tach_phase;
+	tach_next = tach_time + (remain > 0.0 ? (uint64)ceil(remain / tach_rate) : 1);
+}
+
+// Application Function: fan_zero_cross(uint64 now)
+// Desc: Closes out the half cycle that just ended, applying its firing angle to
+//	the motor, then starts the next ZCD pulse
+static void fan_zero_cross(uint64 now)
+{
+	uint64 half = fan_half_cycle();
+	double target = fan_speed_target(fire_offset, half);
+
+	fan_tach_advance(now);
+	fan_rpm += (target - fan_rpm) * (1.0 - exp(-(double)half / FAN_TAU_US));
+	tach_rate = fan_rpm / 60.0 * TACH_BLADE_N / 1000000.0;
+	fan_tach_schedule();
+
+	zcd_last = now;
+	zcd_next = now + half;
+	zcd_fall = now + ZCD_PULSE_US;
+	fire_offset = -1;
+	host_gpio_set_input(ZCD_PIN, 1);
+}
+
+// Application Function: fan_tach_edge(uint64 now)
+// Desc: Toggles the tachometer output
+static void fan_tach_edge(uint64 now)
+{
+	fan_tach_advance(now);
+	tach_level = !tach_level;
+	if (tach_level) {
+		tach_phase = 0.0;
+	} else {
+		tach_phase = 0.5;
+	}
+	fan_tach_schedule();
+	host_gpio_set_input(TACH_PIN, tach_level);
+}
+
+static uint64 fan_next_event(void)
+{
+	uint64 next = zcd_next;
+
+	if (zcd_fall < next) {
+		next = zcd_fall;
+	}
+	if (tach_next < next) {
+		next = tach_next;
+	}
+	return next;
+}
+
+static void fan_run(uint64 now)
+{
+	uint64 next;
+
+	// Handle events in time order, as each may move the others
+	while ((next = fan_next_event()) <= now) {
+		if (next == zcd_fall) {
+			zcd_fall = HOST_NEVER;
+			host_gpio_set_input(ZCD_PIN, 0);
+		} else if (next == zcd_next) {
+			fan_zero_cross(next);
+		} else {
+			fan_tach_edge(next);
+		}
+	}
+}
+
+// Application Function: fan_pins_changed(uint32 levels)
+// Desc: Records the first gate pulse in each half cycle. Once gated the triac
+//	conducts until the next zero crossing, so later pulses have no effect.
+static void fan_pins_changed(uint32 levels)
+{
+	bool level = (levels & TRIAC_BIT) != 0;
+
+	if (level && !gate && fire_offset < 0) {
+		fire_offset = (sint64)(host_time_us() - zcd_last);
+	}
+	gate = level;
+}
+
+// Application Function: host_fan_rpm(void)
+// Desc: True speed of the simulated fan, for benchmarks
+// Returns: RPM
+float host_fan_rpm(void)
+{
+	return (float)fan_rpm;
+}
+
+static struct host_device fan_device = {
+	"fan",
+	fan_next_event,
+	fan_run,
+	fan_pins_changed,
+	NULL
+};
+
+// Application Function: fan_register(void)
+// Desc: Attaches the fan plant to the pin model at start up
+static void __attribute__((constructor)) fan_register(void)
+{
+	host_device_register(&fan_device);
+	host_gpio_set_input(ZCD_PIN, 0);
+	host_gpio_set_input(TACH_PIN, 0);
+}
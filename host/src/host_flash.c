@@ -0,0 +1,111 @@
+// host_flash.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: SPI flash for the host SDK shim, backed by an image file so that
+//	saved settings survive a restart of the process (-f selects the file)
+
+#include <stdio.h>
+#include <string.h>
+#include "spi_flash.h"
+#include "host.h"
+
+#define HOST_FLASH_SIZE	(4 * 1024 * 1024)	// 32 Mbit part, as on the ESP-12
+
+static FILE *flash = NULL;
+
+struct host_flash_stats host_flash_stats;
+
+// Application Function: host_flash_open(void)
+// Desc: Opens the image, creating an erased one if it does not exist yet
+// Returns: The image, or NULL on failure
+static FILE *host_flash_open(void)
+{
+	uint8 erased[SPI_FLASH_SEC_SIZE];
+	int i;
+
+	if (flash != NULL) {
+		return flash;
+	}
+	flash = fopen(host_opts.flash_file, "r+b");
+	if (flash == NULL) {
+		flash = fopen(host_opts.flash_file, "w+b");
+		if (flash == NULL) {
+			perror("host: cannot open flash image");
+			return NULL;
+		}
+		memset(erased, 0xff, sizeof(erased));
+		for (i = 0; i < HOST_FLASH_SIZE / SPI_FLASH_SEC_SIZE; i++) {
+			fwrite(erased, 1, sizeof(erased), flash);
+		}
+		fflush(flash);
+	}
+	return flash;
+}
+
+uint32 spi_flash_get_id(void)
+{
+	return 0x1640ef;
+}
+
+SpiFlashOpResult spi_flash_erase_sector(uint16 sec)
+{
+	uint8 erased[SPI_FLASH_SEC_SIZE];
+	FILE *f = host_flash_open();
+
+	host_flash_stats.erases++;
+	if (f == NULL || (uint32)sec * SPI_FLASH_SEC_SIZE >= HOST_FLASH_SIZE) {
+		return SPI_FLASH_RESULT_ERR;
+	}
+	memset(erased, 0xff, sizeof(erased));
+	if (fseek(f, (long)sec * SPI_FLASH_SEC_SIZE, SEEK_SET) != 0 ||
+	    fwrite(erased, 1, sizeof(erased), f) != sizeof(erased)) {
+		return SPI_FLASH_RESULT_ERR;
+	}
+	fflush(f);
+	return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult spi_flash_write(uint32 des_addr, uint32 *src_addr, uint32 size)
+{
+	uint8 old[SPI_FLASH_SEC_SIZE];
+	uint8 *src = (uint8 *)src_addr;
+	FILE *f = host_flash_open();
+	uint32 n, i;
+
+	host_flash_stats.writes++;
+	if (f == NULL || (des_addr & 3) || (size & 3) || des_addr + size > HOST_FLASH_SIZE) {
+		return SPI_FLASH_RESULT_ERR;
+	}
+
+	// Programming can only clear bits, like NOR flash
+	while (size > 0) {
+		n = size < sizeof(old) ? size : sizeof(old);
+		if (fseek(f, des_addr, SEEK_SET) != 0 || fread(old, 1, n, f) != n) {
+			return SPI_FLASH_RESULT_ERR;
+		}
+		for (i = 0; i < n; i++) {
+			old[i] &= src[i];
+		}
+		if (fseek(f, des_addr, SEEK_SET) != 0 || fwrite(old, 1, n, f) != n) {
+			return SPI_FLASH_RESULT_ERR;
+		}
+		des_addr += n;
+		src += n;
+		size -= n;
+	}
+	fflush(f);
+	return SPI_FLASH_RESULT_OK;
+}
+
+SpiFlashOpResult spi_flash_read(uint32 src_addr, uint32 *des_addr, uint32 size)
+{
+	FILE *f = host_flash_open();
+
+	host_flash_stats.reads++;
+	if (f == NULL || src_addr + size > HOST_FLASH_SIZE) {
+		return SPI_FLASH_RESULT_ERR;
+	}
+	if (fseek(f, src_addr, SEEK_SET) != 0 || fread(des_addr, 1, size, f) != size) {
+		return SPI_FLASH_RESULT_ERR;
+	}
+	return SPI_FLASH_RESULT_OK;
+}
@@ -0,0 +1,406 @@
+// host_gpio.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Simulated GPIO block, FRC1 timer and interrupt controller for the
+//	host SDK shim. Pin levels are resolved from what the firmware drives and what
+//	the attached simulated devices drive, and edges raise GPIO interrupts exactly
+//	as configured through gpio_pin_intr_state_set().
+
+#include <stdio.h>
+#include "ets_sys.h"
+#include "gpio.h"
+#include "host.h"
+
+#define GPIO_PIN_INT_TYPE_LSB	7
+#define GPIO_PIN_INT_TYPE_MASK	(0x7 << GPIO_PIN_INT_TYPE_LSB)
+#define GPIO_PIN_MASK		((1 << GPIO_PIN_COUNT) - 1)
+
+#define FRC1_ENABLE_TIMER	BIT7
+#define FRC1_AUTO_LOAD		BIT6
+#define FRC1_DIVIDER_MASK	(BIT2 | BIT3)
+
+// GPIO register file
+static uint32 gpio_out = 0;
+static uint32 gpio_enable = 0;
+static uint32 gpio_status = 0;
+static uint32 gpio_pin[GPIO_PIN_COUNT];
+static uint32 gpio_level = GPIO_PIN_MASK;	// Resolved pin levels (pulled up at reset)
+static uint32 ext_level = GPIO_PIN_MASK;	// Levels driven onto input pins by devices
+static uint32 ext_low = 0;			// Open drain lines held low by devices
+
+// FRC1 register file
+static uint32 frc1_load = 0;
+static uint32 frc1_ctrl = 0;
+static uint64 frc1_deadline = HOST_NEVER;	// Absolute expiry time (us)
+static uint64 frc1_period = 0;			// Reload period (us)
+
+// Interrupt controller
+static ets_isr_t isr_func[32];
+static void *isr_arg[32];
+static uint32 isr_mask = 0;			// Unmasked interrupt sources
+static void (*frc1_nmi_func)(void) = NULL;
+static gpio_intr_handler_fn_t gpio_handler = NULL;
+static void *gpio_handler_arg = NULL;
+static uint32 irq_depth = 0;			// Nesting depth of interrupt context
+static uint32 irq_lock = 0;			// Nesting depth of ets_intr_lock()
+
+static struct host_device *devices = NULL;
+
+// Application Function: host_gpio_resolve(void)
+// Desc: Works out the level on every pin from the firmware and device drivers.
+//	Open drain pins (pad driver set) can only be pulled low by either side,
+//	push-pull pins follow the firmware when enabled as outputs, and input pins
+//	follow whatever the attached device drives.
+// Returns: The resolved pin levels
+static uint32 host_gpio_resolve(void)
+{
+	uint32 level = 0;
+	uint32 bit;
+	int i;
+
+	for (i = 0; i < GPIO_PIN_COUNT; i++) {
+		bit = 1 << i;
+		if (gpio_pin[i] & GPIO_PIN_PAD_DRIVER_MASK) {
+			if (((gpio_enable & bit) == 0 || (gpio_out & bit)) && (ext_low & bit) == 0) {
+				level |= bit;
+			}
+		} else if (gpio_enable & bit) {
+			level |= gpio_out & bit;
+		} else if ((ext_level & bit) && (ext_low & bit) == 0) {
+			level |= bit;
+		}
+	}
+	return level;
+}
+
+// Application Function: host_gpio_update(bool notify)
+// Desc: Re-resolves the pin levels, latching interrupt status for any edges
+//	that match the configured interrupt type of a pin
+// Args:
+//	bool notify: Tell attached devices about the new levels (set for
+//		firmware writes only, so devices do not recurse into themselves)
+static void host_gpio_update(bool notify)
+{
+	uint32 level = host_gpio_resolve();
+	uint32 rise = level & ~gpio_level;
+	uint32 fall = ~level & gpio_level;
+	uint32 bit, type;
+	struct host_device *dev;
+	int i;
+
+	gpio_level = level;
+	for (i = 0; i < GPIO_PIN_COUNT; i++) {
+		bit = 1 << i;
+		type = (gpio_pin[i] & GPIO_PIN_INT_TYPE_MASK) >> GPIO_PIN_INT_TYPE_LSB;
+		if (((type == GPIO_PIN_INTR_POSEDGE || type == GPIO_PIN_INTR_ANYEDGE) && (rise & bit)) ||
+		    ((type == GPIO_PIN_INTR_NEGEDGE || type == GPIO_PIN_INTR_ANYEDGE) && (fall & bit)) ||
+		    (type == GPIO_PIN_INTR_LOLEVEL && (level & bit) == 0) ||
+		    (type == GPIO_PIN_INTR_HILEVEL && (level & bit))) {
+			gpio_status |= bit;
+		}
+	}
+
+	if (notify) {
+		for (dev = devices; dev != NULL; dev = dev->next) {
+			if (dev->pins_changed != NULL) {
+				dev->pins_changed(gpio_level);
+			}
+		}
+	}
+
+	host_service_irqs();
+}
+
+uint32 host_gpio_reg_read(uint32 reg)
+{
+	switch (reg) {
+	case GPIO_OUT_ADDRESS:		return gpio_out;
+	case GPIO_ENABLE_ADDRESS:	return gpio_enable;
+	case GPIO_IN_ADDRESS:		return gpio_level;
+	case GPIO_STATUS_ADDRESS:	return gpio_status;
+	}
+	if (reg >= GPIO_PIN0_ADDRESS && reg < GPIO_PIN0_ADDRESS + 4 * GPIO_PIN_COUNT) {
+		return gpio_pin[(reg - GPIO_PIN0_ADDRESS) / 4];
+	}
+	return 0;
+}
+
+void host_gpio_reg_write(uint32 reg, uint32 val)
+{
+	switch (reg) {
+	case GPIO_OUT_ADDRESS:		gpio_out = val & GPIO_PIN_MASK; break;
+	case GPIO_OUT_W1TS_ADDRESS:	gpio_out |= val & GPIO_PIN_MASK; break;
+	case GPIO_OUT_W1TC_ADDRESS:	gpio_out &= ~val; break;
+	case GPIO_ENABLE_ADDRESS:	gpio_enable = val & GPIO_PIN_MASK; break;
+	case GPIO_ENABLE_W1TS_ADDRESS:	gpio_enable |= val & GPIO_PIN_MASK; break;
+	case GPIO_ENABLE_W1TC_ADDRESS:	gpio_enable &= ~val; break;
+	case GPIO_STATUS_ADDRESS:	gpio_status = val & GPIO_PIN_MASK; return;
+	case GPIO_STATUS_W1TS_ADDRESS:	gpio_status |= val & GPIO_PIN_MASK; return;
+	case GPIO_STATUS_W1TC_ADDRESS:	gpio_status &= ~val; return;
+	default:
+		if (reg >= GPIO_PIN0_ADDRESS && reg < GPIO_PIN0_ADDRESS + 4 * GPIO_PIN_COUNT) {
+			gpio_pin[(reg - GPIO_PIN0_ADDRESS) / 4] = val;
+		}
+		break;
+	}
+	host_gpio_update(true);
+}
+
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask)
+{
+	gpio_out = (gpio_out | set_mask) & ~clear_mask & GPIO_PIN_MASK;
+	gpio_enable = (gpio_enable | enable_mask) & ~disable_mask & GPIO_PIN_MASK;
+	host_gpio_update(true);
+}
+
+uint32 gpio_input_get(void)
+{
+	return gpio_level;
+}
+
+void gpio_intr_handler_register(void *fn, void *arg)
+{
+	gpio_handler = (gpio_intr_handler_fn_t)fn;
+	gpio_handler_arg = arg;
+}
+
+void gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state)
+{
+	if (i >= GPIO_PIN_COUNT) {
+		return;
+	}
+	gpio_pin[i] = (gpio_pin[i] & ~GPIO_PIN_INT_TYPE_MASK) |
+		((intr_state << GPIO_PIN_INT_TYPE_LSB) & GPIO_PIN_INT_TYPE_MASK);
+}
+
+uint32 gpio_intr_pending(void)
+{
+	return gpio_status;
+}
+
+void gpio_intr_ack(uint32 ack_mask)
+{
+	gpio_status &= ~ack_mask;
+}
+
+void gpio_init(void)
+{
+}
+
+uint32 host_rtc_reg_read(uint32 reg)
+{
+	uint64 now;
+	uint32 div;
+
+	switch (reg) {
+	case FRC1_LOAD_ADDRESS:
+		return frc1_load;
+	case FRC1_CTRL_ADDRESS:
+		return frc1_ctrl;
+	case FRC1_COUNT_ADDRESS:
+		now = host_time_us();
+		if (frc1_deadline == HOST_NEVER || frc1_deadline <= now) {
+			return 0;
+		}
+		div = (frc1_ctrl & FRC1_DIVIDER_MASK) == 0 ? 1 : ((frc1_ctrl & BIT3) ? 256 : 16);
+		return (uint32)((frc1_deadline - now) * (80 / div));
+	}
+	return 0;
+}
+
+void host_rtc_reg_write(uint32 reg, uint32 val)
+{
+	uint32 div;
+
+	switch (reg) {
+	case FRC1_LOAD_ADDRESS:
+		// The counter counts the loaded value down at APB / divider
+		frc1_load = val & 0x7fffff;
+		div = (frc1_ctrl & FRC1_DIVIDER_MASK) == 0 ? 1 : ((frc1_ctrl & BIT3) ? 256 : 16);
+		frc1_period = ((uint64)frc1_load * div) / 80;
+		if (frc1_ctrl & FRC1_ENABLE_TIMER) {
+			frc1_deadline = host_time_us() + frc1_period;
+		}
+		break;
+	case FRC1_CTRL_ADDRESS:
+		frc1_ctrl = val;
+		if ((frc1_ctrl & FRC1_ENABLE_TIMER) == 0) {
+			frc1_deadline = HOST_NEVER;
+		}
+		break;
+	}
+}
+
+// Application Function: host_frc1_next_event(void)
+// Desc: Expiry of the FRC1 timer, if it can currently raise an interrupt
+// Returns: Expiry time (us), or HOST_NEVER
+uint64 host_frc1_next_event(void)
+{
+	if (frc1_nmi_func == NULL && (isr_mask & (1 << ETS_FRC_TIMER1_INUM)) == 0) {
+		return HOST_NEVER;
+	}
+	return frc1_deadline;
+}
+
+void ets_isr_attach(int i, ets_isr_t func, void *arg)
+{
+	isr_func[i] = func;
+	isr_arg[i] = arg;
+	if (i == ETS_FRC_TIMER1_INUM) {
+		frc1_nmi_func = NULL;
+	}
+}
+
+void host_frc1_nmi_attach(void (*func)(void))
+{
+	frc1_nmi_func = func;
+}
+
+void ets_isr_mask(unsigned intr)
+{
+	isr_mask &= ~intr;
+}
+
+void ets_isr_unmask(unsigned intr)
+{
+	isr_mask |= intr;
+	host_service_irqs();
+}
+
+void ets_intr_lock(void)
+{
+	irq_lock++;
+}
+
+void ets_intr_unlock(void)
+{
+	if (irq_lock > 0) {
+		irq_lock--;
+	}
+	host_service_irqs();
+}
+
+// Application Function: host_irq_allowed(void)
+// Desc: Checks whether a maskable interrupt may be taken right now
+// Returns: false inside an ISR or while interrupts are locked
+bool host_irq_allowed(void)
+{
+	return irq_depth == 0 && irq_lock == 0;
+}
+
+void host_irq_enter(void)
+{
+	irq_depth++;
+}
+
+void host_irq_exit(void)
+{
+	irq_depth--;
+}
+
+// Application Function: host_service_irqs(void)
+// Desc: Takes any interrupt that is pending, unmasked and allowed. The FRC1
+//	NMI ignores ets_intr_lock(), as on the chip.
+void host_service_irqs(void)
+{
+	uint64 now;
+
+	if (irq_depth != 0) {
+		return;
+	}
+
+	now = host_time_us();
+	if (frc1_deadline != HOST_NEVER && frc1_deadline <= now &&
+	    (frc1_nmi_func != NULL || (irq_lock == 0 && (isr_mask & (1 << ETS_FRC_TIMER1_INUM))))) {
+		if ((frc1_ctrl & FRC1_AUTO_LOAD) && frc1_period != 0) {
+			frc1_deadline += frc1_period;
+		} else {
+			frc1_deadline = HOST_NEVER;
+		}
+		host_irq_enter();
+		if (frc1_nmi_func != NULL) {
+			frc1_nmi_func();
+		} else if (isr_func[ETS_FRC_TIMER1_INUM] != NULL) {
+			isr_func[ETS_FRC_TIMER1_INUM](isr_arg[ETS_FRC_TIMER1_INUM]);
+		}
+		host_irq_exit();
+	}
+
+	if (gpio_status != 0 && gpio_handler != NULL && irq_lock == 0 &&
+	    (isr_mask & (1 << ETS_GPIO_INUM))) {
+		host_irq_enter();
+		gpio_handler(gpio_status, gpio_handler_arg);
+		host_irq_exit();
+	}
+}
+
+// Application Function: host_device_register(struct host_device *dev)
+// Desc: Attaches a simulated device to the pin model
+void host_device_register(struct host_device *dev)
+{
+	dev->next = devices;
+	devices = dev;
+}
+
+// Application Function: host_device_next_event(void)
+// Desc: Earliest pending event of all attached devices
+// Returns: Event time (us), or HOST_NEVER
+uint64 host_device_next_event(void)
+{
+	uint64 next = HOST_NEVER;
+	uint64 t;
+	struct host_device *dev;
+
+	for (dev = devices; dev != NULL; dev = dev->next) {
+		if (dev->next_event != NULL) {
+			t = dev->next_event();
+			if (t < next) {
+				next = t;
+			}
+		}
+	}
+	return next;
+}
+
+// Application Function: host_device_run(uint64 now)
+// Desc: Services every device with an event due
+void host_device_run(uint64 now)
+{
+	struct host_device *dev;
+
+	for (dev = devices; dev != NULL; dev = dev->next) {
+		if (dev->run != NULL && dev->next_event != NULL && dev->next_event() <= now) {
+			dev->run(now);
+		}
+	}
+}
+
+// Application Function: host_gpio_set_input(uint8 pin, uint8 level)
+// Desc: Drives an input pin from a simulated device
+void host_gpio_set_input(uint8 pin, uint8 level)
+{
+	if (level) {
+		ext_level |= 1 << pin;
+	} else {
+		ext_level &= ~(1 << pin);
+	}
+	host_gpio_update(false);
+}
+
+// Application Function: host_gpio_pull_low(uint32 mask, bool low)
+// Desc: Holds (or releases) open drain lines low from a simulated device
+void host_gpio_pull_low(uint32 mask, bool low)
+{
+	if (low) {
+		ext_low |= mask;
+	} else {
+		ext_low &= ~mask;
+	}
+	host_gpio_update(false);
+}
+
+// Application Function: host_gpio_levels(void)
+// Desc: Current resolved pin levels, as a device would see them
+uint32 host_gpio_levels(void)
+{
+	return gpio_level;
+}
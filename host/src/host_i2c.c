@@ -0,0 +1,182 @@
+// host_i2c.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Simulated Honeywell HIH8121 humidity sensor on the bit-banged I2C
+//	bus. The device follows the bus at the bit level through pin change
+//	notifications, so the firmware's real user_i2c.c driver is exercised.
+
+#include "user_i2c.h"
+#include "host.h"
+
+#define HIH_SLAVE_ADDR		0x27	// 7 bit slave address
+#define HIH_CONVERSION_US	36650	// Typical measurement cycle time
+#define HIH_STATUS_VALID	0
+#define HIH_STATUS_STALE	1
+
+// Bus protocol state
+typedef enum {
+	HIH_IDLE,		// Waiting for a START
+	HIH_ADDR,		// Shifting in the address byte
+	HIH_ADDR_ACK,		// Holding SDA low to ACK the address
+	HIH_TX,			// Shifting out a data byte
+	HIH_TX_ACK,		// Waiting for the master to ACK/NACK
+	HIH_IGNORE		// Not addressed, or write complete; wait for STOP
+} HIH_STATE;
+
+static HIH_STATE hih_state = HIH_IDLE;
+static uint32 hih_levels = SCL_BIT | SDA_BIT;	// Bus levels at the last notification
+static uint8 hih_shift = 0;			// Address shift register
+static uint8 hih_bit = 0;			// Bit counter within the current byte
+static uint8 hih_data[4];			// Output frame (humidity + temperature)
+static uint8 hih_byte = 0;			// Index of the byte being sent
+static uint64 hih_ready = HOST_NEVER;		// Time the pending measurement completes
+static uint8 hih_status = HIH_STATUS_STALE;	// Status reported with the current data
+
+// Application Function: hih_sample(void)
+// Desc: Latches a new measurement into the output frame
+static void hih_sample(void)
+{
+	uint16 count;
+	float rh = host_opts.humidity;
+
+	if (rh < 0.0f) {
+		rh = 0.0f;
+	} else if (rh > 100.0f) {
+		rh = 100.0f;
+	}
+	count = (uint16)(rh / 100.0f * (float)((1 << 14) - 2) + 0.5f);
+	hih_data[0] = (uint8)(count >> 8) & 0x3f;
+	hih_data[1] = (uint8)count;
+	hih_data[2] = 0x66;		// ~25 C
+	hih_data[3] = 0x60;
+}
+
+// Application Function: hih_drive_bit(void)
+// Desc: Puts the current bit of the current frame byte onto SDA. The status
+//	bits are merged into the top of the first byte.
+static void hih_drive_bit(void)
+{
+	uint8 byte = hih_data[hih_byte & 0x3];
+
+	if (hih_byte == 0) {
+		byte = (byte & 0x3f) | (hih_status << 6);
+	}
+	host_gpio_pull_low(SDA_BIT, ((byte >> hih_bit) & 1) == 0);
+}
+
+// Application Function: hih_load_byte(void)
+// Desc: Starts sending the next frame byte, MSB first
+static void hih_load_byte(void)
+{
+	hih_bit = 7;
+	hih_drive_bit();
+}
+
+// Application Function: hih_start_read(void)
+// Desc: Prepares the frame for a read transfer. A completed measurement is
+//	reported valid once, after which it reads back stale.
+static void hih_start_read(void)
+{
+	if (hih_ready != HOST_NEVER && host_time_us() >= hih_ready) {
+		hih_sample();
+		hih_ready = HOST_NEVER;
+		hih_status = HIH_STATUS_VALID;
+	} else if (hih_status == HIH_STATUS_VALID) {
+		hih_status = HIH_STATUS_STALE;
+	}
+	hih_byte = 0;
+	hih_load_byte();
+}
+
+// Application Function: hih_pins_changed(uint32 levels)
+// Desc: Bus state machine, run whenever the firmware changes the pin levels
+static void hih_pins_changed(uint32 levels)
+{
+	uint32 old = hih_levels;
+	bool scl = (levels & SCL_BIT) != 0;
+	bool sda = (levels & SDA_BIT) != 0;
+
+	hih_levels = levels;
+
+	// START / STOP: SDA moving while SCL is held high
+	if (scl && (old & SCL_BIT)) {
+		if ((old & SDA_BIT) && !sda) {
+			host_gpio_pull_low(SDA_BIT, false);
+			hih_state = HIH_ADDR;
+			hih_shift = 0;
+			hih_bit = 0;
+		} else if (!(old & SDA_BIT) && sda) {
+			host_gpio_pull_low(SDA_BIT, false);
+			hih_state = HIH_IDLE;
+		}
+		return;
+	}
+
+	if (scl && !(old & SCL_BIT)) {
+		// Rising clock: the receiver samples SDA
+		if (hih_state == HIH_ADDR) {
+			hih_shift = (hih_shift << 1) | sda;
+			hih_bit++;
+		} else if (hih_state == HIH_TX_ACK && sda) {
+			hih_state = HIH_IGNORE;		// NACK ends the transfer
+		}
+	} else if (!scl && (old & SCL_BIT)) {
+		// Falling clock: the transmitter moves on to the next bit
+		switch (hih_state) {
+		case HIH_ADDR:
+			if (hih_bit == 8) {
+				if ((hih_shift >> 1) == HIH_SLAVE_ADDR) {
+					host_gpio_pull_low(SDA_BIT, true);
+					hih_state = HIH_ADDR_ACK;
+				} else {
+					hih_state = HIH_IGNORE;
+				}
+			}
+			break;
+		case HIH_ADDR_ACK:
+			host_gpio_pull_low(SDA_BIT, false);
+			if (hih_shift & 0x01) {
+				hih_state = HIH_TX;
+				hih_start_read();
+			} else {
+				// A write with no data is a measurement request
+				hih_ready = host_time_us() + HIH_CONVERSION_US;
+				if (hih_status == HIH_STATUS_VALID) {
+					hih_status = HIH_STATUS_STALE;
+				}
+				hih_state = HIH_IGNORE;
+			}
+			break;
+		case HIH_TX:
+			if (hih_bit == 0) {
+				host_gpio_pull_low(SDA_BIT, false);
+				hih_state = HIH_TX_ACK;
+			} else {
+				hih_bit--;
+				hih_drive_bit();
+			}
+			break;
+		case HIH_TX_ACK:
+			hih_byte++;
+			hih_state = HIH_TX;
+			hih_load_byte();
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static struct host_device hih_device = {
+	"hih8121",
+	NULL,
+	NULL,
+	hih_pins_changed,
+	NULL
+};
+
+// Application Function: hih_register(void)
+// Desc: Attaches the sensor to the pin model at start up
+static void __attribute__((constructor)) hih_register(void)
+{
+	host_device_register(&hih_device);
+}
@@ -0,0 +1,426 @@
+// host_main.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Entry point and scheduler of the host SDK shim. Stands in for the
+//	NONOS SDK main loop: calls user_init(), then services the three user task
+//	queues, os_timers, the simulated peripherals and the network sockets.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "osapi.h"
+#include "user_interface.h"
+#include "host.h"
+
+#define HOST_TIMER_MAX	64		// Maximum number of simultaneously armed os_timers
+
+void user_init(void);
+
+struct host_options host_opts = {
+	"flash.bin",			// Flash image
+	0,				// Local port offset
+	0,				// Remote port offset
+	50.0f,				// Relative humidity
+	60.0f,				// Mains frequency
+	false,				// AP found during scans
+	false,				// Wall clock
+	0,				// Run forever
+	false				// Heap allowed throughout
+};
+
+// User task slots (system_os_task)
+struct host_task {
+	os_task_t task;			// Task function
+	os_event_t *queue;		// Queue memory supplied by the user
+	uint8 qlen;			// Queue length
+	uint8 head;			// Index of the oldest queued event
+	uint8 count;			// Number of queued events
+};
+
+// Armed os_timer
+struct host_timer {
+	os_timer_t *timer;		// User timer structure
+	uint64 expire;			// Absolute expiry time (us)
+	uint64 period;			// Re-arm period (us), 0 if one-shot
+};
+
+static struct host_task tasks[USER_TASK_PRIO_MAX];
+static struct host_timer timers[HOST_TIMER_MAX];
+static uint8 timer_n = 0;
+static init_done_cb_t init_done_cb = NULL;
+static uint64 clock_base = 0;		// Wall clock at start up (ns)
+static uint64 clock_virtual = 0;	// Simulated clock (us)
+static char **host_argv;
+
+// Application Function: host_wall_ns(void)
+// Desc: Reads the monotonic wall clock
+// Returns: Current time in ns
+static uint64 host_wall_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000ull + (uint64)ts.tv_nsec;
+}
+
+// Application Function: host_time_us(void)
+// Desc: Time since start up, on either the wall or the simulated clock
+// Returns: Time in us
+uint64 host_time_us(void)
+{
+	if (host_opts.virtual_time) {
+		return clock_virtual;
+	}
+	return (host_wall_ns() - clock_base) / 1000;
+}
+
+// Application Function: host_advance_us(uint64 us)
+// Desc: Moves the simulated clock forward. Does nothing on the wall clock,
+//	which moves by itself.
+// Args:
+//	uint64 us: Amount of time to advance by
+void host_advance_us(uint64 us)
+{
+	if (host_opts.virtual_time) {
+		clock_virtual += us;
+	}
+}
+
+// Application Function: host_timer_find(os_timer_t *ptimer)
+// Desc: Looks up a timer in the armed list
+// Returns: Index into the armed list, or -1 if the timer is not armed
+static int host_timer_find(os_timer_t *ptimer)
+{
+	int i;
+	for (i = 0; i < timer_n; i++) {
+		if (timers[i].timer == ptimer) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void ets_timer_setfn(ETSTimer *ptimer, ETSTimerFunc *pfunction, void *parg)
+{
+	ptimer->timer_func = pfunction;
+	ptimer->timer_arg = parg;
+}
+
+void ets_timer_disarm(ETSTimer *ptimer)
+{
+	int i = host_timer_find(ptimer);
+	if (i < 0) {
+		return;
+	}
+	timers[i] = timers[--timer_n];
+}
+
+void ets_timer_arm_new(ETSTimer *ptimer, uint32 time, bool repeat_flag, bool ms_flag)
+{
+	uint64 period = ms_flag ? (uint64)time * 1000 : time;
+	int i = host_timer_find(ptimer);
+
+	if (i < 0) {
+		if (timer_n == HOST_TIMER_MAX) {
+			fprintf(stderr, "host: too many armed os_timers\n");
+			abort();
+		}
+		i = timer_n++;
+	}
+	timers[i].timer = ptimer;
+	timers[i].expire = host_time_us() + period;
+	timers[i].period = repeat_flag ? period : 0;
+	ptimer->timer_period = (uint32)timers[i].period;
+}
+
+// Application Function: host_timer_next_event(void)
+// Desc: Finds the earliest armed os_timer
+// Returns: Expiry of the earliest timer (us), or HOST_NEVER
+static uint64 host_timer_next_event(void)
+{
+	uint64 next = HOST_NEVER;
+	int i;
+	for (i = 0; i < timer_n; i++) {
+		if (timers[i].expire < next) {
+			next = timers[i].expire;
+		}
+	}
+	return next;
+}
+
+// Application Function: host_timer_run(uint64 now)
+// Desc: Runs the callback of the earliest expired os_timer, if any. Periodic
+//	timers are re-armed before their callback runs, as the SDK does.
+// Returns: true if a callback ran
+static bool host_timer_run(uint64 now)
+{
+	int i, due = -1;
+	os_timer_t *ptimer;
+
+	for (i = 0; i < timer_n; i++) {
+		if (timers[i].expire <= now && (due < 0 || timers[i].expire < timers[due].expire)) {
+			due = i;
+		}
+	}
+	if (due < 0) {
+		return false;
+	}
+
+	ptimer = timers[due].timer;
+	if (timers[due].period != 0) {
+		timers[due].expire += timers[due].period;
+	} else {
+		timers[due] = timers[--timer_n];
+	}
+	if (ptimer->timer_func != NULL) {
+		ptimer->timer_func(ptimer->timer_arg);
+	}
+	return true;
+}
+
+bool system_os_task(os_task_t task, uint8 prio, os_event_t *queue, uint8 qlen)
+{
+	if (prio >= USER_TASK_PRIO_MAX || queue == NULL || qlen == 0) {
+		return false;
+	}
+	tasks[prio].task = task;
+	tasks[prio].queue = queue;
+	tasks[prio].qlen = qlen;
+	tasks[prio].head = 0;
+	tasks[prio].count = 0;
+	return true;
+}
+
+bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par)
+{
+	struct host_task *t;
+	os_event_t *e;
+
+	if (prio >= USER_TASK_PRIO_MAX) {
+		return false;
+	}
+	t = &tasks[prio];
+	if (t->task == NULL || t->count == t->qlen) {
+		return false;
+	}
+	e = &t->queue[(t->head + t->count) % t->qlen];
+	e->sig = sig;
+	e->par = par;
+	t->count++;
+	return true;
+}
+
+// Application Function: host_task_run(void)
+// Desc: Delivers one event to the highest priority task with a non-empty queue
+// Returns: true if an event was delivered
+static bool host_task_run(void)
+{
+	int prio;
+	os_event_t e;
+	struct host_task *t;
+
+	for (prio = USER_TASK_PRIO_MAX - 1; prio >= 0; prio--) {
+		t = &tasks[prio];
+		if (t->task != NULL && t->count != 0) {
+			e = t->queue[t->head];
+			t->head = (t->head + 1) % t->qlen;
+			t->count--;
+			t->task(&e);
+			return true;
+		}
+	}
+	return false;
+}
+
+void system_init_done_cb(init_done_cb_t cb)
+{
+	init_done_cb = cb;
+}
+
+uint32 system_get_time(void)
+{
+	return (uint32)host_time_us();
+}
+
+// Application Function: host_prof_ticks(void)
+// Desc: Stands in for the CCOUNT register in user_prof.h. Always the wall
+//	clock, so code is timed as it runs even on the simulated clock
+// Returns: Wall clock in ns, wrapping
+uint32 host_prof_ticks(void)
+{
+	return (uint32)host_wall_ns();
+}
+
+uint32 system_get_free_heap_size(void)
+{
+	return 0;
+}
+
+void system_restart(void)
+{
+	printf("host: restarting\n");
+	fflush(stdout);
+	execv("/proc/self/exe", host_argv);
+	perror("host: restart failed");
+	exit(EXIT_FAILURE);
+}
+
+void uart_div_modify(uint8 uart_no, uint32 divlatch)
+{
+}
+
+#define HOST_UART0_FIFO		0x60000000
+
+static int host_uart_pending = 0;	// UART bytes written since stdout was last flushed
+
+// Application Function: host_peri_reg_read(uint32 addr)
+// Desc: Register read. The UART0 transmit FIFO is always empty, since
+//	stdout takes every byte at once
+// Returns: Register value, 0 for anything not modelled
+uint32 host_peri_reg_read(uint32 addr)
+{
+	return 0;
+}
+
+// Application Function: host_peri_reg_write(uint32 addr, uint32 val)
+// Desc: Register write. A byte for the UART0 transmit FIFO goes to stdout,
+//	anything else is ignored
+void host_peri_reg_write(uint32 addr, uint32 val)
+{
+	if (addr == HOST_UART0_FIFO) {
+		putchar(val & 0xFF);
+		host_uart_pending = 1;
+	}
+}
+
+// Application Function: host_service_devices(uint64 now)
+// Desc: Runs simulated devices and pending interrupts due at the given time
+static void host_service_devices(uint64 now)
+{
+	host_device_run(now);
+	host_service_irqs();
+}
+
+void ets_delay_us(uint32 us)
+{
+	uint64 target = host_time_us() + us;
+	uint64 next;
+
+	// Busy waits still let interrupts in, so the simulated peripherals keep
+	// running while the firmware spins (e.g. during I2C bit-banging)
+	while (host_time_us() < target) {
+		if (host_opts.virtual_time) {
+			next = host_irq_allowed() ? host_device_next_event() : HOST_NEVER;
+			if (host_irq_allowed() && host_frc1_next_event() < next) {
+				next = host_frc1_next_event();
+			}
+			if (next > target) {
+				next = target;
+			}
+			if (next > clock_virtual) {
+				clock_virtual = next;
+			}
+		}
+		if (host_irq_allowed()) {
+			host_service_devices(host_time_us());
+		}
+	}
+}
+
+// Application Function: host_usage(const char *prog)
+// Desc: Prints command line help
+static void host_usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-f flash.bin] [-o port_offset] [-r remote_offset] [-h %%RH] [-m Hz] [-n] [-v] [-t seconds] [-a]\n"
+		"  -f  flash image backing spi_flash_* (created if missing)\n"
+		"  -o  offset added to every local port\n"
+		"  -r  offset added to every remote port\n"
+		"  -h  relative humidity reported by the simulated HIH8121\n"
+		"  -m  mains frequency seen by the zero crossing detector\n"
+		"  -n  WiFi scans find no access point\n"
+		"  -v  run on a simulated clock (as fast as possible)\n"
+		"  -t  exit after this many seconds\n"
+		"  -a  abort on any heap allocation after start up\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	uint64 now, next;
+	bool busy;
+
+	host_argv = argv;
+	while ((opt = getopt(argc, argv, "f:o:r:h:m:nvt:a")) != -1) {
+		switch (opt) {
+		case 'f': host_opts.flash_file = optarg; break;
+		case 'o': host_opts.port_offset = atoi(optarg); break;
+		case 'r': host_opts.remote_offset = atoi(optarg); break;
+		case 'h': host_opts.humidity = atof(optarg); break;
+		case 'm': host_opts.mains_hz = atof(optarg); break;
+		case 'n': host_opts.no_ap = true; break;
+		case 'v': host_opts.virtual_time = true; break;
+		case 't': host_opts.run_time = (uint64)(atof(optarg) * 1000000.0); break;
+		case 'a': host_opts.no_alloc = true; break;
+		default:
+			host_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	clock_base = host_wall_ns();
+
+	user_init();
+	if (init_done_cb != NULL) {
+		init_done_cb();
+	}
+	host_heap_stats.frozen = host_opts.no_alloc;
+
+	for (;;) {
+		now = host_time_us();
+		if (host_opts.run_time != 0 && now >= host_opts.run_time) {
+			break;
+		}
+
+		host_service_devices(now);
+		host_net_run_deferred();
+
+		busy = host_timer_run(now);
+		busy |= host_task_run();
+		if (busy) {
+			continue;
+		}
+
+		// Nothing runnable: wait for the next deadline or network activity. UART
+		//	bytes carry no newline to flush them, so flush before waiting
+		if (host_uart_pending) {
+			fflush(stdout);
+			host_uart_pending = 0;
+		}
+		next = host_timer_next_event();
+		if (host_device_next_event() < next) {
+			next = host_device_next_event();
+		}
+		if (host_frc1_next_event() < next) {
+			next = host_frc1_next_event();
+		}
+		if (host_opts.run_time != 0 && host_opts.run_time < next) {
+			next = host_opts.run_time;
+		}
+
+		if (host_opts.virtual_time) {
+			host_net_poll(0);
+			if (next != HOST_NEVER && next > clock_virtual) {
+				clock_virtual = next;
+			} else if (next == HOST_NEVER) {
+				host_net_poll(-1);
+			}
+		} else {
+			now = host_time_us();
+			host_net_poll(next == HOST_NEVER ? -1 : (next > now ? (sint64)(next - now) : 0));
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
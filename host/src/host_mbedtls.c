@@ -0,0 +1,107 @@
+// host_mbedtls.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Host stand-in for the parts of libmbedtls.a used by the WebSocket
+//	handshake (SHA-1 and Base64 encoding), since the bundled library is built
+//	for the xtensa target only
+
+#include <string.h>
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+
+#define ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+// Application Function: host_sha1_block(uint32_t h[5], const unsigned char *p)
+// Desc: Runs the SHA-1 compression function over one 64 byte block
+static void host_sha1_block(uint32_t h[5], const unsigned char *p)
+{
+	uint32_t w[80], a, b, c, d, e, f, k, t;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) |
+		       ((uint32_t)p[4 * i + 2] << 8) | p[4 * i + 3];
+	}
+	for (; i < 80; i++) {
+		w[i] = ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+	}
+
+	a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+	for (i = 0; i < 80; i++) {
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+		t = ROL(a, 5) + f + e + k + w[i];
+		e = d; d = c; c = ROL(b, 30); b = a; a = t;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+void mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+	uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	unsigned char block[64];
+	uint64_t bits = (uint64_t)ilen * 8;
+	size_t rem;
+	int i;
+
+	while (ilen >= 64) {
+		host_sha1_block(h, input);
+		input += 64;
+		ilen -= 64;
+	}
+
+	// Pad with 0x80, zeros and the 64 bit message length
+	rem = ilen;
+	memset(block, 0, sizeof(block));
+	memcpy(block, input, rem);
+	block[rem] = 0x80;
+	if (rem >= 56) {
+		host_sha1_block(h, block);
+		memset(block, 0, sizeof(block));
+	}
+	for (i = 0; i < 8; i++) {
+		block[63 - i] = (unsigned char)(bits >> (8 * i));
+	}
+	host_sha1_block(h, block);
+
+	for (i = 0; i < 20; i++) {
+		output[i] = (unsigned char)(h[i / 4] >> (24 - 8 * (i % 4)));
+	}
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen,
+			  const unsigned char *src, size_t slen)
+{
+	static const char map[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t need = 4 * ((slen + 2) / 3) + 1;
+	size_t i, n = 0;
+	uint32_t v;
+
+	if (dlen < need || dst == NULL) {
+		*olen = need;
+		return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+	}
+
+	for (i = 0; i < slen; i += 3) {
+		v = (uint32_t)src[i] << 16;
+		if (i + 1 < slen) v |= (uint32_t)src[i + 1] << 8;
+		if (i + 2 < slen) v |= src[i + 2];
+		dst[n++] = map[(v >> 18) & 0x3f];
+		dst[n++] = map[(v >> 12) & 0x3f];
+		dst[n++] = i + 1 < slen ? map[(v >> 6) & 0x3f] : '=';
+		dst[n++] = i + 2 < slen ? map[v & 0x3f] : '=';
+	}
+	dst[n] = '\0';
+	*olen = n;
+	return 0;
+}
@@ -0,0 +1,49 @@
+// host_mem.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Heap calls of the host SDK shim. Counts the firmware's os_malloc
+//	family calls, and with -a aborts on any made once start up is over, so a
+//	run shows the steady state path leaves the heap alone.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "mem.h"
+#include "host.h"
+
+struct host_heap_stats host_heap_stats;
+
+// Application Function: host_heap_alloc(size_t size)
+// Desc: Counts an allocation, aborting if allocations are forbidden
+static void host_heap_alloc(size_t size)
+{
+	host_heap_stats.allocs++;
+	if (host_heap_stats.frozen) {
+		fprintf(stderr, "HOST: heap allocation of %zu bytes after start up\n", size);
+		abort();
+	}
+}
+
+void *host_malloc(size_t size)
+{
+	host_heap_alloc(size);
+	return malloc(size);
+}
+
+void *host_calloc(size_t n, size_t size)
+{
+	host_heap_alloc(n * size);
+	return calloc(n, size);
+}
+
+void *host_realloc(void *p, size_t size)
+{
+	host_heap_alloc(size);
+	return realloc(p, size);
+}
+
+void host_free(void *p)
+{
+	if (p != NULL) {
+		host_heap_stats.frees++;
+	}
+	free(p);
+}
@@ -0,0 +1,182 @@
+// host_wifi.c
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Simulated WiFi for the host SDK shim. Station scans report a
+//	single access point with the requested SSID (none with -n), connecting
+//	always succeeds, and every interface sits on 127.0.0.1.
+
+#include <stdio.h>
+#include "osapi.h"
+#include "user_interface.h"
+#include "host.h"
+
+#define HOST_SCAN_TIME		100	// Time taken by a scan (ms)
+#define HOST_CONNECT_TIME	200	// Time taken to associate and get an IP (ms)
+
+static uint8 wifi_opmode = STATION_MODE;
+static uint8 wifi_status = STATION_IDLE;
+static struct station_config wifi_station;
+static struct softap_config wifi_softap;
+static struct bss_info wifi_bss;
+static scan_done_cb_t wifi_scan_cb = NULL;
+static os_timer_t wifi_scan_timer;
+static os_timer_t wifi_connect_timer;
+
+uint8 wifi_get_opmode(void)
+{
+	return wifi_opmode;
+}
+
+bool wifi_set_opmode(uint8 opmode)
+{
+	return wifi_set_opmode_current(opmode);
+}
+
+bool wifi_set_opmode_current(uint8 opmode)
+{
+	if (opmode > STATIONAP_MODE) {
+		return false;
+	}
+	wifi_opmode = opmode;
+	return true;
+}
+
+bool wifi_get_ip_info(uint8 if_index, struct ip_info *info)
+{
+	if (info == NULL) {
+		return false;
+	}
+	IP4_ADDR(&info->ip, 127, 0, 0, 1);
+	IP4_ADDR(&info->netmask, 255, 0, 0, 0);
+	IP4_ADDR(&info->gw, 127, 0, 0, 1);
+	return true;
+}
+
+bool wifi_set_ip_info(uint8 if_index, struct ip_info *info)
+{
+	return info != NULL;
+}
+
+bool wifi_station_get_config(struct station_config *config)
+{
+	*config = wifi_station;
+	return true;
+}
+
+bool wifi_station_set_config(struct station_config *config)
+{
+	wifi_station = *config;
+	return true;
+}
+
+bool wifi_station_set_config_current(struct station_config *config)
+{
+	return wifi_station_set_config(config);
+}
+
+// Callback Function: host_wifi_connect_cb(void *arg)
+// Desc: Finishes association
+static void host_wifi_connect_cb(void *arg)
+{
+	wifi_status = STATION_GOT_IP;
+	printf("host: station connected to \"%s\", ip=127.0.0.1\n", wifi_station.ssid);
+}
+
+bool wifi_station_connect(void)
+{
+	if (!(wifi_opmode & STATION_MODE)) {
+		return false;
+	}
+	wifi_status = host_opts.no_ap ? STATION_NO_AP_FOUND : STATION_CONNECTING;
+	if (!host_opts.no_ap) {
+		os_timer_disarm(&wifi_connect_timer);
+		os_timer_setfn(&wifi_connect_timer, host_wifi_connect_cb, NULL);
+		os_timer_arm(&wifi_connect_timer, HOST_CONNECT_TIME, 0);
+	}
+	return true;
+}
+
+bool wifi_station_disconnect(void)
+{
+	os_timer_disarm(&wifi_connect_timer);
+	wifi_status = STATION_IDLE;
+	return true;
+}
+
+// Callback Function: host_wifi_scan_cb(void *arg)
+// Desc: Delivers scan results
+static void host_wifi_scan_cb(void *arg)
+{
+	scan_done_cb_t cb = wifi_scan_cb;
+
+	wifi_scan_cb = NULL;
+	if (cb != NULL) {
+		cb(host_opts.no_ap ? NULL : &wifi_bss, OK);
+	}
+}
+
+bool wifi_station_scan(struct scan_config *config, scan_done_cb_t cb)
+{
+	// Locally administered BSSID
+	static const uint8 bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+	if (!(wifi_opmode & STATION_MODE) || wifi_scan_cb != NULL) {
+		return false;
+	}
+
+	os_memset(&wifi_bss, 0, sizeof(wifi_bss));
+	os_memcpy(wifi_bss.bssid, bssid, sizeof(bssid));
+	if (config != NULL && config->ssid != NULL) {
+		os_strncpy((char *)wifi_bss.ssid, (char *)config->ssid, sizeof(wifi_bss.ssid));
+	}
+	wifi_bss.ssid_len = os_strlen((char *)wifi_bss.ssid);
+	wifi_bss.channel = 1;
+	wifi_bss.rssi = -40;
+	wifi_bss.authmode = AUTH_WPA2_PSK;
+
+	wifi_scan_cb = cb;
+	os_timer_disarm(&wifi_scan_timer);
+	os_timer_setfn(&wifi_scan_timer, host_wifi_scan_cb, NULL);
+	os_timer_arm(&wifi_scan_timer, HOST_SCAN_TIME, 0);
+	return true;
+}
+
+uint8 wifi_station_get_connect_status(void)
+{
+	return wifi_status;
+}
+
+bool wifi_softap_get_config(struct softap_config *config)
+{
+	*config = wifi_softap;
+	return true;
+}
+
+bool wifi_softap_set_config(struct softap_config *config)
+{
+	return wifi_softap_set_config_current(config);
+}
+
+bool wifi_softap_set_config_current(struct softap_config *config)
+{
+	if (!(wifi_opmode & SOFTAP_MODE)) {
+		return false;
+	}
+	wifi_softap = *config;
+	printf("host: softap \"%s\" up\n", wifi_softap.ssid);
+	return true;
+}
+
+bool wifi_softap_dhcps_start(void)
+{
+	return true;
+}
+
+bool wifi_softap_dhcps_stop(void)
+{
+	return true;
+}
+
+bool wifi_softap_set_dhcps_lease(struct dhcps_lease *please)
+{
+	return please != NULL;
+}
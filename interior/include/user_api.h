@@ -0,0 +1,64 @@
+// user_api.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: JSON status and configuration API on the front end server, for
+//	clients which poll or set the controller without holding a WebSocket open.
+//
+//	GET /api/status   Readings and the state of the fan drive
+//	GET /api/config   Settings
+//	PUT /api/config   Changes settings. The body is an object holding any of
+//	                  the members GET /api/config returns:
+//	                    fan_mode      "lock_off", "normal", "lock_on" or "override"
+//	                    control_mode  "speed" or "delay"
+//	                    rpm           FAN_RPM_MIN to FAN_RPM_MAX
+//	                    delay         TRIAC delay, 0 to the supply half cycle in us
+//	                    threshold     Humidity threshold, 0 to 100 %RH
+//	                  Setting rpm or delay also selects that control mode, as
+//	                  the WebSocket's speed= and delay= do, unless control_mode
+//	                  is given too, and both are clamped to range as they are
+//	                  (user_fan_apply). Every member is checked before any is
+//	                  applied; a bad body changes nothing and is answered with
+//	                  400 and {"error":"..."}. Otherwise the answer is the
+//	                  configuration as it now stands.
+
+#ifndef _USER_API_H
+#define _USER_API_H
+
+#include <user_interface.h>
+#include <espconn.h>
+#include <osapi.h>
+#include "user_task.h"
+#include "user_humidity.h"
+#include "user_fan.h"
+#include "user_http.h"
+#include "user_json.h"
+
+#define API_BUF_SIZE	512	// Largest JSON response body
+
+// Callback Function: user_api_status(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for GET /api/status
+// Args:
+//	struct espconn *conn: Client connection
+//	struct user_http_req *req: Request
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_api_status(struct espconn *conn, struct user_http_req *req);
+
+// Callback Function: user_api_config_get(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for GET /api/config
+// Args:
+//	struct espconn *conn: Client connection
+//	struct user_http_req *req: Request
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_api_config_get(struct espconn *conn, struct user_http_req *req);
+
+// Callback Function: user_api_config_put(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for PUT /api/config
+// Args:
+//	struct espconn *conn: Client connection
+//	struct user_http_req *req: Request
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_api_config_put(struct espconn *conn, struct user_http_req *req);
+
+#endif
@@ -0,0 +1,75 @@
+// user_asset.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Static web assets. The page sources in web/ are gzipped at
+//	build time by web/asset_gen.py into flash resident arrays (generated
+//	user_asset_data.c), so they take no RAM and no work per request. An
+//	asset is sent with Content-Encoding: gzip and a Content-Length, one
+//	ASSET_CHUNK at a time from the server's sent callback, so no send is
+//	larger than the lwIP send buffer. A request carrying the asset's ETag
+//	in If-None-Match is answered with 304 Not Modified and no body.
+
+#ifndef _USER_ASSET_H
+#define _USER_ASSET_H
+
+#include <user_interface.h>
+#include <espconn.h>
+#include <osapi.h>
+#include "user_task.h"
+#include "user_http.h"
+
+#define ASSET_CHUNK	1460	// Bytes per send, one TCP segment
+#define ASSET_XFER_N	2	// Transfers which may run at once
+
+// Compressed asset
+struct user_asset {
+	const char *path;	// Request path
+	const char *type;	// Content-Type
+	const char *etag;	// Quoted ETag
+	const uint8 *data;	// gzip data, in flash: read with aligned 32-bit loads only
+	uint32 len;		// Length of data
+};
+
+// Generated by web/asset_gen.py
+extern const struct user_asset user_assets[];
+extern const uint8 user_asset_n;
+
+// Application Function: user_asset_find(const char *path)
+// Desc: Looks up the asset served at a path
+// Args:
+//	const char *path: Request path
+// Returns:
+//	The asset, or NULL if the path is not an asset
+const struct user_asset * ICACHE_FLASH_ATTR user_asset_find(const char *path);
+
+// Application Function: user_asset_send(struct espconn *conn, const struct user_asset *asset, const char *etag)
+// Desc: Answers a GET request for an asset: 304 if the client's copy is
+//	current, otherwise starts sending the asset. The rest of the transfer
+//	is driven from user_asset_sent
+// Args:
+//	struct espconn *conn: Client connection
+//	const struct user_asset *asset: Asset requested, from user_asset_find
+//	const char *etag: The request's If-None-Match, empty if it had none
+// Returns:
+//	false if every transfer slot is taken or the first send failed, in
+//	which case nothing has been sent
+bool ICACHE_FLASH_ATTR user_asset_send(struct espconn *conn, const struct user_asset *asset, const char *etag);
+
+// Application Function: user_asset_sent(struct espconn *conn)
+// Desc: Sends the next chunk of a running transfer. Called from the server's
+//	sent callback. If the send fails the connection is disconnected
+// Args:
+//	struct espconn *conn: Connection which finished sending
+// Returns:
+//	true if conn belongs to an asset transfer and it goes on, false once
+//	the last of it has been sent
+bool ICACHE_FLASH_ATTR user_asset_sent(struct espconn *conn);
+
+// Application Function: user_asset_close(struct espconn *conn)
+// Desc: Abandons the transfer of a closed connection, if it had one
+// Args:
+//	struct espconn *conn: Connection which closed
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_asset_close(struct espconn *conn);
+
+#endif
@@ -13,6 +13,9 @@
 #include <spi_flash.h>
 #include "user_task.h"
 #include "user_flash.h"
+#include "user_http.h"
+#include "user_kv.h"
+#include "user_heap.h"
 
 // Port definitions
 #define HTTP_PORT       80
@@ -13,6 +13,13 @@
 #include "user_task.h"
 #include "user_humidity.h"
 #include "user_fan.h"
+#include "user_ws.h"
+#include "user_telemetry.h"
+#include "user_history.h"
+#include "user_asset.h"
+#include "user_http.h"
+#include "user_api.h"
+#include "user_heap.h"
 
 // Port definitions
 #define UDP_DISCOVERY_PORT 5000
@@ -21,7 +28,10 @@
 // IP Macros
 #define IP_OCTET(ip, oct) (ip >> (8 * oct)) % 256
 
-#define WS_UPDATE_TIME 1500      // Update interval for the WebSocket in milliseconds
+#define WS_UPDATE_TIME 250       // Update interval for the WebSocket in milliseconds
+#define WS_CLIENT_N 4            // Maximum number of open WebSockets
+#define WS_HEAP_N 20             // Updates between heap status frames
+#define WS_PROF_MAX 1460         // Largest "prof" command reply, one TCP segment
 
 /* ------------------- */
 /* Function prototypes */
@@ -49,7 +59,8 @@ void ICACHE_FLASH_ATTR user_front_connect_cb(void *arg);
 void ICACHE_FLASH_ATTR user_front_recon_cb(void *arg, sint8 err);
 
 // Callback Function: user_front_discon_cb(void *arg)
-// Desc: Disconnect callback. Called when a disconnection occurs
+// Desc: Disconnect callback. Called when a disconnection occurs. Frees the
+//      client's websocket session, if it had one
 // Args:
 //      void *arg: pointer to the espconn which called this function
 void ICACHE_FLASH_ATTR user_front_discon_cb(void *arg);
@@ -69,7 +80,8 @@ void ICACHE_FLASH_ATTR user_front_recv_cb(void *arg, char *pusrdata, unsigned sh
 void ICACHE_FLASH_ATTR user_front_sent_cb(void *arg);
 
 // Callback Function: user_ws_recv_cb(void *arg, char *pusrdata, unsigned short length)
-// Desc: Data receipt callback for the WebSocket connection.
+// Desc: Data receipt callback for the WebSocket connection. Feeds the session's
+//      frame parser, answers pings and closes, and passes messages to user_ws_parse_data
 // Args:
 //      void *arg: pointer to the espconn which called this function
 //      char *pusrdata: received client data
@@ -77,9 +89,12 @@ void ICACHE_FLASH_ATTR user_front_sent_cb(void *arg);
 void ICACHE_FLASH_ATTR user_ws_recv_cb(void *arg, char *pusrdata, unsigned short length);
 
 // Callback Function: user_ws_update(void *parg)
-// Desc: Timer function which periodically sends updated information to the websocket
+// Desc: Timer function which periodically sends updated information to every
+//      open websocket. Runs while at least one websocket is open. Every WS_HEAP_N
+//      updates a text frame of the heap counters takes the place of the telemetry,
+//      {"heap":{"live":..,"peak":..,"allocs":..,"frees":..,"failed":..,"free":..}}
 // Args:
-//      void *parg: Pointer to espconn containing the websocket
+//      void *parg: Unused
 void ICACHE_FLASH_ATTR user_ws_update(void *parg);
 
 // Application Function: user_endian_flip(uint8 *buf, uint8 n)
@@ -90,17 +105,11 @@ void ICACHE_FLASH_ATTR user_ws_update(void *parg);
 void ICACHE_FLASH_ATTR user_endian_flip(uint8 *buf, uint8 n);
 
 // Application Function: user_ws_parse_data(uint8 *data, uint16 len)
-// Desc: Parses data received from the WebSocket and takes action accordingly
+// Desc: Parses data received from the WebSocket and takes action accordingly.
+//	Fan commands are handled by user_fan_command
 // Args:
 //	uint8 *data: Received data
 //	uint16 len:  Length of data
 void ICACHE_FLASH_ATTR user_ws_parse_data(uint8 *data, uint16 len);
 
-// Application Function: uint32 user_atoi(uint8 *str, uint16 len)
-// Desc: Converts an ASCII string to an integer
-// Args:
-//	uint8 *str:	String to be converted
-//	uint16 len:	Length of string
-uint32 ICACHE_FLASH_ATTR user_atoi(uint8 *str, uint16 len);
-
 #endif /* USER_CONNECT_H */
@@ -13,12 +13,15 @@
 #include "user_humidity.h"
 #include "user_task.h"
 #include "user_connect.h"
+#include "user_kv.h"
+#include "user_link.h"
+#include "user_ring.h"
 
 // Constants (ports, timing, etc)
 #define BROADCAST_PORT 5000
 #define ESP_CONNECT_PORT 6000
-#define EXT_PACKET_SIZE 4	// Size of data contained within a packet from the exterior system
 #define EXT_WAIT_TIME 60000	// Maximum wait time (in ms) for discovery of the exterior system before fallback to config mode
+#define EXT_SAMPLE_N 32		// Exterior sample queue length (power of 2). Holds two full frames
 
 // User Task: user_broadcast_init(os_event_t *e)
 // Desc: Initializes the UDP broadcast connection for discovery of the
@@ -55,7 +58,8 @@ void ICACHE_FLASH_ATTR user_espconnect_init(os_event_t *e);
 // static void ICACHE_FLASH_ATTR user_espconnect_connect_cb(void *arg);
 
 // Callback Function: user_espconnect_recv_cb(void *arg, char *pusrdata, unsigned short length)
-// Desc: Called when humidity data is received from the exterior system
+// Desc: Called when data is received from the exterior system. Feeds the link
+//	decoder, which hands each complete frame on (see user_link.h)
 // Args:
 //      void *arg: Pointer to espconn
 //      char *pusrdata: Received data
@@ -89,6 +93,15 @@ void ICACHE_FLASH_ATTR user_espconnect_init(os_event_t *e);
 //	Nothing
 // static void ICACHE_FLASH_ATTR user_espconnect_discon_cb(void *arg);
 
+// Application Function: user_ext_update(void)
+// Desc: Takes the exterior samples queued since the last call and stores
+//	their mean as the exterior humidity. Leaves it as it was if none arrived
+// Args:
+//	None
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_ext_update(void);
+
 // Callback Function: user_ext_timeout(void)
 // Desc: Called when the exterior connection wait timer
 //	runs out. Cleans up discovery connections.
@@ -11,19 +11,31 @@
 #include <gpio.h>
 #include <eagle_soc.h>
 #include "user_task.h"
+#include "user_kv.h"
+#include "user_prof.h"
 
 // Fan supply definitions
 #define TRIAC_PULSE_PERIOD	100			// Pulse length in us for driving the triac
 #define FAN_RPM_MAX		3100			// Exhaust fan maximum RPM
 #define FAN_RPM_MIN		500			// Exhaust fan maximum RPM
-#define SUPPLY_PERIOD 		16667 			// Fan supply period in us
-#define SUPPLY_HALF_CYCLE	SUPPLY_PERIOD / 2	// Fan supply half cycle period
-
-// Macros to calculate TRIAC delay
-#define CALC_DELAY(X)		X //((-0.01541*(X)*(X)*(X)) + (0.02207*(X)*(X)) - (0.01175*(X)) + 0.006587)
-#define SPEED_DELAY(X)		X //CALC_DELAY((X)/FAN_RPM_MAX) > 150 ? CALC_DELAY((X)/FAN_RPM_MAX) : 150	// Minimum delay of 150 u
-#define DELAY_BOUNDL		2300
-#define DELAY_BOUNDH		5300
+#define SUPPLY_PERIOD_NOM	16667			// Nominal fan supply period in us (60 Hz)
+#define SUPPLY_HALF_NOM		(SUPPLY_PERIOD_NOM / 2)	// Nominal fan supply half cycle period
+#define SUPPLY_HALF_CYCLE	((sint32)supply_half_cycle)	// Measured fan supply half cycle period
+
+// Supply tracking. The ZCD ISR timestamps every zero crossing and filters the interval
+// between them into supply_half_cycle, which stays at SUPPLY_HALF_NOM until ZCD_LOCK_N
+// intervals in a row fall inside the accepted range. ZCD edges closer together than
+// SUPPLY_HALF_MIN are noise and are ignored
+#define SUPPLY_HALF_MIN		7500	// Shortest accepted half cycle in us (66.7 Hz)
+#define SUPPLY_HALF_MAX		11000	// Longest accepted half cycle in us (45.5 Hz)
+#define SUPPLY_HALF_50HZ	9091	// Half cycles longer than this are on a 50 Hz grid (55 Hz)
+#define ZCD_LOCK_N		8	// Valid intervals in a row before the measurement is used
+#define ZCD_FILTER_SHIFT	4	// Running estimate moves 1/2^ZCD_FILTER_SHIFT towards each interval
+
+// Triac delay limits in us, as a fraction of the half cycle (2300/5300 us at 60 Hz).
+// Speed to delay conversion is done by the controller in user_pid.h
+#define DELAY_BOUNDL		(SUPPLY_HALF_CYCLE * 276 / 1000)
+#define DELAY_BOUNDH		(SUPPLY_HALF_CYCLE * 636 / 1000)
 
 // Fan/ZCD GPIO definitions - DO NOT CHANGE THESE
 #define TRIAC_PIN	12	// GPIO pin connected to the fan triac
@@ -39,20 +51,28 @@
 #define TACH_MUX	PERIPHS_IO_MUX_MTMS_U
 #define TACH_FUNC	FUNC_GPIO14
 
-// Tachometer definitions
-#define TACH_PERIOD 2000	// Tach calculaiton period in ms
+// Tachometer definitions. The ISR timestamps every tach edge and queues the time since the
+// previous edge; user_tach_calc drains the queue every TACH_PERIOD and takes the speed from
+// the median of the last TACH_MEDIAN_N pulse periods
+#define TACH_PERIOD 100		// Tach calculaiton period in ms
 #define TACH_BLADE_N 7 		// Number of fan blades with reflective tape (# of pulses per revolution)
-#define DEBOUNCE_TIME 100	// Debouncing period in us
-#define FEEDBACK_GAIN 0.4f	// The RPM error is multiplied by this to arrive at the triac delay adjustment
+#define DEBOUNCE_TIME 500	// Debouncing period in us
+#define TACH_RING_N 128		// Edge interval queue length (power of 2). Holds > 1 TACH_PERIOD at FAN_RPM_MAX
+#define TACH_MEDIAN_N 5		// Number of pulse periods in the median filter
+#define TACH_TIMEOUT 200000	// Fan is considered stopped after this long without an edge, in us
+#define TACH_PRINT_N 10		// Speed is printed every TACH_PRINT_N tach periods
 
 // Fan driving variables
 extern volatile bool drive_flag;		  // Flag to indicate if fan should be driven
 extern volatile sint32 desired_delay; // Desired TRIAC delay in us
+extern volatile sint32 drive_delay;   // TRIAC delay currently driven in us
 extern volatile sint32 desired_rpm;		// Desired RPM of the fan
 extern volatile sint32 measured_rpm;	// Measured RPM of the fan
 extern volatile bool fan_on;			    // Toggles whether the fan is able to be driven
 extern volatile uint8 fan_mode;      // Operational mode of the fan
 extern volatile uint8 control_mode;  // Mode with which to control fan speed
+extern volatile uint32 supply_half_cycle;	// Measured supply half cycle in us
+extern volatile uint8 supply_hz;		// Detected supply frequency (50 or 60), 0 until locked
 
 typedef enum {
   FAN_LOCK_OFF = 0,      // Fan is locked off (will not run)
@@ -66,6 +86,22 @@ typedef enum {
   CONTROL_DELAY = 1,    // Fan is controlled by manually setting a TRIAC delay
 } CONTROL_MODE;
 
+// Names of FAN_MODE and CONTROL_MODE values, indexed by value, shared by the
+// WebSocket commands and the JSON API
+#define FAN_MODE_N	4
+#define CONTROL_MODE_N	2
+extern const char *fan_mode_names[FAN_MODE_N];
+extern const char *control_mode_names[CONTROL_MODE_N];
+
+// Fan settings, staged while a command or request is checked so that it is
+// applied whole or not at all
+struct user_fan_settings {
+	uint32 speed;		// Desired RPM
+	uint32 delay;		// Desired TRIAC delay in us
+	uint8 control;		// CONTROL_MODE
+	uint8 mode;		// FAN_MODE
+};
+
 // Timers
 os_timer_t tach_t;	// Tachometer calculation timer
 
@@ -76,12 +112,15 @@ typedef enum {
 } FRC1_TIMER_SOURCE_TYPE;
 
 void hw_timer_arm (u32 val);
+void hw_timer_arm_pulse(u32 delay, u32 width);
 void ICACHE_FLASH_ATTR hw_timer_set_func(void (* user_hw_timer_cb_set)(void));
+void ICACHE_FLASH_ATTR hw_timer_set_pulse_func(void (* rise_cb)(void), void (* fall_cb)(void));
 void ICACHE_FLASH_ATTR hw_timer_init(FRC1_TIMER_SOURCE_TYPE source_type, u8 req);
 /* ---------------------------------- */
 
 // Interrupt Service Routine: user_gpio_isr(uint32 intr_mask, void *arg)
-// Desc: ISR called when a GPIO interrupt happens
+// Desc: ISR called when a GPIO interrupt happens. Zero crossings update
+//	the supply period estimate and start the triac pulse sequence
 // Args:
 //	uint32 intr_mask: Interrupt flag mask
 //	void *arg:	Arguments
@@ -90,21 +129,64 @@ void ICACHE_FLASH_ATTR hw_timer_init(FRC1_TIMER_SOURCE_TYPE source_type, u8 req)
 void user_gpio_isr(uint32 intr_mask, void *arg);
 
 // Callback Function: user_fire_triac(void)
-// Desc: Timer callback which fires the triac after
-//	the timer delay
+// Desc: Timer callback which raises the triac gate on the leading
+//	edge of the hw_timer pulse sequence, after the drive delay
 // Args:
 //	Nothing
 // Returns:
 //	Nothing
 void user_fire_triac(void);
 
+// Callback Function: user_release_triac(void)
+// Desc: Timer callback which drops the triac gate on the trailing
+//	edge of the hw_timer pulse sequence, TRIAC_PULSE_PERIOD after
+//	it was raised
+// Args:
+//	Nothing
+// Returns:
+//	Nothing
+void user_release_triac(void);
+
 // Callback Function: user_tach_calc
-// Desc: Calculates the current fan RPM based on the number of
-//	tachometer pulses
+// Desc: Calculates the current fan RPM from the tachometer edge
+//	intervals queued by the ISR, then updates the triac delay
+//	from the speed controller
 // Args:
 //	Nothing
 // Returns:
 //	Nothing
 void ICACHE_FLASH_ATTR user_tach_calc(void);
 
+// Application Function: user_fan_stage(struct user_fan_settings *set)
+// Desc: Stages the current settings, so that anything a command leaves out
+//	keeps its value
+// Args:
+//	struct user_fan_settings *set: Staged settings
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_fan_stage(struct user_fan_settings *set);
+
+// Application Function: user_fan_apply(struct user_fan_settings *set)
+// Desc: Checks staged settings and applies them. Speed and delay are clamped
+//	to range, an unknown fan or control mode refuses the lot
+// Args:
+//	struct user_fan_settings *set: Staged settings, left clamped
+// Returns:
+//	false if the settings were refused
+bool ICACHE_FLASH_ATTR user_fan_apply(struct user_fan_settings *set);
+
+// Application Function: user_fan_command(const char *data, uint16 len)
+// Desc: Applies a fan command, comma separated pairs of speed=<rpm>,
+//	delay=<us> and mode=<lock_off|normal|lock_on|override>, read in one
+//	pass. Speed and delay select the control mode and are clamped to range
+//	by user_fan_apply, as the front page expects. The command is applied
+//	whole or not at all: an unknown key, a bad number or an unknown mode
+//	changes nothing
+// Args:
+//	const char *data: Command
+//	uint16 len: Length of data
+// Returns:
+//	false if the command was refused
+bool ICACHE_FLASH_ATTR user_fan_command(const char *data, uint16 len);
+
 #endif
@@ -0,0 +1,63 @@
+// user_heap.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Counting wrappers for the SDK heap calls. Every block gets a
+//	small header holding its size, so a free can be taken off the live total
+//	without asking the SDK. Firmware code allocates through these instead of
+//	os_malloc/os_zalloc/os_free, so the counts cover everything but the SDK's
+//	own allocations (espconn_send buffers, etc), which only show up in the
+//	free heap figure. This file is shared by the interior, exterior and wlan
+//	builds.
+
+#ifndef _USER_HEAP_H
+#define _USER_HEAP_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include <mem.h>
+
+#define HEAP_HEADER		8	// Block header, keeps the caller's block 8 byte aligned
+#define HEAP_REPORT_TIME	60000	// Period of the heap debug line (ms), where one is printed
+
+// Heap counters
+struct user_heap_stats {
+	uint32 live;		// Bytes held by the firmware, headers included
+	uint32 peak;		// Highest live
+	uint32 allocs;		// Allocations made
+	uint32 frees;		// Blocks freed
+	uint32 failed;		// Allocations the SDK refused
+	uint32 free_heap;	// system_get_free_heap_size() when the counters were read
+};
+
+// Application Function: user_heap_malloc(uint32 size)
+// Desc: os_malloc, counted
+// Args:
+//	uint32 size: Bytes wanted
+// Returns:
+//	The block, or NULL if the heap could not supply it
+void * ICACHE_FLASH_ATTR user_heap_malloc(uint32 size);
+
+// Application Function: user_heap_zalloc(uint32 size)
+// Desc: os_zalloc, counted
+// Args:
+//	uint32 size: Bytes wanted
+// Returns:
+//	The zeroed block, or NULL if the heap could not supply it
+void * ICACHE_FLASH_ATTR user_heap_zalloc(uint32 size);
+
+// Application Function: user_heap_free(void *p)
+// Desc: os_free, counted. p must come from user_heap_malloc or user_heap_zalloc
+// Args:
+//	void *p: Block, or NULL
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_heap_free(void *p);
+
+// Application Function: user_heap_stats(struct user_heap_stats *s)
+// Desc: Reads the counters and the SDK's free heap size
+// Args:
+//	struct user_heap_stats *s: Filled with the counters
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_heap_stats(struct user_heap_stats *s);
+
+#endif
@@ -0,0 +1,95 @@
+// user_history.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Telemetry history. The readings of HIST_TICK_N humidity read
+//	ticks are averaged into one sample in a fixed RAM ring, and GET /history
+//	streams the whole ring to a browser as one chunked HTTP transfer, oldest
+//	sample first, so the page can fill its plot as soon as it connects.
+//
+//	The body is a header followed by samples, all little endian:
+//	Byte 0-1:   HIST_VERSION
+//	Byte 2-3:   Sample size in bytes (sizeof(struct user_hist_sample))
+//	Byte 4-7:   Uptime when the transfer began, seconds
+//	Byte 8-:    Samples
+//
+//	GET /log streams the flash log (see user_log.h) the same way and in the
+//	same layout, oldest record first. Its times count from the boot each
+//	record was written in, and each restart is marked by a sample with time
+//	LOG_BOOT_TIME and the other fields 0. The records after the last marker
+//	belong to the current boot, so they line up with the uptime in the header
+
+#ifndef _USER_HISTORY_H
+#define _USER_HISTORY_H
+
+#include <user_interface.h>
+#include <espconn.h>
+#include <osapi.h>
+#include "user_task.h"
+#include "user_http.h"
+#include "user_telemetry.h"
+#include "user_humidity.h"
+
+#define HIST_VERSION	1
+#define HIST_PERIOD	60						// Seconds per sample
+#define HIST_TICK_N	((HIST_PERIOD * 1000) / HUMIDITY_READ_INTERVAL)	// Readings averaged per sample
+#define HIST_N		240						// Samples held, 4 hours
+#define HIST_CHUNK_N	96	// Samples per HTTP chunk, keeps each chunk inside one TCP segment
+#define LOG_BOOT_TIME	0xFFFFFFFF	// Sample time marking a restart in GET /log
+
+// History sample, 12 bytes
+struct user_hist_sample {
+	uint32 time;		// Uptime, seconds
+	uint16 hum_int;		// Interior humidity, 0.01 %RH
+	uint16 hum_ext;		// Exterior humidity, 0.01 %RH
+	uint16 rpm;		// Measured fan speed, RPM
+	uint16 delay;		// Triac drive delay, us
+};
+
+// Application Function: user_hist_record(void)
+// Desc: Adds the current readings to the running means, and every HIST_TICK_N
+//	calls records the means into the history ring, overwriting the oldest
+//	sample once the ring is full
+// Args:
+//	Nothing
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_hist_record(void);
+
+// Application Function: user_hist_send(struct espconn *conn)
+// Desc: Starts streaming the history to a client. The rest of the transfer
+//	is driven from user_hist_sent. One transfer runs at a time
+// Args:
+//	struct espconn *conn: Client connection
+// Returns:
+//	false if another transfer is already running or the first send failed,
+//	in which case nothing has been sent
+bool ICACHE_FLASH_ATTR user_hist_send(struct espconn *conn);
+
+// Application Function: user_hist_send_log(struct espconn *conn)
+// Desc: Starts streaming the flash log to a client, sharing the transfer
+//	slot with user_hist_send
+// Args:
+//	struct espconn *conn: Client connection
+// Returns:
+//	false if another transfer is already running or the first send failed,
+//	in which case nothing has been sent
+bool ICACHE_FLASH_ATTR user_hist_send_log(struct espconn *conn);
+
+// Application Function: user_hist_sent(struct espconn *conn)
+// Desc: Sends the next part of a running transfer. Called from the server's
+//	sent callback. If the send fails the connection is disconnected
+// Args:
+//	struct espconn *conn: Connection which finished sending
+// Returns:
+//	true if conn belongs to the history transfer and it goes on, false once
+//	the last of it has been sent
+bool ICACHE_FLASH_ATTR user_hist_sent(struct espconn *conn);
+
+// Application Function: user_hist_close(struct espconn *conn)
+// Desc: Abandons the transfer if conn belongs to it
+// Args:
+//	struct espconn *conn: Connection which closed
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_hist_close(struct espconn *conn);
+
+#endif
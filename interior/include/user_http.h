@@ -0,0 +1,183 @@
+// user_http.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Minimal HTTP/1.1 server shared by the front end and the captive
+//	portal. Requests are parsed incrementally, a byte at a time, so a request
+//	split over several TCP segments is put back together, and only the parts
+//	the servers use are kept: method, path, query, a few headers and a short
+//	body. A finished request is routed on method and path to a handler from
+//	the server's route table.
+//
+//	Connections are kept alive between requests. Each open connection holds
+//	a slot of a small pool, found with user_http_same_peer, and its parser
+//	starts over after every request.
+//	Requests are answered one at a time. espconn allows one send in flight,
+//	so a request which arrives while the last response is still going out
+//	waits for the server's sent callback to call user_http_sent. Requests
+//	are not pipelined: anything following a complete request in the same
+//	segment, or arriving while one waits, is dropped. Idle connections are
+//	closed by the espconn timeout.
+//
+//	A connection is closed once its response has gone if the client asked
+//	for that (Connection: close, or HTTP/1.0), if its request was bad, or if
+//	it was answered 503; user_http_respond then sends Connection: close. A
+//	client arriving with every slot taken is answered 503 from one spare
+//	slot, so it gets one answer however many segments it sends, and is
+//	closed unanswered if the spare slot is in use too.
+
+#ifndef _USER_HTTP_H
+#define _USER_HTTP_H
+
+#include <user_interface.h>
+#include <espconn.h>
+#include <osapi.h>
+#include "user_task.h"
+
+#define HTTP_CONN_N	5	// Connections parsed at once, the espconn default limit
+#define HTTP_IDLE_TIME	15	// Seconds a kept alive connection may sit idle
+#define HTTP_PATH_MAX	48	// Longest request target, query included
+#define HTTP_TOKEN_MAX	48	// Longest method, header name, or kept header value
+#define HTTP_BODY_MAX	384	// Longest request body
+#define HTTP_HEAD_MAX	2048	// Longest request line and headers together
+#define HTTP_RESP_MAX	1460	// Longest response sent by user_http_respond, one TCP segment
+
+// Methods
+#define HTTP_GET	1
+#define HTTP_POST	2
+#define HTTP_PUT	3
+#define HTTP_HEAD	4
+#define HTTP_OTHER	5
+
+// user_http_parse results, besides error status codes
+#define HTTP_MORE	0	// Request incomplete, feed the next segment
+#define HTTP_DONE	200	// Request complete
+
+// Request being parsed
+struct user_http_req {
+	uint8 state;				// Parser state
+	uint8 method;				// HTTP_GET, etc
+	bool keep_alive;			// False if the client asked to close after this request
+	bool upgrade;				// Upgrade: websocket
+	char path[HTTP_PATH_MAX + 1];		// Request target, cut at '?'
+	char *query;				// Query string in path, after the '?', or NULL
+	char etag[HTTP_TOKEN_MAX + 1];		// If-None-Match, empty if not sent
+	char ws_key[HTTP_TOKEN_MAX + 1];	// Sec-WebSocket-Key, empty if not sent
+	uint8 body[HTTP_BODY_MAX + 1];		// Body, NUL terminated
+	uint16 body_len;			// Bytes of body received
+	uint16 content_len;			// Content-Length
+
+	// Scratch
+	char tok[HTTP_TOKEN_MAX + 1];		// Token being read
+	uint8 tok_len;
+	uint8 header;				// Header whose value is being read
+	uint16 path_len;
+	uint16 head_len;			// Bytes of request line and headers so far
+};
+
+// Request handler. Sends the response, with user_http_respond or otherwise
+typedef void (*user_http_handler)(struct espconn *conn, struct user_http_req *req);
+
+// Route. Routes are tried in order and the first match wins
+struct user_http_route {
+	uint8 method;			// HTTP_GET, etc
+	const char *path;		// Exact path, or NULL to match any path
+	user_http_handler handler;
+};
+
+// Server, a route table
+struct user_http_server {
+	const char *name;		// For debug output
+	const struct user_http_route *routes;
+	uint8 route_n;
+};
+
+// Application Function: user_http_parse_init(struct user_http_req *req)
+// Desc: Readies a request for parsing
+// Args:
+//	struct user_http_req *req: Request
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_http_parse_init(struct user_http_req *req);
+
+// Application Function: user_http_parse(struct user_http_req *req, const uint8 *data, uint16 len, uint16 *used)
+// Desc: Feeds received bytes to a request. Parsing stops at the end of the
+//	request or at the first error; after an error the request must be
+//	started over with user_http_parse_init
+// Args:
+//	struct user_http_req *req: Request
+//	const uint8 *data: Received data
+//	uint16 len: Length of data
+//	uint16 *used: Set to the number of bytes consumed
+// Returns:
+//	HTTP_MORE, HTTP_DONE, or the 4xx/5xx status to answer a bad request with
+uint16 ICACHE_FLASH_ATTR user_http_parse(struct user_http_req *req, const uint8 *data, uint16 len, uint16 *used);
+
+// Application Function: user_http_same_peer(const uint8 *ip, int port, struct espconn *conn)
+// Desc: Checks if a connection is from a given client. The SDK may hand
+//	callbacks a different espconn for the same client, so per connection
+//	state (HTTP slots, WebSocket sessions, transfers) is kept by the
+//	client's address and port rather than by espconn pointer
+// Args:
+//	const uint8 *ip: Client address kept with the state
+//	int port: Client port kept with the state
+//	struct espconn *conn: Connection a callback was given
+// Returns:
+//	true if conn is from that client
+bool ICACHE_FLASH_ATTR user_http_same_peer(const uint8 *ip, int port, struct espconn *conn);
+
+// Application Function: user_http_accept(struct espconn *conn)
+// Desc: Sets up a newly connected client for keep-alive. Called from a
+//	server's connect callback
+// Args:
+//	struct espconn *conn: Client connection
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_http_accept(struct espconn *conn);
+
+// Application Function: user_http_recv(const struct user_http_server *server, struct espconn *conn, char *data, unsigned short len)
+// Desc: Parses received data and calls the handler of a complete request,
+//	or answers a request which could not be parsed or routed. Called from
+//	a server's receive callback
+// Args:
+//	const struct user_http_server *server: Server the data arrived at
+//	struct espconn *conn: Client connection
+//	char *data: Received data
+//	unsigned short len: Length of data
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_http_recv(const struct user_http_server *server, struct espconn *conn, char *data, unsigned short len);
+
+// Application Function: user_http_sent(struct espconn *conn)
+// Desc: Marks the response of a connection as sent, then either closes the
+//	connection if that response was its last, or answers a request which
+//	was waiting for it. Called from a server's sent callback once the last
+//	send of a response has gone
+// Args:
+//	struct espconn *conn: Client connection
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_http_sent(struct espconn *conn);
+
+// Application Function: user_http_close(struct espconn *conn)
+// Desc: Frees the pool slot of a connection which closed, or which was handed
+//	over to another protocol (WebSocket)
+// Args:
+//	struct espconn *conn: Client connection
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_http_close(struct espconn *conn);
+
+// Application Function: user_http_respond(struct espconn *conn, uint16 status, const char *type, const char *body, uint16 len)
+// Desc: Sends a complete response with a Content-Length in one send, and
+//	Connection: close if the connection will be closed after it
+// Args:
+//	struct espconn *conn: Client connection
+//	uint16 status: HTTP status code
+//	const char *type: Content-Type, or NULL if there is no body
+//	const char *body: Body, or NULL
+//	uint16 len: Length of the body
+// Returns:
+//	false if the response did not fit in HTTP_RESP_MAX or could not be sent,
+//	in which case the connection is disconnected
+bool ICACHE_FLASH_ATTR user_http_respond(struct espconn *conn, uint16 status, const char *type, const char *body, uint16 len);
+
+#endif
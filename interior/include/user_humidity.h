@@ -19,21 +19,69 @@
 // Humidity data read interval in ms
 #define HUMIDITY_READ_INTERVAL 3000
 
+// Measurement cycle timing in ms. The average HIH8121 measurement cycle takes 36.65ms,
+// so the data is first fetched after HUMIDITY_CONVERSION_TIME. If the sensor still
+// reports stale data, the fetch is retried every HUMIDITY_RETRY_TIME, up to HUMIDITY_RETRY_MAX times
+#define HUMIDITY_CONVERSION_TIME 40
+#define HUMIDITY_RETRY_TIME 10
+#define HUMIDITY_RETRY_MAX 6
+
+// HIH8121 status codes, reported in the upper two bits of the first data byte
+#define HUMIDITY_STATUS_VALID	0	// Valid data which has not yet been fetched
+#define HUMIDITY_STATUS_STALE	1	// Data has already been fetched/a measurement is in progress
+#define HUMIDITY_STATUS_CMD	2	// Sensor is in command mode
+#define HUMIDITY_STATUS_DIAG	3	// Sensor is in a diagnostic condition
+
+// Sensor status bits (sensor_status)
+#define SENSOR_INT_OK	0x01	// Last interior reading succeeded
+#define SENSOR_INT_FAIL	0x02	// Interior sensor did not respond or never finished converting
+#define SENSOR_INT_DIAG	0x04	// Interior sensor reported command or diagnostic mode
+#define SENSOR_EXT_OK	0x08	// Exterior system is connected and reporting
+
+// Humidity acquisition states. A reading is split into two phases so that the CPU
+// is never blocked while the sensor converts: a measurement request, then a data
+// fetch from a timer callback once the measurement cycle has completed
+typedef enum {
+  HUMIDITY_IDLE       = 0,      // No measurement in progress
+  HUMIDITY_CONVERTING = 1,      // Measurement requested, waiting to fetch the data
+} HUMIDITY_STATE;
+
 // Humidity data storage.
 extern float sensor_data_int;         // Interior humidity
 extern float sensor_data_ext;	      // Exterior humidity
 extern float threshold_humidity;      // The system will not try to reduce the humidity below this
+extern uint8 sensor_status;           // SENSOR_* bits
 
 // Function Prototypyes:
 
 // Callback Function: user_read_humidity()
-// Desc: Gets a single humidity reading from the humidity sensor via I2C.
+// Desc: Begins a single humidity reading from the humidity sensor via I2C. A
+//	measurement request is sent, and the result is fetched by a timer
+//	callback once the sensor has completed its measurement cycle.
 // Args:
 //	None
 // Returns:
 //	Nothing
 void ICACHE_FLASH_ATTR user_read_humidity(void);
 
+// Callback Function: user_fetch_humidity()
+// Desc: Fetches the result of a measurement started by user_read_humidity(),
+//	stores it and compares the interior/exterior humidities. Re-arms itself
+//	if the sensor has not yet completed the measurement.
+// Args:
+//	None
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_fetch_humidity(void);
+
+// Application Function: user_humidity_convert(uint16 count)
+// Desc: Converts a 14-bit humidity count from the sensor into %RH
+// Args:
+//	uint16 count: Humidity count read from the sensor
+// Returns:
+//	The relative humidity in %RH
+float ICACHE_FLASH_ATTR user_humidity_convert(uint16 count);
+
 // Application Function: user_humidity_cmp(void)
 // Desc: Compares the interior and exterior humidities,
 //	then drives the fan accordingly
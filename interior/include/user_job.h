@@ -0,0 +1,47 @@
+// user_job.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Work queue for the priority 1 task slot. The SDK allows one
+//	task per priority and system_os_task replaces whatever was registered
+//	before, so rather than registering each job as the task, a single job
+//	task is registered once and runs queued jobs in order, one per task
+//	event. Jobs are posted with TASK_START (see user_task.h).
+
+#ifndef _USER_JOB_H
+#define _USER_JOB_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_task.h"
+
+#define JOB_POOL_N	8	// Number of jobs which can be queued at once
+
+// Queued job. The function is called with an event holding sig/par, so any
+// function written as a task can be run as a job
+struct user_job {
+	os_task_t func;		// Job function
+	os_signal_t sig;	// Signal passed to the job
+	os_param_t par;		// Parameter passed to the job
+};
+
+extern uint32 user_job_dropped;		// Jobs rejected because the queue was full
+
+// Application Function: user_job_init(void)
+// Desc: Registers the job task at USER_TASK_PRIO_1 on user_msg_queue_1.
+//	Must be called once, after the message queues are allocated
+// Args:
+//	Nothing
+// Returns:
+//	true on success
+bool ICACHE_FLASH_ATTR user_job_init(void);
+
+// Application Function: user_job_post(os_task_t func, os_signal_t sig, os_param_t par)
+// Desc: Queues a job behind any already waiting. Must not be called from an ISR
+// Args:
+//	os_task_t func: Job function
+//	os_signal_t sig: Signal passed to the job
+//	os_param_t par: Parameter passed to the job
+// Returns:
+//	true if queued, false if the queue was full and the job was dropped
+bool ICACHE_FLASH_ATTR user_job_post(os_task_t func, os_signal_t sig, os_param_t par);
+
+#endif
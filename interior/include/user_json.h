@@ -0,0 +1,165 @@
+// user_json.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: JSON without a heap. The writer appends members straight into a
+//	caller's buffer, tracking commas per nesting level, and notes overflow
+//	instead of writing past the end. The tokenizer walks a document in place
+//	and hands back one token at a time, strings as pointers into the input
+//	and numbers as fixed point, so a handler can check and apply members as
+//	it reads them without building a tree.
+//
+//	Numbers are kept in thousandths (JSON_SCALE), which covers every setting
+//	the controller has. Exponents and magnitudes beyond JSON_NUM_MAX are
+//	rejected. String escapes are passed through undecoded.
+
+#ifndef _USER_JSON_H
+#define _USER_JSON_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_task.h"
+
+#define JSON_DEPTH_MAX	8		// Deepest nesting the writer tracks
+#define JSON_SCALE	1000		// Token numbers are in 1/JSON_SCALE units
+#define JSON_NUM_MAX	2000000		// Largest magnitude a token number may have
+
+// Token types
+typedef enum {
+	JSON_END = 0,		// End of input
+	JSON_ERROR,		// Malformed input
+	JSON_OBJ_BEGIN,
+	JSON_OBJ_END,
+	JSON_ARR_BEGIN,
+	JSON_ARR_END,
+	JSON_COLON,
+	JSON_COMMA,
+	JSON_STRING,
+	JSON_NUMBER,
+	JSON_TRUE,
+	JSON_FALSE,
+	JSON_NULL,
+} JSON_TOKEN;
+
+// Writer
+struct user_json_writer {
+	char *buf;		// Output
+	uint16 size;		// Size of buf
+	uint16 len;		// Characters written, not counting the NUL
+	uint8 depth;		// Open objects and arrays
+	uint8 first;		// Bit n set while level n has no members yet
+	bool overflow;		// Set if anything did not fit
+};
+
+// Tokenizer
+struct user_json_lexer {
+	const char *p;		// Next character
+	const char *end;	// End of input
+};
+
+// Token
+struct user_json_token {
+	uint8 type;		// JSON_*
+	const char *str;	// JSON_STRING: contents, not terminated
+	uint16 len;		// JSON_STRING: length of the contents
+	sint32 num;		// JSON_NUMBER: value in 1/JSON_SCALE units
+	bool integer;		// JSON_NUMBER: true if the number had no fraction
+};
+
+// Application Function: user_json_init(struct user_json_writer *w, char *buf, uint16 size)
+// Desc: Starts writing a document into a buffer
+// Args:
+//	struct user_json_writer *w: Writer
+//	char *buf: Output buffer
+//	uint16 size: Size of buf
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_json_init(struct user_json_writer *w, char *buf, uint16 size);
+
+// Application Function: user_json_open(struct user_json_writer *w, const char *key, char bracket)
+// Desc: Opens an object ('{') or array ('[')
+// Args:
+//	struct user_json_writer *w: Writer
+//	const char *key: Member name, or NULL at the top level or in an array
+//	char bracket: '{' or '['
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_json_open(struct user_json_writer *w, const char *key, char bracket);
+
+// Application Function: user_json_close(struct user_json_writer *w, char bracket)
+// Desc: Closes the innermost object ('}') or array (']')
+// Args:
+//	struct user_json_writer *w: Writer
+//	char bracket: '}' or ']'
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_json_close(struct user_json_writer *w, char bracket);
+
+// Application Function: user_json_int(struct user_json_writer *w, const char *key, sint32 val)
+// Desc: Writes an integer member
+// Args:
+//	struct user_json_writer *w: Writer
+//	const char *key: Member name, or NULL in an array
+//	sint32 val: Value
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_json_int(struct user_json_writer *w, const char *key, sint32 val);
+
+// Application Function: user_json_fixed(struct user_json_writer *w, const char *key, sint32 val, uint8 places)
+// Desc: Writes a fixed point member, as os_sprintf has no %f
+// Args:
+//	struct user_json_writer *w: Writer
+//	const char *key: Member name, or NULL in an array
+//	sint32 val: Value in 10^-places units
+//	uint8 places: Decimal places, 1 to 6
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_json_fixed(struct user_json_writer *w, const char *key, sint32 val, uint8 places);
+
+// Application Function: user_json_str(struct user_json_writer *w, const char *key, const char *val)
+// Desc: Writes a string member, escaping quotes, backslashes and control characters
+// Args:
+//	struct user_json_writer *w: Writer
+//	const char *key: Member name, or NULL in an array
+//	const char *val: Value
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_json_str(struct user_json_writer *w, const char *key, const char *val);
+
+// Application Function: user_json_bool(struct user_json_writer *w, const char *key, bool val)
+// Desc: Writes a boolean member
+// Args:
+//	struct user_json_writer *w: Writer
+//	const char *key: Member name, or NULL in an array
+//	bool val: Value
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_json_bool(struct user_json_writer *w, const char *key, bool val);
+
+// Application Function: user_json_lexer_init(struct user_json_lexer *lx, const char *data, uint16 len)
+// Desc: Starts tokenizing a document
+// Args:
+//	struct user_json_lexer *lx: Tokenizer
+//	const char *data: Document
+//	uint16 len: Length of data
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_json_lexer_init(struct user_json_lexer *lx, const char *data, uint16 len);
+
+// Application Function: user_json_next(struct user_json_lexer *lx, struct user_json_token *t)
+// Desc: Reads the next token
+// Args:
+//	struct user_json_lexer *lx: Tokenizer
+//	struct user_json_token *t: Filled with the token
+// Returns:
+//	The token type, JSON_END at the end of the input
+uint8 ICACHE_FLASH_ATTR user_json_next(struct user_json_lexer *lx, struct user_json_token *t);
+
+// Application Function: user_json_eq(const struct user_json_token *t, const char *s)
+// Desc: Compares a string token with a string
+// Args:
+//	const struct user_json_token *t: Token
+//	const char *s: String
+// Returns:
+//	true if t is a JSON_STRING holding exactly s
+bool ICACHE_FLASH_ATTR user_json_eq(const struct user_json_token *t, const char *s);
+
+#endif
@@ -0,0 +1,83 @@
+// user_kv.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Single pass key=value tokenizer for the short text messages the
+//	system exchanges: WebSocket commands (speed=2000,mode=normal), discovery
+//	packets (key=...&ip=a.b.c.d) and captive portal forms (ssid=...&pass=...).
+//	Each call hands back the next pair as pointers into the message, so the
+//	caller can switch on the key and check the value without another scan.
+//	Messages need not be NUL terminated.
+
+#ifndef _USER_KV_H
+#define _USER_KV_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_task.h"
+
+// Pair
+struct user_kv {
+	const char *key;	// Key, not terminated
+	uint16 key_len;
+	const char *val;	// Value, not terminated; empty if there was no '='
+	uint16 val_len;
+};
+
+// Tokenizer
+struct user_kv_lexer {
+	const char *p;		// Next character
+	const char *end;	// End of the message
+	char sep;		// Pair separator, ',' or '&'
+};
+
+// Application Function: user_kv_init(struct user_kv_lexer *lx, const char *data, uint16 len, char sep)
+// Desc: Starts tokenizing a message. A NUL ends the message early
+// Args:
+//	struct user_kv_lexer *lx: Tokenizer
+//	const char *data: Message
+//	uint16 len: Length of data
+//	char sep: Pair separator
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_kv_init(struct user_kv_lexer *lx, const char *data, uint16 len, char sep);
+
+// Application Function: user_kv_next(struct user_kv_lexer *lx, struct user_kv *kv)
+// Desc: Reads the next pair. Empty pairs (",,") are skipped
+// Args:
+//	struct user_kv_lexer *lx: Tokenizer
+//	struct user_kv *kv: Filled with the pair
+// Returns:
+//	false at the end of the message
+bool ICACHE_FLASH_ATTR user_kv_next(struct user_kv_lexer *lx, struct user_kv *kv);
+
+// Application Function: user_kv_is(const char *s, uint16 len, const char *str)
+// Desc: Compares a key or value with a string
+// Args:
+//	const char *s: Key or value
+//	uint16 len: Length of s
+//	const char *str: String
+// Returns:
+//	true if they are equal
+bool ICACHE_FLASH_ATTR user_kv_is(const char *s, uint16 len, const char *str);
+
+// Application Function: user_kv_uint(const char *s, uint16 len, uint32 max, uint32 *out)
+// Desc: Converts a decimal value, rejecting anything but digits
+// Args:
+//	const char *s: Value
+//	uint16 len: Length of s
+//	uint32 max: Largest value accepted
+//	uint32 *out: Set to the value
+// Returns:
+//	false if s is empty, not a number, or above max
+bool ICACHE_FLASH_ATTR user_kv_uint(const char *s, uint16 len, uint32 max, uint32 *out);
+
+// Application Function: user_kv_ip(const char *s, uint16 len, uint8 *ip)
+// Desc: Converts a dotted IPv4 address
+// Args:
+//	const char *s: Value
+//	uint16 len: Length of s
+//	uint8 *ip: Set to the four octets
+// Returns:
+//	false if s is not an address
+bool ICACHE_FLASH_ATTR user_kv_ip(const char *s, uint16 len, uint8 *ip);
+
+#endif
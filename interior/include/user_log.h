@@ -0,0 +1,133 @@
+// user_log.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Flash backed humidity log. Once a LOG_PERIOD the mean of the
+//	readings taken over the period is packed into an 8 byte record and
+//	appended to the user data sectors after the station config. Sectors are
+//	used in turn, each opened with a numbered header, and once every sector
+//	is in use the oldest is erased to make room, so the log holds the last
+//	few days and wear is spread evenly over the sectors.
+//
+//	Sector layout:
+//	Byte 0-15:   struct user_log_header
+//	Byte 16-:    LOG_REC_N records, written in order. An erased record reads
+//	             back as all ones, so the used records are always a prefix
+//
+//	Record layout (two little endian words):
+//	w0 bit 0-9:    Interior humidity, 0.1 %RH
+//	w0 bit 10-19:  Exterior humidity, 0.1 %RH
+//	w0 bit 20-29:  Fan speed, 4 RPM
+//	w0 bit 30-31:  Record type (LOG_REC_*)
+//	w1 bit 0-9:    Triac drive delay, 16 us
+//	w1 bit 10-23:  Periods since the time base (see user_log_next)
+//	w1 bit 24-31:  CRC-8 of the other 56 bits
+//
+//	After a reboot the newest sector is found by a binary search over the
+//	sector headers, and the end of its records by a binary search over the
+//	record slots. Logging continues in that sector after a boot record.
+
+#ifndef _USER_LOG_H
+#define _USER_LOG_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_task.h"
+#include "user_flash.h"
+#include "user_humidity.h"
+
+#define LOG_SECT_SIZE	(4 * 1024)
+#define LOG_START_SECT	(USER_DATA_START_SECT + 1)			// The first sector holds the station config
+#define LOG_SECT_N	(USER_DATA_END_SECT - LOG_START_SECT)		// 15 sectors
+#define LOG_MAGIC	0x474F4C48					// "HLOG"
+#define LOG_PERIOD	60						// Seconds per record
+#define LOG_TICK_N	((LOG_PERIOD * 1000) / HUMIDITY_READ_INTERVAL)	// Readings averaged per record
+
+// Record types
+#define LOG_REC_DATA	0	// Averaged readings
+#define LOG_REC_BOOT	1	// The system restarted; times after this count from the new boot
+
+// Sector header
+struct user_log_header {
+	uint32 magic;		// LOG_MAGIC
+	uint32 seq;		// Sector sequence number, +1 for every sector opened, from 1
+	uint32 start;		// Periods since boot when the sector was opened
+	uint32 crc;		// CRC-32 of the fields above
+};
+
+// Packed record
+struct user_log_rec {
+	uint32 w0;
+	uint32 w1;
+};
+
+#define LOG_REC_N	((LOG_SECT_SIZE - sizeof(struct user_log_header)) / sizeof(struct user_log_rec))
+
+// Read position in the log, see user_log_next
+struct user_log_cursor {
+	uint32 seq;		// Sequence number of the sector being read
+	uint16 slot;		// Next slot in it
+	uint16 used;		// Used slots in it, if it is not the newest
+	uint32 base;		// Time base of its records, in periods
+};
+
+// Decoded record
+struct user_log_entry {
+	uint8 type;		// LOG_REC_*
+	uint32 time;		// Seconds since boot at the end of the period
+	uint16 hum_int;		// Interior humidity, 0.1 %RH
+	uint16 hum_ext;		// Exterior humidity, 0.1 %RH
+	uint16 rpm;		// Fan speed, RPM
+	uint16 delay;		// Triac drive delay, us
+};
+
+// Application Function: user_log_init(void)
+// Desc: Finds the end of the log left by the last boot and marks the restart,
+//	or starts a new log if the sectors hold none
+// Args:
+//	Nothing
+// Returns:
+//	false if the flash could not be written, in which case nothing is logged
+bool ICACHE_FLASH_ATTR user_log_init(void);
+
+// Application Function: user_log_tick(float hum_int, float hum_ext, sint32 rpm, sint32 delay)
+// Desc: Adds the current readings to the running means, appending a record
+//	every LOG_TICK_N calls. Called on every humidity read tick
+// Args:
+//	float hum_int: Interior humidity, %RH
+//	float hum_ext: Exterior humidity, %RH
+//	sint32 rpm: Measured fan speed
+//	sint32 delay: Triac drive delay, us
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_log_tick(float hum_int, float hum_ext, sint32 rpm, sint32 delay);
+
+// Application Function: user_log_append(const struct user_log_entry *e)
+// Desc: Packs and appends one record, opening the next sector if the
+//	current one is full. e->time is ignored; the record is stamped with
+//	the current period
+// Args:
+//	const struct user_log_entry *e: Record to append
+// Returns:
+//	false on a flash error
+bool ICACHE_FLASH_ATTR user_log_append(const struct user_log_entry *e);
+
+// Application Function: user_log_cursor_init(struct user_log_cursor *c)
+// Desc: Places a cursor at the oldest record in the log
+// Args:
+//	struct user_log_cursor *c: Cursor
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_log_cursor_init(struct user_log_cursor *c);
+
+// Application Function: user_log_next(struct user_log_cursor *c, struct user_log_entry *e)
+// Desc: Decodes the record at a cursor and moves it on, oldest record first.
+//	Records failing their CRC are skipped. Records may be appended between
+//	calls, and are read in turn; if the sector under the cursor is erased to
+//	make room, reading goes on from the oldest sector left
+// Args:
+//	struct user_log_cursor *c: Cursor
+//	struct user_log_entry *e: Destination for the record
+// Returns:
+//	false once there are no more records
+bool ICACHE_FLASH_ATTR user_log_next(struct user_log_cursor *c, struct user_log_entry *e);
+
+#endif
@@ -0,0 +1,63 @@
+// user_pid.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Fan speed controller. A PID loop on the RPM error trims a
+//	feed-forward triac delay looked up from a delay-to-RPM table, which is
+//	refined while the fan holds its set point.
+
+#ifndef _USER_PID_H
+#define _USER_PID_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_fan.h"
+#include "user_task.h"
+
+// Controller gains. The RPM error (measured - desired) is converted to a change in
+// triac delay in us, so a fan running too fast is slowed by a longer delay
+#define PID_KP		0.4f	// us per RPM
+#define PID_KI		0.5f	// us per RPM per second
+#define PID_KD		0.02f	// us per RPM/s, acts on the measurement to avoid set point kick
+#define PID_I_BAND	150	// The integral only accumulates while the error is within this many RPM
+
+// Feed-forward table. Entry i holds the delay which drives the fan at
+// FF_RPM_START + i * FF_RPM_STEP RPM; speeds in between are interpolated
+#define FF_RPM_START	1500
+#define FF_RPM_STEP	250
+#define FF_TABLE_N	7
+
+// Table learning. Once the fan has held within FF_LEARN_BAND RPM of its set point for a
+// whole tach period, the table is pulled FF_LEARN_RATE of the way towards the delay in use
+#define FF_LEARN_BAND	30
+#define FF_LEARN_RATE	0.25f
+
+// Application Function: user_pid_reset(void)
+// Desc: Clears the controller history. Called whenever closed loop speed control
+//	is (re)started, so the next update starts from the feed-forward delay
+// Args:
+//	Nothing
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_pid_reset(void);
+
+// Application Function: user_pid_update(sint32 desired, sint32 measured, uint32 dt)
+// Desc: Runs one controller step. The integral is only accumulated while the
+//	output is inside DELAY_BOUNDL/H or the error is driving it back inside
+//	(clamping anti-windup)
+// Args:
+//	sint32 desired: Desired fan speed in RPM
+//	sint32 measured: Measured fan speed in RPM
+//	uint32 dt: Time since the last update in ms
+// Returns:
+//	New triac delay in us, within DELAY_BOUNDL/H
+sint32 ICACHE_FLASH_ATTR user_pid_update(sint32 desired, sint32 measured, uint32 dt);
+
+// Application Function: user_ff_delay(sint32 rpm)
+// Desc: Looks up the feed-forward delay for a fan speed, scaled to the
+//	measured supply half cycle
+// Args:
+//	sint32 rpm: Fan speed in RPM
+// Returns:
+//	Triac delay in us, within DELAY_BOUNDL/H
+sint32 ICACHE_FLASH_ATTR user_ff_delay(sint32 rpm);
+
+#endif
@@ -0,0 +1,119 @@
+// user_prof.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Timing of hot code paths. A region is bracketed with
+//	PROF_START/PROF_END, which read the CPU cycle counter (CCOUNT) and add
+//	the difference to the region's entry in a static table: count, min, max,
+//	total for the mean, and a histogram with one bucket per power of 2 ticks.
+//	The table is printed over the UART and sent to a WebSocket client on the
+//	"prof" command (see user_connect.c).
+//
+//	The host build has no CCOUNT, so ticks there are clock_gettime ns.
+//	With DEBUG_LEVEL at DEBUG_NONE the macros expand to nothing and the
+//	table and its code are left out of the build.
+//
+//	PROF_START declares a variable, so it goes with a function's
+//	declarations; every return after it wants a PROF_END, e.g.
+//		void foo(void)
+//		{
+//			uint8 i = 0;
+//			PROF_START(PROF_FOO);
+//			...
+//			PROF_END(PROF_FOO);
+//			return;
+//		};
+//
+//	user_prof_record is kept in IRAM (no ICACHE_FLASH_ATTR) so regions in
+//	interrupt handlers can use it.
+
+#ifndef _USER_PROF_H
+#define _USER_PROF_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include <ets_sys.h>
+#include "user_task.h"
+#include "user_json.h"
+
+#if DEBUG_LEVEL != DEBUG_NONE
+#define PROF_ENABLED
+#endif
+
+#define PROF_BUCKET_N	24		// Histogram buckets. Bucket b counts durations of 2^b to 2^(b+1) - 1 ticks, the last everything longer
+
+// Regions
+typedef enum {
+	PROF_GPIO_ISR = 0,	// user_gpio_isr
+	PROF_FIRE_TRIAC,	// user_fire_triac
+	PROF_READ_HUMIDITY,	// user_read_humidity
+	PROF_TACH_CALC,		// user_tach_calc
+	PROF_WS_UPDATE,		// user_ws_update
+	PROF_REGION_N
+} PROF_REGION;
+
+// Timings of one region, in ticks
+struct user_prof_region {
+	uint32 count;			// Times the region ran
+	uint32 min;
+	uint32 max;
+	uint64 total;			// For the mean
+	uint32 hist[PROF_BUCKET_N];	// Log2 histogram
+};
+
+#ifdef HOST_BUILD
+uint32 host_prof_ticks(void);		// host_main.c
+#define PROF_TICKS()		host_prof_ticks()
+#define PROF_TICKS_PER_US	1000
+#else
+#define PROF_TICKS()		({ uint32 ccount; __asm__ __volatile__ ("rsr %0, ccount" : "=a" (ccount)); ccount; })
+#define PROF_TICKS_PER_US	system_get_cpu_freq()
+#endif
+
+#ifdef PROF_ENABLED
+#define PROF_START(region)	uint32 prof_start_##region = PROF_TICKS()
+#define PROF_END(region)	user_prof_record((region), PROF_TICKS() - prof_start_##region)
+#else
+#define PROF_START(region)
+#define PROF_END(region)
+#endif
+
+#ifdef PROF_ENABLED
+
+// Application Function: user_prof_record(uint8 region, uint32 ticks)
+// Desc: Adds one timing to a region. Use PROF_END rather than calling this
+// Args:
+//	uint8 region: PROF_REGION
+//	uint32 ticks: Duration
+// Returns:
+//	Nothing
+void user_prof_record(uint8 region, uint32 ticks);
+
+// Application Function: user_prof_print(void)
+// Desc: Prints the table over the UART, one line per region that has run
+// Args:
+//	None
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_prof_print(void);
+
+// Application Function: user_prof_json(struct user_json_writer *w)
+// Desc: Writes the table as
+//	{"prof":{"ticks_per_us":..,"regions":[{"name":..,"count":..,"min":..,
+//	"max":..,"mean":..,"hist":[..]},..]}}
+//	Each histogram stops at its highest non-empty bucket
+// Args:
+//	struct user_json_writer *w: Writer, freshly initialized
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_prof_json(struct user_json_writer *w);
+
+// Application Function: user_prof_reset(void)
+// Desc: Clears the table
+// Args:
+//	None
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_prof_reset(void);
+
+#endif
+
+#endif
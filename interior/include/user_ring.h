@@ -0,0 +1,113 @@
+// user_ring.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Lock-free single-producer/single-consumer ring buffer and
+//	atomic snapshot helpers for passing data between interrupt handlers
+//	and SDK tasks.
+//
+//	A ring must have exactly one producer and one consumer, e.g. an ISR
+//	pushing and a task popping. The producer only writes head and the
+//	consumer only writes tail, so neither side has to mask interrupts.
+//
+//	Everything here is static inline and deliberately not ICACHE_FLASH_ATTR:
+//	the code is inlined into its caller, so it runs from IRAM when called
+//	from user_gpio_isr or a hw_timer callback, and from flash in a task.
+
+#ifndef _USER_RING_H
+#define _USER_RING_H
+
+#include <c_types.h>
+#include <ets_sys.h>
+
+// Compiler barrier. The ESP8266 has one core, so this is enough to keep a
+// slot's contents from being reordered around the index that publishes it
+#define USER_BARRIER()	__asm__ __volatile__ ("" ::: "memory")
+
+// Ring control structure. The slot count must be a power of 2 no larger than 32768
+struct user_ring {
+	volatile uint32 *buf;		// Slot storage
+	uint16 mask;			// Slot count - 1
+	volatile uint16 head;		// Free running write index, written by the producer only
+	volatile uint16 tail;		// Free running read index, written by the consumer only
+	volatile uint32 dropped;	// Pushes rejected because the ring was full
+};
+
+// Static initializer from a uint32 array, e.g.
+//	static volatile uint32 foo_buf[64];
+//	static struct user_ring foo_ring = USER_RING_INIT(foo_buf);
+#define USER_RING_INIT(storage)	{ (storage), (sizeof(storage) / sizeof((storage)[0])) - 1, 0, 0, 0 }
+
+// Application Function: user_ring_count(struct user_ring *ring)
+// Desc: Number of queued entries. Exact for the consumer; the producer
+//	may see it one too high while a pop is in progress
+static inline uint16 user_ring_count(struct user_ring *ring)
+{
+	return (uint16)(ring->head - ring->tail);
+};
+
+// Application Function: user_ring_push(struct user_ring *ring, uint32 val)
+// Desc: Queues a value. Producer side only
+// Returns:
+//	true if queued, false if the ring was full (the value is dropped and counted)
+static inline bool user_ring_push(struct user_ring *ring, uint32 val)
+{
+	uint16 head = ring->head;
+
+	if ((uint16)(head - ring->tail) > ring->mask) {
+		ring->dropped++;
+		return false;
+	};
+
+	ring->buf[head & ring->mask] = val;
+	USER_BARRIER();			// Slot must be written before it is published
+	ring->head = head + 1;
+
+	return true;
+};
+
+// Application Function: user_ring_pop(struct user_ring *ring, uint32 *val)
+// Desc: Takes the oldest value. Consumer side only
+// Returns:
+//	true if *val was filled, false if the ring was empty
+static inline bool user_ring_pop(struct user_ring *ring, uint32 *val)
+{
+	uint16 tail = ring->tail;
+
+	if (tail == ring->head) {
+		return false;
+	};
+
+	USER_BARRIER();			// Slot must be read after head was seen to pass it
+	*val = ring->buf[tail & ring->mask];
+	USER_BARRIER();			// ...and before it is handed back to the producer
+	ring->tail = tail + 1;
+
+	return true;
+};
+
+// Application Function: user_atomic_swap(volatile uint32 *var, uint32 val)
+// Desc: Replaces a variable shared with an ISR and returns its old value,
+//	with interrupts masked so no update from the ISR falls in between.
+//	Use user_atomic_swap(&cnt, 0) to snapshot and reset a counter
+static inline uint32 user_atomic_swap(volatile uint32 *var, uint32 val)
+{
+	uint32 old = 0;
+
+	ETS_INTR_LOCK();
+	old = *var;
+	*var = val;
+	ETS_INTR_UNLOCK();
+
+	return old;
+};
+
+// Application Function: user_atomic_add(volatile uint32 *var, uint32 val)
+// Desc: Read-modify-write add to a variable shared with an ISR. Not
+//	needed from inside an ISR, which cannot be pre-empted by a task
+static inline void user_atomic_add(volatile uint32 *var, uint32 val)
+{
+	ETS_INTR_LOCK();
+	*var += val;
+	ETS_INTR_UNLOCK();
+};
+
+#endif
@@ -19,12 +19,16 @@
 //              
 //              Level 2: Extremely important, time sensitive tasks. This is reserved for the control task in user_main
 //              Level 1: Initialization/configuration tasks. These tasks must be completed
-//                      in order for the device to operate correctly. 
-//              Level 0: Low priority book-keeping/data collection tasks.
+//                      in order for the device to operate correctly. They are run one at a time,
+//                      in the order they were started, by the job task in user_job.c
+//              Level 0: Low priority book-keeping/data collection tasks. Drains the debug
+//                      log to the UART (user_dlog.c)
 
 #ifndef _USER_TASK_H
 #define _USER_TASK_H
 
+#include "user_dlog.h"
+
 // Message Queues
 #define MSG_QUEUE_LENGTH 4
 os_event_t * user_msg_queue_0;
@@ -41,31 +45,36 @@ os_timer_t timer_tachometer;
 
 // Task Calling Macros
 #define TASK_RETURN(sig,par) 		system_os_post(USER_TASK_PRIO_2, (sig), (par))
-#define TASK_START(task,sig,par)	({\
-						system_os_task((task), USER_TASK_PRIO_1, user_msg_queue_1, MSG_QUEUE_LENGTH);\
-						system_os_post(USER_TASK_PRIO_1, (sig), (par));\
-					})
-
-// Debug Message Macos/Defines:
-enum {
-	DEBUG_NONE = 0,			// No messages are printed over serial
-	DEBUG_ERR,			// Only error messages are printed over serial
-	DEBUG_LOW,			// Only flow control related messages and error messages are printed over serial
-	DEBUG_HIGH			// Data/variables are printed over serial in addition to flow control messages
-};
+#define TASK_START(task,sig,par)	user_job_post((task), (sig), (par))	// Queues task as a priority 1 job, see user_job.h
+
+// Debug Message Macos/Defines. The levels are defines rather than an enum so
+//	that #if can test DEBUG_LEVEL (see user_prof.h)
+#define DEBUG_NONE	0		// No messages are printed over serial
+#define DEBUG_ERR	1		// Only error messages are printed over serial
+#define DEBUG_LOW	2		// Only flow control related messages and error messages are printed over serial
+#define DEBUG_HIGH	3		// Data/variables are printed over serial in addition to flow control messages
+// DEBUG_LEVEL may be set from make, e.g. make DEBUG_LEVEL=DEBUG_LOW. Messages
+//	are queued and sent to the UART later by the drain task (see user_dlog.h)
+#ifndef DEBUG_LEVEL
 #define DEBUG_LEVEL DEBUG_HIGH
+#endif
+#if DEBUG_LEVEL == DEBUG_NONE
+#define PRINT_DEBUG(level, ...)
+#else
 #define PRINT_DEBUG(level, ...) ({\
 	if ((level) <= DEBUG_LEVEL) {\
-		os_printf(__VA_ARGS__);\
+		user_dlog(__VA_ARGS__);\
 	};\
 })
+#endif
 			
 /* --------------------------------------------------- */
 /* Control Signals/Parameters                          */
 /* --------------------------------------------------- */
 /* Signals/Parameters are designed to be combined into */
-/* 32-bit value for easy switch case statements. The   */
-/* signal occupies the upper 16-bits and the parameter */
+/* a 32-bit event which keys the control task's        */
+/* transition table (see user_dispatch.h). The signal  */
+/* occupies the upper 16-bits and the parameter        */
 /* occupies the lower 16-bits. They can then be OR'd   */
 /* together to form a unique signal/parameter combo    */
 /* --------------------------------------------------- */
@@ -74,7 +83,6 @@ enum {
 // General control signals/parameters
 #define SIG_CONTROL				(uint32)(0x0000 << 16)
 #define PAR_CONTROL_START			(uint32)(0x0000)
-#define PAR_CONTROL_ERR_DEADLOOP		(uint32)(0xFFFE)
 #define PAR_CONTROL_ERR_FATAL			(uint32)(0xFFFF)
 
 // AP scanning signals/parameters
@@ -0,0 +1,83 @@
+// user_telemetry.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Compact telemetry frames for the WebSocket feed. Each frame
+//	carries a version, a sequence number and a mask of the fields it holds,
+//	followed by those fields as 16 bit little endian fixed point values in
+//	field order. Normally only fields which changed since the last frame are
+//	sent; a key frame with every field goes out every TLM_KEY_N updates and to
+//	any client which has missed a frame. The decoder is in web/front_page.html.
+//
+//	Byte 0:    TLM_VERSION
+//	Byte 1:    Sequence number, +1 per frame sent
+//	Byte 2-3:  Field mask, bit n set if field n follows
+//	Byte 4-:   Fields, 2 bytes each
+
+#ifndef _USER_TELEMETRY_H
+#define _USER_TELEMETRY_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_task.h"
+#include "user_humidity.h"
+#include "user_fan.h"
+#include "user_ws.h"
+
+#define TLM_VERSION	1
+#define TLM_KEY_N	20	// Updates between key frames
+
+// Fields, in frame order
+typedef enum {
+	TLM_HUM_INT = 0,	// Interior humidity, 0.01 %RH
+	TLM_HUM_EXT,		// Exterior humidity, 0.01 %RH
+	TLM_RPM,		// Measured fan speed, RPM
+	TLM_DELAY,		// Triac drive delay, us
+	TLM_THRESHOLD,		// Humidity threshold, 0.01 %RH
+	TLM_MODES,		// fan_mode in bits 0-3, control_mode in bits 4-7
+	TLM_STATUS,		// sensor_status bits, drive_flag in bit 7
+	TLM_FIELD_N
+} TLM_FIELD;
+
+#define TLM_ALL		((1 << TLM_FIELD_N) - 1)
+#define TLM_STATUS_DRIVE 0x80	// TLM_STATUS bit set while the fan is driven
+
+// Largest frame including its WebSocket header
+#define TLM_FRAME_MAX	(2 + 4 + (2 * TLM_FIELD_N))
+
+// Application Function: user_tlm_fixed(float val, float scale)
+// Desc: Converts a value to unsigned 16 bit fixed point, clamping to range
+// Args:
+//	float val: Value
+//	float scale: Fixed point units per unit of val
+// Returns:
+//	Rounded, clamped fixed point value
+uint16 ICACHE_FLASH_ATTR user_tlm_fixed(float val, float scale);
+
+// Application Function: user_tlm_clamp(sint32 val)
+// Desc: Clamps an integer to the unsigned 16 bit range
+// Args:
+//	sint32 val: Value
+// Returns:
+//	val clamped to 0-65535
+uint16 ICACHE_FLASH_ATTR user_tlm_clamp(sint32 val);
+
+// Application Function: user_tlm_next(void)
+// Desc: Samples every field and decides what the next frame must hold. The
+//	sequence number is advanced only if something is to be sent
+// Args:
+//	Nothing
+// Returns:
+//	Mask of fields changed since the last frame, TLM_ALL on a key frame,
+//	or 0 if nothing changed
+uint16 ICACHE_FLASH_ATTR user_tlm_next(void);
+
+// Application Function: user_tlm_frame(uint8 *buf, uint16 mask)
+// Desc: Builds a WebSocket binary frame of the fields in mask from the last
+//	sample, with the current sequence number
+// Args:
+//	uint8 *buf: Destination, at least TLM_FRAME_MAX bytes
+//	uint16 mask: Fields to include
+// Returns:
+//	Frame length in bytes
+uint8 ICACHE_FLASH_ATTR user_tlm_frame(uint8 *buf, uint16 mask);
+
+#endif
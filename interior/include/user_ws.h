@@ -0,0 +1,109 @@
+// user_ws.h
+// Authors: Christian Auspland & Matthew Blanchard
+// Description: Incremental WebSocket frame parser. One parser is kept per
+//	connection and is fed each TCP segment as it arrives. Frames may be split
+//	across segments or several may share one; the parser resumes wherever
+//	the last segment stopped, unmasks payloads, reassembles fragmented
+//	messages and hands complete messages and control frames to a callback.
+
+#ifndef _USER_WS_H
+#define _USER_WS_H
+
+#include <user_interface.h>
+#include <osapi.h>
+#include "user_task.h"
+
+#define WS_MSG_MAX	256	// Largest reassembled message accepted, in bytes
+#define WS_CTL_MAX	125	// Largest control frame payload allowed by RFC 6455
+
+// Opcodes
+#define WS_OP_CONT	0x0
+#define WS_OP_TEXT	0x1
+#define WS_OP_BINARY	0x2
+#define WS_OP_CLOSE	0x8
+#define WS_OP_PING	0x9
+#define WS_OP_PONG	0xA
+
+// Close status codes
+#define WS_CLOSE_NORMAL		1000
+#define WS_CLOSE_PROTOCOL	1002
+#define WS_CLOSE_TOO_BIG	1009
+
+// Parser states
+typedef enum {
+	WS_STATE_HDR0 = 0,	// FIN/RSV/opcode byte
+	WS_STATE_HDR1,		// MASK/length byte
+	WS_STATE_LEN,		// Extended length bytes
+	WS_STATE_MASK,		// Masking key bytes
+	WS_STATE_PAYLOAD,	// Payload bytes
+	WS_STATE_ERROR		// Protocol error, all further data is dropped
+} WS_STATE;
+
+// Callback for a complete message or control frame. data is unmasked and
+// NUL terminated (the terminator is not counted in len) and is only valid
+// for the duration of the call
+typedef void (*user_ws_msg_fn)(void *arg, uint8 opcode, uint8 *data, uint16 len);
+
+// Parser state for one connection
+struct user_ws_parser {
+	WS_STATE state;			// Current parser state
+	uint8 opcode;			// Opcode of the frame being parsed
+	bool fin;			// FIN bit of the frame being parsed
+	uint8 need;			// Header bytes still to come in WS_STATE_LEN/MASK
+	uint8 mask[4];			// Masking key of the frame being parsed
+	uint32 frame_len;		// Payload length of the frame being parsed
+	uint32 frame_got;		// Payload bytes of the frame received so far
+	uint8 msg_opcode;		// Opcode of the message being reassembled, WS_OP_CONT if none
+	uint16 msg_len;			// Bytes of the message reassembled so far
+	uint16 ctl_len;			// Bytes of the control frame received so far
+	uint16 close_code;		// Close status to report once WS_STATE_ERROR is entered
+	uint8 msg[WS_MSG_MAX + 1];	// Message reassembly buffer
+	uint8 ctl[WS_CTL_MAX + 1];	// Control frame buffer, so a ping may arrive mid-message
+};
+
+// Application Function: user_ws_parser_init(struct user_ws_parser *p)
+// Desc: Resets a parser for a newly upgraded connection
+// Args:
+//	struct user_ws_parser *p: Parser
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_ws_parser_init(struct user_ws_parser *p);
+
+// Application Function: user_ws_parse(struct user_ws_parser *p, uint8 *data, uint16 len, user_ws_msg_fn cb, void *arg)
+// Desc: Feeds the next chunk of the byte stream to a parser. Masked payload is
+//	unmasked in place in data, so data must be writable
+// Args:
+//	struct user_ws_parser *p: Parser
+//	uint8 *data: Received bytes
+//	uint16 len: Number of received bytes
+//	user_ws_msg_fn cb: Called for every complete message and control frame
+//	void *arg: Passed through to cb
+// Returns:
+//	0 while the stream is valid, otherwise the close status code to send
+//	(WS_CLOSE_PROTOCOL or WS_CLOSE_TOO_BIG)
+uint16 ICACHE_FLASH_ATTR user_ws_parse(struct user_ws_parser *p, uint8 *data, uint16 len, user_ws_msg_fn cb, void *arg);
+
+// Application Function: user_ws_unmask(uint8 *data, uint32 len, const uint8 *mask, uint32 offset)
+// Desc: XORs a run of payload with the masking key in place, a 32 bit word at a
+//	time between the unaligned head and tail
+// Args:
+//	uint8 *data: Payload bytes
+//	uint32 len: Number of bytes
+//	const uint8 *mask: 4 byte masking key
+//	uint32 offset: Position of data[0] within the frame payload, which selects
+//		the starting key byte
+// Returns:
+//	Nothing
+void ICACHE_FLASH_ATTR user_ws_unmask(uint8 *data, uint32 len, const uint8 *mask, uint32 offset);
+
+// Application Function: user_ws_frame_header(uint8 *buf, uint8 opcode, uint16 len)
+// Desc: Writes an unmasked, unfragmented server frame header
+// Args:
+//	uint8 *buf: Destination, at least 4 bytes
+//	uint8 opcode: Frame opcode
+//	uint16 len: Payload length
+// Returns:
+//	Header length in bytes (2 or 4)
+uint8 ICACHE_FLASH_ATTR user_ws_frame_header(uint8 *buf, uint8 opcode, uint16 len);
+
+#endif
@@ -40,16 +40,44 @@ typedef enum {
     NMI_SOURCE = 1,	
 } FRC1_TIMER_SOURCE_TYPE;
 
+//PULSE SEQUENCE STAGE
+typedef enum {
+    PULSE_IDLE = 0,	//no pulse sequence pending, expiry calls user_hw_timer_cb
+    PULSE_RISE = 1,	//next expiry is the leading edge of a pulse
+    PULSE_FALL = 2,	//next expiry is the trailing edge of a pulse
+} PULSE_STAGE;
+
 static void (* user_hw_timer_cb)(void) = NULL;
+static void (* user_hw_timer_rise_cb)(void) = NULL;
+static void (* user_hw_timer_fall_cb)(void) = NULL;
 static u8 TimeType = 0;
 static u8 AutoLoad = 0;
 static u8 Cando = 0;
+static volatile u8 PulseStage = PULSE_IDLE;
+static u32 PulseWidth = 0;
 static void  hw_timer_isr_cb(void)
 {
         //if(user_hw_timer_cb!=NULL)
                // (*(user_hw_timer_cb))();
 
-         if(AutoLoad == 1)
+        if(PulseStage == PULSE_RISE)
+        {
+                // Program the trailing edge before running the rise func, so the
+                // pulse width doesn't stretch by the callback latency
+                PulseStage = PULSE_FALL;
+                RTC_REG_WRITE(FRC1_LOAD_ADDRESS, US_TO_RTC_TIMER_TICKS(PulseWidth));
+                if (user_hw_timer_rise_cb != NULL) {
+                    (*user_hw_timer_rise_cb)();
+                }
+        }
+        else if(PulseStage == PULSE_FALL)
+        {
+                PulseStage = PULSE_IDLE;
+                if (user_hw_timer_fall_cb != NULL) {
+                    (*user_hw_timer_fall_cb)();
+                }
+        }
+        else if(AutoLoad == 1)
         {
                 if (user_hw_timer_cb != NULL) {
                     (*user_hw_timer_cb)();
@@ -82,6 +110,7 @@ in non autoload mode:
 *******************************************************************************/
 void  hw_timer_arm(u32 val)
 {
+      PulseStage = PULSE_IDLE;
       RTC_REG_WRITE(FRC1_LOAD_ADDRESS, US_TO_RTC_TIMER_TICKS(val));
        if(AutoLoad == 0)
        {
@@ -90,6 +119,43 @@ void  hw_timer_arm(u32 val)
 }
 
 
+/******************************************************************************
+* FunctionName : hw_timer_arm_pulse
+* Description  : start a two-edge pulse sequence in non autoload mode. The
+                 first expiry calls the rise func and re-arms the timer for
+                 the pulse width, the second expiry calls the fall func.
+* Parameters   : uint32 delay : delay to the leading edge, 10 ~ 0x7fffff
+                 uint32 width : pulse width, 10 ~ 0x7fffff
+* Returns      : NONE
+*******************************************************************************/
+void  hw_timer_arm_pulse(u32 delay, u32 width)
+{
+        // Terminate a pulse which is still in progress rather than leaving it high
+        if((PulseStage == PULSE_FALL) && (user_hw_timer_fall_cb != NULL))
+        {
+                (*user_hw_timer_fall_cb)();
+        }
+
+        PulseWidth = width;
+        PulseStage = PULSE_RISE;
+        RTC_REG_WRITE(FRC1_LOAD_ADDRESS, US_TO_RTC_TIMER_TICKS(delay));
+}
+
+
+/******************************************************************************
+* FunctionName : hw_timer_set_pulse_func
+* Description  : set the funcs called on the edges of a pulse sequence.
+* Parameters   : void (* rise_cb)(void): called on the leading edge
+                 void (* fall_cb)(void): called on the trailing edge
+* Returns      : NONE
+*******************************************************************************/
+void  hw_timer_set_pulse_func(void (* rise_cb)(void), void (* fall_cb)(void))
+{
+        user_hw_timer_rise_cb = rise_cb;
+        user_hw_timer_fall_cb = fall_cb;
+}
+
+
 /******************************************************************************
 * FunctionName : hw_timer_set_func
 * Description  : set the func, when trigger timer is up.
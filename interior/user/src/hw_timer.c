@@ -54,6 +54,16 @@ typedef enum {
     NMI_SOURCE = 1,
 } FRC1_TIMER_SOURCE_TYPE;
 
+//PULSE SEQUENCE STAGE
+typedef enum {
+    PULSE_IDLE = 0,	//no pulse sequence pending, expiry calls user_hw_timer_cb
+    PULSE_RISE = 1,	//next expiry is the leading edge of a pulse
+    PULSE_FALL = 2,	//next expiry is the trailing edge of a pulse
+} PULSE_STAGE;
+
+static volatile u8 pulse_stage = PULSE_IDLE;
+static u32 pulse_width = 0;
+
 /******************************************************************************
 * FunctionName : hw_timer_arm
 * Description  : set a trigger timer delay for this timer.
@@ -67,10 +77,49 @@ in non autoload mode:
 *******************************************************************************/
 void hw_timer_arm(u32 val)
 {
+    pulse_stage = PULSE_IDLE;
     RTC_REG_WRITE(FRC1_LOAD_ADDRESS, US_TO_RTC_TIMER_TICKS(val));
 }
 
 static void (* user_hw_timer_cb)(void) = NULL;
+static void (* user_hw_timer_rise_cb)(void) = NULL;
+static void (* user_hw_timer_fall_cb)(void) = NULL;
+
+/******************************************************************************
+* FunctionName : hw_timer_arm_pulse
+* Description  : start a two-edge pulse sequence in non autoload mode. The
+                 first expiry calls the rise func and re-arms the timer for
+                 the pulse width, the second expiry calls the fall func. No
+                 busy-waiting is needed inside the isr to time the pulse.
+* Parameters   : uint32 delay : delay to the leading edge, 10 ~ 0x7fffff
+                 uint32 width : pulse width, 10 ~ 0x7fffff
+* Returns      : NONE
+*******************************************************************************/
+void hw_timer_arm_pulse(u32 delay, u32 width)
+{
+    // Terminate a pulse which is still in progress rather than leaving it high
+    if ((pulse_stage == PULSE_FALL) && (user_hw_timer_fall_cb != NULL)) {
+        (*(user_hw_timer_fall_cb))();
+    }
+
+    pulse_width = width;
+    pulse_stage = PULSE_RISE;
+    RTC_REG_WRITE(FRC1_LOAD_ADDRESS, US_TO_RTC_TIMER_TICKS(delay));
+}
+
+/******************************************************************************
+* FunctionName : hw_timer_set_pulse_func
+* Description  : set the funcs called on the edges of a pulse sequence.
+* Parameters   : void (* rise_cb)(void): called on the leading edge
+                 void (* fall_cb)(void): called on the trailing edge
+* Returns      : NONE
+*******************************************************************************/
+void ICACHE_FLASH_ATTR hw_timer_set_pulse_func(void (* rise_cb)(void), void (* fall_cb)(void))
+{
+    user_hw_timer_rise_cb = rise_cb;
+    user_hw_timer_fall_cb = fall_cb;
+}
+
 /******************************************************************************
 * FunctionName : hw_timer_set_func
 * Description  : set the func, when trigger timer is up.
@@ -85,7 +134,20 @@ void ICACHE_FLASH_ATTR hw_timer_set_func(void (* user_hw_timer_cb_set)(void))
 
 static void  hw_timer_isr_cb(void)
 {
-    if (user_hw_timer_cb != NULL) {
+    if (pulse_stage == PULSE_RISE) {
+        // Program the trailing edge before running the rise func, so the
+        // pulse width doesn't stretch by the callback latency
+        pulse_stage = PULSE_FALL;
+        RTC_REG_WRITE(FRC1_LOAD_ADDRESS, US_TO_RTC_TIMER_TICKS(pulse_width));
+        if (user_hw_timer_rise_cb != NULL) {
+            (*(user_hw_timer_rise_cb))();
+        }
+    } else if (pulse_stage == PULSE_FALL) {
+        pulse_stage = PULSE_IDLE;
+        if (user_hw_timer_fall_cb != NULL) {
+            (*(user_hw_timer_fall_cb))();
+        }
+    } else if (user_hw_timer_cb != NULL) {
         (*(user_hw_timer_cb))();
     }
 }
@@ -0,0 +1,237 @@
+// user_api.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_api.h"
+
+// Settings, staged while a PUT body is checked
+struct user_api_config {
+	struct user_fan_settings fan;	// Checked and applied by user_fan_apply
+	sint32 threshold;		// Hundredths of a percent
+};
+
+static char api_buf[API_BUF_SIZE];	// Response body, copied out by user_http_respond
+
+// Application Function: user_api_send(struct espconn *conn, uint16 status, struct user_json_writer *w)
+// Desc: Sends a finished document, or a 500 if it overflowed
+static void ICACHE_FLASH_ATTR user_api_send(struct espconn *conn, uint16 status, struct user_json_writer *w)
+{
+	if (w->overflow) {
+		PRINT_DEBUG(DEBUG_ERR, "api response larger than %d bytes\r\n", API_BUF_SIZE);
+		user_http_respond(conn, 500, NULL, NULL, 0);
+		return;
+	};
+	user_http_respond(conn, status, "application/json", w->buf, w->len);
+
+	return;
+};
+
+// Application Function: user_api_error(struct espconn *conn, const char *msg)
+// Desc: Answers a bad request with 400 and {"error":msg}
+static void ICACHE_FLASH_ATTR user_api_error(struct espconn *conn, const char *msg)
+{
+	struct user_json_writer w;
+
+	PRINT_DEBUG(DEBUG_LOW, "api request refused, %s\r\n", msg);
+	user_json_init(&w, api_buf, sizeof(api_buf));
+	user_json_open(&w, NULL, '{');
+	user_json_str(&w, "error", msg);
+	user_json_close(&w, '}');
+	user_api_send(conn, 400, &w);
+
+	return;
+};
+
+// Application Function: user_api_hundredths(float val)
+// Desc: Rounds a reading to hundredths for user_json_fixed
+static sint32 ICACHE_FLASH_ATTR user_api_hundredths(float val)
+{
+	return (sint32)((val * 100) + ((val < 0) ? -0.5 : 0.5));
+};
+
+// Application Function: user_api_name(const struct user_json_token *t, const char **names, uint8 n)
+// Desc: Looks a string token up in a table of names
+// Returns: The index of the name, or n if it is not in the table
+static uint8 ICACHE_FLASH_ATTR user_api_name(const struct user_json_token *t, const char **names, uint8 n)
+{
+	uint8 i = 0;
+
+	for (i = 0; i < n; i++) {
+		if (user_json_eq(t, names[i])) {
+			break;
+		};
+	};
+
+	return i;
+};
+
+// Application Function: user_api_member(struct user_json_token *key, struct user_json_token *val, struct user_api_config *cfg, bool *mode_set)
+// Desc: Checks one member of a PUT body into the staged settings
+// Returns: NULL, or what was wrong with the member
+static const char * ICACHE_FLASH_ATTR user_api_member(struct user_json_token *key, struct user_json_token *val, struct user_api_config *cfg, bool *mode_set)
+{
+	uint8 i = 0;
+
+	if (user_json_eq(key, "fan_mode")) {
+		i = user_api_name(val, fan_mode_names, FAN_MODE_N);
+		if (i == FAN_MODE_N) {
+			return "unknown fan_mode";
+		};
+		cfg->fan.mode = i;
+
+	} else if (user_json_eq(key, "control_mode")) {
+		i = user_api_name(val, control_mode_names, CONTROL_MODE_N);
+		if (i == CONTROL_MODE_N) {
+			return "unknown control_mode";
+		};
+		cfg->fan.control = i;
+		*mode_set = true;
+
+	} else if (user_json_eq(key, "rpm")) {
+		if ((val->type != JSON_NUMBER) || !val->integer || (val->num < 0)) {
+			return "rpm must be a whole number";
+		};
+		cfg->fan.speed = val->num / JSON_SCALE;
+		if (!*mode_set) {
+			cfg->fan.control = CONTROL_SPEED;
+		};
+
+	} else if (user_json_eq(key, "delay")) {
+		if ((val->type != JSON_NUMBER) || !val->integer || (val->num < 0)) {
+			return "delay must be a whole number";
+		};
+		cfg->fan.delay = val->num / JSON_SCALE;
+		if (!*mode_set) {
+			cfg->fan.control = CONTROL_DELAY;
+		};
+
+	} else if (user_json_eq(key, "threshold")) {
+		if ((val->type != JSON_NUMBER) || (val->num < 0) || (val->num > 100 * JSON_SCALE)) {
+			return "threshold must be a number from 0 to 100";
+		};
+		cfg->threshold = val->num / (JSON_SCALE / 100);
+
+	} else {
+		return "unknown member";
+	};
+
+	return NULL;
+};
+
+// Application Function: user_api_parse(const char *body, uint16 len, struct user_api_config *cfg)
+// Desc: Checks a whole PUT body into the staged settings
+// Returns: NULL, or what was wrong with the body
+static const char * ICACHE_FLASH_ATTR user_api_parse(const char *body, uint16 len, struct user_api_config *cfg)
+{
+	struct user_json_lexer lx;
+	struct user_json_token key;		// Member name
+	struct user_json_token t;		// Member value, then separator
+	bool mode_set = false;			// control_mode given explicitly
+	const char *err = NULL;
+
+	user_json_lexer_init(&lx, body, len);
+	if (user_json_next(&lx, &t) != JSON_OBJ_BEGIN) {
+		return "body must be an object";
+	};
+
+	// Empty object
+	if ((user_json_next(&lx, &key) == JSON_OBJ_END) && (user_json_next(&lx, &t) == JSON_END)) {
+		return NULL;
+	};
+
+	// Members, the first name already read
+	while (true) {
+		if ((key.type != JSON_STRING) || (user_json_next(&lx, &t) != JSON_COLON)) {
+			return "malformed object";
+		};
+		user_json_next(&lx, &t);
+		if ((t.type == JSON_ERROR) || (t.type == JSON_END)) {
+			return "malformed value";
+		};
+		err = user_api_member(&key, &t, cfg, &mode_set);
+		if (err != NULL) {
+			return err;
+		};
+
+		user_json_next(&lx, &t);
+		if (t.type == JSON_OBJ_END) {
+			break;
+		} else if (t.type != JSON_COMMA) {
+			return "malformed object";
+		};
+		user_json_next(&lx, &key);
+	};
+
+	if (user_json_next(&lx, &t) != JSON_END) {
+		return "trailing data after object";
+	};
+
+	return NULL;
+};
+
+void ICACHE_FLASH_ATTR user_api_status(struct espconn *conn, struct user_http_req *req)
+{
+	struct user_json_writer w;
+
+	user_json_init(&w, api_buf, sizeof(api_buf));
+	user_json_open(&w, NULL, '{');
+	user_json_fixed(&w, "humidity_int", user_api_hundredths(sensor_data_int), 2);
+	user_json_fixed(&w, "humidity_ext", user_api_hundredths(sensor_data_ext), 2);
+	user_json_bool(&w, "sensor_int_ok", (sensor_status & SENSOR_INT_OK) != 0);
+	user_json_bool(&w, "sensor_ext_ok", (sensor_status & SENSOR_EXT_OK) != 0);
+	user_json_fixed(&w, "threshold", user_api_hundredths(threshold_humidity), 2);
+	user_json_str(&w, "fan_mode", (fan_mode < FAN_MODE_N) ? fan_mode_names[fan_mode] : "unknown");
+	user_json_str(&w, "control_mode", (control_mode < CONTROL_MODE_N) ? control_mode_names[control_mode] : "unknown");
+	user_json_bool(&w, "drive", drive_flag);
+	user_json_int(&w, "rpm", measured_rpm);
+	user_json_int(&w, "desired_rpm", desired_rpm);
+	user_json_int(&w, "delay", drive_delay);
+	user_json_int(&w, "supply_hz", supply_hz);
+	user_json_int(&w, "free_heap", system_get_free_heap_size());
+	user_json_close(&w, '}');
+	user_api_send(conn, 200, &w);
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_api_config_get(struct espconn *conn, struct user_http_req *req)
+{
+	struct user_json_writer w;
+
+	user_json_init(&w, api_buf, sizeof(api_buf));
+	user_json_open(&w, NULL, '{');
+	user_json_str(&w, "fan_mode", (fan_mode < FAN_MODE_N) ? fan_mode_names[fan_mode] : "unknown");
+	user_json_str(&w, "control_mode", (control_mode < CONTROL_MODE_N) ? control_mode_names[control_mode] : "unknown");
+	user_json_int(&w, "rpm", desired_rpm);
+	user_json_int(&w, "delay", desired_delay);
+	user_json_fixed(&w, "threshold", user_api_hundredths(threshold_humidity), 2);
+	user_json_close(&w, '}');
+	user_api_send(conn, 200, &w);
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_api_config_put(struct espconn *conn, struct user_http_req *req)
+{
+	struct user_api_config cfg;
+	const char *err = NULL;
+
+	// Stage the current settings, so members left out keep their values
+	user_fan_stage(&cfg.fan);
+	cfg.threshold = user_api_hundredths(threshold_humidity);
+
+	err = user_api_parse((const char *)req->body, req->body_len, &cfg);
+	if ((err == NULL) && !user_fan_apply(&cfg.fan)) {
+		err = "fan settings refused";
+	};
+	if (err != NULL) {
+		user_api_error(conn, err);
+		return;
+	};
+	threshold_humidity = cfg.threshold / 100.0;
+	PRINT_DEBUG(DEBUG_LOW, "api config: fan_mode=%d, control_mode=%d, rpm=%d, delay=%d\r\n",
+		fan_mode, control_mode, desired_rpm, desired_delay);
+
+	user_api_config_get(conn, req);
+
+	return;
+};
@@ -0,0 +1,184 @@
+// user_asset.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_asset.h"
+
+static const char *asset_header = {
+	"HTTP/1.1 200 OK\r\n"
+	"Content-Type: %s\r\n"
+	"Content-Encoding: gzip\r\n"
+	"Content-Length: %d\r\n"
+	"ETag: %s\r\n"
+	"Cache-Control: no-cache\r\n\r\n"
+};
+static const char *asset_not_modified = {
+	"HTTP/1.1 304 Not Modified\r\n"
+	"ETag: %s\r\n"
+	"Cache-Control: no-cache\r\n\r\n"
+};
+
+// Transfers in progress, found with user_http_same_peer
+struct user_asset_xfer {
+	struct espconn *conn;			// Client connection, NULL if the slot is free
+	uint8 remote_ip[4];			// Client address
+	int remote_port;			// Client port
+	const struct user_asset *asset;		// Asset being sent
+	uint32 pos;				// Bytes of the asset sent
+};
+static struct user_asset_xfer asset_xfers[ASSET_XFER_N];
+static uint8 asset_buf[ASSET_CHUNK];		// Chunk being sent, espconn_send copies it out
+
+// Application Function: user_asset_find_xfer(struct espconn *conn)
+// Desc: Finds the transfer of a connection
+// Returns:
+//	Transfer, or NULL if the connection has none
+static struct user_asset_xfer * ICACHE_FLASH_ATTR user_asset_find_xfer(struct espconn *conn)
+{
+	uint8 i = 0;
+
+	for (i = 0; i < ASSET_XFER_N; i++) {
+		if ((asset_xfers[i].conn != NULL) &&
+		    user_http_same_peer(asset_xfers[i].remote_ip, asset_xfers[i].remote_port, conn)) {
+			return &asset_xfers[i];
+		};
+	};
+
+	return NULL;
+};
+
+// Application Function: user_asset_read(uint8 *dst, const uint8 *src, uint16 len)
+// Desc: Copies asset data out of flash. Flash mapped memory only allows
+//	aligned 32-bit loads, so whole words are read and split into bytes
+static void ICACHE_FLASH_ATTR user_asset_read(uint8 *dst, const uint8 *src, uint16 len)
+{
+	const uint32 *word = (const uint32 *)((size_t)src & ~3);	// Word holding the first byte
+	uint8 skip = (size_t)src & 3;					// Bytes of that word before it
+	uint32 w = 0;
+	uint8 n = 0;
+
+	while (len > 0) {
+		w = *word++;
+		n = 4 - skip;
+		n > len ? (n = len) : 0;
+		os_memcpy(dst, (uint8 *)&w + skip, n);
+		dst += n;
+		len -= n;
+		skip = 0;
+	};
+
+	return;
+};
+
+// Application Function: user_asset_next(struct user_asset_xfer *x, uint16 start)
+// Desc: Fills the rest of asset_buf from start with the next part of the
+//	asset and sends it, freeing the transfer on failure
+// Returns:
+//	false if the send failed
+static bool ICACHE_FLASH_ATTR user_asset_next(struct user_asset_xfer *x, uint16 start)
+{
+	uint32 n = x->asset->len - x->pos;	// Asset bytes in this send
+	sint8 result = 0;			// Function result
+
+	n > (ASSET_CHUNK - start) ? (n = ASSET_CHUNK - start) : 0;
+	user_asset_read(&asset_buf[start], &x->asset->data[x->pos], n);
+	x->pos += n;
+
+	result = espconn_send(x->conn, asset_buf, start + n);
+	if (result != 0) {
+		PRINT_DEBUG(DEBUG_ERR, "asset send failed, error=%d\r\n", result);
+		x->conn = NULL;
+		return false;
+	};
+
+	return true;
+};
+
+const struct user_asset * ICACHE_FLASH_ATTR user_asset_find(const char *path)
+{
+	uint8 i = 0;
+
+	for (i = 0; i < user_asset_n; i++) {
+		if (os_strcmp(user_assets[i].path, path) == 0) {
+			return &user_assets[i];
+		};
+	};
+
+	return NULL;
+};
+
+bool ICACHE_FLASH_ATTR user_asset_send(struct espconn *conn, const struct user_asset *asset, const char *etag)
+{
+	struct user_asset_xfer *x = NULL;	// Transfer slot
+	uint16 len = 0;				// HTTP header length
+	sint8 result = 0;			// Function result
+	uint8 i = 0;
+
+	// The client's copy is current if our ETag is among those it holds
+	if (os_strstr(etag, asset->etag) != NULL) {
+		PRINT_DEBUG(DEBUG_LOW, "asset %s not modified\r\n", asset->path);
+		len = os_sprintf(asset_buf, asset_not_modified, asset->etag);
+		result = espconn_send(conn, asset_buf, len);
+		if (result != 0) {
+			PRINT_DEBUG(DEBUG_ERR, "asset send failed, error=%d\r\n", result);
+			return false;
+		};
+		return true;
+	};
+
+	// A connection asking again drops its old transfer
+	x = user_asset_find_xfer(conn);
+	for (i = 0; (x == NULL) && (i < ASSET_XFER_N); i++) {
+		if (asset_xfers[i].conn == NULL) {
+			x = &asset_xfers[i];
+		};
+	};
+	if (x == NULL) {
+		return false;
+	};
+
+	x->conn = conn;
+	os_memcpy(x->remote_ip, conn->proto.tcp->remote_ip, 4);
+	x->remote_port = conn->proto.tcp->remote_port;
+	x->asset = asset;
+	x->pos = 0;
+
+	// The first send carries the header and as much of the asset as fits
+	PRINT_DEBUG(DEBUG_LOW, "sending asset %s, length=%d\r\n", asset->path, asset->len);
+	len = os_sprintf(asset_buf, asset_header, asset->type, asset->len, asset->etag);
+
+	return user_asset_next(x, len);
+};
+
+bool ICACHE_FLASH_ATTR user_asset_sent(struct espconn *conn)
+{
+	struct user_asset_xfer *x = user_asset_find_xfer(conn);
+
+	if (x == NULL) {
+		return false;
+	};
+
+	if (x->pos >= x->asset->len) {
+		PRINT_DEBUG(DEBUG_LOW, "asset %s sent\r\n", x->asset->path);
+		x->conn = NULL;
+		return false;
+	};
+	// A response cut short can't be finished, so the connection is closed and
+	//	its disconnect callback frees it everywhere
+	x->conn = conn;
+	if (!user_asset_next(x, 0)) {
+		espconn_disconnect(conn);
+	};
+
+	return true;
+};
+
+void ICACHE_FLASH_ATTR user_asset_close(struct espconn *conn)
+{
+	struct user_asset_xfer *x = user_asset_find_xfer(conn);
+
+	if (x != NULL) {
+		x->conn = NULL;
+	};
+
+	return;
+};
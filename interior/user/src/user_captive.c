@@ -23,62 +23,52 @@ static struct _esp_tcp tcp_captive_ext_proto;
 
 // HTML for captive portal webpage
 const char const *captive_page = {
-        "HTTP/1.1 200 OK\r\n\
-        Content-type: text/html\r\n\r\n\
-        <html>\
-        <head><title>HBFC/D Wireless Config</title></head>\
-        <body>\
-        <h1>\
-                Humidity Based Fan Controller / Dehumidifier Wifi Configuration<br>\
-        </h1>\
-        <p>\
-                The HBFC/D either couldn't find the SSID it has saved in memory,\
-                or the password was incorrect. Please enter wifi credentials and\
-                hit \"Submit\"<br>\
-        </p>\
-        <form id=\"wifi_config\" action=\"./submit\" method=\"post\">\
-                Wifi Credentials:<br><br>\
-                SSID:<br>\
-                <input type=\"text\" name=\"ssid\"><br>\
-                Password:<br>\
-                <input type=\"password\" name=\"pass\"><br>\
-                <input type=\"submit\" value=\"Submit\"><br>\
-        </form>\
-        </body>\
-        </html>"
+	"<html>"
+	"<head><title>HBFC/D Wireless Config</title></head>"
+	"<body>"
+	"<h1>Humidity Based Fan Controller / Dehumidifier Wifi Configuration<br></h1>"
+	"<p>"
+	"The HBFC/D either couldn't find the SSID it has saved in memory, "
+	"or the password was incorrect. Please enter wifi credentials and "
+	"hit \"Submit\"<br>"
+	"</p>"
+	"<form id=\"wifi_config\" action=\"./submit\" method=\"post\">"
+	"Wifi Credentials:<br><br>"
+	"SSID:<br>"
+	"<input type=\"text\" name=\"ssid\"><br>"
+	"Password:<br>"
+	"<input type=\"password\" name=\"pass\"><br>"
+	"<input type=\"submit\" value=\"Submit\"><br>"
+	"</form>"
+	"</body>"
+	"</html>"
 };
 
 // HTML for exterior system wait page
 const char const *wait_page = {
-	"HTTP/1.1 200 OK\r\n\
-	Content-type: text/html\r\n\r\n\
-	<html>\
-	<head><title>HBFC/D Wait</title></head>\
-	<body>\
-	<h>\
-		Humidity Based Fan Controller / Dehumidifer Wait Page<br>\
-	</h1>\
-	<p>\
-		The exterior sensor system has not yet connected. Please wait a few seconds\
-		and refresh this page\
-	</p>\
-	</body>\
-	</html>"
+	"<html>"
+	"<head><title>HBFC/D Wait</title></head>"
+	"<body>"
+	"<h1>Humidity Based Fan Controller / Dehumidifer Wait Page<br></h1>"
+	"<p>"
+	"The exterior sensor system has not yet connected. Please wait a few seconds "
+	"and refresh this page"
+	"</p>"
+	"</body>"
+	"</html>"
 };
 
 // HTML for form submission page
 const char const *submit_page = {
-        "HTTP/1.1 200 OK\r\n\
-        Content-type: text/html\r\n\r\n\
-        <html>\
-        <head><title>HBFC/D Config Submission</title></head>\
-        <body>\
-        <p>\
-        Wireless configuration submitted. The system will attempt to connect to the\
-        given network.\
-        </p>\
-        </body>\
-        </html>"
+	"<html>"
+	"<head><title>HBFC/D Config Submission</title></head>"
+	"<body>"
+	"<p>"
+	"Wireless configuration submitted. The system will attempt to connect to the "
+	"given network."
+	"</p>"
+	"</body>"
+	"</html>"
 };
 
 static bool captive_ext_connect = 0;
@@ -178,9 +168,6 @@ void ICACHE_FLASH_ATTR user_apmode_init(os_event_t *e)
 		return; 
         }
 
-	// Set TCP timeout interval to 1 second
-	espconn_regist_time(&tcp_captive_conn, 1, 0);
-
         // Set up TCP server on port 4000
         os_memset(&tcp_captive_ext_conn, 0, sizeof(tcp_captive_ext_conn));      // Clear connection settings
         os_memset(&tcp_captive_ext_proto, 0, sizeof(tcp_captive_ext_proto));
@@ -223,6 +210,7 @@ static void ICACHE_FLASH_ATTR user_captive_connect_cb(void *arg)
         espconn_regist_reconcb(client_conn, user_captive_recon_cb);
         espconn_regist_disconcb(client_conn, user_captive_discon_cb);
         espconn_regist_sentcb(client_conn, user_captive_sent_cb);
+	user_http_accept(client_conn);
 
 	return;
 };
@@ -230,118 +218,150 @@ static void ICACHE_FLASH_ATTR user_captive_connect_cb(void *arg)
 static void ICACHE_FLASH_ATTR user_captive_recon_cb(void *arg, sint8 err)
 {
         PRINT_DEBUG(DEBUG_ERR, "user connection error, code=%d\r\n", err);
+	user_http_close(arg);
 	return;
 };
 
 static void ICACHE_FLASH_ATTR user_captive_discon_cb(void *arg)
 {
         PRINT_DEBUG(DEBUG_LOW, "user disconnected\r\n");
+	user_http_close(arg);
 	return;
 };
 
-static void ICACHE_FLASH_ATTR user_captive_recv_cb(void *arg, char *pusrdata, unsigned short length)
+// Callback Function: user_captive_page(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for GET requests. Sends the configuration page only if the
+//	exterior system is connected, otherwise the wait page
+static void ICACHE_FLASH_ATTR user_captive_page(struct espconn *conn, struct user_http_req *req)
+{
+	if (captive_ext_connect == true) {
+		PRINT_DEBUG(DEBUG_LOW, "sending captive portal\r\n");
+		user_http_respond(conn, 200, "text/html", captive_page, os_strlen(captive_page));
+	} else {
+		PRINT_DEBUG(DEBUG_LOW, "sending wait page\r\n");
+		user_http_respond(conn, 200, "text/html", wait_page, os_strlen(wait_page));
+	}
+
+	return;
+};
+
+// Callback Function: user_captive_submit(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for the configuration form, POSTed to /submit. Saves the
+//	submitted credentials to flash
+static void ICACHE_FLASH_ATTR user_captive_submit(struct espconn *conn, struct user_http_req *req)
 {
-        struct espconn *client_conn = arg;                      // Pull client connection
         sint8 flash_result = 0;                                 // Result of flash operation
-        uint8 *p1;                                              // Char pointers for string manipulations
-        uint8 *p2;                              
-        uint8 *ssid;                                            // User sent SSID
-        uint8 ssid_len;                                         // Length of the SSID
-        uint8 *pass;                                            // User sent password
-        uint8 pass_len;                                         // Length of the password
+        struct user_kv_lexer lx;                                // Form tokenizer
+        struct user_kv kv;                                      // Current form field
+        const char *ssid = NULL;                                // User sent SSID
+        uint16 ssid_len = 0;                                    // Length of the SSID
+        const char *pass = NULL;                                // User sent password
+        uint16 pass_len = 0;                                    // Length of the password
 	uint8 pass_raw[256];					// Raw password
 	uint8 ssid_raw[256];					// Raw SSID
 
+        PRINT_DEBUG(DEBUG_LOW, "user submitted config\r\n");
+
+        // Pick the fields out of the form in one pass; anything else is ignored
+        user_kv_init(&lx, (const char *)req->body, req->body_len, '&');
+        while (user_kv_next(&lx, &kv)) {
+                if (user_kv_is(kv.key, kv.key_len, "ssid")) {
+                        ssid = kv.val;
+                        ssid_len = kv.val_len;
+                } else if (user_kv_is(kv.key, kv.key_len, "pass")) {
+                        pass = kv.val;
+                        pass_len = kv.val_len;
+                }
+        }
+        if (ssid == NULL) {
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: User submitted a form without an SSID\r\n");
+                user_http_respond(conn, 400, NULL, NULL, 0);
+                return;
+        }
+        if (pass == NULL) {
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: User submitted a form without a password\r\n");
+                user_http_respond(conn, 400, NULL, NULL, 0);
+                return;
+        }
 
-        PRINT_DEBUG(DEBUG_LOW, "received data from client\r\n");
-        PRINT_DEBUG(DEBUG_HIGH, "data=%s\r\n", pusrdata);
-
-        // Check if an HTTP GET request was received
-        if (os_strncmp(pusrdata, "GET ", 4) == 0) {
+	// Make sure the SSID/Pass will fit in the buffers
+	if (ssid_len >= sizeof(ssid_raw)) {
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: User submitted an SSID which was too large\r\n");
+		user_http_respond(conn, 413, NULL, NULL, 0);
+		return;
+	}
+	if (pass_len >= sizeof(pass_raw)) {
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: User submitted a password which was too large\r\n");
+		user_http_respond(conn, 413, NULL, NULL, 0);
+		return;
+	}
 
-                PRINT_DEBUG(DEBUG_HIGH, "http GET request detected\r\n");
+	// Copy the raw HTTP post contents to the "raw" buffers
+	os_memcpy(ssid_raw, ssid, ssid_len);		// Copy raw SSID for fixing
+	os_memcpy(pass_raw, pass, pass_len);		// Copy raw pass for fixing
 	
-		// Send the configuration page only if the exterior system is connected,
-		// otherwise send the wait page
-		if (captive_ext_connect == true) {
-                	PRINT_DEBUG(DEBUG_LOW, "sending captive portal\r\n");
-                	espconn_send(client_conn, (uint8 *)captive_page, os_strlen(captive_page)); 
-		} else {
-			PRINT_DEBUG(DEBUG_LOW, "sending wait page\r\n");
-                	espconn_send(client_conn, (uint8 *)wait_page, os_strlen(wait_page)); 
-		}
+	// "Fix" SSID/pass by decoding escaped characters
+	ssid_len = user_http_post_fix(ssid_raw, ssid_len);
+	pass_len = user_http_post_fix(pass_raw, pass_len);
+
+	// SSID max = 32, Password max = 64. If these are too large, shave them down. Extra input will be ignored		
+	ssid_len = (ssid_len > 32) ? 32 : ssid_len;
+	pass_len = (pass_len > 64) ? 64 : pass_len;
+
+        // Store retrieved data in flash     
+        struct user_data_station_config post_config;
+        os_memcpy(post_config.config.ssid, ssid_raw, ssid_len);
+        os_memcpy(post_config.config.password, pass_raw, pass_len);
+        post_config.config.ssid[ssid_len] = '\0';       // Append null terminators
+        post_config.config.password[pass_len] = '\0';
+
+        flash_result = FLASH_ERASE(USER_DATA_START_SECT);
+        if (flash_result != SPI_FLASH_RESULT_OK) {
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: flash erase failed\r\n");
+                user_http_respond(conn, 500, NULL, NULL, 0);
+                TASK_RETURN(SIG_APMODE, PAR_APMODE_FLASH_FAILURE);
+                return;
         }
 
-        // Check if we received an HTTP POST request
-        else if (os_strncmp(pusrdata, "POST ", 5) == 0) {
-
-		// Send submit page
-                PRINT_DEBUG(DEBUG_LOW, "user submitted config\r\n");
-                espconn_send(client_conn, (uint8 *)submit_page, os_strlen(submit_page));
-
-                // Search for form data
-                p1 = (char *)os_strstr(pusrdata, "ssid=");      // Locate SSID
-                p1 = p1 + 5;                                    // Move past "ssid=" to the actual SSID
-                p2 = os_strchr(p1, '&');                        // Search for &, which separates values
-                ssid_len = (uint8)((uint32)p2 - (uint32)p1);    // Calculate SSID length
-                ssid = p1;                                      // Save location of SSID
-
-                p1 = (char *)os_strstr(pusrdata, "pass=");      // Locate password
-                p1 = p1 + 5;                                    // Move past "pass=" to the actual password
-                pass_len = os_strlen(p1);                       // Calculate password length.
-                pass = p1;
-
-		// Make sure the SSID/Pass will fit in the buffers
-		if (ssid_len > 256) {
-			PRINT_DEBUG(DEBUG_ERR, "ERROR: User submitted an SSID which was too large\r\n");
-			return;
-		}
-		if (pass_len > 256) {
-			PRINT_DEBUG(DEBUG_ERR, "ERROR: User submitted a password which was too large\r\n");
-			return;
-		}
+        flash_result = FLASH_WRITE(USER_DATA_START_ADDR, &post_config);
+        if (flash_result != SPI_FLASH_RESULT_OK) {
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: flash write failed\r\n");
+                user_http_respond(conn, 500, NULL, NULL, 0);
+                TASK_RETURN(SIG_APMODE, PAR_APMODE_FLASH_FAILURE);
+                return;
+        }
+	
+	// Send submit page
+	user_http_respond(conn, 200, "text/html", submit_page, os_strlen(submit_page));
 
-		// Copy the raw HTTP post contents to the "raw" buffers
-		os_memcpy(ssid_raw, ssid, ssid_len);		// Copy raw SSID for fixing
-		os_memcpy(pass_raw, pass, pass_len);		// Copy raw pass for fixing
-		
-		// "Fix" SSID/pass by decoding escaped characters
-		ssid_len = user_http_post_fix(ssid_raw, ssid_len);
-		pass_len = user_http_post_fix(pass_raw, pass_len);
-
-		// SSID max = 32, Password max = 64. If these are too large, shave them down. Extra input will be ignored		
-		ssid_len = (ssid_len > 32) ? 32 : ssid_len;
-		pass_len = (pass_len > 64) ? 64 : pass_len;
-
-                // Store retrieved data in flash     
-                struct user_data_station_config post_config;
-                os_memcpy(post_config.config.ssid, ssid_raw, ssid_len);
-                os_memcpy(post_config.config.password, pass_raw, pass_len);
-                post_config.config.ssid[ssid_len] = '\0';       // Append null terminators
-                post_config.config.password[pass_len] = '\0';
-
-                flash_result = FLASH_ERASE(USER_DATA_START_SECT);
-                if (flash_result != SPI_FLASH_RESULT_OK) {
-                        PRINT_DEBUG(DEBUG_ERR, "ERROR: flash erase failed\r\n");
-                        TASK_RETURN(SIG_APMODE, PAR_APMODE_FLASH_FAILURE);
-                        return;
-                }
+	TASK_RETURN(SIG_APMODE, PAR_APMODE_CONFIG_RECV);
+	return;
+};
 
-                flash_result = FLASH_WRITE(USER_DATA_START_ADDR, &post_config);
-                if (flash_result != SPI_FLASH_RESULT_OK) {
-                        PRINT_DEBUG(DEBUG_ERR, "ERROR: flash write failed\r\n");
-                        TASK_RETURN(SIG_APMODE, PAR_APMODE_FLASH_FAILURE);
-                        return;
-                }
-		
-		TASK_RETURN(SIG_APMODE, PAR_APMODE_CONFIG_RECV);
-		return;		
-        } 
+// Captive portal routes. Any GET gets the portal, so that the probes an OS makes
+// on joining a network find it
+static const struct user_http_route captive_routes[] = {
+	{ HTTP_POST, "/submit", user_captive_submit },
+	{ HTTP_GET, NULL, user_captive_page },
+};
+static const struct user_http_server captive_server = {
+	"captive portal",
+	captive_routes,
+	sizeof(captive_routes) / sizeof(captive_routes[0])
+};
+
+static void ICACHE_FLASH_ATTR user_captive_recv_cb(void *arg, char *pusrdata, unsigned short length)
+{
+        PRINT_DEBUG(DEBUG_LOW, "received data from client\r\n");
+	user_http_recv(&captive_server, arg, pusrdata, length);
+
+	return;
 };
 
 static void ICACHE_FLASH_ATTR user_captive_sent_cb(void *arg)
 {
         PRINT_DEBUG(DEBUG_LOW, "sent data to client\r\n");
+	user_http_sent(arg);
 };
 
 static void ICACHE_FLASH_ATTR user_captive_ext_connect_cb(void *arg)
@@ -403,7 +423,7 @@ void ICACHE_FLASH_ATTR user_ext_send_cred(void)
 	sint16 data_len = 0;				// Length of data. Negative indicates an error
 	sint8 send_result = 0;				// Result of data sending operation
 
-	saved_conn = (struct user_data_station_config *)os_zalloc(sizeof(struct user_data_station_config));
+	saved_conn = (struct user_data_station_config *)user_heap_zalloc(sizeof(struct user_data_station_config));
 	if (saved_conn == NULL) {
 		PRINT_DEBUG(DEBUG_ERR, "ERROR: failed to allocate memory for flash read\r\n");
 		TASK_RETURN(SIG_APMODE, PAR_APMODE_FLASH_FAILURE);
@@ -419,7 +439,7 @@ void ICACHE_FLASH_ATTR user_ext_send_cred(void)
         if (flash_result != SPI_FLASH_RESULT_OK) {
                 PRINT_DEBUG(DEBUG_ERR, "ERROR: flash read failed\r\n");
 		TASK_RETURN(SIG_APMODE, PAR_APMODE_FLASH_FAILURE);
-		os_free(saved_conn);
+		user_heap_free(saved_conn);
                 return;
         }
 
@@ -431,12 +451,12 @@ void ICACHE_FLASH_ATTR user_ext_send_cred(void)
 	if (send_result != 0) {
 		PRINT_DEBUG(DEBUG_ERR, "ERROR: failed to send data to exterior, code=%d\r\n", send_result);
 		TASK_RETURN(SIG_APMODE, PAR_APMODE_SEND_FAILURE);
-		os_free(saved_conn);
+		user_heap_free(saved_conn);
 		return;
 	}; 
 	
 	PRINT_DEBUG(DEBUG_LOW, "sent data\r\n");
-	os_free(saved_conn);
+	user_heap_free(saved_conn);
 	return;
 };
 
@@ -3,221 +3,8 @@
 
 #include "user_connect.h"
 
-// HTML for front end webpage
-const char const *front_page = {
-"HTTP/1.1 200 OK\r\n\
-Content-type: text/html\r\n\r\n\
-<!DOCTYPE html>\
-<html>\
-<head>\
-  <meta charset=\"UTF-8\"/>\
-  <title>HBFC/D Front Page</title>\
-  <script>\
-    var ws;\
-    var debug = 0;\
-    var ext_data = [];\
-    var int_data = [];\
-    function button_ws() {\
-      ws = new WebSocket('ws://' + window.location.hostname + ':80/');\
-      ws.binaryType = \"arraybuffer\";\
-      console.log('WebSocket opened');\
-      ws.onopen = function(evt) {\
-        console.log('WebSocket connected');\
-        ws.send('Hello HBFC/D');\
-      };\
-      ws.onmessage = function(evt) {\
-        if(evt.data instanceof ArrayBuffer) {\
-          var buffer = evt.data;\
-          var view = new DataView(buffer);\
-          var int_element = document.getElementById(\"int_humidity\");\
-          var ext_element = document.getElementById(\"ext_humidity\");\
-          var rpm_element = document.getElementById(\"rpm\");\
-          var int_val = view.getFloat32(0, true);\
-          var ext_val = view.getFloat32(4, true);\
-          int_element.innerHTML = int_val.toPrecision(4);\
-          ext_element.innerHTML = ext_val.toPrecision(4);\
-          rpm_element.innerHTML = view.getInt32(8, true);\
-          if(int_data.length >= 100) {\
-            int_data.shift();\
-            ext_data.shift();\
-            int_data.push(int_val);\
-            ext_data.push(ext_val);\
-          } else {\
-            int_data.push(int_val);\
-            ext_data.push(ext_val);\
-          }\
-          update_plot();\
-        };\
-        ws.send(\"ack\");\
-      };\
-      var ws_init = document.getElementById(\"ws_init\");\
-      ws_init.style.display = \"none\";\
-      var config = document.getElementById(\"config\");\
-      config.style.display = \"block\";\
-      var data = document.getElementById(\"data\");\
-      data.style.display = \"block\";\
-    };\
-    function config_submit() {\
-      if (debug == 0) {\
-        var config_speed = document.getElementById(\"config_speed\");\
-        ws.send(\"speed=\" + config_speed.value + \",mode=normal\");\
-        console.log(\"Sending configuration\");\
-      } else {\
-        var control_mode = document.getElementById(\"control_mode\");\
-        var fan_mode = document.getElementById(\"fan_mode\");\
-        if (control_mode.value == \"speed\") {\
-          var config_speed = document.getElementById(\"config_speed\");\
-          ws.send(\"speed=\" + config_speed.value + \",mode=\" + fan_mode.value);\
-        } else {\
-          var config_delay = document.getElementById(\"config_delay\");\
-          ws.send(\"delay=\" + config_delay.value + \",mode=\" + fan_mode.value);\
-        }\
-      }\
-    };\
-    function toggle_debug() {\
-      if (debug == 0) {\
-        var debug_element = document.getElementById(\"debug\");\
-        debug_element.style.display = \"block\";\
-        debug = 1;\
-      } else {\
-        var debug_element = document.getElementById(\"debug\");\
-        debug_element.style.display = \"none\";\
-        debug = 0;\
-      }\
-    };\
-    function update_plot() {\
-      var plot = document.getElementById(\"plot\");\
-      var ctx = plot.getContext('2d');\
-      ctx.clearRect(0, 0, plot.width, plot.height);\
-      ctx.font = \"14px Arial\";\
-      ctx.fillStyle = \"black\";\
-      ctx.textAlign = \"center\";\
-      ctx.strokeStyle=\"#D3D3D3\";\
-      ctx.lineWidth=0.5;\
-      for (var i = 1; i < 10; i++) {\
-        ctx.fillText(i*10, 10, plot.height - ((i / 10.0) * plot.height) - 1);\
-        ctx.moveTo(15, plot.height - ((i / 10.0) * plot.height));\
-        ctx.lineTo(plot.width, plot.height - ((i / 10.0) * plot.height));\
-        ctx.stroke();\
-      }\
-      ctx.fillText(\"RH (%)\", 35, 15);\
-      for (var i = 1; i < 10; i++) {\
-        ctx.fillText(i*10, (i / 10.0) * plot.width, plot.height - 10);\
-        ctx.moveTo((i / 10.0) * plot.width, plot.height - 20);\
-        ctx.lineTo((i / 10.0) * plot.width, 0);\
-        ctx.stroke();\
-      }\
-      ctx.fillText(\"Time (s)\", plot.width - 30, plot.height - 15);\
-      ctx.strokeStyle=\"#FF0000\";\
-      ctx.lineWidth=3;\
-      ctx.beginPath();\
-      ctx.moveTo(0, (100 - int_data[0]) / 100 * plot.height);\
-      for (var i = 1; i < int_data.length; i++) {\
-        ctx.lineTo((i / 99.0) * plot.width, (100 - int_data[i]) / 100 * plot.height);\
-      }\
-      ctx.stroke();\
-      ctx.strokeStyle=\"#0000FF\";\
-      ctx.lineWidth=3;\
-      ctx.beginPath();\
-      ctx.moveTo(0, (100 - ext_data[0]) / 100 * plot.height);\
-      for (var i = 1; i < ext_data.length; i++) {\
-        ctx.lineTo((i / 99.0) * plot.width, (100 - ext_data[i]) / 100 * plot.height);\
-      }\
-      ctx.stroke();\
-      ctx.strokeStyle=\"#00FF00\";\
-      ctx.lineWidth=3;\
-      ctx.beginPath();\
-      var limit = (40 > ext_data[0]) ? 45 : (ext_data[0] + 5);\
-      ctx.moveTo(0, (100 - limit) / 100 * plot.height);\
-      for (var i = 1; i < ext_data.length; i++) {\
-        limit = (40 > ext_data[i]) ? 45 : (ext_data[i] + 5);\
-        ctx.lineTo((i / 99.0) * plot.width, (100 - limit) / 100 * plot.height);\
-      }\
-      ctx.stroke();\
-      ctx.fillStyle=\"white\";\
-      ctx.strokeStyle=\"black\";\
-      ctx.lineWidth=0.5;\
-      ctx.fillRect(plot.width - 160, plot.height - 150, 100, 90);\
-      ctx.strokeRect(plot.width - 160, plot.height - 150, 100, 90);\
-      ctx.fillStyle=\"black\";\
-      ctx.fillText(\"Int\", plot.width - 140, plot.height - 130);\
-      ctx.fillText(\"Ext\", plot.width - 140, plot.height - 100);\
-      ctx.fillText(\"Spec\", plot.width - 140, plot.height - 70);\
-      ctx.strokeStyle=\"#FF0000\";\
-      ctx.lineWidth=3;\
-      ctx.beginPath();\
-      ctx.moveTo(plot.width - 100, plot.height - 135);\
-      ctx.lineTo(plot.width - 70, plot.height - 135);\
-      ctx.stroke();\
-      ctx.strokeStyle=\"#0000FF\";\
-      ctx.lineWidth=3;\
-      ctx.beginPath();\
-      ctx.moveTo(plot.width - 100, plot.height - 105);\
-      ctx.lineTo(plot.width - 70, plot.height - 105);\
-      ctx.stroke();\
-      ctx.strokeStyle=\"#00FF00\";\
-      ctx.lineWidth=3;\
-      ctx.beginPath();\
-      ctx.moveTo(plot.width - 100, plot.height - 75);\
-      ctx.lineTo(plot.width - 70, plot.height - 75);\
-      ctx.stroke();\
-    }\
-  </script>\
-<body>\
-  <h1>\
-    Humidity Based Fan Controller / Dehumidifer Monitoring & Control\
-  </h1>\
-  <div id=\"ws_init\" style=\"\">\
-    <button id=\"ws_start\" type=\"button\" onclick=\"button_ws();\">Start Websocket</button>\
-  </div>\
-  <div id=\"config\" style=\"display:none\">\
-    Fan Speed (RPM)<br>\
-    <input id=\"config_speed\" type=\"number\" step=\"1\"><br>\
-    <div id=\"debug\" style=\"display:none\">\
-      <br>Triac Firing Delay (microseconds)<br>\
-      <input id=\"config_delay\" type=\"number\" step=\"1\"><br><br>\
-      Control Mode: \
-      <select id=\"control_mode\">\
-        <option value=\"speed\">Fan Speed</option>\
-        <option value=\"delay\">Triac Delay</option>\
-      </select><br>\
-      Fan Mode: \
-      <select id=\"fan_mode\">\
-        <option value=\"normal\">Normal</option>\
-        <option value=\"lock_on\">Force On</option>\
-        <option value=\"lock_off\">Force Off</option>\
-      </select><br>\
-    </div>\
-    <button id=\"config_submit\" type=\"button\" onclick=\"config_submit();\">Modify Configuration</button><br>\
-    <button id=\"debug_on\" type=\"button\" onclick=\"toggle_debug();\">Toggle Debug Mode</button><br>\
-  </div>\
-  <div id=\"data\" style=\"display:none\">\
-    <table>\
-    <tr>\
-      <th>Interior Humidity (%RH)</th>\
-      <td id=\"int_humidity\">Unknown</td>\
-    </tr>\
-    <tr>\
-      <th>Exterior Humidity (%RH)</th>\
-      <td id=\"ext_humidity\">Unknown</td>\
-    </tr>\
-    <tr>\
-      <th>Fan RPM</th>\
-      <td id=\"rpm\">Unknown</td>\
-    </tr>\
-    <table>\
-    <br>\
-    <h2>Humidity vs. Time Plot</h2>\
-    <canvas id=\"plot\" width=\"800\" height=\"600\" style=\"border:1px solid #d3d3d3;\"></canvas>\
-  </div>\
-</body>\
-</html>"
-};
-
 // WebSocket constants
-char *ws_header = "Upgrade: websocket\r\n";
 char *ws_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-char *ws_key = "Sec-WebSocket-Key: ";
 char *ws_response = {
         "HTTP/1.1 101 Switching Protocols\r\n"\
         "Upgrade: websocket\r\n"\
@@ -225,7 +12,19 @@ char *ws_response = {
         "Sec-WebSocket-Accept: %s\r\n\r\n"
 };
 
-static struct espconn *ws_conn = NULL;		// WebSocket control structure
+// WebSocket session table. Sessions are found with user_http_same_peer, as the SDK
+// may hand callbacks a different espconn than the one which was upgraded
+struct user_ws_client {
+	struct espconn *conn;		// Client connection, NULL if the slot is free
+	uint8 remote_ip[4];		// Client address
+	int remote_port;		// Client port
+	bool busy;			// True while a frame is waiting for user_front_sent_cb
+	bool closing;			// True once a close frame has been sent
+	bool stale;			// True if the client needs a key frame (new, or missed a frame)
+	struct user_ws_parser parser;	// Frame parser, resumed on every received segment
+};
+static struct user_ws_client ws_clients[WS_CLIENT_N];
+static uint8 ws_client_n = 0;		// Number of open sessions
 
 // espconn structs - these are control structures for TCP/UDP connections
 static struct espconn tcp_ext_conn;
@@ -235,6 +34,80 @@ static struct _esp_tcp tcp_front_proto;
 
 // WebSocket update timer
 os_timer_t ws_timer;
+static uint8 ws_heap_count = 0;		// Updates since the last heap status frame
+
+#ifdef PROF_ENABLED
+static uint8 ws_prof_buf[WS_PROF_MAX];	// "prof" command reply
+#endif
+
+// Application Function: user_ws_find(struct espconn *conn)
+// Desc: Finds the WebSocket session of a client connection
+// Returns:
+//	Session, or NULL if the connection is not an open WebSocket
+static struct user_ws_client * ICACHE_FLASH_ATTR user_ws_find(struct espconn *conn)
+{
+	uint8 i = 0;
+
+	for (i = 0; i < WS_CLIENT_N; i++) {
+		if ((ws_clients[i].conn != NULL) &&
+		    user_http_same_peer(ws_clients[i].remote_ip, ws_clients[i].remote_port, conn)) {
+			return &ws_clients[i];
+		};
+	};
+
+	return NULL;
+};
+
+// Application Function: user_ws_open(struct espconn *conn)
+// Desc: Takes a free session slot for a connection being upgraded to a WebSocket,
+//	starting the shared update timer with the first session
+// Returns:
+//	Session, or NULL if all WS_CLIENT_N slots are taken
+static struct user_ws_client * ICACHE_FLASH_ATTR user_ws_open(struct espconn *conn)
+{
+	uint8 i = 0;
+
+	for (i = 0; i < WS_CLIENT_N; i++) {
+		if (ws_clients[i].conn == NULL) {
+			ws_clients[i].conn = conn;
+			os_memcpy(ws_clients[i].remote_ip, conn->proto.tcp->remote_ip, 4);
+			ws_clients[i].remote_port = conn->proto.tcp->remote_port;
+			ws_clients[i].busy = true;	// Until the 101 reply has gone, see user_front_sent_cb
+			ws_clients[i].closing = false;
+			ws_clients[i].stale = true;
+			user_ws_parser_init(&ws_clients[i].parser);
+
+			if (ws_client_n++ == 0) {
+				os_timer_setfn(&ws_timer, user_ws_update, NULL);
+				os_timer_arm(&ws_timer, WS_UPDATE_TIME, 1);
+			};
+			PRINT_DEBUG(DEBUG_LOW, "websocket opened, clients=%d\r\n", ws_client_n);
+			return &ws_clients[i];
+		};
+	};
+
+	return NULL;
+};
+
+// Application Function: user_ws_close(struct espconn *conn)
+// Desc: Frees the session of a closed connection, if it had one, stopping the
+//	shared update timer with the last session
+static void ICACHE_FLASH_ATTR user_ws_close(struct espconn *conn)
+{
+	struct user_ws_client *client = user_ws_find(conn);
+
+	if (client == NULL) {
+		return;
+	};
+
+	client->conn = NULL;
+	if (--ws_client_n == 0) {
+		os_timer_disarm(&ws_timer);
+	};
+	PRINT_DEBUG(DEBUG_LOW, "websocket closed, clients=%d\r\n", ws_client_n);
+
+	return;
+};
 
 void ICACHE_FLASH_ATTR user_front_init(os_event_t *e)
 {
@@ -277,6 +150,7 @@ void ICACHE_FLASH_ATTR user_front_connect_cb(void *arg)
         espconn_regist_reconcb(client_conn, user_front_recon_cb);
         espconn_regist_disconcb(client_conn, user_front_discon_cb);
         espconn_regist_sentcb(client_conn, user_front_sent_cb);
+        user_http_accept(client_conn);
 
         return;
 };
@@ -284,20 +158,69 @@ void ICACHE_FLASH_ATTR user_front_connect_cb(void *arg)
 void ICACHE_FLASH_ATTR user_front_recon_cb(void *arg, sint8 err)
 {
         PRINT_DEBUG(DEBUG_ERR, "tcp connection error occured\r\n");
+	user_ws_close(arg);
+	user_hist_close(arg);
+	user_asset_close(arg);
+	user_http_close(arg);
 	return;
 };
 
 void ICACHE_FLASH_ATTR user_front_discon_cb(void *arg)
 {
         PRINT_DEBUG(DEBUG_LOW, "tcp connection disconnected\r\n");
+	user_ws_close(arg);
+	user_hist_close(arg);
+	user_asset_close(arg);
+	user_http_close(arg);
 	return;
 };
 
-void ICACHE_FLASH_ATTR user_front_recv_cb(void *arg, char *pusrdata, unsigned short length)
+// Callback Function: user_front_asset(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for static assets, sent precompressed over several sends (see user_asset.c)
+static void ICACHE_FLASH_ATTR user_front_asset(struct espconn *conn, struct user_http_req *req)
+{
+        const struct user_asset *asset = user_asset_find(req->path);    // Static asset requested
+
+        if (asset == NULL) {
+                PRINT_DEBUG(DEBUG_LOW, "no such page\r\n");
+                user_http_respond(conn, 404, NULL, NULL, 0);
+        } else if (!user_asset_send(conn, asset, req->etag)) {
+                PRINT_DEBUG(DEBUG_ERR, "asset not sent, %d transfers already running or send failed\r\n", ASSET_XFER_N);
+                user_http_respond(conn, 503, NULL, NULL, 0);
+        }
+
+        return;
+};
+
+// Callback Function: user_front_history(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for GET /history, streamed over several sends (see user_history.c)
+static void ICACHE_FLASH_ATTR user_front_history(struct espconn *conn, struct user_http_req *req)
+{
+        if (!user_hist_send(conn)) {
+                PRINT_DEBUG(DEBUG_ERR, "history not sent, transfer already running or send failed\r\n");
+                user_http_respond(conn, 503, NULL, NULL, 0);
+        }
+
+        return;
+};
+
+// Callback Function: user_front_log(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for GET /log, the flash log streamed as /history is
+static void ICACHE_FLASH_ATTR user_front_log(struct espconn *conn, struct user_http_req *req)
+{
+        if (!user_hist_send_log(conn)) {
+                PRINT_DEBUG(DEBUG_ERR, "log not sent, transfer already running or send failed\r\n");
+                user_http_respond(conn, 503, NULL, NULL, 0);
+        }
+
+        return;
+};
+
+// Callback Function: user_front_root(struct espconn *conn, struct user_http_req *req)
+// Desc: Route handler for GET /, which is either the front page or a WebSocket
+//	upgrade. An upgraded connection leaves the HTTP pool for a WebSocket session
+static void ICACHE_FLASH_ATTR user_front_root(struct espconn *conn, struct user_http_req *req)
 {
-        struct espconn *client_conn = arg;      // Pull client connection info
-        uint8 *p1;                              // Character pointers for navagating data
-        uint8 *p2;
         uint8 key[64];                          // Concatenated secure key
         uint8 key_len = 0;                      // Length of secure key
         uint8 guid_len = os_strlen(ws_guid);    // Length of GUID
@@ -308,196 +231,331 @@ void ICACHE_FLASH_ATTR user_front_recv_cb(void *arg, char *pusrdata, unsigned sh
         uint8 response_len = 0;                 // Length of HTTP response
 	sint8 result = 0;			// API call result
 
-        PRINT_DEBUG(DEBUG_LOW, "received data from client\r\n");
-        PRINT_DEBUG(DEBUG_HIGH, "data=%s\r\n", pusrdata);
-
-
-        // Check if we recieved an HTTP GET request
-        if (os_strncmp(pusrdata, "GET ", 4) == 0) {
-                PRINT_DEBUG(DEBUG_HIGH, "http GET request detected\r\n");
-
-                // Check if the request is for a web socket
-                if (os_strstr(pusrdata, ws_header)) {
-
-                        // Get the secure key from the client data
-                        p1 = (uint8 *)os_strstr(pusrdata, ws_key);      // Navigate to key line
-                        p1 += os_strlen(ws_key);                        // Move to beginning of the actual key portion of the key line
-                        p2 = (uint8 *)os_strstr(p1, "\r\n");            // Navigate to end of key
-                        key_len = p2 - p1;
-                        PRINT_DEBUG(DEBUG_HIGH, "found key of length %d\r\n", key_len);
-
-                        // Concatenate the secure key with the GUID for WebSockets
-                        if ((key_len + guid_len) < 64) {
-                                os_memcpy(key, p1, key_len);                            // First half = client key
-                                os_memcpy(&key[key_len], ws_guid, guid_len);            // Second half = GUID
-                                PRINT_DEBUG(DEBUG_HIGH, "concat_key=%s\r\n", key);
-                        } else {
-                                PRINT_DEBUG(DEBUG_ERR, "failed to create websocket response\r\n");
-                                return;
-                        }
+        // Check if the request is for a web socket
+        if (!req->upgrade) {
+                user_front_asset(conn, req);
+                return;
+        }
 
-                        // Calculate SHA-1 Hash
-                        os_memset(sha1_sum, 0, 20);
-                        mbedtls_sha1(key, guid_len + key_len, sha1_sum);
-                        PRINT_DEBUG(DEBUG_HIGH, "sha1_hash=%s\r\n", sha1_sum);
-                        uint16 i = 0;
-                        for (i = 0; i < 20; i++){
-                                PRINT_DEBUG(DEBUG_HIGH, "%x:", sha1_sum[i]);
-                        }
-                        PRINT_DEBUG(DEBUG_HIGH, "\r\n");
-
-                        // Encode SHA-1 Hash in base 64
-                        mbedtls_base64_encode(NULL, 0, &olen, sha1_sum, 20);                                    // Buffer length needed for Base64 encoding -> olen
-                        if (mbedtls_base64_encode(sha1_key, sizeof(sha1_key), &olen, sha1_sum, 20) == 0) {      // Encode in base 64
-
-                                // Form WebSocket request response & send
-                                sha1_key[olen] = '\0';
-                                PRINT_DEBUG(DEBUG_HIGH, "base64=%s\r\n", sha1_key);
-                                response_len = os_sprintf(response_buf, ws_response, sha1_key);
-                                espconn_send(client_conn, response_buf, response_len);
-                                PRINT_DEBUG(DEBUG_HIGH, "sent=%s\r\n", response_buf);
-
-                                // The connection has upgraded to a WebSocket. Apply WebSocket callbacks for data transmission
-                                espconn_regist_recvcb(client_conn, user_ws_recv_cb);
-
-				// Upgrade the keep-alive time for the WebSocket to 30 minutes (1800 seconds)
-				result = espconn_regist_time(client_conn, 1800, true);
-				if (result < 0) {
-					PRINT_DEBUG(DEBUG_ERR, "ERROR: failed to upgrade timeout interval for WebSocket\r\n");
-				}
-
-                                // Arm WebSocket update timer
-                                os_timer_setfn(&ws_timer, user_ws_update, client_conn);
-                                os_timer_arm(&ws_timer, WS_UPDATE_TIME, 1);
-
-                        } else {
-                                PRINT_DEBUG(DEBUG_ERR, "failed to create websocket response\r\n");
-                                return;
-                        }
+        // Refuse the upgrade if every session slot is taken
+        if ((user_ws_find(conn) == NULL) && (user_ws_open(conn) == NULL)) {
+                PRINT_DEBUG(DEBUG_ERR, "websocket refused, %d clients already open\r\n", WS_CLIENT_N);
+                user_http_respond(conn, 503, NULL, NULL, 0);
+                return;
+        }
 
-                // The request is ordinary
-                } else {
-                        PRINT_DEBUG(DEBUG_LOW, "sending front page\r\n");
-                        espconn_send(client_conn, (uint8 *)front_page, os_strlen(front_page));
+        // Concatenate the secure key with the GUID for WebSockets
+        key_len = os_strlen(req->ws_key);
+        PRINT_DEBUG(DEBUG_HIGH, "found key of length %d\r\n", key_len);
+        if ((key_len > 0) && ((key_len + guid_len) < 64)) {
+                os_memcpy(key, req->ws_key, key_len);                   // First half = client key
+                os_memcpy(&key[key_len], ws_guid, guid_len);            // Second half = GUID
+        } else {
+                PRINT_DEBUG(DEBUG_ERR, "failed to create websocket response\r\n");
+                user_ws_close(conn);
+                user_http_respond(conn, 400, NULL, NULL, 0);
+                return;
+        }
+
+        // Calculate SHA-1 Hash
+        os_memset(sha1_sum, 0, 20);
+        mbedtls_sha1(key, guid_len + key_len, sha1_sum);
+
+        // Encode SHA-1 Hash in base 64
+        if (mbedtls_base64_encode(sha1_key, sizeof(sha1_key), &olen, sha1_sum, 20) == 0) {
+
+                // Form WebSocket request response & send
+                sha1_key[olen] = '\0';
+                PRINT_DEBUG(DEBUG_HIGH, "base64=%s\r\n", sha1_key);
+                response_len = os_sprintf(response_buf, ws_response, sha1_key);
+                result = espconn_send(conn, response_buf, response_len);
+                if (result != 0) {
+                        // No sent callback will follow, so the connection is closed
+                        PRINT_DEBUG(DEBUG_ERR, "websocket upgrade send failed, error=%d\r\n", result);
+                        user_ws_close(conn);
+                        espconn_disconnect(conn);
+                        return;
                 }
+                PRINT_DEBUG(DEBUG_HIGH, "sent=%s\r\n", response_buf);
+
+                // The connection has upgraded to a WebSocket. Apply WebSocket callbacks for data transmission
+                espconn_regist_recvcb(conn, user_ws_recv_cb);
+                user_http_close(conn);
+
+		// Upgrade the keep-alive time for the WebSocket to 30 minutes (1800 seconds)
+		result = espconn_regist_time(conn, 1800, true);
+		if (result < 0) {
+			PRINT_DEBUG(DEBUG_ERR, "ERROR: failed to upgrade timeout interval for WebSocket\r\n");
+		}
+
+        } else {
+                PRINT_DEBUG(DEBUG_ERR, "failed to create websocket response\r\n");
+                user_ws_close(conn);
+                user_http_respond(conn, 500, NULL, NULL, 0);
         }
 
         return;
 };
 
-void ICACHE_FLASH_ATTR user_front_sent_cb(void *arg)
+// Front end routes. Any other GET path is looked up among the static assets
+static const struct user_http_route front_routes[] = {
+        { HTTP_GET, "/", user_front_root },
+        { HTTP_GET, "/history", user_front_history },
+        { HTTP_GET, "/log", user_front_log },
+        { HTTP_GET, "/api/status", user_api_status },
+        { HTTP_GET, "/api/config", user_api_config_get },
+        { HTTP_PUT, "/api/config", user_api_config_put },
+        { HTTP_GET, NULL, user_front_asset },
+};
+static const struct user_http_server front_server = {
+        "front end",
+        front_routes,
+        sizeof(front_routes) / sizeof(front_routes[0])
+};
+
+void ICACHE_FLASH_ATTR user_front_recv_cb(void *arg, char *pusrdata, unsigned short length)
 {
-        PRINT_DEBUG(DEBUG_LOW, "sent to client\r\n");
+        PRINT_DEBUG(DEBUG_LOW, "received data from client\r\n");
+        user_http_recv(&front_server, arg, pusrdata, length);
+
+        return;
 };
 
-void ICACHE_FLASH_ATTR user_ws_recv_cb(void *arg, char *pusrdata, unsigned short length)
+void ICACHE_FLASH_ATTR user_front_sent_cb(void *arg)
 {
-        struct espconn *client_conn = arg;      // Grab connection
-        uint8 opcode = 0;                       // WebSocket packet Opcode
-        uint64 payload_len = 0;                 // Payload size
-        uint8 mask[4];                          // Payload mask
-        bool mask_flag = 0;                     // Flag indicating if data is masked
-        uint8 mask_start = 0;                   // Index of start of mask
-        uint64 i = 0;                           // Loop index
-
-        /* Websocket Packet Structure ================================= */
-        /*                                                              */
-        /* Byte 0:                                                      */
-        /*      Bit 0:    FIN (1 if last packet, 0 otherwise            */
-        /*      Bit 1-3:  RSV (Reserved)                                */
-        /*      Bit 4-7:  OPCODE (denotes data type                     */
-        /* Byte 1:                                                      */
-        /*      Bit 0:    MASK (1 if data is masked)                    */
-        /*      Bit 1-7:  Payload Length (length of actual data)        */
-        /* ----- If Payload Length is 126        ---------------------- */
-        /* Byte 2-3:                                                    */
-        /*      Bit 0-7:  Extended payload length                       */
-        /* Byte 4-7:                                                    */
-        /*      Bit 0-7:  Masking key                                   */
-        /* ----- If Payload Length is 127 ----------------------------- */
-        /* Byte 2-9:                                                    */
-        /*      Bit 0-7:  Extended payload length                       */
-        /* Byte 10-13:                                                  */
-        /*      Bit 0-7:  Masking key                                   */
-        /* ----- Else ------------------------------------------------- */
-        /* Byte 2-5:                                                    */
-        /*      Bit 0-7: Masking key                                    */
-        /* ---- Always ------------------------------------------------ */
-        /* Byte 6/8/14 - ?:                                             */
-        /*      Bit 0-7: Payload data                                   */
-        /* ============================================================ */
-
-        // The smallest possible packet (Opcode and payload length with no mask or payload)
-        if (length < 2) {
-                PRINT_DEBUG(DEBUG_ERR, "received malformed ws packet\r\n");
+        struct user_ws_client *client = user_ws_find(arg);
+
+        // WebSocket frames are frequent, so only report page sends. Once a response
+        //      is out, a request which arrived meanwhile may be answered
+        if (user_hist_sent(arg) || user_asset_sent(arg)) {
                 return;
+        } else if (client != NULL) {
+                client->busy = false;
+        } else {
+                PRINT_DEBUG(DEBUG_LOW, "sent to client\r\n");
+                user_http_sent(arg);
         }
+};
 
-        // Evaluate Opcode
-        opcode = (pusrdata[0] & 0x0F);
-        switch (opcode) {
-                case 0x01:      // Text   data
-                case 0x02:      // Binary data
-                case 0x08:      // Close signal
-                        os_printf("opcode=%d\r\n", opcode);
-
-                        // Parse payload length
-                        payload_len = (pusrdata[1] & 0xEF);
-                        if (payload_len == 126) {
-                                payload_len = ((uint64)pusrdata[2] << 8) | ((uint64)pusrdata[3] << 16);
-                                mask_start = 4;
-                        } else if (payload_len == 127) {
-                                payload_len = ((uint64)pusrdata[2] << 0) | ((uint64)pusrdata[3] << 8) | ((uint64)pusrdata[4] << 16) | ((uint64)pusrdata[5] << 24);
-                                payload_len |= ((uint64)pusrdata[6] << 32) | ((uint64)pusrdata[7] << 40) | ((uint64)pusrdata[8] << 48) | ((uint64)pusrdata[9] << 56);
-                                mask_start = 10;
-                        } else {
-                                mask_start = 2;
-                        }
+// Application Function: user_ws_send_ctl(struct user_ws_client *client, uint8 opcode, uint8 *data, uint16 len)
+// Desc: Sends a control frame (close or pong) to a session
+static void ICACHE_FLASH_ATTR user_ws_send_ctl(struct user_ws_client *client, uint8 opcode, uint8 *data, uint16 len)
+{
+        uint8 frame[4 + WS_CTL_MAX];    // Header and payload
+        uint8 hdr_len = 0;              // Header length
+        sint8 result = 0;               // Function result
+
+        len > WS_CTL_MAX ? (len = WS_CTL_MAX) : 0;
+        hdr_len = user_ws_frame_header(frame, opcode, len);
+        os_memcpy(&frame[hdr_len], data, len);
+
+        result = espconn_send(client->conn, frame, hdr_len + len);
+        if (result == 0) {
+                client->busy = true;
+        } else {
+                PRINT_DEBUG(DEBUG_ERR, "websocket control send failed, opcode=%d error=%d\r\n", opcode, result);
+        }
 
-                        // Extract mask if necessary
-                        mask_flag = pusrdata[1] & 0x80;
-                        if (mask_flag == 0) {
-                                os_printf("received unmasked packet=%s\r\n", pusrdata);
-                                return;
-                        }
-                        os_strncpy(mask, &pusrdata[mask_start], 4);
+        return;
+};
+
+#ifdef PROF_ENABLED
+// Application Function: user_ws_prof(struct user_ws_client *client, uint8 *data, uint16 len)
+// Desc: Runs the timing debug commands. "prof" prints the table over the UART
+//	and sends it back as a JSON text frame (see user_prof.h), "prof_reset"
+//	clears it
+// Returns:
+//	true if the message was one of the commands
+static bool ICACHE_FLASH_ATTR user_ws_prof(struct user_ws_client *client, uint8 *data, uint16 len)
+{
+        struct user_json_writer w;      // Reply, written after room for the longest header
+        uint8 hdr[4];                   // Header, 2 or 4 bytes
+        uint8 hdr_len = 0;
+        sint8 result = 0;               // Function result
+
+        if (user_kv_is((const char *)data, len, "prof_reset")) {
+                user_prof_reset();
+                return true;
+        } else if (!user_kv_is((const char *)data, len, "prof")) {
+                return false;
+        }
+
+        user_prof_print();
+        user_json_init(&w, (char *)&ws_prof_buf[4], WS_PROF_MAX - 4);
+        user_prof_json(&w);
+        if (w.overflow) {
+                PRINT_DEBUG(DEBUG_ERR, "prof table does not fit a frame\r\n");
+                return true;
+        }
 
-                        // Perform unmasking operation: each byte can be unmasked by XORing it with byte (i % 4) of the mask
-                        for (i = 0; i < (length - mask_start - 4); i++) {
-                                pusrdata[mask_start + 4 + i] ^= mask[i % 4];
+        hdr_len = user_ws_frame_header(hdr, WS_OP_TEXT, w.len);
+        os_memcpy(&ws_prof_buf[4 - hdr_len], hdr, hdr_len);
+        result = espconn_send(client->conn, &ws_prof_buf[4 - hdr_len], hdr_len + w.len);
+        if (result == 0) {
+                client->busy = true;
+        } else {
+                PRINT_DEBUG(DEBUG_ERR, "prof send failed, error=%d\r\n", result);
+        }
+
+        return true;
+};
+#endif
+
+// Callback Function: user_ws_message(void *arg, uint8 opcode, uint8 *data, uint16 len)
+// Desc: Parser callback, called once per complete message or control frame
+static void ICACHE_FLASH_ATTR user_ws_message(void *arg, uint8 opcode, uint8 *data, uint16 len)
+{
+        struct user_ws_client *client = arg;    // Session the frame arrived on
+        uint8 status[2];                        // Close status code, big endian
+
+        switch (opcode) {
+                case WS_OP_TEXT:
+                case WS_OP_BINARY:
+                        PRINT_DEBUG(DEBUG_LOW, "websocket message=%s\r\n", data);
+#ifdef PROF_ENABLED
+                        if (user_ws_prof(client, data, len)) {
+                                break;
+                        }
+#endif
+                        user_ws_parse_data(data, len);
+                        break;
+                case WS_OP_PING:
+                        user_ws_send_ctl(client, WS_OP_PONG, data, len);
+                        break;
+                case WS_OP_CLOSE:
+                        // Echo the client's status code; the client then drops the connection
+                        if (!client->closing) {
+                                client->closing = true;
+                                if (len < 2) {
+                                        status[0] = WS_CLOSE_NORMAL >> 8;
+                                        status[1] = WS_CLOSE_NORMAL & 0xFF;
+                                        data = status;
+                                }
+                                user_ws_send_ctl(client, WS_OP_CLOSE, data, 2);
                         }
-                        os_printf("received masked packet=%s\r\n", &pusrdata[mask_start + 4]);
-			user_ws_parse_data(&pusrdata[mask_start + 4], length - mask_start - 4);
+                        break;
+                default:        // Pongs are unsolicited, nothing to do
                         break;
         };
+
         return;
 };
 
-void ICACHE_FLASH_ATTR user_ws_update(void *parg)
+void ICACHE_FLASH_ATTR user_ws_recv_cb(void *arg, char *pusrdata, unsigned short length)
 {
-        sint8 result = 0;                       // Function result
-        struct espconn *ws_conn = parg;         // Grab WebSocket connection
-        uint8 data[14];                         // Packet data
-        os_memset(&data, 0, 14);
+        struct user_ws_client *client = user_ws_find(arg);     // Session the data belongs to
+        uint16 code = 0;                                        // Close status from the parser
+        uint8 status[2];                                        // Close status code, big endian
 
-        // Contruct packet. See user_sw_recv_cb for information on WebSocket packet structure.
-        //      Packets from the server should never be masked
+        if (client == NULL) {
+                PRINT_DEBUG(DEBUG_ERR, "websocket data from unknown client\r\n");
+                return;
+        }
 
+        // Frames may be split across segments or share one; the parser keeps its
+        //      place between calls. See user_ws.c for the frame structure
+        code = user_ws_parse(&client->parser, (uint8 *)pusrdata, length, user_ws_message, client);
+        if ((code != 0) && !client->closing) {
+                client->closing = true;
+                status[0] = code >> 8;
+                status[1] = code & 0xFF;
+                user_ws_send_ctl(client, WS_OP_CLOSE, status, 2);
+        }
 
-        // Contruct bytes 1 & 2
-        data[0] = (0x80) | (0x02);     // Unfragmented, binary data
-        data[1] = 0x0C;                // Unmasked, payload length 12 bytes
+        return;
+};
 
-        // Add humidity data
-	os_memcpy(&data[2], &sensor_data_int, 4);
-	os_memcpy(&data[6], &sensor_data_ext, 4);
+// Application Function: user_ws_heap_frame(uint8 *buf)
+// Desc: Builds a WebSocket text frame of the heap counters
+// Returns:
+//	Frame length in bytes. buf must hold 3 + WS_CTL_MAX bytes, the last for the
+//	writer's NUL. A payload of at most WS_CTL_MAX keeps the header at 2 bytes;
+//	counters which would not fit are left out
+static uint8 ICACHE_FLASH_ATTR user_ws_heap_frame(uint8 *buf)
+{
+        struct user_json_writer w;              // Payload, after the header
+        struct user_heap_stats s;               // Counters
+
+        user_heap_stats(&s);
+        user_json_init(&w, (char *)&buf[2], WS_CTL_MAX + 1);
+        user_json_open(&w, NULL, '{');
+        user_json_open(&w, "heap", '{');
+        user_json_int(&w, "live", s.live);
+        user_json_int(&w, "peak", s.peak);
+        user_json_int(&w, "allocs", s.allocs);
+        user_json_int(&w, "frees", s.frees);
+        user_json_int(&w, "failed", s.failed);
+        user_json_int(&w, "free", s.free_heap);
+        user_json_close(&w, '}');
+        user_json_close(&w, '}');
+
+        return user_ws_frame_header(buf, WS_OP_TEXT, w.len) + w.len;
+};
 
-	// Add measured RPM
-	os_memcpy(&data[10], &measured_rpm, 4);
+void ICACHE_FLASH_ATTR user_ws_update(void *parg)
+{
+        sint8 result = 0;                       // Function result
+        uint8 delta[TLM_FRAME_MAX];             // Frame of changed fields
+        uint8 delta_len = 0;
+        uint8 key[TLM_FRAME_MAX];               // Frame of every field
+        uint8 key_len = 0;
+        uint16 mask = 0;                        // Fields in the delta frame
+        uint8 heap[3 + WS_CTL_MAX];             // Heap status frame
+        uint8 heap_len = 0;
+        uint8 i = 0;                            // Session index
+        PROF_START(PROF_WS_UPDATE);
+
+        // Only fields which changed since the last update are sent, see user_telemetry.h.
+        //      A client which missed the last frame can't apply a delta, so gets a key frame
+        mask = user_tlm_next();
+        if (mask != 0) {
+                delta_len = user_tlm_frame(delta, mask);
+        }
 
-        // Send data to WebSocket
-        result = espconn_send(ws_conn, data, 14);
+        // Now and then the heap counters go out instead. Telemetry held back for
+        //      them is made up by a key frame next time, as for a busy client
+        if (++ws_heap_count >= WS_HEAP_N) {
+                ws_heap_count = 0;
+                heap_len = user_ws_heap_frame(heap);
+        }
 
+        for (i = 0; i < WS_CLIENT_N; i++) {
+                if ((ws_clients[i].conn == NULL) || ws_clients[i].closing) {
+                        continue;
+                }
+                // A client still working through the last frame skips this one rather
+                //      than blocking the others
+                if (ws_clients[i].busy) {
+                        ws_clients[i].stale |= (mask != 0);
+                        continue;
+                }
+                if (heap_len != 0) {
+                        result = espconn_send(ws_clients[i].conn, heap, heap_len);
+                        if (result == 0) {
+                                ws_clients[i].busy = true;
+                                ws_clients[i].stale |= (mask != 0);
+                                continue;
+                        }
+                } else if (ws_clients[i].stale) {
+                        if (key_len == 0) {
+                                key_len = user_tlm_frame(key, TLM_ALL);
+                        }
+                        result = espconn_send(ws_clients[i].conn, key, key_len);
+                } else if (mask != 0) {
+                        result = espconn_send(ws_clients[i].conn, delta, delta_len);
+                } else {
+                        continue;
+                }
+                if (result == 0) {
+                        ws_clients[i].busy = true;
+                        ws_clients[i].stale = false;
+                } else {
+                        ws_clients[i].stale = true;
+                        PRINT_DEBUG(DEBUG_ERR, "websocket send failed, client=%d error=%d\r\n", i, result);
+                }
+        }
+
+        PROF_END(PROF_WS_UPDATE);
         return;
 };
 
@@ -518,84 +576,8 @@ void ICACHE_FLASH_ATTR user_endian_flip(uint8 *buf, uint8 n)
 
 void ICACHE_FLASH_ATTR user_ws_parse_data(uint8 *data, uint16 len)
 {
-	uint8 *p1 = NULL;	// Char pointer 1, for data navigation
-	uint8 *p2 = NULL;	// Char pointer 2, for data navigation
-	uint32 speed = 0;	// Fan speed in RPM
-  uint32 delay = 0; // TRIAC delay in us
-
-	// Search for each config element
-	p1 = (uint8 *)os_strstr(data, "speed=");		// Locate speed element
-	if (p1 != NULL) {
-		p1 += 6;						// Move to end of 6 char substr "speed="
-		p2 = (uint8 *)os_strstr(p1, ",");			// Find end of speed element value (CSV)
-		speed = user_atoi(p1, p2 - p1);				// Extract integer fan RPM
-
-		speed > FAN_RPM_MAX ? (speed = FAN_RPM_MAX) : 0;	// Cut speed down to max if RPM is above maximum
-		speed < FAN_RPM_MIN ? (speed = FAN_RPM_MIN) : 0;	// Bump speed up to min if the RPM is below minimum
-		desired_rpm = speed;				// Modify triac delay
-    control_mode = CONTROL_SPEED;
-	}
-  p1 = (uint8 *)os_strstr(data, "delay=");		// Locate speed element
-  if (p1 != NULL) {
-    p1 += 6;						// Move to end of 6 char substr "speed="
-    p2 = (uint8 *)os_strstr(p1, ",");			// Find end of speed element value (CSV)
-    delay = user_atoi(p1, p2 - p1);				// Extract integer fan RPM
-
-    delay > SUPPLY_HALF_CYCLE ? (delay = SUPPLY_HALF_CYCLE) : 0;	// Cut speed down to max if RPM is above maximum
-    delay < 0 ? (delay = 0) : 0;	// Bump speed up to min if the RPM is below minimum
-    desired_delay = delay;				        // Modify triac delay
-    control_mode = CONTROL_DELAY;
-  }
-	p1 = (uint8 *)os_strstr(data, "mode=");			// Locate fan state element
-	if (p1 != NULL) {
-		p1 += 4;				// Move to end of 4 char substr "fan="
-
-    // Check if the state is "on"
-		p2 = (uint8 *)os_strstr(p1, "lock_on");
-		if (p2 != NULL) {
-			fan_mode = FAN_LOCK_ON;
-		}
-
-    // Change if the state is "off"
-		p2 = (uint8 *)os_strstr(p1, "lock_off");
-		if (p2 != NULL) {
-			fan_mode = FAN_LOCK_OFF;
-		}
-
-    // Change if the state is "normal"
-    p2 = (uint8 *)os_strstr(p1, "normal");
-    if (p2 != NULL) {
-      fan_mode = FAN_NORMAL;
-    }
-
-	}
+	// Fan commands are the only messages the front page sends, besides its greeting
+	user_fan_command((const char *)data, len);
 
 	return;
 };
-
-uint32 ICACHE_FLASH_ATTR user_atoi(uint8 *str, uint16 len)
-{
-	uint32 val = 0;		// Converted value
-	uint32 mult = 1;	// Multiplier for each digit
-	sint8 i = 0;		// Loop index
-	uint8 c = 0;		// Extracted character
-	sint16 digit = 0;	// Converted digit
-
-	// A 32 bit unsigned integer can hold at most 10 digits
-	if (len > 10) {
-		PRINT_DEBUG(DEBUG_ERR, "atoi conversion error, input too large\r\n");
-		return 0;
-	}
-
-	// Convert each digit, working from the least significant
-	for (i = (len - 1); i >= 0; i--) {
-		digit = str[i] - 0x30;
-		if ((digit < 0) || (digit > 9)) {	// Stop converting if we find a non-digit
-			return val;
-		}
-		val += (digit * mult);
-		mult *= 10;
-	}
-
-	return val;
-};
@@ -0,0 +1,213 @@
+// user_dlog.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include <stdarg.h>
+#include "user_dlog.h"
+#include "user_task.h"
+
+const char user_dlog_base[] = "dlog: %d records dropped\r\n";
+
+#if DEBUG_LEVEL != DEBUG_NONE
+
+// Record ring. head and tail run free and are masked on use
+static uint8 dlog_ring[DLOG_RING_SIZE];
+static uint16 dlog_head = 0;		// Next byte written
+static uint16 dlog_tail = 0;		// Next byte sent
+static uint32 dlog_dropped = 0;		// Records dropped since the last count went out
+static bool dlog_ready = false;		// Drain task registered
+static bool dlog_posted = false;	// Drain task posted or waiting on dlog_timer
+static os_timer_t dlog_timer;		// Waits for the UART FIFO to empty
+
+// Static function prototypes
+static void ICACHE_FLASH_ATTR user_dlog_drain(os_event_t *e);
+static void ICACHE_FLASH_ATTR user_dlog_post(void *arg);
+
+// Application Function: user_dlog_pack(uint8 *rec, const char *fmt, va_list ap)
+// Desc: Builds a record, walking the format string for its conversions
+// Returns:
+//	Record length
+static uint8 ICACHE_FLASH_ATTR user_dlog_pack(uint8 *rec, const char *fmt, va_list ap)
+{
+	sint32 offset = fmt - user_dlog_base;	// Format address, relative
+	uint8 len = DLOG_HEADER;		// Record length so far
+	const char *s = NULL;			// %s argument
+	uint32 val = 0;				// Any other argument
+	uint8 n = 0;				// Characters of s kept
+
+	rec[0] = DLOG_SYNC_0;
+	rec[1] = DLOG_SYNC_1;
+	rec[3] = offset & 0xFF;
+	rec[4] = (offset >> 8) & 0xFF;
+	rec[5] = (offset >> 16) & 0xFF;
+	rec[6] = (offset >> 24) & 0xFF;
+
+	while (*fmt != '\0') {
+		if (*fmt++ != '%') {
+			continue;
+		};
+
+		// Skip flags, width and length, up to the conversion
+		while ((*fmt != '\0') && (os_strchr("-+ #0123456789.l", *fmt) != NULL)) {
+			fmt++;
+		};
+		if ((*fmt == '\0') || (*fmt == '%')) {
+			fmt += (*fmt != '\0');
+			continue;
+		};
+
+		if (*fmt++ == 's') {
+			s = va_arg(ap, const char *);
+			for (n = 0; (s != NULL) && (n < DLOG_STR_MAX) && (s[n] != '\0'); n++);
+			if (len + 1 + n > DLOG_RECORD_MAX) {
+				break;
+			};
+			rec[len++] = n;
+			os_memcpy(&rec[len], s, n);
+			len += n;
+		} else {
+			val = va_arg(ap, uint32);
+			if (len + 4 > DLOG_RECORD_MAX) {
+				break;
+			};
+			rec[len++] = val & 0xFF;
+			rec[len++] = (val >> 8) & 0xFF;
+			rec[len++] = (val >> 16) & 0xFF;
+			rec[len++] = (val >> 24) & 0xFF;
+		};
+	};
+
+	rec[2] = len - 3;
+
+	return len;
+};
+
+// Application Function: user_dlog_put(const uint8 *rec, uint8 len)
+// Desc: Copies a record into the ring. Called with interrupts masked
+// Returns:
+//	false if the ring has no room for it
+static bool ICACHE_FLASH_ATTR user_dlog_put(const uint8 *rec, uint8 len)
+{
+	uint8 i = 0;
+
+	if ((uint16)(DLOG_RING_SIZE - (uint16)(dlog_head - dlog_tail)) < len) {
+		return false;
+	};
+	for (i = 0; i < len; i++) {
+		dlog_ring[dlog_head++ & (DLOG_RING_SIZE - 1)] = rec[i];
+	};
+
+	return true;
+};
+
+// Application Function: user_dlog_dropped(uint8 *rec, ...)
+// Desc: Builds the dropped records count record
+// Returns:
+//	Record length
+static uint8 ICACHE_FLASH_ATTR user_dlog_dropped(uint8 *rec, ...)
+{
+	va_list ap;
+	uint8 len = 0;
+
+	va_start(ap, rec);
+	len = user_dlog_pack(rec, user_dlog_base, ap);
+	va_end(ap);
+
+	return len;
+};
+
+void ICACHE_FLASH_ATTR user_dlog(const char *fmt, ...)
+{
+	uint8 rec[DLOG_RECORD_MAX];	// Record being built
+	uint8 len = 0;
+	uint8 drop[DLOG_HEADER + 4];	// Dropped count record
+	uint8 drop_len = 0;
+	bool post = false;		// Drain task to be posted
+	va_list ap;
+
+	va_start(ap, fmt);
+	len = user_dlog_pack(rec, fmt, ap);
+	va_end(ap);
+
+	ETS_INTR_LOCK();
+	if (dlog_dropped != 0) {
+		drop_len = user_dlog_dropped(drop, dlog_dropped);
+		if (user_dlog_put(drop, drop_len)) {
+			dlog_dropped = 0;
+		};
+	};
+	if ((dlog_dropped != 0) || !user_dlog_put(rec, len)) {
+		dlog_dropped++;
+	};
+	post = dlog_ready && !dlog_posted;
+	dlog_posted |= post;
+	ETS_INTR_UNLOCK();
+
+	if (post) {
+		system_os_post(USER_TASK_PRIO_0, 0, 0);
+	};
+
+	return;
+};
+#endif
+
+void ICACHE_FLASH_ATTR user_dlog_init(void)
+{
+#if DEBUG_LEVEL != DEBUG_NONE
+	system_os_task(user_dlog_drain, USER_TASK_PRIO_0, user_msg_queue_0, MSG_QUEUE_LENGTH);
+	os_timer_setfn(&dlog_timer, user_dlog_post, NULL);
+	dlog_ready = true;
+	dlog_posted = true;
+	system_os_post(USER_TASK_PRIO_0, 0, 0);
+#endif
+
+	return;
+};
+
+#if DEBUG_LEVEL != DEBUG_NONE
+// Callback Function: user_dlog_post(void *arg)
+// Desc: dlog_timer callback, resumes draining
+void ICACHE_FLASH_ATTR user_dlog_post(void *arg)
+{
+	system_os_post(USER_TASK_PRIO_0, 0, 0);
+
+	return;
+};
+
+// User Task: user_dlog_drain(os_event_t *e)
+// Desc: Moves whole records from the ring to the UART FIFO while they fit.
+//	Tasks don't pre-empt one another, so nothing else printed lands inside
+//	a record
+void ICACHE_FLASH_ATTR user_dlog_drain(os_event_t *e)
+{
+	uint16 room = 0;	// Free bytes in the UART FIFO
+	uint8 len = 0;		// Record length
+	uint8 i = 0;
+
+	room = DLOG_UART_FIFO_SIZE - DLOG_UART_TX_COUNT(READ_PERI_REG(DLOG_UART_STATUS));
+	for (;;) {
+		ETS_INTR_LOCK();
+		if (dlog_tail == dlog_head) {
+			dlog_posted = false;
+			ETS_INTR_UNLOCK();
+			return;
+		};
+		ETS_INTR_UNLOCK();
+
+		// Only the tail moves here, and a record is complete once head passes it
+		len = 3 + dlog_ring[(dlog_tail + 2) & (DLOG_RING_SIZE - 1)];
+		if (len > room) {
+			break;
+		};
+		for (i = 0; i < len; i++) {
+			WRITE_PERI_REG(DLOG_UART_FIFO, dlog_ring[dlog_tail++ & (DLOG_RING_SIZE - 1)]);
+		};
+		room -= len;
+	};
+
+	// Come back once the FIFO has had time to empty
+	os_timer_arm(&dlog_timer, DLOG_WAIT_TIME, false);
+
+	return;
+};
+
+#endif
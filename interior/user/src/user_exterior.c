@@ -5,7 +5,6 @@
 
 // Discovery key details
 static const uint8 const *discovery_recv_key = "hbfcd_exterior_confirm";
-static const uint16 discovery_recv_keylen = 22;
 
 // Exterior connection flag
 static bool ext_conn_flag = false;
@@ -18,10 +17,22 @@ static struct _esp_udp udp_broadcast_proto;
 static struct espconn tcp_espconnect_conn;
 static struct _esp_tcp tcp_espconnect_proto;
 
+// Link protocol state for the exterior connection
+static struct user_link_decoder ext_decoder;
+static uint16 ext_seq_next = 0;		// Sequence number expected next
+static bool ext_seq_valid = false;	// false until the first frame of a connection
+static uint16 ack_seq = 0;		// Sequence number of the next ACK sent
+static uint8 ack_buf[LINK_HEADER_SIZE + 2];
+
+// Exterior samples (0.01 %RH) waiting for the next humidity tick
+static volatile uint32 ext_sample_buf[EXT_SAMPLE_N];
+static struct user_ring ext_sample_ring = USER_RING_INIT(ext_sample_buf);
+
 // Static function prototypes
 static void ICACHE_FLASH_ATTR user_broadcast_recv_cb(void *arg, char *pusrdata, unsigned short length);
 static void ICACHE_FLASH_ATTR user_espconnect_connect_cb(void *arg);
 static void ICACHE_FLASH_ATTR user_espconnect_recv_cb(void *arg, char *pusrdata, unsigned short length);
+static void ICACHE_FLASH_ATTR user_espconnect_frame(void *arg, const struct user_link_frame *frame);
 static void ICACHE_FLASH_ATTR user_espconnect_sent_cb(void *arg);
 static void ICACHE_FLASH_ATTR user_espconnect_recon_cb(void *arg, sint8 err);
 static void ICACHE_FLASH_ATTR user_espconnect_discon_cb(void *arg);
@@ -56,20 +67,32 @@ void ICACHE_FLASH_ATTR user_broadcast_init(os_event_t *e)
 
 void ICACHE_FLASH_ATTR user_broadcast_recv_cb(void *arg, char *pusrdata, unsigned short length)
 {
-	// Expecting discovery data in the format key=xxxxx,ip=xxx.xxx.xxx.xxx.
-	// Note the ending '.' and that the number of x's between each set of points can be 1-3
+	// Expecting discovery data in the format key=xxxxx&ip=xxx.xxx.xxx.xxx
+	// Note that the number of x's between each set of points can be 1-3
 	
 	struct espconn *client_conn = arg;	// Grab connection info
-	char *p1 = NULL;			// Data pointer 1 (for navigation)
-	char *p2 = NULL;			// Data pointer 2 (for navigation)
-	uint32 octet = 0;			// IP octet value
-	uint8 i = 0;				// Loop index
-
-	PRINT_DEBUG(DEBUG_HIGH, "recevied data (udp %d): data=%s\r\n)", BROADCAST_PORT, pusrdata);
+	struct user_kv_lexer lx;		// Packet tokenizer
+	struct user_kv kv;			// Current field
+	bool key_match = false;			// Packet carried the discovery key
+	const char *ip = NULL;			// IP field
+	uint16 ip_len = 0;			// Length of the IP field
+	uint8 remote_ip[4];			// Converted IP
+
+	PRINT_DEBUG(DEBUG_HIGH, "recevied data (udp %d): length=%d\r\n", BROADCAST_PORT, length);
+
+	// Read the packet's fields in one pass
+	user_kv_init(&lx, pusrdata, length, '&');
+	while (user_kv_next(&lx, &kv)) {
+		if (user_kv_is(kv.key, kv.key_len, "key")) {
+			key_match = user_kv_is(kv.val, kv.val_len, (const char *)discovery_recv_key);
+		} else if (user_kv_is(kv.key, kv.key_len, "ip")) {
+			ip = kv.val;
+			ip_len = kv.val_len;
+		}
+	}
 
 	// Check if the connecting client provided the discovery key
-	p1 = (uint8 *)os_strstr(pusrdata, discovery_recv_key);
-	if (p1 != NULL) {
+	if (key_match) {
 	
 		PRINT_DEBUG(DEBUG_HIGH, "discovery key match detected, from ip=%d.%d.%d.%d\r\n",
                 	client_conn->proto.tcp->remote_ip[0],
@@ -77,39 +100,21 @@ void ICACHE_FLASH_ATTR user_broadcast_recv_cb(void *arg, char *pusrdata, unsigne
                 	client_conn->proto.tcp->remote_ip[2],
                 	client_conn->proto.tcp->remote_ip[3]);
 
-		// Skip to end of key, then to start of IP    V
-		p1 += discovery_recv_keylen;  // key=xxxxxxxxx&ip=xxx.xxx.xxx.xxx.
-		p1 += 4;		      //                  ^
-	
 		// If the exterior is not yet connected, retrieve the exterior's IP from the discovery packet
 		// and apply it to the TCP connection control structure	
 		if (ext_conn_flag == false) {
 
+			// If the address doesn't convert, the ip is malformed
+			if ((ip == NULL) || !user_kv_ip(ip, ip_len, remote_ip)) {
+				PRINT_DEBUG(DEBUG_ERR, "ERROR: received malformed discovery ip\r\n");
+				TASK_RETURN(SIG_DISCOVERY, PAR_DISCOVERY_MALFORMED);
+				return;
+			}
+
 			// Clear exterior TCP control structures in preparation for the new data
                	 	os_memset(&tcp_espconnect_conn, 0, sizeof(tcp_espconnect_conn));
                 	os_memset(&tcp_espconnect_proto, 0, sizeof(tcp_espconnect_proto));
-
-			// Iterate through each octet and convert	
-			for (i = 0; i < 4; i++) {
-
-				// Look for next decimal point		    p1-v  v-p2
-				p2 = (uint8 *)os_strstr(p1, ".");	// ... xxx.xxx ...
-			
-				// If a decimal point isn't found, the ip is malformed
-				if (p2 == NULL) {	
-					PRINT_DEBUG(DEBUG_ERR, "ERROR: received malformed discovery ip\r\n");
-					TASK_RETURN(SIG_DISCOVERY, PAR_DISCOVERY_MALFORMED);
-					return;
-				}
-
-				// Convert and save octet
-				octet = user_atoi(p1, p2 - p1);
-				tcp_espconnect_proto.remote_ip[i] = octet;
-			
-				// Move first pointer up and repeat
-				p1 = p2;	//			     p2-vv-p1 
-				p1++;		// Discard decimal point ... xxx.xxx ...
-			}
+			os_memcpy(tcp_espconnect_proto.remote_ip, remote_ip, 4);
 	
 			PRINT_DEBUG(DEBUG_HIGH, "discovery ip=%d.%d.%d.%d\r\n",
                 		tcp_espconnect_proto.remote_ip[0],
@@ -164,6 +169,10 @@ void ICACHE_FLASH_ATTR user_espconnect_connect_cb(void *arg)
 
         PRINT_DEBUG(DEBUG_LOW, "connected to exterior system\r\n");
 
+        // Each connection starts a fresh frame stream
+        user_link_decode_init(&ext_decoder);
+        ext_seq_valid = false;
+
         // Register callbacks for connected client
         espconn_regist_recvcb(client_conn, user_espconnect_recv_cb);
         espconn_regist_reconcb(client_conn, user_espconnect_recon_cb);
@@ -176,30 +185,57 @@ void ICACHE_FLASH_ATTR user_espconnect_connect_cb(void *arg)
 
 void ICACHE_FLASH_ATTR user_espconnect_recv_cb(void *arg, char *pusrdata, unsigned short length)
 {
-	struct espconn *ext_conn = arg;	// Grab control structure
-	float *humidity_ext = (float *)os_zalloc(sizeof(float));         // Exterior humidity
+	// Frames may arrive split over several segments or several to a segment
+	user_link_decode(&ext_decoder, (const uint8 *)pusrdata, length, user_espconnect_frame, arg);
 
-	//PRINT_DEBUG(DEBUG_HIGH, "received from exterior: data=%s\r\n", pusrdata);
+        return;
+};
 
-        // Check packet size. If it's less than EXT_PACKET_SIZE then the packet must be malformed, discard
-        if (length != EXT_PACKET_SIZE) {
-                PRINT_DEBUG(DEBUG_ERR, "received malformed exterior packet\r\n");
-		os_free(humidity_ext);
-                return;
-        }
+// Callback Function: user_espconnect_frame(void *arg, const struct user_link_frame *frame)
+// Desc: Called by the link decoder for each frame from the exterior. Queues the
+//	samples for user_ext_update and acknowledges the frame
+void ICACHE_FLASH_ATTR user_espconnect_frame(void *arg, const struct user_link_frame *frame)
+{
+	struct espconn *ext_conn = arg;		// Grab control structure
+	struct user_link_samples samples;	// Decoded batch
+	uint16 len = 0;				// ACK length
+	sint8 result = 0;			// API call result
+	uint8 i = 0;				// Loop index
 
-        // Retreive exterior humidity from packet
-        os_memcpy(humidity_ext, &pusrdata[0], 4);
+	if (!user_link_samples(frame, &samples)) {
+		PRINT_DEBUG(DEBUG_ERR, "received malformed exterior frame, type=%d length=%d\r\n", frame->type, frame->len);
+		return;
+	}
 
-        // Store the exterior humidity
-        sensor_data_ext = *humidity_ext;
+	// TCP neither drops nor reorders, so a gap means frames were lost across a reconnect
+	if (ext_seq_valid && (frame->seq != ext_seq_next)) {
+		PRINT_DEBUG(DEBUG_ERR, "exterior frames missing, expected seq=%d got seq=%d\r\n", ext_seq_next, frame->seq);
+	}
+	ext_seq_next = frame->seq + 1;
+	ext_seq_valid = true;
+
+        // Queue the samples, if the exterior's sensor is answering. A full
+	// queue drops the newest, which only happens if the humidity tick stalls
+	if (samples.status & LINK_STATUS_OK) {
+		for (i = 0; i < samples.n; i++) {
+			user_ring_push(&ext_sample_ring, samples.sample[i]);
+		}
+		sensor_status |= SENSOR_EXT_OK;
+	} else {
+		sensor_status &= ~SENSOR_EXT_OK;
+	}
 	
-	PRINT_DEBUG(DEBUG_HIGH, "received humidity=%d from exterior\r\n", (uint32)(*humidity_ext));
-
-	// Send an ACK to the exterior system
-        // espconn_send(ext_conn, "ack", 3); 
+	PRINT_DEBUG(DEBUG_HIGH, "received exterior frame, seq=%d samples=%d status=%d\r\n",
+		frame->seq, samples.n, samples.status);
+
+	// Acknowledge the frame. The exterior only counts ACKs, so one lost to a
+	// send already in flight does no harm
+	len = user_link_encode_ack(ack_buf, ack_seq++, frame->seq);
+	result = espconn_send(ext_conn, ack_buf, len);
+	if (result < 0) {
+		PRINT_DEBUG(DEBUG_HIGH, "exterior ack not sent, code=%d\r\n", result);
+	}
 
-	os_free(humidity_ext);
         return;
 };
 
@@ -218,9 +254,28 @@ void ICACHE_FLASH_ATTR user_espconnect_recon_cb(void *arg, sint8 err)
 void ICACHE_FLASH_ATTR user_espconnect_discon_cb(void *arg)
 {
         PRINT_DEBUG(DEBUG_LOW, "exterior system disconnected\r\n");
+	sensor_status &= ~SENSOR_EXT_OK;
         return;
 };
 
+void ICACHE_FLASH_ATTR user_ext_update(void)
+{
+	uint32 sample = 0;	// Queued sample
+	uint32 sum = 0;		// Sum of the queued samples
+	uint16 n = 0;		// Number of queued samples
+
+	while (user_ring_pop(&ext_sample_ring, &sample)) {
+		sum += sample;
+		n++;
+	}
+	if (n > 0) {
+		sensor_data_ext = (float)sum / (100.0f * n);
+		PRINT_DEBUG(DEBUG_HIGH, "exterior humidity=%d from %d samples\r\n", (uint32)sensor_data_ext, n);
+	}
+
+	return;
+};
+
 void ICACHE_FLASH_ATTR user_ext_timeout(void)
 {
 	// Run only if the exterior is not yet connected
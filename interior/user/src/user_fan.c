@@ -2,76 +2,294 @@
 // Authors: Christian Auspland & Matthew Blanchard
 
 #include "user_fan.h"
+#include "user_pid.h"
+#include "user_ring.h"
 
 // Variables
 volatile bool drive_flag = false;				// True if the fan should be driven
-volatile sint32 desired_delay = SUPPLY_HALF_CYCLE / 2;
-volatile sint32 drive_delay = SUPPLY_HALF_CYCLE / 2;	// Delay on triac pulse in us
-volatile uint16 tach_cnt = 0;				// Count of tachometer pulses
+volatile sint32 desired_delay = SUPPLY_HALF_NOM / 2;
+volatile sint32 drive_delay = SUPPLY_HALF_NOM / 2;	// Delay on triac pulse in us
 volatile sint32 desired_rpm = 2500;			// The desired RPM of the fan
 volatile sint32 measured_rpm = 0;			// RPM measured by tachometer
 volatile uint8 fan_mode = FAN_NORMAL;
 volatile uint8 control_mode = CONTROL_SPEED;
+volatile uint32 supply_half_cycle = SUPPLY_HALF_NOM;
+volatile uint8 supply_hz = 0;
 
-void user_gpio_isr(uint32 intr_mask, void *arg)
+// Tachometer edge queue. The ISR pushes the time between consecutive tach edges in us
+// and user_tach_calc pops them
+static volatile uint32 tach_buf[TACH_RING_N];
+static struct user_ring tach_ring = USER_RING_INIT(tach_buf);
+static volatile uint32 tach_last = 0;			// Time of the last accepted tach edge
+
+// Zero crossing tracking, only touched by the ISR
+static uint32 zcd_last = 0;			// Time of the last accepted zero crossing
+static uint32 zcd_est = SUPPLY_HALF_NOM << ZCD_FILTER_SHIFT;	// Half cycle estimate in us << ZCD_FILTER_SHIFT
+static uint32 zcd_sum = 0;			// Sum of the current run of valid intervals
+static uint8 zcd_run = 0;			// Length of the current run of valid intervals
+
+// Application Function: user_zcd_track(uint32 cur_time)
+// Desc: Folds the interval since the last zero crossing into the supply half cycle
+//	estimate. Called from the ISR
+// Returns:
+//	false if the edge is too close to the last one to be a real zero crossing
+static bool user_zcd_track(uint32 cur_time)
 {
-	static uint32 last_time = 0;	// Timer value for software debouncing
+	uint32 interval = cur_time - zcd_last;
+
+	if (interval < SUPPLY_HALF_MIN) {
+		return false;
+	};
+	zcd_last = cur_time;
+
+	// A missed crossing or power up gap breaks the run, but keeps the last estimate
+	if (interval > SUPPLY_HALF_MAX) {
+		zcd_run = 0;
+		zcd_sum = 0;
+		return true;
+	};
+
+	if (supply_hz == 0) {
+		// Not locked yet: average a full run to seed the estimate, so a 50 Hz
+		// grid does not have to crawl up from the 60 Hz default
+		zcd_sum += interval;
+		if (++zcd_run < ZCD_LOCK_N) {
+			return true;
+		};
+		zcd_est = (zcd_sum / ZCD_LOCK_N) << ZCD_FILTER_SHIFT;
+	} else {
+		zcd_est += interval - (zcd_est >> ZCD_FILTER_SHIFT);
+	};
+
+	supply_half_cycle = zcd_est >> ZCD_FILTER_SHIFT;
+	supply_hz = (supply_half_cycle > SUPPLY_HALF_50HZ) ? 50 : 60;
+
+	return true;
+};
 
+void user_gpio_isr(uint32 intr_mask, void *arg)
+{
 	uint32 gpio_status = GPIO_REG_READ(GPIO_STATUS_ADDRESS);	// Check which GPIO(s) have an interrupt queued
+	PROF_START(PROF_GPIO_ISR);
 
-	// Check if a ZCD interrupt occured
-	if ((intr_mask & (ZCD_BIT)) && drive_flag) {			// Pulse the triac with appropriate delay if drive flag is set
-		hw_timer_arm(drive_delay);
+	// Check if a ZCD interrupt occured. Noise edges are ignored rather than restarting the triac delay
+	if ((intr_mask & (ZCD_BIT)) && user_zcd_track(system_get_time()) && drive_flag) {
+		hw_timer_arm_pulse(drive_delay, TRIAC_PULSE_PERIOD);	// Pulse the triac with appropriate delay if drive flag is set
 	};
 
 	// Check if a tachometer interrupt occured
 	if (intr_mask & (TACH_BIT)) {
 		uint32 cur_time = system_get_time();	// Use the system time register for software debouncing
-		if ((cur_time - last_time) > 500) {	// 500us debounce
-			tach_cnt++;
-			last_time = cur_time;
+		if ((cur_time - tach_last) > DEBOUNCE_TIME) {
+			user_ring_push(&tach_ring, cur_time - tach_last);	// Dropped if the queue is full
+			tach_last = cur_time;
 		};
 	};
 
 	gpio_intr_ack(intr_mask);
 
+	PROF_END(PROF_GPIO_ISR);
         return;
 };
 
 void user_fire_triac(void)
 {
-	// Pulse the triac
+	PROF_START(PROF_FIRE_TRIAC);
+
+	// Raise the triac gate. The hw_timer has already been re-armed to
+	// drop it again after TRIAC_PULSE_PERIOD
 	gpio_output_set(TRIAC_BIT, 0, TRIAC_BIT, 0);
-	os_delay_us(TRIAC_PULSE_PERIOD);
+
+	PROF_END(PROF_FIRE_TRIAC);
+	return;
+};
+
+void user_release_triac(void)
+{
+	// End the triac pulse
 	gpio_output_set(0, TRIAC_BIT, TRIAC_BIT, 0);
 
 	return;
 };
 
+// Application Function: user_tach_median(uint32 *period, uint8 n)
+// Desc: Finds the median of a short list of pulse periods (sorts in place)
+static uint32 ICACHE_FLASH_ATTR user_tach_median(uint32 *period, uint8 n)
+{
+	uint8 i = 0;	// Loop indices
+	uint8 j = 0;
+	uint32 swp = 0;	// Swap value
+
+	for (i = 1; i < n; i++) {
+		for (j = i; (j > 0) && (period[j - 1] > period[j]); j--) {
+			swp = period[j];
+			period[j] = period[j - 1];
+			period[j - 1] = swp;
+		}
+	}
+
+	return period[n / 2];
+};
+
 void ICACHE_FLASH_ATTR user_tach_calc(void)
 {
-	float freq = 0;					// Calculated frequency
-	static sint32 last_rpm = -3100;			// Last measured RPM
+	static uint32 edge[TACH_MEDIAN_N + 1];		// Most recent edge intervals, oldest first
+	static uint8 edge_n = 0;			// Number of valid entries in edge
+	static uint8 print_cnt = 0;			// Tach periods since the last debug print
+	static bool closed_loop = false;		// True while the speed loop was running last period
+	uint32 period[TACH_MEDIAN_N];			// Pulse periods for the median filter
+	uint32 delta = 0;				// Interval between two edges in us
+	uint16 edges = 0;				// Number of edges this period
+	uint32 dropped = 0;				// Edges lost to a full queue since the last print
+	uint8 i = 0;
+	PROF_START(PROF_TACH_CALC);
 
-	// Calculate RPM
-	freq = ((float)tach_cnt * 1000) / (TACH_PERIOD * 2);	// Convert to pulses/second. Two tach counts are generated per pulse
-	measured_rpm = (freq * 60) / TACH_BLADE_N;		// Convert to rotations per minute
+	// Drain the edge queue, keeping the most recent intervals. An interval longer
+	// than TACH_TIMEOUT means the fan was stopped, so history before it is dropped
+	while (user_ring_pop(&tach_ring, &delta)) {
+		edges++;
+		if (delta > TACH_TIMEOUT) {
+			edge_n = 0;
+			continue;
+		}
+		if (edge_n == TACH_MEDIAN_N + 1) {
+			os_memmove(&edge[0], &edge[1], TACH_MEDIAN_N * sizeof(edge[0]));
+			edge_n--;
+		}
+		edge[edge_n++] = delta;
+	}
+	if ((system_get_time() - tach_last) > TACH_TIMEOUT) {
+		edge_n = 0;
+	}
+
+	// Each pulse period spans two edges (the tape's leading and trailing edge),
+	// so sum neighbouring intervals to cancel out any duty cycle asymmetry
+	if (edge_n >= 2) {
+		for (i = 0; i + 1 < edge_n; i++) {
+			period[i] = edge[i] + edge[i + 1];
+		}
+		delta = user_tach_median(period, edge_n - 1);
+		measured_rpm = 60000000 / (delta * TACH_BLADE_N);
+	} else {
+		measured_rpm = 0;
+	}
 
-	// When the fan is running (RPM reading above minimum), adjust triac drive delay as the measured/desired RPM error changes
+	// When the fan is driven in speed mode, let the controller set the triac delay.
+	// On (re)entry the controller starts from its feed-forward delay
 	if ((drive_flag) && (control_mode == CONTROL_SPEED)) {
-		if (((measured_rpm - last_rpm) < 100) && ((measured_rpm - last_rpm) > -100)) {		// Allow up to 100 RPM error
-			drive_delay += (FEEDBACK_GAIN * (measured_rpm - desired_rpm));			// Proportional control
-			drive_delay = (drive_delay > DELAY_BOUNDH) ? DELAY_BOUNDH : drive_delay;	// Keep drive delay within bounds
-			drive_delay = (drive_delay < DELAY_BOUNDL) ? DELAY_BOUNDL : drive_delay;
+		if (!closed_loop) {
+			user_pid_reset();
+			closed_loop = true;
+		}
+		drive_delay = user_pid_update(desired_rpm, measured_rpm, TACH_PERIOD);
+	} else {
+		closed_loop = false;
+		if (control_mode == CONTROL_DELAY) {
+			drive_delay = desired_delay;
 		}
-		last_rpm = measured_rpm;
-	} else if (control_mode == CONTROL_DELAY) {
-		drive_delay = desired_delay;
 	};
 
-	PRINT_DEBUG(DEBUG_HIGH, "tach_cnt=%d, rpm=%d, freq=%d, drive_flag=%d, drive_delay=%d\r\n", tach_cnt, measured_rpm, (uint32)freq, drive_flag, drive_delay);
+	if (++print_cnt >= TACH_PRINT_N) {
+		dropped = user_atomic_swap(&tach_ring.dropped, 0);
+		PRINT_DEBUG(DEBUG_HIGH, "tach_edges=%d, tach_dropped=%d, rpm=%d, drive_flag=%d, drive_delay=%d, supply=%dHz/%dus\r\n",
+			edges, dropped, measured_rpm, drive_flag, drive_delay, supply_hz, supply_half_cycle);
+		print_cnt = 0;
+	}
+
+	PROF_END(PROF_TACH_CALC);
+	return;
+};
+
+const char *fan_mode_names[FAN_MODE_N] = { "lock_off", "normal", "lock_on", "override" };
+const char *control_mode_names[CONTROL_MODE_N] = { "speed", "delay" };
+#define FAN_CMD_NUM_MAX	100000	// Largest number a command may carry
+
+void ICACHE_FLASH_ATTR user_fan_stage(struct user_fan_settings *set)
+{
+	set->speed = desired_rpm;
+	set->delay = desired_delay;
+	set->control = control_mode;
+	set->mode = fan_mode;
 
-	// Reset pulse count
-	tach_cnt = 0;
 	return;
 };
+
+bool ICACHE_FLASH_ATTR user_fan_apply(struct user_fan_settings *set)
+{
+	if ((set->mode >= FAN_MODE_N) || (set->control >= CONTROL_MODE_N)) {
+		return false;
+	};
+	set->speed > FAN_RPM_MAX ? (set->speed = FAN_RPM_MAX) : 0;
+	set->speed < FAN_RPM_MIN ? (set->speed = FAN_RPM_MIN) : 0;
+	set->delay > SUPPLY_HALF_CYCLE ? (set->delay = SUPPLY_HALF_CYCLE) : 0;
+
+	// Targets before the modes which act on them
+	desired_rpm = set->speed;
+	desired_delay = set->delay;
+	control_mode = set->control;
+	fan_mode = set->mode;
+
+	return true;
+};
+
+// Application Function: user_fan_pair(const struct user_kv *kv, struct user_fan_settings *set)
+// Desc: Checks one pair of a fan command into the staged settings
+// Returns:
+//	false if the pair is not a valid setting
+static bool ICACHE_FLASH_ATTR user_fan_pair(const struct user_kv *kv, struct user_fan_settings *set)
+{
+	uint8 i = 0;	// Loop index
+
+	// Keys differ in length or first letter, so one switch picks the key
+	// and a single compare confirms it
+	switch ((kv->key_len << 8) | kv->key[0]) {
+	case (5 << 8) | 's':
+		if (!user_kv_is(kv->key, kv->key_len, "speed") ||
+		    !user_kv_uint(kv->val, kv->val_len, FAN_CMD_NUM_MAX, &set->speed)) {
+			return false;
+		}
+		set->control = CONTROL_SPEED;
+		return true;
+
+	case (5 << 8) | 'd':
+		if (!user_kv_is(kv->key, kv->key_len, "delay") ||
+		    !user_kv_uint(kv->val, kv->val_len, FAN_CMD_NUM_MAX, &set->delay)) {
+			return false;
+		}
+		set->control = CONTROL_DELAY;
+		return true;
+
+	case (4 << 8) | 'm':
+		if (!user_kv_is(kv->key, kv->key_len, "mode")) {
+			return false;
+		}
+		for (i = 0; i < FAN_MODE_N; i++) {
+			if (user_kv_is(kv->val, kv->val_len, fan_mode_names[i])) {
+				set->mode = i;
+				return true;
+			}
+		}
+		return false;
+
+	default:
+		return false;
+	}
+};
+
+bool ICACHE_FLASH_ATTR user_fan_command(const char *data, uint16 len)
+{
+	struct user_kv_lexer lx;		// Command tokenizer
+	struct user_kv kv;			// Current pair
+	struct user_fan_settings set;		// Staged settings
+
+	user_fan_stage(&set);
+	user_kv_init(&lx, data, len, ',');
+	while (user_kv_next(&lx, &kv)) {
+		if (!user_fan_pair(&kv, &set)) {
+			PRINT_DEBUG(DEBUG_LOW, "fan command refused, bad pair at offset %d\r\n", kv.key - data);
+			return false;
+		}
+	}
+
+	return user_fan_apply(&set);
+};
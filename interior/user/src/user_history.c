@@ -0,0 +1,254 @@
+// user_history.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_history.h"
+#include "user_log.h"
+
+static const char *hist_header = {
+	"HTTP/1.1 200 OK\r\n"
+	"Content-Type: application/octet-stream\r\n"
+	"Cache-Control: no-store\r\n"
+	"Transfer-Encoding: chunked\r\n\r\n"
+};
+
+// Transfer progress
+typedef enum {
+	HIST_IDLE = 0,		// No transfer
+	HIST_HEADER,		// HTTP header sent
+	HIST_DATA,		// Chunks being sent
+	HIST_END,		// Last chunk sent
+} HIST_STATE;
+
+// Sample ring
+static struct user_hist_sample hist_ring[HIST_N];
+static uint32 hist_total = 0;		// Samples ever recorded, hist_total % HIST_N is the next slot
+static uint32 hist_uptime = 0;		// Uptime, seconds
+static uint32 hist_uptime_us = 0;	// Part second of uptime not yet counted, us
+static uint32 hist_last_us = 0;		// system_get_time() at the last record
+
+// Running sums of the readings since the last sample
+static float hist_sum_int = 0;
+static float hist_sum_ext = 0;
+static uint32 hist_sum_rpm = 0;
+static uint32 hist_sum_delay = 0;
+static uint16 hist_n = 0;
+
+// Transfer in progress, found with user_http_same_peer
+static struct espconn *hist_conn = NULL;
+static uint8 hist_remote_ip[4];
+static int hist_remote_port = 0;
+static uint8 hist_state = HIST_IDLE;
+static uint16 (*hist_fill)(uint8 *buf, uint16 max) = NULL;	// Body source, see user_hist_start
+static uint32 hist_pos = 0;		// Next sample to send, counted as hist_total is
+static uint32 hist_end = 0;		// hist_total when the transfer began
+static struct user_log_cursor hist_cursor;	// Next flash log record to send
+static uint8 hist_buf[16 + 8 + (HIST_CHUNK_N * sizeof(struct user_hist_sample)) + 2];	// Size line, blob header, samples, CRLF
+
+// Application Function: user_hist_match(struct espconn *conn)
+// Desc: Checks if a connection belongs to the running transfer
+static bool ICACHE_FLASH_ATTR user_hist_match(struct espconn *conn)
+{
+	return (hist_conn != NULL) && user_http_same_peer(hist_remote_ip, hist_remote_port, conn);
+};
+
+void ICACHE_FLASH_ATTR user_hist_record(void)
+{
+	struct user_hist_sample *s = &hist_ring[hist_total % HIST_N];
+	uint32 now = system_get_time();
+
+	// system_get_time wraps every 71 minutes, so uptime is accumulated from
+	// the time between records instead
+	hist_uptime_us += now - hist_last_us;
+	hist_last_us = now;
+	hist_uptime += hist_uptime_us / 1000000;
+	hist_uptime_us %= 1000000;
+
+	hist_sum_int += sensor_data_int;
+	hist_sum_ext += sensor_data_ext;
+	hist_sum_rpm += (measured_rpm > 0) ? measured_rpm : 0;
+	hist_sum_delay += (drive_delay > 0) ? drive_delay : 0;
+	if (++hist_n < HIST_TICK_N) {
+		return;
+	};
+
+	s->time = hist_uptime;
+	s->hum_int = user_tlm_fixed(hist_sum_int / hist_n, 100);
+	s->hum_ext = user_tlm_fixed(hist_sum_ext / hist_n, 100);
+	s->rpm = user_tlm_clamp(hist_sum_rpm / hist_n);
+	s->delay = user_tlm_clamp(hist_sum_delay / hist_n);
+	hist_total++;
+
+	hist_sum_int = 0;
+	hist_sum_ext = 0;
+	hist_sum_rpm = 0;
+	hist_sum_delay = 0;
+	hist_n = 0;
+
+	return;
+};
+
+// Application Function: user_hist_fill_ring(uint8 *buf, uint16 max)
+// Desc: Body source for GET /history, copies samples out of the ring
+static uint16 ICACHE_FLASH_ATTR user_hist_fill_ring(uint8 *buf, uint16 max)
+{
+	uint16 len = 0;		// Bytes filled
+
+	// Samples overwritten since the transfer began are skipped
+	if ((hist_total > HIST_N) && (hist_pos < hist_total - HIST_N)) {
+		hist_pos = hist_total - HIST_N;
+	};
+	while ((len + sizeof(struct user_hist_sample) <= max) && (hist_pos < hist_end)) {
+		os_memcpy(&buf[len], &hist_ring[hist_pos % HIST_N], sizeof(struct user_hist_sample));
+		len += sizeof(struct user_hist_sample);
+		hist_pos++;
+	};
+
+	return len;
+};
+
+// Application Function: user_hist_fill_log(uint8 *buf, uint16 max)
+// Desc: Body source for GET /log, reads records from the flash log in the
+//	history sample layout, a boot record as a sample with time LOG_BOOT_TIME
+static uint16 ICACHE_FLASH_ATTR user_hist_fill_log(uint8 *buf, uint16 max)
+{
+	struct user_log_entry e;		// Decoded record
+	struct user_hist_sample s;		// Record as sent
+	uint16 len = 0;				// Bytes filled
+
+	while ((len + sizeof(struct user_hist_sample) <= max) && user_log_next(&hist_cursor, &e)) {
+		os_memset(&s, 0, sizeof(s));
+		if (e.type == LOG_REC_BOOT) {
+			s.time = LOG_BOOT_TIME;
+		} else {
+			s.time = e.time;
+			s.hum_int = e.hum_int * 10;
+			s.hum_ext = e.hum_ext * 10;
+			s.rpm = e.rpm;
+			s.delay = e.delay;
+		};
+		os_memcpy(&buf[len], &s, sizeof(s));
+		len += sizeof(s);
+	};
+
+	return len;
+};
+
+// Application Function: user_hist_start(struct espconn *conn, uint16 (*fill)(uint8 *buf, uint16 max))
+// Desc: Sends the response header of a transfer whose body fill produces, a
+//	chunk at a time from user_hist_sent, until it returns 0
+// Returns:
+//	false if the header could not be sent
+static bool ICACHE_FLASH_ATTR user_hist_start(struct espconn *conn, uint16 (*fill)(uint8 *buf, uint16 max))
+{
+	sint8 result = 0;	// Function result
+
+	hist_conn = conn;
+	os_memcpy(hist_remote_ip, conn->proto.tcp->remote_ip, 4);
+	hist_remote_port = conn->proto.tcp->remote_port;
+	hist_fill = fill;
+
+	result = espconn_send(conn, (uint8 *)hist_header, os_strlen(hist_header));
+	if (result != 0) {
+		PRINT_DEBUG(DEBUG_ERR, "history send failed, error=%d\r\n", result);
+		hist_conn = NULL;
+		hist_state = HIST_IDLE;
+		return false;
+	};
+	hist_state = HIST_HEADER;
+
+	return true;
+};
+
+bool ICACHE_FLASH_ATTR user_hist_send(struct espconn *conn)
+{
+	if (hist_conn != NULL) {
+		return false;
+	};
+
+	hist_end = hist_total;
+	hist_pos = (hist_total > HIST_N) ? (hist_total - HIST_N) : 0;
+	PRINT_DEBUG(DEBUG_LOW, "sending history, samples=%d\r\n", hist_end - hist_pos);
+
+	return user_hist_start(conn, user_hist_fill_ring);
+};
+
+bool ICACHE_FLASH_ATTR user_hist_send_log(struct espconn *conn)
+{
+	if (hist_conn != NULL) {
+		return false;
+	};
+
+	user_log_cursor_init(&hist_cursor);
+	PRINT_DEBUG(DEBUG_LOW, "sending flash log\r\n");
+
+	return user_hist_start(conn, user_hist_fill_log);
+};
+
+bool ICACHE_FLASH_ATTR user_hist_sent(struct espconn *conn)
+{
+	uint16 len = 0;		// Chunk data length
+	uint16 start = 0;	// Offset of the chunk in hist_buf
+	uint8 size[8];		// Chunk size line
+	uint8 size_len = 0;	// Chunk size line length
+	sint8 result = 0;	// Function result
+
+	if (!user_hist_match(conn)) {
+		return false;
+	};
+
+	// The trailing chunk has gone, the transfer is done
+	if (hist_state == HIST_END) {
+		PRINT_DEBUG(DEBUG_LOW, "history sent\r\n");
+		hist_conn = NULL;
+		hist_state = HIST_IDLE;
+		return false;
+	};
+
+	// Chunk data goes after room for its size line, which is filled in once the length is known
+	if (hist_state == HIST_HEADER) {
+		hist_buf[16 + len++] = HIST_VERSION & 0xFF;
+		hist_buf[16 + len++] = HIST_VERSION >> 8;
+		hist_buf[16 + len++] = sizeof(struct user_hist_sample) & 0xFF;
+		hist_buf[16 + len++] = sizeof(struct user_hist_sample) >> 8;
+		os_memcpy(&hist_buf[16 + len], &hist_uptime, 4);
+		len += 4;
+		hist_state = HIST_DATA;
+	};
+	len += hist_fill(&hist_buf[16 + len], HIST_CHUNK_N * sizeof(struct user_hist_sample));
+
+	if (len == 0) {
+		// Last chunk: zero size, no trailers
+		os_memcpy(hist_buf, "0\r\n\r\n", 5);
+		start = 0;
+		len = 5;
+		hist_state = HIST_END;
+	} else {
+		size_len = os_sprintf(size, "%x\r\n", len);
+		start = 16 - size_len;
+		os_memcpy(&hist_buf[start], size, size_len);
+		os_memcpy(&hist_buf[16 + len], "\r\n", 2);
+		len += size_len + 2;
+	};
+
+	// A response cut short can't be finished, so the connection is closed and
+	//	its disconnect callback frees it everywhere
+	result = espconn_send(conn, &hist_buf[start], len);
+	if (result != 0) {
+		PRINT_DEBUG(DEBUG_ERR, "history send failed, error=%d\r\n", result);
+		hist_conn = NULL;
+		hist_state = HIST_IDLE;
+		espconn_disconnect(conn);
+	};
+
+	return true;
+};
+
+void ICACHE_FLASH_ATTR user_hist_close(struct espconn *conn)
+{
+	if (user_hist_match(conn)) {
+		hist_conn = NULL;
+		hist_state = HIST_IDLE;
+	};
+
+	return;
+};
@@ -0,0 +1,588 @@
+// user_http.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_http.h"
+
+#define HTTP_RESP_HEAD	128	// Room kept in a response for the status line and headers
+
+// Parser states
+typedef enum {
+	HTTP_S_METHOD = 0,	// Request line: method
+	HTTP_S_TARGET,		// Request line: target
+	HTTP_S_VERSION,		// Request line: version
+	HTTP_S_LINE,		// Start of a header line, or the blank line ending them
+	HTTP_S_NAME,		// Header name
+	HTTP_S_VALUE_WS,	// Space before a header value
+	HTTP_S_VALUE,		// Header value
+	HTTP_S_BODY,		// Body, content_len bytes
+	HTTP_S_DONE,		// Complete request
+	HTTP_S_ERROR,		// Bad request, answered; the rest of the connection is ignored
+} HTTP_STATE;
+
+// Headers kept, by lower case name
+typedef enum {
+	HTTP_H_OTHER = 0,
+	HTTP_H_CONTENT_LENGTH,
+	HTTP_H_CONNECTION,
+	HTTP_H_UPGRADE,
+	HTTP_H_IF_NONE_MATCH,
+	HTTP_H_WS_KEY,
+} HTTP_HEADER;
+static const char *http_headers[] = {
+	"",
+	"content-length",
+	"connection",
+	"upgrade",
+	"if-none-match",
+	"sec-websocket-key",
+};
+#define HTTP_HEADER_N	(sizeof(http_headers) / sizeof(http_headers[0]))
+
+// Connection pool. The slot past HTTP_CONN_N only holds a client being
+//	refused for want of the others, while its 503 goes out
+struct user_http_conn {
+	struct espconn *conn;		// Client connection, NULL if the slot is free
+	uint8 remote_ip[4];		// Client address
+	int remote_port;		// Client port
+	bool busy;			// True while a response is going out
+	bool keep_alive;		// False if the connection closes once the response has gone
+	const struct user_http_server *server;	// Server the connection belongs to
+	struct user_http_req req;	// Request being parsed
+};
+static struct user_http_conn http_conns[HTTP_CONN_N + 1];
+static uint8 http_buf[HTTP_RESP_MAX];	// Response being sent, espconn_send copies it out
+
+// Application Function: user_http_lower(char c)
+// Desc: ASCII lower case
+static char ICACHE_FLASH_ATTR user_http_lower(char c)
+{
+	return ((c >= 'A') && (c <= 'Z')) ? (c + ('a' - 'A')) : c;
+};
+
+// Application Function: user_http_lower_str(char *str)
+// Desc: ASCII lower cases a string in place
+static void ICACHE_FLASH_ATTR user_http_lower_str(char *str)
+{
+	for (; *str != '\0'; str++) {
+		*str = user_http_lower(*str);
+	};
+
+	return;
+};
+
+// Application Function: user_http_reason(uint16 status)
+// Desc: Reason phrase of a status code
+static const char * ICACHE_FLASH_ATTR user_http_reason(uint16 status)
+{
+	switch (status) {
+	case 200: return "OK";
+	case 204: return "No Content";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 404: return "Not Found";
+	case 405: return "Method Not Allowed";
+	case 413: return "Payload Too Large";
+	case 414: return "URI Too Long";
+	case 431: return "Request Header Fields Too Large";
+	case 501: return "Not Implemented";
+	case 503: return "Service Unavailable";
+	default:  return "Internal Server Error";
+	};
+};
+
+// Application Function: user_http_method(const char *tok)
+// Desc: Method code of a method token
+static uint8 ICACHE_FLASH_ATTR user_http_method(const char *tok)
+{
+	if (os_strcmp(tok, "GET") == 0) {
+		return HTTP_GET;
+	} else if (os_strcmp(tok, "POST") == 0) {
+		return HTTP_POST;
+	} else if (os_strcmp(tok, "PUT") == 0) {
+		return HTTP_PUT;
+	} else if (os_strcmp(tok, "HEAD") == 0) {
+		return HTTP_HEAD;
+	};
+
+	return HTTP_OTHER;
+};
+
+// Application Function: user_http_header(struct user_http_req *req)
+// Desc: Applies a header whose value has been read into req->tok
+// Returns:
+//	HTTP_MORE, or the status to answer a bad value with
+static uint16 ICACHE_FLASH_ATTR user_http_header(struct user_http_req *req)
+{
+	uint32 n = 0;		// Content-Length
+	uint8 i = 0;
+
+	switch (req->header) {
+	case HTTP_H_CONTENT_LENGTH:
+		for (i = 0; i < req->tok_len; i++) {
+			if ((req->tok[i] < '0') || (req->tok[i] > '9')) {
+				return 400;
+			};
+			n = (n * 10) + (req->tok[i] - '0');
+			if (n > HTTP_BODY_MAX) {
+				return 413;
+			};
+		};
+		req->content_len = n;
+		break;
+
+	case HTTP_H_CONNECTION:
+		user_http_lower_str(req->tok);
+		if (os_strstr(req->tok, "close") != NULL) {
+			req->keep_alive = false;
+		} else if (os_strstr(req->tok, "keep-alive") != NULL) {
+			req->keep_alive = true;
+		};
+		break;
+
+	case HTTP_H_UPGRADE:
+		user_http_lower_str(req->tok);
+		req->upgrade = (os_strstr(req->tok, "websocket") != NULL);
+		break;
+
+	case HTTP_H_IF_NONE_MATCH:
+		os_memcpy(req->etag, req->tok, req->tok_len + 1);
+		break;
+
+	case HTTP_H_WS_KEY:
+		os_memcpy(req->ws_key, req->tok, req->tok_len + 1);
+		break;
+
+	default:
+		break;
+	};
+
+	return HTTP_MORE;
+};
+
+void ICACHE_FLASH_ATTR user_http_parse_init(struct user_http_req *req)
+{
+	req->state = HTTP_S_METHOD;
+	req->method = HTTP_OTHER;
+	req->keep_alive = true;
+	req->upgrade = false;
+	req->path[0] = '\0';
+	req->query = NULL;
+	req->etag[0] = '\0';
+	req->ws_key[0] = '\0';
+	req->body[0] = '\0';
+	req->body_len = 0;
+	req->content_len = 0;
+	req->tok_len = 0;
+	req->header = HTTP_H_OTHER;
+	req->path_len = 0;
+	req->head_len = 0;
+
+	return;
+};
+
+uint16 ICACHE_FLASH_ATTR user_http_parse(struct user_http_req *req, const uint8 *data, uint16 len, uint16 *used)
+{
+	uint16 status = HTTP_MORE;	// Parse result
+	uint16 i = 0;			// Data index
+	uint16 n = 0;			// Body bytes copied at once
+	uint8 h = 0;			// Header index
+	char c = 0;
+
+	for (i = 0; (i < len) && (status == HTTP_MORE); i++) {
+		c = data[i];
+
+		// The body is copied whole rather than a byte at a time
+		if (req->state == HTTP_S_BODY) {
+			n = req->content_len - req->body_len;
+			n > (len - i) ? (n = len - i) : 0;
+			os_memcpy(&req->body[req->body_len], &data[i], n);
+			req->body_len += n;
+			i += n - 1;
+			if (req->body_len == req->content_len) {
+				req->body[req->body_len] = '\0';
+				req->state = HTTP_S_DONE;
+				status = HTTP_DONE;
+			};
+			continue;
+		};
+
+		if (++req->head_len > HTTP_HEAD_MAX) {
+			status = 431;
+			break;
+		};
+
+		// Lines may end in CRLF or a bare LF
+		if (c == '\r') {
+			continue;
+		};
+
+		switch (req->state) {
+		case HTTP_S_METHOD:
+			if ((c == '\n') && (req->tok_len == 0)) {
+				break;		// Blank lines ahead of a request are allowed
+			} else if (c == ' ') {
+				req->tok[req->tok_len] = '\0';
+				req->method = user_http_method(req->tok);
+				req->tok_len = 0;
+				req->state = HTTP_S_TARGET;
+			} else if ((c == '\n') || (req->tok_len >= HTTP_TOKEN_MAX)) {
+				status = 400;
+			} else {
+				req->tok[req->tok_len++] = c;
+			};
+			break;
+
+		case HTTP_S_TARGET:
+			if (c == ' ') {
+				req->path[req->path_len] = '\0';
+				req->query = (char *)os_strchr(req->path, '?');
+				if (req->query != NULL) {
+					*req->query++ = '\0';
+				};
+				req->state = HTTP_S_VERSION;
+			} else if (c == '\n') {
+				status = 400;
+			} else if (req->path_len >= HTTP_PATH_MAX) {
+				status = 414;
+			} else {
+				req->path[req->path_len++] = c;
+			};
+			break;
+
+		case HTTP_S_VERSION:
+			if (c == '\n') {
+				req->tok[req->tok_len] = '\0';
+				if (os_strncmp(req->tok, "HTTP/1.", 7) != 0) {
+					status = 400;
+				};
+				req->keep_alive = (os_strcmp(req->tok, "HTTP/1.0") != 0);
+				req->tok_len = 0;
+				req->state = HTTP_S_LINE;
+			} else if (req->tok_len >= HTTP_TOKEN_MAX) {
+				status = 400;
+			} else {
+				req->tok[req->tok_len++] = c;
+			};
+			break;
+
+		case HTTP_S_LINE:
+			// A blank line ends the headers
+			if (c == '\n') {
+				if (req->content_len == 0) {
+					req->state = HTTP_S_DONE;
+					status = HTTP_DONE;
+				} else {
+					req->state = HTTP_S_BODY;
+				};
+				break;
+			};
+			req->tok_len = 0;
+			req->state = HTTP_S_NAME;
+			// Fall through
+
+		case HTTP_S_NAME:
+			if (c == ':') {
+				req->tok[req->tok_len] = '\0';
+				req->header = HTTP_H_OTHER;
+				for (h = 1; h < HTTP_HEADER_N; h++) {
+					if (os_strcmp(req->tok, http_headers[h]) == 0) {
+						req->header = h;
+						break;
+					};
+				};
+				req->tok_len = 0;
+				req->state = HTTP_S_VALUE_WS;
+			} else if (c == '\n') {
+				status = 400;
+			} else if (req->tok_len < HTTP_TOKEN_MAX) {
+				req->tok[req->tok_len++] = user_http_lower(c);	// Names longer than any kept are cut, and never match
+			};
+			break;
+
+		case HTTP_S_VALUE_WS:
+			if ((c == ' ') || (c == '\t')) {
+				break;
+			};
+			req->state = HTTP_S_VALUE;
+			// Fall through
+
+		case HTTP_S_VALUE:
+			if (c == '\n') {
+				while ((req->tok_len > 0) && ((req->tok[req->tok_len - 1] == ' ') || (req->tok[req->tok_len - 1] == '\t'))) {
+					req->tok_len--;
+				};
+				req->tok[req->tok_len] = '\0';
+				status = user_http_header(req);
+				req->tok_len = 0;
+				req->state = HTTP_S_LINE;
+			} else if (req->tok_len < HTTP_TOKEN_MAX) {
+				req->tok[req->tok_len++] = c;		// Longer values are cut
+			};
+			break;
+
+		default:
+			status = 400;
+			break;
+		};
+	};
+
+	if ((status != HTTP_MORE) && (status != HTTP_DONE)) {
+		req->state = HTTP_S_ERROR;
+	};
+	*used = i;
+
+	return status;
+};
+
+bool ICACHE_FLASH_ATTR user_http_same_peer(const uint8 *ip, int port, struct espconn *conn)
+{
+	return (port == conn->proto.tcp->remote_port) &&
+	       (os_memcmp(ip, conn->proto.tcp->remote_ip, 4) == 0);
+};
+
+// Application Function: user_http_find(struct espconn *conn)
+// Desc: Finds the pool slot of a connection
+// Returns:
+//	Slot, or NULL if the connection has none
+static struct user_http_conn * ICACHE_FLASH_ATTR user_http_find(struct espconn *conn)
+{
+	uint8 i = 0;
+
+	for (i = 0; i <= HTTP_CONN_N; i++) {
+		if ((http_conns[i].conn != NULL) &&
+		    user_http_same_peer(http_conns[i].remote_ip, http_conns[i].remote_port, conn)) {
+			return &http_conns[i];
+		};
+	};
+
+	return NULL;
+};
+
+// Application Function: user_http_take(struct user_http_conn *c, struct espconn *conn)
+// Desc: Gives a free pool slot to a connection
+static void ICACHE_FLASH_ATTR user_http_take(struct user_http_conn *c, struct espconn *conn)
+{
+	c->conn = conn;
+	os_memcpy(c->remote_ip, conn->proto.tcp->remote_ip, 4);
+	c->remote_port = conn->proto.tcp->remote_port;
+	c->busy = false;
+	c->keep_alive = true;
+	user_http_parse_init(&c->req);
+
+	return;
+};
+
+// Application Function: user_http_open(struct espconn *conn)
+// Desc: Takes a free pool slot for a connection
+// Returns:
+//	Slot, or NULL if all HTTP_CONN_N slots are taken
+static struct user_http_conn * ICACHE_FLASH_ATTR user_http_open(struct espconn *conn)
+{
+	uint8 i = 0;
+
+	for (i = 0; i < HTTP_CONN_N; i++) {
+		if (http_conns[i].conn == NULL) {
+			user_http_take(&http_conns[i], conn);
+			return &http_conns[i];
+		};
+	};
+
+	return NULL;
+};
+
+// Application Function: user_http_fail(struct user_http_conn *c, uint16 status)
+// Desc: Answers a connection with an error status and closes it once the
+//	answer has gone. Anything more the client sends is ignored. If a response
+//	is already going out the error is not sent, the connection just closes
+//	after it
+static void ICACHE_FLASH_ATTR user_http_fail(struct user_http_conn *c, uint16 status)
+{
+	c->req.state = HTTP_S_ERROR;
+	c->keep_alive = false;
+	if (c->busy) {
+		return;
+	};
+
+	c->busy = true;
+	user_http_respond(c->conn, status, NULL, NULL, 0);
+
+	return;
+};
+
+// Application Function: user_http_route(const struct user_http_server *server, struct espconn *conn, struct user_http_req *req)
+// Desc: Calls the handler of the first route matching a request, or answers
+//	404 if no route has its path and 405 if none of those has its method
+static void ICACHE_FLASH_ATTR user_http_route(const struct user_http_server *server, struct espconn *conn, struct user_http_req *req)
+{
+	bool path_found = false;	// A route matched the path
+	uint8 i = 0;
+
+	PRINT_DEBUG(DEBUG_LOW, "%s: request method=%d path=%s\r\n", server->name, req->method, req->path);
+	for (i = 0; i < server->route_n; i++) {
+		if ((server->routes[i].path != NULL) && (os_strcmp(server->routes[i].path, req->path) != 0)) {
+			continue;
+		};
+		path_found = true;
+		if (server->routes[i].method == req->method) {
+			server->routes[i].handler(conn, req);
+			return;
+		};
+	};
+
+	user_http_respond(conn, path_found ? 405 : 404, NULL, NULL, 0);
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_http_accept(struct espconn *conn)
+{
+	sint8 result = 0;	// Function result
+
+	result = espconn_regist_time(conn, HTTP_IDLE_TIME, 1);
+	if (result < 0) {
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: failed to set http idle time, error=%d\r\n", result);
+	};
+
+	return;
+};
+
+// Application Function: user_http_dispatch(struct user_http_conn *c)
+// Desc: Routes the complete request of a connection, then readies the parser
+//	for the next one, unless the handler gave the connection up. Whether the
+//	connection stays open is settled here, as the parser forgets the request
+static void ICACHE_FLASH_ATTR user_http_dispatch(struct user_http_conn *c)
+{
+	struct espconn *conn = c->conn;
+
+	c->busy = true;
+	c->keep_alive = c->req.keep_alive;
+	user_http_route(c->server, conn, &c->req);
+	if (c->conn == conn) {
+		user_http_parse_init(&c->req);
+	};
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_http_recv(const struct user_http_server *server, struct espconn *conn, char *data, unsigned short len)
+{
+	struct user_http_conn *c = user_http_find(conn);	// Pool slot
+	uint16 status = 0;					// Parse result
+	uint16 used = 0;					// Bytes parsed
+
+	// A client with no slot is answered 503 once from the spare slot, and
+	//	closed unanswered if another is already being refused
+	if ((c == NULL) && ((c = user_http_open(conn)) == NULL)) {
+		PRINT_DEBUG(DEBUG_ERR, "%s: request refused, %d connections already open\r\n", server->name, HTTP_CONN_N);
+		c = &http_conns[HTTP_CONN_N];
+		if (c->conn != NULL) {
+			espconn_disconnect(conn);
+			return;
+		};
+		user_http_take(c, conn);
+		c->server = server;
+		user_http_fail(c, 503);
+		return;
+	};
+	c->conn = conn;
+	c->server = server;
+
+	// A bad or refused request leaves the stream unreadable, and a waiting request is answered first
+	if (c->req.state == HTTP_S_ERROR) {
+		return;
+	} else if (c->req.state == HTTP_S_DONE) {
+		PRINT_DEBUG(DEBUG_ERR, "%s: dropped %d bytes following a request\r\n", server->name, len);
+		return;
+	};
+
+	status = user_http_parse(&c->req, (uint8 *)data, len, &used);
+	if (status == HTTP_MORE) {
+		return;
+	};
+	if (used < len) {
+		PRINT_DEBUG(DEBUG_ERR, "%s: dropped %d bytes following a request\r\n", server->name, len - used);
+	};
+
+	if (status != HTTP_DONE) {
+		PRINT_DEBUG(DEBUG_ERR, "%s: bad request, status=%d\r\n", server->name, status);
+		user_http_fail(c, status);
+	} else if (!c->busy) {
+		user_http_dispatch(c);
+	};
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_http_sent(struct espconn *conn)
+{
+	struct user_http_conn *c = user_http_find(conn);
+
+	if (c == NULL) {
+		return;
+	};
+
+	c->conn = conn;
+	c->busy = false;
+	if (!c->keep_alive) {
+		// The response said Connection: close. The slot is freed by the
+		//	disconnect callback, until then the client is ignored
+		c->req.state = HTTP_S_ERROR;
+		espconn_disconnect(conn);
+	} else if (c->req.state == HTTP_S_DONE) {
+		user_http_dispatch(c);
+	};
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_http_close(struct espconn *conn)
+{
+	struct user_http_conn *c = user_http_find(conn);
+
+	if (c != NULL) {
+		c->conn = NULL;
+	};
+
+	return;
+};
+
+bool ICACHE_FLASH_ATTR user_http_respond(struct espconn *conn, uint16 status, const char *type, const char *body, uint16 len)
+{
+	struct user_http_conn *c = user_http_find(conn);	// Pool slot
+	uint16 head_len = 0;	// Status line and headers length
+	sint8 result = 0;	// Function result
+
+	// A response which can't go out gets no sent callback, so the connection
+	//	would stay busy; it is closed instead, and the disconnect callback
+	//	frees its slots
+	if (len > HTTP_RESP_MAX - HTTP_RESP_HEAD) {
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: http response too long, length=%d\r\n", len);
+		espconn_disconnect(conn);
+		return false;
+	};
+
+	head_len = os_sprintf(http_buf, "HTTP/1.1 %d %s\r\n", status, user_http_reason(status));
+	if (type != NULL) {
+		head_len += os_sprintf(&http_buf[head_len], "Content-Type: %s\r\n", type);
+	};
+	// A client turned away now is better off retrying on a new connection later
+	if ((c != NULL) && (status == 503)) {
+		c->keep_alive = false;
+	};
+	if ((c == NULL) || !c->keep_alive) {
+		head_len += os_sprintf(&http_buf[head_len], "Connection: close\r\n");
+	};
+	head_len += os_sprintf(&http_buf[head_len], "Content-Length: %d\r\n\r\n", len);
+	if (body != NULL) {
+		os_memcpy(&http_buf[head_len], body, len);
+	};
+
+	result = espconn_send(conn, http_buf, head_len + len);
+	if (result != 0) {
+		PRINT_DEBUG(DEBUG_ERR, "http send failed, error=%d\r\n", result);
+		espconn_disconnect(conn);
+		return false;
+	};
+
+	return true;
+};
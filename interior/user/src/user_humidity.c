@@ -2,21 +2,40 @@
 // Authors: Christian Auspland & Matthew Blanchard
 
 #include "user_humidity.h"
+#include "user_exterior.h"
+#include "user_history.h"
+#include "user_log.h"
 
 // Humidity data initializations
 float sensor_data_int = 0;
 float sensor_data_ext = 0;
+uint8 sensor_status = 0;
 float threshold_humidity = 40;
 
+// Humidity acquisition state
+static uint8 humidity_state = HUMIDITY_IDLE;	// Current phase of the measurement cycle
+static uint8 humidity_retries = 0;		// Number of fetches which have returned stale data
+static os_timer_t timer_humidity_fetch;		// Timer for fetching measurement results
+
 // Static function prototypes
 static void ICACHE_FLASH_ATTR user_humidity_cmp(void);
 
 void ICACHE_FLASH_ATTR user_read_humidity(void)
 {
-        uint8 status = 0;               // Status reported by humidity sensor
-        uint8 read_byte = 0;            // Byte read from the humidity sensor
-        uint16 humidity = 0;            // Humidity reading w/o calculations
-        float adj_humidity = 0;         // Humidity reading after calculations
+	PROF_START(PROF_READ_HUMIDITY);
+
+	// Every tick takes in the exterior samples received since the last one,
+	// then adds the latest readings to the history and the flash log
+	user_ext_update();
+	user_hist_record();
+	user_log_tick(sensor_data_int, sensor_data_ext, measured_rpm, drive_delay);
+
+	// Don't start a new measurement while one is still being fetched
+	if (humidity_state != HUMIDITY_IDLE) {
+		PRINT_DEBUG(DEBUG_ERR, "humidity measurement still in progress, skipping\r\n");
+		PROF_END(PROF_READ_HUMIDITY);
+		return;
+	}
 
         // Wake up the sensor by sending a measurement request. This consists of the slave's address
         // and a single 0 bit.
@@ -24,14 +43,29 @@ void ICACHE_FLASH_ATTR user_read_humidity(void)
         if (user_i2c_write_byte((SENSOR_ADDR << 1) & 0xFE) == 1) {
                 PRINT_DEBUG(DEBUG_ERR, "slave failed to initiate measurement\r\n");
         	user_i2c_stop_bit();
+		PROF_END(PROF_READ_HUMIDITY);
 		return;
         };
         user_i2c_stop_bit();
 
-        // The average measurement cycle takes 36.65ms. 100ms leaves a good amount
-        // of leeway
-        os_delay_us(50000);
-        os_delay_us(50000);
+        // The average measurement cycle takes 36.65ms. Rather than waiting for it to complete,
+        // return to the SDK and fetch the data from a timer callback once it should be done
+	humidity_state = HUMIDITY_CONVERTING;
+	humidity_retries = 0;
+	os_timer_disarm(&timer_humidity_fetch);
+	os_timer_setfn(&timer_humidity_fetch, user_fetch_humidity, NULL);
+	os_timer_arm(&timer_humidity_fetch, HUMIDITY_CONVERSION_TIME, false);
+
+	PROF_END(PROF_READ_HUMIDITY);
+        return;
+};
+
+void ICACHE_FLASH_ATTR user_fetch_humidity(void)
+{
+        uint8 status = 0;               // Status reported by humidity sensor
+        uint8 read_byte = 0;            // Byte read from the humidity sensor
+        uint16 humidity = 0;            // Humidity reading w/o calculations
+        float adj_humidity = 0;         // Humidity reading after calculations
 
         // Retrieve the data now that the measurement cycle has completed. The data is sent in two bytes
 	//         Byte 1                Byte 0
@@ -42,6 +76,8 @@ void ICACHE_FLASH_ATTR user_read_humidity(void)
         if (user_i2c_write_byte((SENSOR_ADDR << 1) | 0x01) == 1) {
                 PRINT_DEBUG(DEBUG_ERR, "slave failed to receive address\r\n");
         	user_i2c_stop_bit();
+		sensor_status = (sensor_status & ~SENSOR_INT_OK) | SENSOR_INT_FAIL;
+		humidity_state = HUMIDITY_IDLE;
 		return;
         };
 
@@ -53,14 +89,28 @@ void ICACHE_FLASH_ATTR user_read_humidity(void)
         user_i2c_stop_bit();
         humidity |= read_byte;                           // Lower byte is lower 8 bits of humidity
 
+	// Stale data means the measurement cycle hasn't finished yet. Check back shortly
+	if (status == HUMIDITY_STATUS_STALE) {
+		if (humidity_retries < HUMIDITY_RETRY_MAX) {
+			humidity_retries++;
+			os_timer_arm(&timer_humidity_fetch, HUMIDITY_RETRY_TIME, false);
+		} else {
+			PRINT_DEBUG(DEBUG_ERR, "humidity measurement timed out\r\n");
+			sensor_status = (sensor_status & ~SENSOR_INT_OK) | SENSOR_INT_FAIL;
+			humidity_state = HUMIDITY_IDLE;
+		}
+		return;
+	}
+	humidity_state = HUMIDITY_IDLE;
+	sensor_status = (sensor_status & ~(SENSOR_INT_FAIL | SENSOR_INT_DIAG)) | SENSOR_INT_OK;
+	if (status >= HUMIDITY_STATUS_CMD) {
+		sensor_status |= SENSOR_INT_DIAG;
+	}
+
 	ETS_GPIO_INTR_ENABLE();
 	gpio_intr_handler_register(user_gpio_isr, 0);
 
-	// The formula for the conversion from the received integer "humidity count" to a floating point %RH is as follows:
-	//        Humidity Count
-	// %RH =  -------------- * 100%
-	//	    (2^14) - 2
-        adj_humidity = ((float)humidity / (float)((1 << 14) - 2)) * 100;        // Calculate RH as defined by Honeywell
+        adj_humidity = user_humidity_convert(humidity);
 
 	// Print results
         PRINT_DEBUG(DEBUG_HIGH, "reading=%d, humidity=%d, status=%d\r\n", humidity, (uint32)adj_humidity, status);
@@ -75,6 +125,15 @@ void ICACHE_FLASH_ATTR user_read_humidity(void)
         return;
 };
 
+float ICACHE_FLASH_ATTR user_humidity_convert(uint16 count)
+{
+	// The formula for the conversion from the received integer "humidity count" to a floating point %RH is as follows:
+	//        Humidity Count
+	// %RH =  -------------- * 100%
+	//	    (2^14) - 2
+        return ((float)count / (float)((1 << 14) - 2)) * 100;        // Calculate RH as defined by Honeywell
+};
+
 void ICACHE_FLASH_ATTR user_humidity_cmp(void)
 {
 	// If the fan state is off, never drive the fan
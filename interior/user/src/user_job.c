@@ -0,0 +1,77 @@
+// user_job.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_job.h"
+
+uint32 user_job_dropped = 0;
+
+// Job queue. Jobs are only posted and run from task/timer context, which the
+// SDK never pre-empts, so the queue needs no locking
+static struct user_job job_pool[JOB_POOL_N];
+static uint8 job_head = 0;		// Next free slot
+static uint8 job_n = 0;			// Number of queued jobs
+static bool job_wake = false;		// True while a wake event is waiting in the task's queue
+
+// User Task: user_job_task(os_event_t *e)
+// Desc: Runs the oldest queued job, then posts itself again while jobs remain,
+//	so higher priority tasks and the SDK get to run between jobs. At most one
+//	event is ever waiting in the task's message queue
+static void ICACHE_FLASH_ATTR user_job_task(os_event_t *e)
+{
+	struct user_job job;		// Copy of the job, so its slot can be reused while it runs
+	os_event_t job_e;		// Event handed to the job
+
+	job_wake = false;
+	if (job_n == 0) {
+		return;
+	};
+
+	job = job_pool[(job_head + JOB_POOL_N - job_n) % JOB_POOL_N];
+	job_n--;
+
+	job_e.sig = job.sig;
+	job_e.par = job.par;
+	job.func(&job_e);
+
+	if ((job_n > 0) && !job_wake) {
+		job_wake = system_os_post(USER_TASK_PRIO_1, 0, 0);
+	};
+
+	return;
+};
+
+bool ICACHE_FLASH_ATTR user_job_init(void)
+{
+	job_head = 0;
+	job_n = 0;
+	job_wake = false;
+
+	if (system_os_task(user_job_task, USER_TASK_PRIO_1, user_msg_queue_1, MSG_QUEUE_LENGTH) != true) {
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: failed to register job task\r\n");
+		return false;
+	};
+
+	return true;
+};
+
+bool ICACHE_FLASH_ATTR user_job_post(os_task_t func, os_signal_t sig, os_param_t par)
+{
+	if (job_n >= JOB_POOL_N) {
+		user_job_dropped++;
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: job queue full, dropped=%d\r\n", user_job_dropped);
+		return false;
+	};
+
+	job_pool[job_head].func = func;
+	job_pool[job_head].sig = sig;
+	job_pool[job_head].par = par;
+	job_head = (job_head + 1) % JOB_POOL_N;
+	job_n++;
+
+	// Wake the job task unless it is already due to run
+	if (!job_wake) {
+		job_wake = system_os_post(USER_TASK_PRIO_1, 0, 0);
+	};
+
+	return true;
+};
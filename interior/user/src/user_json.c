@@ -0,0 +1,278 @@
+// user_json.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_json.h"
+
+// Application Function: user_json_put(struct user_json_writer *w, const char *s, uint16 len)
+// Desc: Appends characters, keeping the output NUL terminated
+static void ICACHE_FLASH_ATTR user_json_put(struct user_json_writer *w, const char *s, uint16 len)
+{
+	if (w->overflow || (w->len + len >= w->size)) {
+		w->overflow = true;
+		return;
+	};
+
+	os_memcpy(&w->buf[w->len], s, len);
+	w->len += len;
+	w->buf[w->len] = '\0';
+
+	return;
+};
+
+// Application Function: user_json_quoted(struct user_json_writer *w, const char *s)
+// Desc: Appends a quoted, escaped string
+static void ICACHE_FLASH_ATTR user_json_quoted(struct user_json_writer *w, const char *s)
+{
+	char esc[8];		// Escape sequence
+	const char *run = s;	// Start of the characters not yet appended
+
+	user_json_put(w, "\"", 1);
+	for (; *s != '\0'; s++) {
+		if ((*s != '"') && (*s != '\\') && ((uint8)*s >= 0x20)) {
+			continue;
+		};
+		user_json_put(w, run, s - run);
+		if ((*s == '"') || (*s == '\\')) {
+			esc[0] = '\\';
+			esc[1] = *s;
+			user_json_put(w, esc, 2);
+		} else {
+			user_json_put(w, esc, os_sprintf(esc, "\\u%04x", (uint8)*s));
+		};
+		run = s + 1;
+	};
+	user_json_put(w, run, s - run);
+	user_json_put(w, "\"", 1);
+
+	return;
+};
+
+// Application Function: user_json_member(struct user_json_writer *w, const char *key)
+// Desc: Starts a member or element: a comma after the first, then the key if any
+static void ICACHE_FLASH_ATTR user_json_member(struct user_json_writer *w, const char *key)
+{
+	uint8 bit = 1 << (w->depth & 7);	// First member flag of this level
+
+	if (w->first & bit) {
+		w->first &= ~bit;
+	} else if (w->depth > 0) {
+		user_json_put(w, ",", 1);
+	};
+	if (key != NULL) {
+		user_json_quoted(w, key);
+		user_json_put(w, ":", 1);
+	};
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_json_init(struct user_json_writer *w, char *buf, uint16 size)
+{
+	w->buf = buf;
+	w->size = size;
+	w->len = 0;
+	w->depth = 0;
+	w->first = 0x01;
+	w->overflow = (size == 0);
+	if (size > 0) {
+		buf[0] = '\0';
+	};
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_json_open(struct user_json_writer *w, const char *key, char bracket)
+{
+	user_json_member(w, key);
+	user_json_put(w, &bracket, 1);
+	if (w->depth + 1 >= JSON_DEPTH_MAX) {
+		w->overflow = true;
+		return;
+	};
+	w->depth++;
+	w->first |= 1 << w->depth;
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_json_close(struct user_json_writer *w, char bracket)
+{
+	if (w->depth > 0) {
+		w->depth--;
+	};
+	user_json_put(w, &bracket, 1);
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_json_int(struct user_json_writer *w, const char *key, sint32 val)
+{
+	char num[12];		// Longest 32 bit integer with its sign
+
+	user_json_member(w, key);
+	user_json_put(w, num, os_sprintf(num, "%d", val));
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_json_fixed(struct user_json_writer *w, const char *key, sint32 val, uint8 places)
+{
+	char num[20];		// Sign, integer part, point, fraction
+	uint32 mag = (val < 0) ? -val : val;
+	uint32 div = 1;
+	uint16 len = 0;
+	uint8 i = 0;
+
+	for (i = 0; i < places; i++) {
+		div *= 10;
+	};
+
+	user_json_member(w, key);
+	len = os_sprintf(num, "%s%u.", (val < 0) ? "-" : "", mag / div);
+	for (i = 0; i < places; i++) {
+		div /= 10;
+		num[len++] = '0' + ((mag / div) % 10);
+	};
+	user_json_put(w, num, len);
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_json_str(struct user_json_writer *w, const char *key, const char *val)
+{
+	user_json_member(w, key);
+	user_json_quoted(w, val);
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_json_bool(struct user_json_writer *w, const char *key, bool val)
+{
+	user_json_member(w, key);
+	val ? user_json_put(w, "true", 4) : user_json_put(w, "false", 5);
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_json_lexer_init(struct user_json_lexer *lx, const char *data, uint16 len)
+{
+	lx->p = data;
+	lx->end = data + len;
+
+	return;
+};
+
+// Application Function: user_json_word(struct user_json_lexer *lx, const char *word, uint8 type)
+// Desc: Reads a literal (true, false, null)
+static uint8 ICACHE_FLASH_ATTR user_json_word(struct user_json_lexer *lx, const char *word, uint8 type)
+{
+	uint8 len = os_strlen(word);
+
+	if ((lx->end - lx->p < len) || (os_strncmp(lx->p, word, len) != 0)) {
+		return JSON_ERROR;
+	};
+	lx->p += len;
+
+	return type;
+};
+
+// Application Function: user_json_number(struct user_json_lexer *lx, struct user_json_token *t)
+// Desc: Reads a number into thousandths. Fraction digits past the third are dropped
+static uint8 ICACHE_FLASH_ATTR user_json_number(struct user_json_lexer *lx, struct user_json_token *t)
+{
+	bool neg = false;	// Leading minus
+	uint32 val = 0;		// Magnitude, thousandths
+	uint32 frac = JSON_SCALE;	// Place of the next fraction digit
+	bool digits = false;	// A digit was seen
+
+	if (*lx->p == '-') {
+		neg = true;
+		lx->p++;
+	};
+	for (; (lx->p < lx->end) && (*lx->p >= '0') && (*lx->p <= '9'); lx->p++) {
+		val = (val * 10) + (*lx->p - '0');
+		digits = true;
+		if (val > JSON_NUM_MAX) {
+			return JSON_ERROR;
+		};
+	};
+	val *= JSON_SCALE;
+	t->integer = true;
+
+	if ((lx->p < lx->end) && (*lx->p == '.')) {
+		lx->p++;
+		t->integer = false;
+		digits = false;
+		for (; (lx->p < lx->end) && (*lx->p >= '0') && (*lx->p <= '9'); lx->p++) {
+			frac /= 10;
+			val += (*lx->p - '0') * frac;
+			digits = true;
+		};
+	};
+	if (!digits || ((lx->p < lx->end) && ((*lx->p == 'e') || (*lx->p == 'E')))) {
+		return JSON_ERROR;
+	};
+
+	t->num = neg ? -(sint32)val : (sint32)val;
+
+	return JSON_NUMBER;
+};
+
+uint8 ICACHE_FLASH_ATTR user_json_next(struct user_json_lexer *lx, struct user_json_token *t)
+{
+	const char *start = NULL;	// Start of a string's contents
+
+	// Skip white space
+	while ((lx->p < lx->end) && ((*lx->p == ' ') || (*lx->p == '\t') || (*lx->p == '\r') || (*lx->p == '\n'))) {
+		lx->p++;
+	};
+	if (lx->p >= lx->end) {
+		t->type = JSON_END;
+		return t->type;
+	};
+
+	switch (*lx->p) {
+	case '{': t->type = JSON_OBJ_BEGIN; lx->p++; break;
+	case '}': t->type = JSON_OBJ_END; lx->p++; break;
+	case '[': t->type = JSON_ARR_BEGIN; lx->p++; break;
+	case ']': t->type = JSON_ARR_END; lx->p++; break;
+	case ':': t->type = JSON_COLON; lx->p++; break;
+	case ',': t->type = JSON_COMMA; lx->p++; break;
+	case 't': t->type = user_json_word(lx, "true", JSON_TRUE); break;
+	case 'f': t->type = user_json_word(lx, "false", JSON_FALSE); break;
+	case 'n': t->type = user_json_word(lx, "null", JSON_NULL); break;
+
+	case '"':
+		start = ++lx->p;
+		while ((lx->p < lx->end) && (*lx->p != '"')) {
+			if ((*lx->p == '\\') && (lx->p + 1 < lx->end)) {
+				lx->p++;
+			};
+			lx->p++;
+		};
+		if (lx->p >= lx->end) {
+			t->type = JSON_ERROR;
+			break;
+		};
+		t->str = start;
+		t->len = lx->p - start;
+		t->type = JSON_STRING;
+		lx->p++;
+		break;
+
+	default:
+		if ((*lx->p == '-') || ((*lx->p >= '0') && (*lx->p <= '9'))) {
+			t->type = user_json_number(lx, t);
+		} else {
+			t->type = JSON_ERROR;
+		};
+		break;
+	};
+
+	return t->type;
+};
+
+bool ICACHE_FLASH_ATTR user_json_eq(const struct user_json_token *t, const char *s)
+{
+	return (t->type == JSON_STRING) && (os_strlen(s) == t->len) && (os_strncmp(t->str, s, t->len) == 0);
+};
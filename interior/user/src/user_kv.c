@@ -0,0 +1,105 @@
+// user_kv.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_kv.h"
+
+void ICACHE_FLASH_ATTR user_kv_init(struct user_kv_lexer *lx, const char *data, uint16 len, char sep)
+{
+	lx->p = data;
+	lx->end = data + len;
+	lx->sep = sep;
+
+	return;
+};
+
+bool ICACHE_FLASH_ATTR user_kv_next(struct user_kv_lexer *lx, struct user_kv *kv)
+{
+	const char *p = lx->p;
+
+	// Skip empty pairs
+	while ((p < lx->end) && (*p == lx->sep)) {
+		p++;
+	};
+	if ((p >= lx->end) || (*p == '\0')) {
+		lx->p = p;
+		return false;
+	};
+
+	// Key, up to '=' or the end of the pair
+	kv->key = p;
+	while ((p < lx->end) && (*p != '=') && (*p != lx->sep) && (*p != '\0')) {
+		p++;
+	};
+	kv->key_len = p - kv->key;
+
+	// Value, up to the end of the pair
+	if ((p < lx->end) && (*p == '=')) {
+		p++;
+	};
+	kv->val = p;
+	while ((p < lx->end) && (*p != lx->sep) && (*p != '\0')) {
+		p++;
+	};
+	kv->val_len = p - kv->val;
+
+	lx->p = p;
+
+	return true;
+};
+
+bool ICACHE_FLASH_ATTR user_kv_is(const char *s, uint16 len, const char *str)
+{
+	uint16 i = 0;
+
+	for (i = 0; i < len; i++) {
+		if (str[i] != s[i]) {		// Also stops at the end of str
+			return false;
+		};
+	};
+
+	return (str[len] == '\0');
+};
+
+bool ICACHE_FLASH_ATTR user_kv_uint(const char *s, uint16 len, uint32 max, uint32 *out)
+{
+	uint32 val = 0;		// Converted value
+	uint16 i = 0;		// Loop index
+
+	if (len == 0) {
+		return false;
+	};
+	for (i = 0; i < len; i++) {
+		if ((s[i] < '0') || (s[i] > '9')) {
+			return false;
+		};
+		val = (val * 10) + (s[i] - '0');
+		if (val > max) {
+			return false;
+		};
+	};
+	*out = val;
+
+	return true;
+};
+
+bool ICACHE_FLASH_ATTR user_kv_ip(const char *s, uint16 len, uint8 *ip)
+{
+	const char *end = s + len;
+	const char *dot = NULL;		// End of the octet
+	uint32 octet = 0;		// Converted octet
+	uint8 i = 0;			// Loop index
+
+	for (i = 0; i < 4; i++) {
+		for (dot = s; (dot < end) && (*dot != '.'); dot++);
+		if (!user_kv_uint(s, dot - s, 255, &octet)) {
+			return false;
+		};
+		ip[i] = octet;
+		if ((i < 3) != (dot < end)) {
+			return false;		// Too few octets, or something after the fourth
+		};
+		s = dot + 1;
+	};
+
+	return true;
+};
@@ -0,0 +1,170 @@
+// user_link.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_link.h"
+
+// Application Function: user_link_put16(uint8 *p, uint16 val)
+// Desc: Writes a little endian 16 bit field
+static void ICACHE_FLASH_ATTR user_link_put16(uint8 *p, uint16 val)
+{
+	p[0] = val & 0xFF;
+	p[1] = val >> 8;
+
+	return;
+};
+
+// Application Function: user_link_get16(const uint8 *p)
+// Desc: Reads a little endian 16 bit field
+static uint16 ICACHE_FLASH_ATTR user_link_get16(const uint8 *p)
+{
+	return p[0] | (p[1] << 8);
+};
+
+uint16 ICACHE_FLASH_ATTR user_link_encode(uint8 *buf, uint8 type, uint16 seq, uint16 len)
+{
+	buf[0] = LINK_MAGIC_0;
+	buf[1] = LINK_MAGIC_1;
+	buf[2] = LINK_VERSION;
+	buf[3] = type;
+	user_link_put16(&buf[4], seq);
+	user_link_put16(&buf[6], len);
+
+	return LINK_HEADER_SIZE + len;
+};
+
+uint16 ICACHE_FLASH_ATTR user_link_encode_samples(uint8 *buf, uint16 seq, const struct user_link_samples *s)
+{
+	uint8 *p = &buf[LINK_HEADER_SIZE];	// Payload
+	uint8 n = (s->n > LINK_SAMPLES_MAX) ? LINK_SAMPLES_MAX : s->n;
+	uint8 i = 0;
+
+	user_link_put16(&p[0], s->time & 0xFFFF);
+	user_link_put16(&p[2], s->time >> 16);
+	user_link_put16(&p[4], s->period);
+	p[6] = s->status;
+	p[7] = n;
+	for (i = 0; i < n; i++) {
+		user_link_put16(&p[LINK_SAMPLES_HEADER + (2 * i)], s->sample[i]);
+	};
+
+	return user_link_encode(buf, LINK_SAMPLES, seq, LINK_SAMPLES_HEADER + (2 * n));
+};
+
+uint16 ICACHE_FLASH_ATTR user_link_encode_ack(uint8 *buf, uint16 seq, uint16 acked)
+{
+	user_link_put16(&buf[LINK_HEADER_SIZE], acked);
+
+	return user_link_encode(buf, LINK_ACK, seq, 2);
+};
+
+void ICACHE_FLASH_ATTR user_link_decode_init(struct user_link_decoder *dec)
+{
+	dec->len = 0;
+
+	return;
+};
+
+// Application Function: user_link_resync(struct user_link_decoder *dec)
+// Desc: Drops the first byte of a bad header, then any bytes which cannot
+//	start a frame, leaving the decoder at the next possible frame start
+static void ICACHE_FLASH_ATTR user_link_resync(struct user_link_decoder *dec)
+{
+	uint16 i = 1;	// New start
+
+	while ((i < dec->len) && (dec->buf[i] != LINK_MAGIC_0)) {
+		i++;
+	};
+	dec->skipped += i;
+	dec->len -= i;
+	os_memmove(dec->buf, &dec->buf[i], dec->len);
+
+	return;
+};
+
+// Application Function: user_link_header_bad(const struct user_link_decoder *dec)
+// Desc: Checks as much of the header as has arrived
+// Returns:
+//	true if the bytes so far cannot be the start of a frame
+static bool ICACHE_FLASH_ATTR user_link_header_bad(const struct user_link_decoder *dec)
+{
+	return ((dec->len > 0) && (dec->buf[0] != LINK_MAGIC_0)) ||
+	       ((dec->len > 1) && (dec->buf[1] != LINK_MAGIC_1)) ||
+	       ((dec->len > 2) && (dec->buf[2] != LINK_VERSION)) ||
+	       ((dec->len >= LINK_HEADER_SIZE) && (user_link_get16(&dec->buf[6]) > LINK_PAYLOAD_MAX));
+};
+
+void ICACHE_FLASH_ATTR user_link_decode(struct user_link_decoder *dec, const uint8 *data, uint16 len, user_link_handler handler, void *arg)
+{
+	struct user_link_frame frame;	// Frame handed to the handler
+	uint16 want = 0;		// Bytes still needed for the header or frame
+	uint16 n = 0;			// Bytes taken this pass
+
+	while (len > 0) {
+
+		// Header, a byte at a time so a bad start is caught early
+		if (dec->len < LINK_HEADER_SIZE) {
+			dec->buf[dec->len++] = *data++;
+			len--;
+			while (user_link_header_bad(dec)) {
+				user_link_resync(dec);
+			};
+			if (dec->len < LINK_HEADER_SIZE) {
+				continue;
+			};
+		};
+
+		// Payload, as much as has arrived
+		want = LINK_HEADER_SIZE + user_link_get16(&dec->buf[6]) - dec->len;
+		n = (len < want) ? len : want;
+		os_memcpy(&dec->buf[dec->len], data, n);
+		dec->len += n;
+		data += n;
+		len -= n;
+		if (n < want) {
+			break;
+		};
+
+		// Frame complete
+		frame.type = dec->buf[3];
+		frame.seq = user_link_get16(&dec->buf[4]);
+		frame.payload = &dec->buf[LINK_HEADER_SIZE];
+		frame.len = dec->len - LINK_HEADER_SIZE;
+		dec->frames++;
+		dec->len = 0;
+		handler(arg, &frame);
+	};
+
+	return;
+};
+
+bool ICACHE_FLASH_ATTR user_link_samples(const struct user_link_frame *frame, struct user_link_samples *s)
+{
+	const uint8 *p = frame->payload;
+	uint8 i = 0;
+
+	if ((frame->type != LINK_SAMPLES) || (frame->len < LINK_SAMPLES_HEADER)) {
+		return false;
+	};
+	s->n = p[7];
+	if ((s->n > LINK_SAMPLES_MAX) || (frame->len != LINK_SAMPLES_HEADER + (2 * s->n))) {
+		return false;
+	};
+	s->time = user_link_get16(&p[0]) | ((uint32)user_link_get16(&p[2]) << 16);
+	s->period = user_link_get16(&p[4]);
+	s->status = p[6];
+	for (i = 0; i < s->n; i++) {
+		s->sample[i] = user_link_get16(&p[LINK_SAMPLES_HEADER + (2 * i)]);
+	};
+
+	return true;
+};
+
+bool ICACHE_FLASH_ATTR user_link_ack(const struct user_link_frame *frame, uint16 *acked)
+{
+	if ((frame->type != LINK_ACK) || (frame->len != 2)) {
+		return false;
+	};
+	*acked = user_link_get16(frame->payload);
+
+	return true;
+};
@@ -0,0 +1,319 @@
+// user_log.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_log.h"
+
+// Log position
+static bool log_ready = false;		// Set once the end of the log is known
+static struct user_log_header log_hdr;	// Header of the newest sector
+static uint16 log_sect = 0;		// Newest sector, 0 to LOG_SECT_N - 1
+static uint16 log_slot = 0;		// Next free record slot in log_sect
+static uint32 log_ticks = 0;		// Periods since boot
+static uint32 log_base = 0;		// Period new records are stamped relative to
+
+// Running means
+static float log_sum_int = 0;
+static float log_sum_ext = 0;
+static uint32 log_sum_rpm = 0;
+static uint32 log_sum_delay = 0;
+static uint16 log_n = 0;
+
+// Application Function: user_log_crc32(const uint8 *data, uint32 len)
+// Desc: CRC-32 (IEEE 802.3), computed a bit at a time to keep the table out of RAM
+static uint32 ICACHE_FLASH_ATTR user_log_crc32(const uint8 *data, uint32 len)
+{
+	uint32 crc = 0xFFFFFFFF;
+	uint8 i = 0;
+
+	while (len--) {
+		crc ^= *data++;
+		for (i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		};
+	};
+
+	return ~crc;
+};
+
+// Application Function: user_log_crc8(const struct user_log_rec *r)
+// Desc: CRC-8 (polynomial 0x07) of a record, less its own CRC byte
+static uint8 ICACHE_FLASH_ATTR user_log_crc8(const struct user_log_rec *r)
+{
+	uint8 data[7];
+	uint8 crc = 0;
+	uint8 i = 0;
+	uint8 j = 0;
+
+	os_memcpy(data, &r->w0, 4);
+	os_memcpy(&data[4], &r->w1, 3);
+	for (i = 0; i < sizeof(data); i++) {
+		crc ^= data[i];
+		for (j = 0; j < 8; j++) {
+			crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) : (crc << 1);
+		};
+	};
+
+	return crc;
+};
+
+// Application Function: user_log_addr(uint16 sect, uint16 slot)
+// Desc: Flash address of a record slot
+static uint32 ICACHE_FLASH_ATTR user_log_addr(uint16 sect, uint16 slot)
+{
+	return ((LOG_START_SECT + sect) * LOG_SECT_SIZE) + sizeof(struct user_log_header) + (slot * sizeof(struct user_log_rec));
+};
+
+// Application Function: user_log_key(uint16 sect, struct user_log_header *h)
+// Desc: Reads a sector header
+// Returns:
+//	The sector's sequence number, or 0 if it has no valid header
+static uint32 ICACHE_FLASH_ATTR user_log_key(uint16 sect, struct user_log_header *h)
+{
+	if ((FLASH_READ((LOG_START_SECT + sect) * LOG_SECT_SIZE, h) != SPI_FLASH_RESULT_OK) ||
+	    (h->magic != LOG_MAGIC) ||
+	    (h->crc != user_log_crc32((uint8 *)h, sizeof(*h) - 4))) {
+		return 0;
+	};
+
+	return h->seq;
+};
+
+// Application Function: user_log_slots(uint16 sect)
+// Desc: Binary search for the first erased record slot of a sector
+// Returns:
+//	Number of used slots
+static uint16 ICACHE_FLASH_ATTR user_log_slots(uint16 sect)
+{
+	uint16 lo = 0;		// Search bounds
+	uint16 hi = LOG_REC_N;
+	uint16 mid = 0;
+	uint32 w0 = 0;		// First word of a record, all ones if erased
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if ((FLASH_READ(user_log_addr(sect, mid), &w0) == SPI_FLASH_RESULT_OK) && (w0 != 0xFFFFFFFF)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		};
+	};
+
+	return lo;
+};
+
+// Application Function: user_log_open(uint16 sect, uint32 seq)
+// Desc: Erases a sector and starts it with a header
+// Returns:
+//	false on a flash error
+static bool ICACHE_FLASH_ATTR user_log_open(uint16 sect, uint32 seq)
+{
+	log_hdr.magic = LOG_MAGIC;
+	log_hdr.seq = seq;
+	log_hdr.start = log_ticks;
+	log_hdr.crc = user_log_crc32((uint8 *)&log_hdr, sizeof(log_hdr) - 4);
+
+	if ((FLASH_ERASE(LOG_START_SECT + sect) != SPI_FLASH_RESULT_OK) ||
+	    (FLASH_WRITE((LOG_START_SECT + sect) * LOG_SECT_SIZE, &log_hdr) != SPI_FLASH_RESULT_OK)) {
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: failed to open log sector %d\r\n", LOG_START_SECT + sect);
+		log_ready = false;
+		return false;
+	};
+
+	log_sect = sect;
+	log_slot = 0;
+	log_base = log_ticks;
+
+	return true;
+};
+
+// Application Function: user_log_write(struct user_log_rec *r)
+// Desc: Writes a packed record to the next slot, moving to the next sector if needed
+// Returns:
+//	false on a flash error
+static bool ICACHE_FLASH_ATTR user_log_write(struct user_log_rec *r)
+{
+	if ((log_slot >= LOG_REC_N) && !user_log_open((log_sect + 1) % LOG_SECT_N, log_hdr.seq + 1)) {
+		return false;
+	};
+
+	r->w1 = (r->w1 & 0x00FFFFFF) | ((uint32)user_log_crc8(r) << 24);
+	if (FLASH_WRITE(user_log_addr(log_sect, log_slot), r) != SPI_FLASH_RESULT_OK) {
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: log write failed\r\n");
+		return false;
+	};
+	log_slot++;
+
+	return true;
+};
+
+bool ICACHE_FLASH_ATTR user_log_init(void)
+{
+	struct user_log_header h;		// Header being examined
+	struct user_log_rec r = { LOG_REC_BOOT << 30, 0 };	// Boot record
+	uint32 first = 0;			// Sequence number of sector 0
+	uint16 lo = 0;				// Search bounds
+	uint16 hi = LOG_SECT_N - 1;
+	uint16 mid = 0;
+
+	// Sequence numbers rise by one from sector to sector, wrapping around the
+	// area, and a sector without a header reads as 0. So the newest sector is the
+	// last one numbered at least as high as sector 0
+	first = user_log_key(0, &h);
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (user_log_key(mid, &h) >= first) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		};
+	};
+
+	if (user_log_key(lo, &log_hdr) == 0) {
+		PRINT_DEBUG(DEBUG_LOW, "no log found, starting a new one\r\n");
+		if (!user_log_open(0, 1)) {
+			return false;
+		};
+	} else {
+		log_sect = lo;
+		log_slot = user_log_slots(lo);
+		PRINT_DEBUG(DEBUG_LOW, "log recovered, sector=%d seq=%d records=%d\r\n", LOG_START_SECT + lo, log_hdr.seq, log_slot);
+	};
+
+	// Times of the records which follow count from this boot
+	log_ready = true;
+	if (!user_log_write(&r)) {
+		log_ready = false;
+		return false;
+	};
+	log_base = 0;
+
+	return true;
+};
+
+bool ICACHE_FLASH_ATTR user_log_append(const struct user_log_entry *e)
+{
+	struct user_log_rec r;		// Packed record
+	uint32 rpm = e->rpm / 4;	// Fields in record units, clamped to 10 bits
+	uint32 delay = e->delay / 16;
+
+	if (!log_ready) {
+		return false;
+	};
+
+	rpm > 0x3FF ? (rpm = 0x3FF) : 0;
+	delay > 0x3FF ? (delay = 0x3FF) : 0;
+	r.w0 = (e->hum_int > 1000 ? 1000 : e->hum_int) |
+	       ((e->hum_ext > 1000 ? 1000 : e->hum_ext) << 10) |
+	       (rpm << 20) |
+	       ((uint32)(e->type & 0x03) << 30);
+	r.w1 = delay | (((log_ticks - log_base) & 0x3FFF) << 10);
+
+	return user_log_write(&r);
+};
+
+void ICACHE_FLASH_ATTR user_log_tick(float hum_int, float hum_ext, sint32 rpm, sint32 delay)
+{
+	struct user_log_entry e;	// Record of the period's means
+
+	log_sum_int += hum_int;
+	log_sum_ext += hum_ext;
+	log_sum_rpm += (rpm > 0) ? rpm : 0;
+	log_sum_delay += (delay > 0) ? delay : 0;
+	if (++log_n < LOG_TICK_N) {
+		return;
+	};
+
+	log_ticks++;
+	e.type = LOG_REC_DATA;
+	e.time = 0;
+	e.hum_int = (uint16)((log_sum_int * 10) / log_n + 0.5f);
+	e.hum_ext = (uint16)((log_sum_ext * 10) / log_n + 0.5f);
+	e.rpm = log_sum_rpm / log_n;
+	e.delay = log_sum_delay / log_n;
+	user_log_append(&e);
+
+	log_sum_int = 0;
+	log_sum_ext = 0;
+	log_sum_rpm = 0;
+	log_sum_delay = 0;
+	log_n = 0;
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_log_cursor_init(struct user_log_cursor *c)
+{
+	// Sector sequence numbers count up from 1, so the log holds at most the
+	// last LOG_SECT_N of them
+	c->seq = (log_hdr.seq > LOG_SECT_N) ? (log_hdr.seq - LOG_SECT_N + 1) : 1;
+	c->slot = 0;
+	c->used = 0;
+	c->base = 0;
+
+	return;
+};
+
+bool ICACHE_FLASH_ATTR user_log_next(struct user_log_cursor *c, struct user_log_entry *e)
+{
+	struct user_log_header h;	// Header of the sector being entered
+	struct user_log_rec r;		// Record read
+	uint16 sect = 0;		// Sector being read
+
+	while (log_ready && (c->seq <= log_hdr.seq)) {
+		// Sectors more than LOG_SECT_N behind the newest have been reused
+		if (log_hdr.seq - c->seq >= LOG_SECT_N) {
+			user_log_cursor_init(c);
+			continue;
+		};
+		sect = (log_sect + LOG_SECT_N - (log_hdr.seq - c->seq)) % LOG_SECT_N;
+
+		// Entering a sector: its time base. A sector which does not continue
+		// the numbering belongs to a log which has since been overwritten
+		if (c->slot == 0) {
+			if (user_log_key(sect, &h) != c->seq) {
+				c->seq++;
+				continue;
+			};
+			c->base = h.start;
+			c->used = 0;
+		};
+
+		// The newest sector ends at log_slot. Any other is full up to its
+		// first erased slot, found once it is no longer being written
+		if (c->seq == log_hdr.seq) {
+			if (c->slot >= log_slot) {
+				return false;
+			};
+		} else {
+			if (c->used == 0) {
+				c->used = user_log_slots(sect);
+			};
+			if (c->slot >= c->used) {
+				c->seq++;
+				c->slot = 0;
+				continue;
+			};
+		};
+
+		if ((FLASH_READ(user_log_addr(sect, c->slot++), &r) != SPI_FLASH_RESULT_OK) ||
+		    ((r.w1 >> 24) != user_log_crc8(&r))) {
+			continue;
+		};
+
+		e->type = r.w0 >> 30;
+		if (e->type == LOG_REC_BOOT) {
+			c->base = 0;
+			os_memset(e, 0, sizeof(*e));
+			e->type = LOG_REC_BOOT;
+		} else {
+			e->time = (c->base + ((r.w1 >> 10) & 0x3FFF)) * LOG_PERIOD;
+			e->hum_int = r.w0 & 0x3FF;
+			e->hum_ext = (r.w0 >> 10) & 0x3FF;
+			e->rpm = ((r.w0 >> 20) & 0x3FF) * 4;
+			e->delay = (r.w1 & 0x3FF) * 16;
+		};
+		return true;
+	};
+
+	return false;
+};
@@ -12,6 +12,10 @@
 #include "user_fan.h"
 #include "user_captive.h"
 #include "user_exterior.h"
+#include "user_log.h"
+#include "user_dispatch.h"
+#include "user_job.h"
+#include "user_heap.h"
 
 // Function prototypes
 void ICACHE_FLASH_ATTR user_init(void);				// First step initialization function. Handoff from bootloader.
@@ -19,6 +23,19 @@ void ICACHE_FLASH_ATTR user_task_init(void);			// Task initialization. Hands off
 void ICACHE_FLASH_ATTR user_control_task(os_event_t *e);	// Main control task. Schedules all other user tasks.
 void ICACHE_FLASH_ATTR user_gpio_init(void);			// Performs GPIO initialization
 
+// Control states
+enum {
+	STATE_BOOT = 0,		// Waiting for the control task to start
+	STATE_SCAN,		// Scanning for/associating to the saved AP and waiting for an IP
+	STATE_DISCOVERY,	// Waiting to discover and connect to the exterior
+	STATE_RUN,		// Connected to the exterior, controlling the fan
+	STATE_APMODE,		// Serving the configuration page in AP mode
+	STATE_FATAL,		// Waiting for the reboot timer after an unrecoverable error
+	STATE_N
+};
+
+static struct user_machine ctl_machine;		// Control state machine, defined with its transition table below
+
 // User Task: user_init()
 // Desc: Initialization. The ESP8266 hooks into this function after boot.
 //      ICACHE_FLASH_ATTR flag causes the function to be saved to flash
@@ -46,208 +63,248 @@ void ICACHE_FLASH_ATTR user_init(void)
 void ICACHE_FLASH_ATTR user_task_init(void)
 {
         // Allocate space for message queues
-        user_msg_queue_0 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
-        user_msg_queue_1 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
-        user_msg_queue_2 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
-
-        // Register control task and begin control
+        user_msg_queue_0 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+        user_msg_queue_1 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+        user_msg_queue_2 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+
+        // Start sending the debug log, including anything queued during start up
+        user_dlog_init();
+
+        // Pick up the flash log where the last boot left it. Without it the system
+        //	still runs, it just keeps no log
+        if (!user_log_init()) {
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: flash log not started, nothing will be logged\r\n");
+        };
+
+        // Register control task and begin control. Without the job task every
+        //	TASK_START job would sit in the queue, so don't start either
+        if (!user_job_init()) {
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: job task not registered, rebooting system in 5 seconds\r\n");
+                os_timer_setfn(&timer_reboot, system_restart, NULL);
+                os_timer_arm(&timer_reboot, 5000, false);
+                return;
+        };
+        if (!user_dispatch_init(&ctl_machine, STATE_BOOT)) {
+                // Lookups in an unsorted table would misroute events, so don't start. The
+                //	reboot is delayed so the debug log gets out first
+                PRINT_DEBUG(DEBUG_ERR, "ERROR: control task not started, rebooting system in 5 seconds\r\n");
+                os_timer_setfn(&timer_reboot, system_restart, NULL);
+                os_timer_arm(&timer_reboot, 5000, false);
+                return;
+        };
         system_os_task(user_control_task, USER_TASK_PRIO_2, user_msg_queue_2, MSG_QUEUE_LENGTH);
 	TASK_RETURN(SIG_CONTROL, PAR_CONTROL_START);
 
 	return;
 };
 
+/* ==================== */
+/* Master Control Block */
+/* ==================== */
+
+// User Task: user_ctl_scan(os_event_t *e)
+// Desc: Entry to STATE_SCAN. Scans for AP's using the SSID/password saved in memory
+static void ICACHE_FLASH_ATTR user_ctl_scan(os_event_t *e)
+{
+	TASK_START(user_scan, 0, 0);
+};
+
+// User Task: user_ctl_wait_ip(os_event_t *e)
+// Desc: Once the system has found and associated to an AP, it waits to receive an IP address
+static void ICACHE_FLASH_ATTR user_ctl_wait_ip(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "waiting for IP ...\r\n");
+	os_timer_setfn(&timer_ipcheck, user_check_ip, NULL); 	// Check for an IP every second
+	os_timer_arm(&timer_ipcheck, 1000, true);
+};
+
+// User Task: user_ctl_discovery(os_event_t *e)
+// Desc: Entry to STATE_DISCOVERY. Once the system has obtained an IP, disable the IP checking
+//	timer and initialize the exterior connection configuration
+static void ICACHE_FLASH_ATTR user_ctl_discovery(os_event_t *e)
+{
+	os_timer_disarm(&timer_ipcheck);
+	TASK_START(user_broadcast_init, 0, 0);
+};
+
+// User Task: user_ctl_discovery_wait(os_event_t *e)
+// Desc: Once discovery via udp broadcast is configured, initialize a timeout timer,
+//	which will cause the system to fall back to configuration mode to re-sync
+//	with the exterior system if the exterior system fails to discover it
+static void ICACHE_FLASH_ATTR user_ctl_discovery_wait(os_event_t *e)
+{
+	os_timer_setfn(&timer_extcon, user_ext_timeout, NULL);
+	os_timer_arm(&timer_extcon, EXT_WAIT_TIME, false);
+};
+
+// User Task: user_ctl_discovery_timeout(os_event_t *e)
+// Desc: If the discovery times out, clear the config and reboot to get back to config mode
+static void ICACHE_FLASH_ATTR user_ctl_discovery_timeout(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "erasing config\r\n");
+
+	sint8 flash_result = FLASH_ERASE(USER_DATA_START_SECT);
+	if (flash_result != SPI_FLASH_RESULT_OK) {
+		PRINT_DEBUG(DEBUG_ERR, "ERROR: flash erase failed\r\n");
+		TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
+		return;
+	}
+
+	system_restart();
+};
+
+// User Task: user_ctl_connect(os_event_t *e)
+// Desc: If a discovery packet is received, proceed to connect to the found system
+static void ICACHE_FLASH_ATTR user_ctl_connect(os_event_t *e)
+{
+	os_timer_disarm(&timer_extcon);
+	TASK_START(user_espconnect_init, 0, 0);
+};
+
+// User Task: user_ctl_run(os_event_t *e)
+// Desc: Entry to STATE_RUN. Once the system is connected to the exterior, initialize the
+//	humidity readings and tachometer, then start the webserver
+static void ICACHE_FLASH_ATTR user_ctl_run(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "initiating humidity readings\r\n");
+	os_timer_setfn(&timer_humidity, user_read_humidity, NULL);		// Initialize humidity readings
+	os_timer_arm(&timer_humidity, HUMIDITY_READ_INTERVAL, true);
+	os_timer_setfn(&timer_tachometer, user_tach_calc, NULL);		// Initialize tachometer readings
+	os_timer_arm(&timer_tachometer, TACH_PERIOD, true);
+	TASK_START(user_front_init, 0, 0);
+};
+
+// User Task: user_ctl_apmode(os_event_t *e)
+// Desc: Entry to STATE_APMODE. If the system does not find an AP with it's saved SSID/pass,
+//	it will enter AP mode and serve a configuration webpage, where a user can enter a new SSID/pass
+static void ICACHE_FLASH_ATTR user_ctl_apmode(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "switching to configuration mode\r\n");
+	TASK_START(user_apmode_init, 0, 0);
+};
+
+// User Task: user_ctl_apmode_ready(os_event_t *e)
+// Desc: Once AP mode is configured and the system is serving the config webpage/listening for
+//	the exterior system, setup is complete. Control drops off and waits for notification from
+//	the aforementioned connections that either a user has entered an SSID/password or something
+//	has gone wrong.
+static void ICACHE_FLASH_ATTR user_ctl_apmode_ready(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "apmode setup completed\r\n");
+};
+
+// User Task: user_ctl_forward(os_event_t *e)
+// Desc: Once the system has received/saved an SSID/pass from a user, continually attempt to send
+//	the credentials to the exterior system until acknowledgement is received from it.
+static void ICACHE_FLASH_ATTR user_ctl_forward(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "WiFi details obtained from user\r\n");
+	os_timer_setfn(&timer_extfwd, user_ext_send_cred, NULL);
+	os_timer_arm(&timer_extfwd, 1000, true);
+};
+
+// User Task: user_ctl_forwarded(os_event_t *e)
+// Desc: Once the exterior has accepted wifi credentials, perform AP mode cleanup and switch back
+//	to station mode
+static void ICACHE_FLASH_ATTR user_ctl_forwarded(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "exterior has accepted WiFi credentials\r\n");
+	os_timer_disarm(&timer_extfwd);
+	TASK_START(user_apmode_cleanup, 0, 0);
+};
+
+// User Task: user_ctl_apmode_done(os_event_t *e)
+// Desc: Exit from STATE_APMODE once cleanup is complete
+static void ICACHE_FLASH_ATTR user_ctl_apmode_done(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_LOW, "AP mode cleanup completed\r\n");
+};
+
+// User Task: user_ctl_ignore(os_event_t *e)
+// Desc: Recoverable error which needs no response
+static void ICACHE_FLASH_ATTR user_ctl_ignore(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_ERR, "RESPONSE: ignoring\r\n");
+};
+
+// User Task: user_ctl_fatal(os_event_t *e)
+// Desc: Entry to STATE_FATAL. The system is restarted after a 5 second delay.
+//	STATE_FATAL is final, so the control task then sleeps until the reboot
+static void ICACHE_FLASH_ATTR user_ctl_fatal(os_event_t *e)
+{
+	PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL! rebooting system in 5 seconds\r\n");
+	os_timer_setfn(&timer_reboot, system_restart, NULL);
+	os_timer_arm(&timer_reboot, 5000, false);
+};
+
+static const struct user_state ctl_states[STATE_N] = {
+	[STATE_BOOT]		= { "boot",		NULL,			NULL,			false },
+	[STATE_SCAN]		= { "scan",		user_ctl_scan,		NULL,			false },
+	[STATE_DISCOVERY]	= { "discovery",	user_ctl_discovery,	NULL,			false },
+	[STATE_RUN]		= { "run",		user_ctl_run,		NULL,			false },
+	[STATE_APMODE]		= { "apmode",		user_ctl_apmode,	user_ctl_apmode_done,	false },
+	[STATE_FATAL]		= { "fatal",		user_ctl_fatal,		NULL,			true },
+};
+
+// Transition table, sorted by sig | par
+static const struct user_transition ctl_table[] = {
+	// General control signals
+	{ SIG_CONTROL | PAR_CONTROL_START,			STATE_BOOT,	STATE_SCAN,		NULL },
+	{ SIG_CONTROL | PAR_CONTROL_ERR_FATAL,			STATE_ANY,	STATE_FATAL,		NULL },
+
+	// AP scanning signals
+	{ SIG_AP_SCAN | PAR_AP_SCAN_CONNECTED,			STATE_ANY,	STATE_SAME,		user_ctl_wait_ip },
+	{ SIG_AP_SCAN | PAR_AP_SCAN_NOAP,			STATE_ANY,	STATE_APMODE,		NULL },
+	{ SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONNECT,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to attempt to connect to an SSID
+	{ SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONFIG,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to configure station mode
+	{ SIG_AP_SCAN | PAR_AP_SCAN_FAILED_SCAN,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to begin AP scanning task
+	{ SIG_AP_SCAN | PAR_AP_SCAN_FLASH_FAILURE,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to read data from flash memory
+	{ SIG_AP_SCAN | PAR_AP_SCAN_STATION_MODE_FAILURE,	STATE_ANY,	STATE_FATAL,		NULL },	// Failed to change the wifi mode to station
+
+	// IP waiting signals
+	{ SIG_IP_WAIT | PAR_IP_WAIT_GOTIP,			STATE_ANY,	STATE_DISCOVERY,	NULL },
+	{ SIG_IP_WAIT | PAR_IP_WAIT_CHECK_FAILURE,		STATE_ANY,	STATE_SAME,		user_ctl_ignore },	// In theory the IP is still there
+
+	// Discovery signals
+	{ SIG_DISCOVERY | PAR_DISCOVERY_CONFIG_COMPLETE,	STATE_ANY,	STATE_SAME,		user_ctl_discovery_wait },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_TIMEOUT,		STATE_ANY,	STATE_SAME,		user_ctl_discovery_timeout },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_FOUND,			STATE_ANY,	STATE_SAME,		user_ctl_connect },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_CONNECTED,		STATE_ANY,	STATE_RUN,		NULL },
+	{ SIG_DISCOVERY | PAR_DISCOVERY_CONN_FAILED,		STATE_ANY,	STATE_SAME,		user_ctl_discovery },	// Begin the discovery process again
+	{ SIG_DISCOVERY | PAR_DISCOVERY_MALFORMED,		STATE_ANY,	STATE_SAME,		NULL },			// Keep going
+	{ SIG_DISCOVERY | PAR_DISCOVERY_LISTEN_FAILURE,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to start listening for discovery packets
+
+	// Webserver signals
+	{ SIG_WEB | PAR_WEB_INIT_FAILURE,			STATE_ANY,	STATE_FATAL,		NULL },
+
+	// AP mode signals
+	{ SIG_APMODE | PAR_APMODE_SETUP_COMPLETE,		STATE_ANY,	STATE_SAME,		user_ctl_apmode_ready },
+	{ SIG_APMODE | PAR_APMODE_CONFIG_RECV,			STATE_ANY,	STATE_SAME,		user_ctl_forward },
+	{ SIG_APMODE | PAR_APMODE_EXT_ACCEPT,			STATE_ANY,	STATE_SAME,		user_ctl_forwarded },
+	{ SIG_APMODE | PAR_APMODE_CLEANUP_COMPLETE,		STATE_ANY,	STATE_SCAN,		NULL },	// Launch a new AP scan
+	{ SIG_APMODE | PAR_APMODE_SEND_FAILURE,			STATE_ANY,	STATE_SAME,		user_ctl_ignore },	// It will try again
+	{ SIG_APMODE | PAR_APMODE_FLASH_FAILURE,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to erase flash data
+	{ SIG_APMODE | PAR_APMODE_EXT_INIT_FAILURE,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to open port to listen for exterior system
+	{ SIG_APMODE | PAR_APMODE_WEB_INIT_FAILURE,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to open webserver
+	{ SIG_APMODE | PAR_APMODE_DHCP_CONFIG_FAILURE,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to configure DHCP/IP settings
+	{ SIG_APMODE | PAR_APMODE_MODE_CONFIG_FAILURE,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to configure AP mode
+	{ SIG_APMODE | PAR_APMODE_AP_MODE_FAILURE,		STATE_ANY,	STATE_FATAL,		NULL },	// Failed to enter AP mode
+};
+
+static struct user_machine ctl_machine = {
+	ctl_states,
+	ctl_table,
+	sizeof(ctl_table) / sizeof(ctl_table[0]),
+	STATE_BOOT
+};
+
 // User Task: user_control_task(os_event_t *e)
 // Desc: Maximum priority control task which calls other tasks
-//	based on the results of previous tasks
+//	based on the results of previous tasks. The control flow itself
+//	lives in ctl_table
 void ICACHE_FLASH_ATTR user_control_task(os_event_t *e)
 {
-	/* ==================== */
-	/* Master Control Block */
-	/* ==================== */
-	switch(e->sig | e->par) {
-
-		/* ----------------------- */
-		/* General Control Signals */
-		/* ----------------------- */
-
-		// Control entry point. The interior begins by scanning for AP's using the
-		// SSID/password it has saved in memory.
-		case SIG_CONTROL | PAR_CONTROL_START:
-			TASK_START(user_scan, 0, 0);
-			break;
-
-		// Deadloop of task calls while waiting for the system to restart
-		case SIG_CONTROL | PAR_CONTROL_ERR_DEADLOOP:
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_DEADLOOP);
-			break;
-
-		// Fatal error case. The control function calls itself with this sig/par
-		// if it is passed an error it cannot recover from. The system is restarted
-		// after a 5 second delay
-		case SIG_CONTROL | PAR_CONTROL_ERR_FATAL:
-			PRINT_DEBUG(DEBUG_LOW, os_printf("rebooting system in 5 seconds\r\n"));
-			os_timer_setfn(&timer_reboot, system_restart, NULL);
-			os_timer_arm(&timer_reboot, 5000, false);
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_DEADLOOP);
-			break;
-
-		/* ------------------- */
-		/* AP Scanning Signals */
-		/* ------------------- */
-
-		// Once the system has found and associated to an AP, it waits to receive an IP
-		// address
-		case SIG_AP_SCAN | PAR_AP_SCAN_CONNECTED:
-			PRINT_DEBUG(DEBUG_LOW, "waiting for IP ...\r\n");
-			os_timer_setfn(&timer_ipcheck, user_check_ip, NULL); 	// Check for an IP every second			
-			os_timer_arm(&timer_ipcheck, 1000, true);
-			break;    
-
-		// If the system does not find an AP with it's saved SSID/pass, it will enter
-		// AP mode and serve a configuration webpage, where a user can enter a new SSID/pass
-		case SIG_AP_SCAN | PAR_AP_SCAN_NOAP:
-			PRINT_DEBUG(DEBUG_LOW, "switching to configuration mode\r\n");
-			TASK_START(user_apmode_init, 0, 0);
-			break;
- 
-		// Error cases:
-		case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONNECT:       // Failed to attempt to connect to an SSID   
-		case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_CONFIG:        // Failed to configure station mode  
-		case SIG_AP_SCAN | PAR_AP_SCAN_FAILED_SCAN:          // Failed to begin AP scanning task 
-		case SIG_AP_SCAN | PAR_AP_SCAN_FLASH_FAILURE:        // Failed to read data from flash memory   
-		case SIG_AP_SCAN | PAR_AP_SCAN_STATION_MODE_FAILURE: // Failed to change the wifi mode to station
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL!\r\n");
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
-			break;
-			
-		/* ------------------ */
-		/* IP Waiting Signals */
-		/* ------------------ */
-		
-		// Once the system has obtained an IP, disable the IP checking timer and initialize the
-		// exterior connection configuration
-		case SIG_IP_WAIT | PAR_IP_WAIT_GOTIP:
-			os_timer_disarm(&timer_ipcheck);            
-			TASK_START(user_broadcast_init, 0, 0);
-			break;
-
-		// Error case. Failed to check IP info. In theory it's still there, so ignore this
-		case SIG_IP_WAIT | PAR_IP_WAIT_CHECK_FAILURE:
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: ignoring\r\n");
-			break; 
-
-		/* ----------------- */
-		/* Discovery Signals */
-		/* ----------------- */
-
-		// Once discovery via udp broadcast is configured, initialize a timeout timer,
-		// which will cause the system to fall back to configuration mode to re-sync
-		// with the exterior system if the exterior system fails to discover it
-		case SIG_DISCOVERY | PAR_DISCOVERY_CONFIG_COMPLETE:
-			os_timer_setfn(&timer_extcon, user_ext_timeout, NULL);	
-			os_timer_arm(&timer_extcon, EXT_WAIT_TIME, false);
-			break;    
-		
-		// If the discovery times out, clear the config and reboot to get back to config mode
-		case SIG_DISCOVERY | PAR_DISCOVERY_TIMEOUT:
-			PRINT_DEBUG(DEBUG_LOW, "erasing config\r\n");
-
-                	sint8 flash_result = FLASH_ERASE(USER_DATA_START_SECT);
-                	if (flash_result != SPI_FLASH_RESULT_OK) {
-                        	PRINT_DEBUG(DEBUG_ERR, "ERROR: flash erase failed\r\n");
-				TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
-                        	break;
-                	}
-
-			system_restart();
-			break;
-		
-		// If a discovery packet is received, proceed to connect to the found system
-		case SIG_DISCOVERY | PAR_DISCOVERY_FOUND:
-			os_timer_disarm(&timer_extcon);
-			TASK_START(user_espconnect_init, 0, 0);
-			break;
-
-		// Once the system is connected to the exterior, initialize the humidity readings and tachometer, then start the webserver
-		case SIG_DISCOVERY | PAR_DISCOVERY_CONNECTED:
-			PRINT_DEBUG(DEBUG_LOW, "initiating humidity readings\r\n");
-			os_timer_setfn(&timer_humidity, user_read_humidity, NULL);		// Initialize humidity readings
-			os_timer_arm(&timer_humidity, HUMIDITY_READ_INTERVAL, true);
-			os_timer_setfn(&timer_tachometer, user_tach_calc, NULL);		// Initialize tachometer readings
-			os_timer_arm(&timer_tachometer, TACH_PERIOD, true);
-			TASK_START(user_front_init, 0, 0);
-			break;
-
-		// Error cases:
-		case SIG_DISCOVERY | PAR_DISCOVERY_CONN_FAILED:		// If the connection failed, begin the discovery process again
-			TASK_START(user_broadcast_init, 0, 0);
-			break;	
-		case SIG_DISCOVERY | PAR_DISCOVERY_MALFORMED:		// Received a malformed discovery packet. Keep going.
-			break;
-		case SIG_DISCOVERY | PAR_DISCOVERY_LISTEN_FAILURE:	// Failed to start listening for discovery packets
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL!\r\n");
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
-			break; 
-		
-		/* ----------------- */
-		/* Webserver Signals */
-		/* ----------------- */
-		
-		// Error cases:
-		case SIG_WEB | PAR_WEB_INIT_FAILURE:
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL!\r\n");
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
-			break; 
-		
-		/* --------------- */
-		/* AP Mode Signals */
-		/* --------------- */
-
-		// Once AP mode is configured and the system is serving the config webpage/listening for the exterior
-		// system, setup is complete. Control drops off and waits for notification from the aforementioned
-		// connections that either a user has entered an SSID/password or something has gone wrong.
-		case SIG_APMODE | PAR_APMODE_SETUP_COMPLETE:
-			PRINT_DEBUG(DEBUG_LOW, "apmode setup completed\r\n");
-			break;
-
-		// Once the system has received/saved an SSID/pass from a user, continually attempt to send
-		// the credentials to the exterior system until acknowledgement is received from it.
-		case SIG_APMODE | PAR_APMODE_CONFIG_RECV:
-			PRINT_DEBUG(DEBUG_LOW, "WiFi details obtained from user\r\n");
-			os_timer_setfn(&timer_extfwd, user_ext_send_cred, NULL);
-			os_timer_arm(&timer_extfwd, 1000, true);
-			break;	
-		
-		// Once the exterior has accepted wifi credentials, perform AP mode cleanup and switch back
-		// to station mode
-		case SIG_APMODE | PAR_APMODE_EXT_ACCEPT:
-			PRINT_DEBUG(DEBUG_LOW, "exterior has accepted WiFi credentials\r\n");
-			os_timer_disarm(&timer_extfwd);
-			TASK_START(user_apmode_cleanup, 0, 0);
-			break;
-
-		// Once cleanup is complete, launch a new AP scan
-		case SIG_APMODE | PAR_APMODE_CLEANUP_COMPLETE:
-			PRINT_DEBUG(DEBUG_LOW, "AP mode cleanup completed\r\n");
-			TASK_START(user_scan, 0, 0);
-			return;
-
-		// Error cases:
-		case SIG_APMODE | PAR_APMODE_SEND_FAILURE:		// Failed to send data to the exterior. Ignore, it will try again
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: ignoring\r\n");
-			break;
-		case SIG_APMODE | PAR_APMODE_FLASH_FAILURE:		// Failed to erase flash data
-		case SIG_APMODE | PAR_APMODE_EXT_INIT_FAILURE:		// Failed to open port to listen for exterior system
-		case SIG_APMODE | PAR_APMODE_WEB_INIT_FAILURE:		// Failed to open webserver
-		case SIG_APMODE | PAR_APMODE_DHCP_CONFIG_FAILURE:	// Failed to configure DHCP/IP settings
-		case SIG_APMODE | PAR_APMODE_MODE_CONFIG_FAILURE:	// Failed to configure AP mode
-		case SIG_APMODE | PAR_APMODE_AP_MODE_FAILURE:		// Failed to enter AP mode
-			PRINT_DEBUG(DEBUG_ERR, "RESPONSE: FATAL!\r\n"); 
-			TASK_RETURN(SIG_CONTROL, PAR_CONTROL_ERR_FATAL);
-			break;	
-
-		};	
+	user_dispatch(&ctl_machine, e);
 
 	return;
 };
@@ -283,7 +340,7 @@ void ICACHE_FLASH_ATTR user_gpio_init(void)
 
 	// Initialize HW timer
 	hw_timer_init(FRC1_SOURCE, 0);
-	hw_timer_set_func(user_fire_triac); 
+	hw_timer_set_pulse_func(user_fire_triac, user_release_triac);
 	
 	// Initialize ZCD
 	gpio_output_set(0, 0, 0, ZCD_BIT);     					// Set ZCD pin as input
@@ -0,0 +1,123 @@
+// user_pid.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_pid.h"
+
+// Feed-forward table, calibrated against the phase cut RMS voltage of the fan supply
+// and refined at run time. Delays are held for a SUPPLY_HALF_NOM half cycle and scaled
+// to the measured one on lookup, so the firing angle is the same on any grid
+static sint32 ff_table[FF_TABLE_N] = {5300, 4944, 4518, 4055, 3528, 2873, 2300};
+
+static float pid_integral = 0;		// Integral term in us
+static sint32 pid_last_rpm = 0;		// Measurement at the previous update
+static bool pid_primed = false;		// False until the first update after a reset
+static uint8 pid_settled = 0;		// Set once an update has landed within FF_LEARN_BAND
+
+static void ICACHE_FLASH_ATTR user_ff_learn(sint32 rpm, sint32 delay);
+
+void ICACHE_FLASH_ATTR user_pid_reset(void)
+{
+	pid_integral = 0;
+	pid_last_rpm = 0;
+	pid_primed = false;
+	pid_settled = 0;
+
+	return;
+};
+
+sint32 ICACHE_FLASH_ATTR user_ff_delay(sint32 rpm)
+{
+	sint32 i = 0;		// Table index below rpm
+	sint32 frac = 0;	// Distance above entry i, in RPM
+	sint32 delay = 0;	// Interpolated delay
+
+	if (rpm <= FF_RPM_START) {
+		delay = ff_table[0];
+	} else if (rpm >= FF_RPM_START + (FF_TABLE_N - 1) * FF_RPM_STEP) {
+		delay = ff_table[FF_TABLE_N - 1];
+	} else {
+		i = (rpm - FF_RPM_START) / FF_RPM_STEP;
+		frac = (rpm - FF_RPM_START) - (i * FF_RPM_STEP);
+		delay = ff_table[i] + ((ff_table[i + 1] - ff_table[i]) * frac) / FF_RPM_STEP;
+	}
+	delay = (delay * SUPPLY_HALF_CYCLE) / SUPPLY_HALF_NOM;
+
+	delay = (delay > DELAY_BOUNDH) ? DELAY_BOUNDH : delay;
+	delay = (delay < DELAY_BOUNDL) ? DELAY_BOUNDL : delay;
+	return delay;
+};
+
+// Application Function: user_ff_learn(sint32 rpm, sint32 delay)
+// Desc: Moves the two table entries either side of rpm towards the delay which was
+//	found to hold the fan at that speed, weighted by how close each entry is
+static void ICACHE_FLASH_ATTR user_ff_learn(sint32 rpm, sint32 delay)
+{
+	sint32 i = 0;		// Table index below rpm
+	float w = 0;		// Weight of entry i + 1
+	float err = 0;		// Table error at rpm, in us
+
+	if ((rpm < FF_RPM_START) || (rpm >= FF_RPM_START + (FF_TABLE_N - 1) * FF_RPM_STEP)) {
+		return;
+	}
+
+	i = (rpm - FF_RPM_START) / FF_RPM_STEP;
+	w = (float)((rpm - FF_RPM_START) - (i * FF_RPM_STEP)) / FF_RPM_STEP;
+	err = FF_LEARN_RATE * (delay - user_ff_delay(rpm)) * SUPPLY_HALF_NOM / SUPPLY_HALF_CYCLE;
+	ff_table[i] += (sint32)(err * (1 - w));
+	ff_table[i + 1] += (sint32)(err * w);
+
+	return;
+};
+
+sint32 ICACHE_FLASH_ATTR user_pid_update(sint32 desired, sint32 measured, uint32 dt)
+{
+	float t = (float)dt / 1000;			// Update period in s
+	sint32 err = measured - desired;		// RPM error
+	sint32 ff = user_ff_delay(desired);		// Feed-forward delay
+	float p = PID_KP * err;				// Proportional term
+	float d = 0;					// Derivative term
+	float i_next = pid_integral + PID_KI * err * t;	// Integral if this step is accumulated
+	float out = 0;					// Unclamped output
+	sint32 ff_new = 0;				// Feed-forward delay after learning
+
+	if (pid_primed) {
+		d = PID_KD * (measured - pid_last_rpm) / t;
+	}
+	pid_last_rpm = measured;
+	pid_primed = true;
+
+	// Anti-windup: hold the integral while the output is pinned and the
+	// error would push it further past the bound. Large errors after a set
+	// point change are left to the feed-forward and proportional terms,
+	// since the lagging tach reading would otherwise wind the integral up
+	out = ff + p + i_next + d;
+	if (!((out > DELAY_BOUNDH) && (err > 0)) && !((out < DELAY_BOUNDL) && (err < 0)) &&
+	    (err < PID_I_BAND) && (err > -PID_I_BAND)) {
+		pid_integral = i_next;
+	}
+	pid_integral = (ff + pid_integral > DELAY_BOUNDH) ? (DELAY_BOUNDH - ff) : pid_integral;
+	pid_integral = (ff + pid_integral < DELAY_BOUNDL) ? (DELAY_BOUNDL - ff) : pid_integral;
+
+	out = ff + p + pid_integral + d;
+	out = (out > DELAY_BOUNDH) ? DELAY_BOUNDH : out;
+	out = (out < DELAY_BOUNDL) ? DELAY_BOUNDL : out;
+
+	// Refine the table once the set point has been held. The integral then takes
+	// back whatever the table moved by, so the output does not jump
+	if ((err < FF_LEARN_BAND) && (err > -FF_LEARN_BAND)) {
+		if (pid_settled < 1) {
+			pid_settled++;
+		} else {
+			user_ff_learn(measured, (sint32)out);
+			ff_new = user_ff_delay(desired);
+			if (ff_new != ff) {
+				pid_integral -= ff_new - ff;
+				PRINT_DEBUG(DEBUG_HIGH, "ff table learned delay=%d at rpm=%d\r\n", (sint32)out, measured);
+			}
+		}
+	} else {
+		pid_settled = 0;
+	}
+
+	return (sint32)out;
+};
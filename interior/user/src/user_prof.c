@@ -0,0 +1,120 @@
+// user_prof.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_prof.h"
+
+#ifdef PROF_ENABLED
+
+// Region names, indexed by PROF_REGION
+static const char *prof_names[PROF_REGION_N] = {
+	"gpio_isr",
+	"fire_triac",
+	"read_humidity",
+	"tach_calc",
+	"ws_update",
+};
+
+static struct user_prof_region prof_table[PROF_REGION_N];
+
+void user_prof_record(uint8 region, uint32 ticks)
+{
+	struct user_prof_region *r = &prof_table[region];
+	uint8 b = 0;		// Histogram bucket
+
+	if ((r->count == 0) || (ticks < r->min)) {
+		r->min = ticks;
+	};
+	if (ticks > r->max) {
+		r->max = ticks;
+	};
+	r->count++;
+	r->total += ticks;
+
+	if (ticks != 0) {
+		b = 31 - __builtin_clz(ticks);
+	};
+	r->hist[(b < PROF_BUCKET_N) ? b : PROF_BUCKET_N - 1]++;
+
+	return;
+};
+
+// Application Function: user_prof_copy(uint8 region, struct user_prof_region *r)
+// Desc: Copies a region with interrupts masked, so an ISR region is not torn
+static void ICACHE_FLASH_ATTR user_prof_copy(uint8 region, struct user_prof_region *r)
+{
+	ETS_INTR_LOCK();
+	*r = prof_table[region];
+	ETS_INTR_UNLOCK();
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_prof_print(void)
+{
+	struct user_prof_region r;	// Region snapshot
+	uint8 i = 0;			// Region index
+	uint8 b = 0;			// Bucket index
+
+	os_printf("prof: ticks_per_us=%d\r\n", PROF_TICKS_PER_US);
+	for (i = 0; i < PROF_REGION_N; i++) {
+		user_prof_copy(i, &r);
+		if (r.count == 0) {
+			continue;
+		};
+		os_printf("prof: %s count=%d min=%d max=%d mean=%d hist=",
+			prof_names[i], r.count, r.min, r.max, (uint32)(r.total / r.count));
+		for (b = 0; b < PROF_BUCKET_N; b++) {
+			if (r.hist[b] != 0) {
+				os_printf(" %d:%d", b, r.hist[b]);
+			};
+		};
+		os_printf("\r\n");
+	};
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_prof_json(struct user_json_writer *w)
+{
+	struct user_prof_region r;	// Region snapshot
+	uint8 i = 0;			// Region index
+	uint8 b = 0;			// Bucket index
+	uint8 top = 0;			// Buckets up to the highest non-empty one
+
+	user_json_open(w, NULL, '{');
+	user_json_open(w, "prof", '{');
+	user_json_int(w, "ticks_per_us", PROF_TICKS_PER_US);
+	user_json_open(w, "regions", '[');
+	for (i = 0; i < PROF_REGION_N; i++) {
+		user_prof_copy(i, &r);
+		user_json_open(w, NULL, '{');
+		user_json_str(w, "name", prof_names[i]);
+		user_json_int(w, "count", r.count);
+		user_json_int(w, "min", r.min);
+		user_json_int(w, "max", r.max);
+		user_json_int(w, "mean", (r.count != 0) ? (uint32)(r.total / r.count) : 0);
+		for (top = PROF_BUCKET_N; (top > 0) && (r.hist[top - 1] == 0); top--);
+		user_json_open(w, "hist", '[');
+		for (b = 0; b < top; b++) {
+			user_json_int(w, NULL, r.hist[b]);
+		};
+		user_json_close(w, ']');
+		user_json_close(w, '}');
+	};
+	user_json_close(w, ']');
+	user_json_close(w, '}');
+	user_json_close(w, '}');
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_prof_reset(void)
+{
+	ETS_INTR_LOCK();
+	os_memset(prof_table, 0, sizeof(prof_table));
+	ETS_INTR_UNLOCK();
+
+	return;
+};
+
+#endif
@@ -0,0 +1,90 @@
+// user_telemetry.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_telemetry.h"
+
+static uint16 tlm_now[TLM_FIELD_N];	// Latest sample
+static uint16 tlm_sent[TLM_FIELD_N];	// Values as of the last frame sent
+static uint8 tlm_seq = 0;		// Sequence number of the last frame
+static uint8 tlm_count = 0;		// Updates since the last key frame
+
+uint16 ICACHE_FLASH_ATTR user_tlm_fixed(float val, float scale)
+{
+	val *= scale;
+	if (val <= 0) {
+		return 0;
+	};
+	if (val >= 65535.0f) {
+		return 0xFFFF;
+	};
+
+	return (uint16)(val + 0.5f);
+};
+
+uint16 ICACHE_FLASH_ATTR user_tlm_clamp(sint32 val)
+{
+	if (val < 0) {
+		return 0;
+	};
+	if (val > 0xFFFF) {
+		return 0xFFFF;
+	};
+
+	return val;
+};
+
+uint16 ICACHE_FLASH_ATTR user_tlm_next(void)
+{
+	uint16 mask = 0;	// Changed fields
+	uint8 i = 0;		// Field index
+
+	tlm_now[TLM_HUM_INT] = user_tlm_fixed(sensor_data_int, 100);
+	tlm_now[TLM_HUM_EXT] = user_tlm_fixed(sensor_data_ext, 100);
+	tlm_now[TLM_RPM] = user_tlm_clamp(measured_rpm);
+	tlm_now[TLM_DELAY] = user_tlm_clamp(drive_delay);
+	tlm_now[TLM_THRESHOLD] = user_tlm_fixed(threshold_humidity, 100);
+	tlm_now[TLM_MODES] = (fan_mode & 0x0F) | ((control_mode & 0x0F) << 4);
+	tlm_now[TLM_STATUS] = sensor_status | (drive_flag ? TLM_STATUS_DRIVE : 0);
+
+	if (++tlm_count >= TLM_KEY_N) {
+		tlm_count = 0;
+		mask = TLM_ALL;
+	} else {
+		for (i = 0; i < TLM_FIELD_N; i++) {
+			if (tlm_now[i] != tlm_sent[i]) {
+				mask |= 1 << i;
+			};
+		};
+	};
+
+	if (mask != 0) {
+		os_memcpy(tlm_sent, tlm_now, sizeof(tlm_sent));
+		tlm_seq++;
+	};
+
+	return mask;
+};
+
+uint8 ICACHE_FLASH_ATTR user_tlm_frame(uint8 *buf, uint16 mask)
+{
+	uint8 payload[4 + (2 * TLM_FIELD_N)];	// Telemetry payload
+	uint8 len = 0;				// Payload length
+	uint8 hdr_len = 0;			// WebSocket header length
+	uint8 i = 0;				// Field index
+
+	payload[len++] = TLM_VERSION;
+	payload[len++] = tlm_seq;
+	payload[len++] = mask & 0xFF;
+	payload[len++] = mask >> 8;
+	for (i = 0; i < TLM_FIELD_N; i++) {
+		if (mask & (1 << i)) {
+			payload[len++] = tlm_sent[i] & 0xFF;
+			payload[len++] = tlm_sent[i] >> 8;
+		};
+	};
+
+	hdr_len = user_ws_frame_header(buf, WS_OP_BINARY, len);
+	os_memcpy(&buf[hdr_len], payload, len);
+
+	return hdr_len + len;
+};
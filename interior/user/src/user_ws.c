@@ -0,0 +1,254 @@
+// user_ws.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_ws.h"
+
+/* Websocket Frame Structure (RFC 6455) ======================= */
+/*                                                              */
+/* Byte 0:                                                      */
+/*      Bit 7:    FIN (1 if last frame of a message)            */
+/*      Bit 4-6:  RSV (Reserved, must be 0)                     */
+/*      Bit 0-3:  OPCODE (denotes frame type)                   */
+/* Byte 1:                                                      */
+/*      Bit 7:    MASK (1 if data is masked, always from client)*/
+/*      Bit 0-6:  Payload Length (length of actual data)        */
+/* ----- If Payload Length is 126        ---------------------- */
+/* Byte 2-3:  Extended payload length, big endian               */
+/* ----- If Payload Length is 127 ----------------------------- */
+/* Byte 2-9:  Extended payload length, big endian               */
+/* ---- Then, if masked --------------------------------------- */
+/* 4 bytes:   Masking key                                       */
+/* ---- Always ------------------------------------------------ */
+/* Payload data                                                 */
+/* ============================================================ */
+
+void ICACHE_FLASH_ATTR user_ws_parser_init(struct user_ws_parser *p)
+{
+	os_memset(p, 0, sizeof(*p));
+	p->state = WS_STATE_HDR0;
+	p->msg_opcode = WS_OP_CONT;
+
+	return;
+};
+
+// Application Function: user_ws_fail(struct user_ws_parser *p, uint16 code)
+// Desc: Puts the parser into the error state
+// Returns:
+//	code
+static uint16 ICACHE_FLASH_ATTR user_ws_fail(struct user_ws_parser *p, uint16 code)
+{
+	PRINT_DEBUG(DEBUG_ERR, "websocket protocol error, close=%d\r\n", code);
+	p->state = WS_STATE_ERROR;
+	p->close_code = code;
+
+	return code;
+};
+
+// Application Function: user_ws_frame_start(struct user_ws_parser *p)
+// Desc: Checks a frame header once it is complete and prepares for its payload
+// Returns:
+//	0, or the close status code if the frame is not allowed
+static uint16 ICACHE_FLASH_ATTR user_ws_frame_start(struct user_ws_parser *p)
+{
+	p->frame_got = 0;
+
+	// Control frames may not be fragmented and carry at most 125 bytes
+	if (p->opcode & 0x08) {
+		if (!p->fin || (p->frame_len > WS_CTL_MAX)) {
+			return user_ws_fail(p, WS_CLOSE_PROTOCOL);
+		};
+		p->ctl_len = 0;
+		return 0;
+	};
+
+	// A continuation needs a message to continue, and a new message may not
+	// start until the last one is finished
+	if (p->opcode == WS_OP_CONT) {
+		if (p->msg_opcode == WS_OP_CONT) {
+			return user_ws_fail(p, WS_CLOSE_PROTOCOL);
+		};
+	} else {
+		if (p->msg_opcode != WS_OP_CONT) {
+			return user_ws_fail(p, WS_CLOSE_PROTOCOL);
+		};
+		p->msg_opcode = p->opcode;
+		p->msg_len = 0;
+	};
+
+	if (p->frame_len > (uint32)(WS_MSG_MAX - p->msg_len)) {
+		return user_ws_fail(p, WS_CLOSE_TOO_BIG);
+	};
+
+	return 0;
+};
+
+// Application Function: user_ws_frame_end(struct user_ws_parser *p, user_ws_msg_fn cb, void *arg)
+// Desc: Finishes a frame, emitting it if it completes a message or is a control frame
+static void ICACHE_FLASH_ATTR user_ws_frame_end(struct user_ws_parser *p, user_ws_msg_fn cb, void *arg)
+{
+	p->state = WS_STATE_HDR0;
+
+	if (p->opcode & 0x08) {
+		p->ctl[p->ctl_len] = '\0';
+		cb(arg, p->opcode, p->ctl, p->ctl_len);
+	} else if (p->fin) {
+		p->msg[p->msg_len] = '\0';
+		cb(arg, p->msg_opcode, p->msg, p->msg_len);
+		p->msg_opcode = WS_OP_CONT;
+		p->msg_len = 0;
+	};
+
+	return;
+};
+
+uint16 ICACHE_FLASH_ATTR user_ws_parse(struct user_ws_parser *p, uint8 *data, uint16 len, user_ws_msg_fn cb, void *arg)
+{
+	uint16 i = 0;		// Position in data
+	uint16 n = 0;		// Payload bytes taken from data at once
+	uint8 b = 0;		// Header byte
+	uint16 code = 0;	// Close status from a failed check
+
+	while (i < len) {
+		switch (p->state) {
+
+		case WS_STATE_HDR0:
+			b = data[i++];
+			p->fin = (b & 0x80) != 0;
+			p->opcode = b & 0x0F;
+			if ((b & 0x70) ||							// No extensions are negotiated
+			    ((p->opcode > WS_OP_BINARY) && (p->opcode < WS_OP_CLOSE)) ||	// Reserved data opcodes
+			    (p->opcode > WS_OP_PONG)) {						// Reserved control opcodes
+				return user_ws_fail(p, WS_CLOSE_PROTOCOL);
+			};
+			p->state = WS_STATE_HDR1;
+			break;
+
+		case WS_STATE_HDR1:
+			b = data[i++];
+			if (!(b & 0x80)) {		// Frames from a client must be masked
+				return user_ws_fail(p, WS_CLOSE_PROTOCOL);
+			};
+			p->frame_len = b & 0x7F;
+			if (p->frame_len == 126) {
+				p->need = 2;
+			} else if (p->frame_len == 127) {
+				p->need = 8;
+			} else {
+				p->need = 0;
+			};
+			if (p->need > 0) {
+				p->frame_len = 0;
+				p->state = WS_STATE_LEN;
+			} else {
+				p->need = 4;
+				p->state = WS_STATE_MASK;
+			};
+			break;
+
+		case WS_STATE_LEN:
+			b = data[i++];
+			p->need--;
+			if ((p->need >= 4) && (b != 0)) {	// Upper half of a 64 bit length, far beyond WS_MSG_MAX
+				return user_ws_fail(p, WS_CLOSE_TOO_BIG);
+			};
+			p->frame_len = (p->frame_len << 8) | b;
+			if (p->need == 0) {
+				p->need = 4;
+				p->state = WS_STATE_MASK;
+			};
+			break;
+
+		case WS_STATE_MASK:
+			p->mask[4 - p->need] = data[i++];
+			if (--p->need > 0) {
+				break;
+			};
+			code = user_ws_frame_start(p);
+			if (code != 0) {
+				return code;
+			};
+			if (p->frame_len == 0) {
+				user_ws_frame_end(p, cb, arg);
+			} else {
+				p->state = WS_STATE_PAYLOAD;
+			};
+			break;
+
+		case WS_STATE_PAYLOAD:
+			// Take as much of the frame as this chunk holds, unmask it in place
+			// and append it to the control or message buffer
+			n = len - i;
+			if (n > p->frame_len - p->frame_got) {
+				n = p->frame_len - p->frame_got;
+			};
+			user_ws_unmask(&data[i], n, p->mask, p->frame_got);
+			if (p->opcode & 0x08) {
+				os_memcpy(&p->ctl[p->ctl_len], &data[i], n);
+				p->ctl_len += n;
+			} else {
+				os_memcpy(&p->msg[p->msg_len], &data[i], n);
+				p->msg_len += n;
+			};
+			p->frame_got += n;
+			i += n;
+			if (p->frame_got == p->frame_len) {
+				user_ws_frame_end(p, cb, arg);
+			};
+			break;
+
+		case WS_STATE_ERROR:
+		default:
+			return p->close_code;
+		};
+	};
+
+	return 0;
+};
+
+void ICACHE_FLASH_ATTR user_ws_unmask(uint8 *data, uint32 len, const uint8 *mask, uint32 offset)
+{
+	uint32 key = 0;		// Mask rotated to line up with the current word
+	uint32 *word = NULL;	// Aligned word pointer into data
+	uint32 i = 0;		// Loop index
+
+	// Each byte is unmasked by XORing it with byte (i % 4) of the mask, counted from the
+	// start of the frame payload. Bytes before the first word boundary go one at a time
+	while ((len > 0) && ((size_t)data & 3)) {
+		*data++ ^= mask[offset++ & 3];
+		len--;
+	};
+
+	// The rest is XORed a word at a time. The key is built in memory order so it
+	// matches the bytes of each word whatever the byte order
+	for (i = 0; i < 4; i++) {
+		((uint8 *)&key)[i] = mask[(offset + i) & 3];
+	};
+	word = (uint32 *)data;
+	for (i = 0; i < (len >> 2); i++) {
+		word[i] ^= key;
+	};
+
+	// Tail; offset is still congruent mod 4 after whole words
+	data += len & ~3;
+	offset += len & ~3;
+	for (i = 0; i < (len & 3); i++) {
+		data[i] ^= mask[(offset + i) & 3];
+	};
+
+	return;
+};
+
+uint8 ICACHE_FLASH_ATTR user_ws_frame_header(uint8 *buf, uint8 opcode, uint16 len)
+{
+	buf[0] = 0x80 | opcode;		// Unfragmented
+	if (len < 126) {
+		buf[1] = len;		// Unmasked, short length
+		return 2;
+	};
+
+	buf[1] = 126;			// Unmasked, 16 bit length
+	buf[2] = len >> 8;
+	buf[3] = len & 0xFF;
+
+	return 4;
+};
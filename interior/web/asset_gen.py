@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+# asset_gen.py
+# Authors: Christian Auspland & Matthew Blanchard
+# Description: Compresses the web front end into a C source file for the
+#	firmware. Every asset is gzipped once at build time and stored as a
+#	flash resident (ICACHE_RODATA_ATTR) array, along with its length and an
+#	ETag taken from the CRC-32 of the compressed bytes. The output is the
+#	same for the same input, so the ETag only changes with the page.
+#
+#	asset_gen.py <output.c> <path> <file> [<path> <file> ...]
+
+import gzip
+import os
+import sys
+import zlib
+
+CONTENT_TYPES = {
+	".html": "text/html",
+	".js": "application/javascript",
+	".css": "text/css",
+}
+
+def emit_array(out, name, data):
+	out.write("static const uint8 %s[] ICACHE_RODATA_ATTR __attribute__((aligned(4))) = {\n" % name)
+	for i in range(0, len(data), 12):
+		out.write("\t" + " ".join("0x%02x," % b for b in data[i:i + 12]) + "\n")
+	out.write("};\n\n")
+
+def main(argv):
+	if (len(argv) < 4) or (len(argv) % 2 != 0):
+		sys.stderr.write("usage: asset_gen.py <output.c> <path> <file> [<path> <file> ...]\n")
+		return 1
+
+	assets = []
+	for path, file in zip(argv[2::2], argv[3::2]):
+		ext = os.path.splitext(file)[1]
+		if ext not in CONTENT_TYPES:
+			sys.stderr.write("asset_gen.py: no content type for %s\n" % file)
+			return 1
+		with open(file, "rb") as f:
+			raw = f.read()
+		# mtime=0 keeps the output, and so the ETag, stable between builds
+		data = gzip.compress(raw, compresslevel=9, mtime=0)
+		assets.append((path, file, CONTENT_TYPES[ext], data, len(raw)))
+
+	with open(argv[1], "w") as out:
+		out.write("// %s\n" % os.path.basename(argv[1]))
+		out.write("// Generated by asset_gen.py, do not edit. Sources:\n")
+		for path, file, ctype, data, raw_len in assets:
+			out.write("//\t%s: %s, %d bytes, %d gzipped\n" % (path, file, raw_len, len(data)))
+		out.write("\n#include \"user_asset.h\"\n\n")
+		for i, (path, file, ctype, data, raw_len) in enumerate(assets):
+			emit_array(out, "asset_data_%d" % i, data)
+		out.write("const struct user_asset user_assets[] = {\n")
+		for i, (path, file, ctype, data, raw_len) in enumerate(assets):
+			out.write("\t{ \"%s\", \"%s\", \"\\\"%08x\\\"\", asset_data_%d, %d },\n" %
+				(path, ctype, zlib.crc32(data) & 0xFFFFFFFF, i, len(data)))
+		out.write("};\n")
+		out.write("const uint8 user_asset_n = %d;\n" % len(assets))
+
+	return 0
+
+if __name__ == "__main__":
+	sys.exit(main(sys.argv))
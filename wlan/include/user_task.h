@@ -30,6 +30,7 @@ os_event_t * user_msg_queue_2;
 
 // Timers
 os_timer_t timer_reboot;
+os_timer_t timer_heap;
 
 // Task Calling Macros
 #define TASK_RETURN(sig,par) 		system_os_post(USER_TASK_PRIO_2, (sig), (par))
@@ -0,0 +1,65 @@
+// user_heap.c
+// Authors: Christian Auspland & Matthew Blanchard
+
+#include "user_heap.h"
+
+static struct user_heap_stats heap;
+
+// Application Function: user_heap_take(uint32 *block, uint32 size)
+// Desc: Counts a new block and hides its header
+// Returns:
+//	The caller's part of the block, or NULL if block is NULL
+static void * ICACHE_FLASH_ATTR user_heap_take(uint32 *block, uint32 size)
+{
+	if (block == NULL) {
+		heap.failed++;
+		return NULL;
+	};
+
+	block[0] = size;
+	heap.allocs++;
+	heap.live += size;
+	if (heap.live > heap.peak) {
+		heap.peak = heap.live;
+	};
+
+	return (uint8 *)block + HEAP_HEADER;
+};
+
+void * ICACHE_FLASH_ATTR user_heap_malloc(uint32 size)
+{
+	size += HEAP_HEADER;
+
+	return user_heap_take((uint32 *)os_malloc(size), size);
+};
+
+void * ICACHE_FLASH_ATTR user_heap_zalloc(uint32 size)
+{
+	size += HEAP_HEADER;
+
+	return user_heap_take((uint32 *)os_zalloc(size), size);
+};
+
+void ICACHE_FLASH_ATTR user_heap_free(void *p)
+{
+	uint32 *block = NULL;	// Start of the block, at its header
+
+	if (p == NULL) {
+		return;
+	};
+
+	block = (uint32 *)((uint8 *)p - HEAP_HEADER);
+	heap.frees++;
+	heap.live -= block[0];
+	os_free(block);
+
+	return;
+};
+
+void ICACHE_FLASH_ATTR user_heap_stats(struct user_heap_stats *s)
+{
+	*s = heap;
+	s->free_heap = system_get_free_heap_size();
+
+	return;
+};
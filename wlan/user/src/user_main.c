@@ -8,11 +8,13 @@
 #include <mem.h>
 #include "user_task.h"
 #include "user_ap.h"
+#include "user_heap.h"
 
 // Function prototypes
 void ICACHE_FLASH_ATTR user_init(void);				// First step initialization function. Handoff from bootloader.
 void ICACHE_FLASH_ATTR user_task_init(void);			// Task initialization. Hands off to the control task.
 void ICACHE_FLASH_ATTR user_control_task(os_event_t *e);	// Main control task
+void ICACHE_FLASH_ATTR user_heap_report(void *parg);		// Prints the heap counters
 
 // User Task: user_init()
 // Desc: Initialization. The ESP8266 hooks into this function after boot.
@@ -38,9 +40,13 @@ void ICACHE_FLASH_ATTR user_init(void)
 void ICACHE_FLASH_ATTR user_task_init(void)
 {
         // Allocate space for message queues
-        user_msg_queue_0 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
-        user_msg_queue_1 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
-        user_msg_queue_2 = (os_event_t *)os_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+        user_msg_queue_0 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+        user_msg_queue_1 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+        user_msg_queue_2 = (os_event_t *)user_heap_malloc(sizeof(os_event_t) * MSG_QUEUE_LENGTH);
+
+        // Print the heap counters now and then
+        os_timer_setfn(&timer_heap, user_heap_report, NULL);
+        os_timer_arm(&timer_heap, HEAP_REPORT_TIME, true);
 
         // Register control task and begin control
         system_os_task(user_control_task, USER_TASK_PRIO_2, user_msg_queue_2, MSG_QUEUE_LENGTH);
@@ -49,6 +55,19 @@ void ICACHE_FLASH_ATTR user_task_init(void)
 	return;
 };
 
+// Callback Function: user_heap_report(void *parg)
+// Desc: Prints the heap counters, see user_heap.h
+void ICACHE_FLASH_ATTR user_heap_report(void *parg)
+{
+	struct user_heap_stats s;	// Counters
+
+	user_heap_stats(&s);
+	os_printf("heap live=%d peak=%d allocs=%d frees=%d failed=%d free=%d\r\n",
+		s.live, s.peak, s.allocs, s.frees, s.failed, s.free_heap);
+
+	return;
+};
+
 // User Task: user_control_task(os_event_t *e)
 // Desc: Maximum priority control task which calls other tasks
 //	based on the results of previous tasks